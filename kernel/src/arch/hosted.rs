@@ -39,6 +39,7 @@ enum ExitMessage {
 thread_local!(static NETWORK_LISTEN_ADDRESS: RefCell<SocketAddr> = RefCell::new(SocketAddr::new(IpAddr::V4(Ipv4Addr::new(127, 0, 0, 1)), 0)));
 thread_local!(static SEND_ADDR: RefCell<Option<Sender<SocketAddr>>> = RefCell::new(None));
 thread_local!(static PID1_KEY: RefCell<[u8; 16]> = RefCell::new([0u8; 16]));
+thread_local!(static TRACE_EPOCH: std::time::Instant = std::time::Instant::now());
 
 #[cfg(test)]
 pub fn set_pid1_key(new_key: [u8; 16]) {
@@ -73,6 +74,12 @@ fn generate_pid_key() -> [u8; 16] {
     process_key
 }
 
+/// There's no cycle counter to read when running hosted, so trace events are
+/// timestamped with the number of nanoseconds since the kernel first asked.
+pub fn timestamp() -> u64 {
+    TRACE_EPOCH.with(|epoch| epoch.elapsed().as_nanos() as u64)
+}
+
 #[allow(dead_code)]
 pub fn current_pid() -> PID {
     crate::arch::process::current_pid()
@@ -127,6 +134,8 @@ fn handle_connection(
                         ServerMessage::ServerPacketWithData(packet_data, v)
                     } else if packet_data[1]
                         == xous_kernel::syscall::SysCallNumber::ReturnMemory as _
+                        || packet_data[1]
+                            == xous_kernel::syscall::SysCallNumber::SendMessageBatch as _
                     {
                         let mut v = vec![0; packet_data[4]];
                         if conn.read_exact(&mut v).is_err() {
@@ -240,12 +249,8 @@ fn handle_connection(
                                     | xous_kernel::Message::BlockingScalar(_) => (),
                                 }
                             }
-                            SysCall::ReturnMemory(
-                                ref _sender,
-                                ref mut buf,
-                                ref _offset,
-                                ref _valid,
-                            ) => {
+                            SysCall::ReturnMemory(_, ref mut buf, _, _)
+                            | SysCall::SendMessageBatch(_, ref mut buf) => {
                                 let sliced_data = data.into_boxed_slice();
                                 assert_eq!(
                                     sliced_data.len(),
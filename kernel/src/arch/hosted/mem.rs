@@ -87,6 +87,7 @@ pub fn lend_page_inner(
     _dest_space: &MemoryMapping,
     _dest_addr: *mut u8,
     _mutable: bool,
+    _shared: bool,
 ) -> Result<usize, Error> {
     unimplemented!()
 }
@@ -113,3 +114,10 @@ pub fn hand_page_to_user(_virt: *mut u8) -> Result<(), Error> {
 pub fn virt_to_phys(virt: usize) -> Result<usize, Error> {
     Ok(virt)
 }
+
+/// Copy a value out of the current process' memory. In hosted mode any such
+/// memory has already been copied into a kernel buffer, which may not be
+/// aligned for `T`.
+pub unsafe fn read_user<T: Copy>(src: *const T) -> T {
+    core::ptr::read_unaligned(src)
+}
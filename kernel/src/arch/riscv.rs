@@ -45,6 +45,22 @@ pub fn init() {
     let mut wfi_kernel_csr = CSR::new(WFI_KERNEL.base as *mut u32);
     wfi_kernel_csr.wfo(utra::wfi::IGNORE_LOCKED_IGNORE_LOCKED, 1);
 
+    // Give every process a read-only view of the ticktimer registers, so that reading the time
+    // doesn't take a round trip through the ticktimer server. The page lives in the shared top
+    // megapage and has the user bit set. It isn't claimed, so the ticktimer server can still map
+    // the device and remains its owner.
+    MemoryManager::with_mut(|memory_manager| {
+        mem::map_page_inner(
+            memory_manager,
+            PID::new(1).unwrap(),
+            utra::ticktimer::HW_TICKTIMER_BASE,
+            xous_kernel::arch::TICKTIMER_PAGE,
+            MemoryFlags::R,
+            true,
+        )
+    })
+    .expect("unable to map ticktimer");
+
     unsafe {
         sie::set_ssoft();
         sie::set_sext();
@@ -52,6 +68,27 @@ pub fn init() {
     rand::init();
 }
 
+/// Read the cycle counter, which timestamps trace events and measures CPU time.
+#[cfg(target_arch = "riscv32")]
+pub fn timestamp() -> u64 {
+    use riscv::register::{cycle, cycleh};
+    // Read the high word on either side of the low word, in case the low word
+    // wrapped in between.
+    loop {
+        let high = cycleh::read();
+        let low = cycle::read();
+        if cycleh::read() == high {
+            return ((high as u64) << 32) | low as u64;
+        }
+    }
+}
+
+/// Read the cycle counter, which timestamps trace events and measures CPU time.
+#[cfg(target_arch = "riscv64")]
+pub fn timestamp() -> u64 {
+    riscv::register::cycle::read() as u64
+}
+
 /// Put the core to sleep until an interrupt hits. Returns `true`
 /// to indicate the kernel should not exit.
 pub fn idle() -> bool {
@@ -77,6 +77,7 @@ pub extern "C" fn trap_handler(
     }
 
     let pid = current_pid();
+    crate::trace::enter_kernel();
 
     if (sc.bits() == 9) || (sc.bits() == 8) {
         // We got here because of an `ecall` instruction.  When we return, skip
@@ -90,6 +91,7 @@ pub extern "C" fn trap_handler(
         });
         let call = SysCall::from_args(a0, a1, a2, a3, a4, a5, a6, a7).unwrap_or_else(|_| {
             ArchProcess::with_current_mut(|p| unsafe {
+                crate::trace::leave_kernel(pid, tid);
                 _xous_syscall_return_result(
                     &xous_kernel::Result::Error(xous_kernel::Error::UnhandledSyscall),
                     p.current_thread(),
@@ -110,6 +112,7 @@ pub extern "C" fn trap_handler(
                 crate::arch::syscall::resume(current_pid().get() == 1, thread);
             } else {
                 // println!("Returning to address {:08x}", thread.sepc);
+                crate::trace::leave_kernel(current_pid(), crate::arch::process::current_tid());
                 unsafe { _xous_syscall_return_result(&response, thread) };
             }
         });
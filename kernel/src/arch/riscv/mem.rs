@@ -16,6 +16,9 @@ pub const EXCEPTION_STACK_TOP: usize = 0xffff_0000;
 pub const PAGE_SIZE: usize = 4096;
 const PAGE_TABLE_OFFSET: usize = 0xff40_0000;
 const PAGE_TABLE_ROOT_OFFSET: usize = 0xff80_0000;
+/// Where pages are briefly mapped while they are being zeroed. This lies in
+/// the kernel megapage, which is shared by every process.
+const ZERO_PAGE_WINDOW: usize = 0xffcb_0000;
 
 extern "C" {
     fn flush_mmu();
@@ -189,7 +192,7 @@ impl MemoryMapping {
         if l1_pt.entries[vpn1] & MMUFlags::VALID.bits() == 0 {
             let pid = crate::arch::current_pid();
             // Allocate a fresh page
-            let l0pt_phys = mm.alloc_page(pid)?;
+            let (l0pt_phys, zeroed) = mm.alloc_zeroed_page(pid)?;
 
             // Mark this entry as a leaf node (WRX as 0), and indicate
             // it is a valid page by setting "V".
@@ -207,8 +210,10 @@ impl MemoryMapping {
             )?;
 
             // Zero-out the new page
-            let page_addr = l0pt_virt as *mut usize;
-            unsafe { memset(page_addr as *mut u8, 0, PAGE_SIZE) };
+            if !zeroed {
+                let page_addr = l0pt_virt as *mut usize;
+                unsafe { memset(page_addr as *mut u8, 0, PAGE_SIZE) };
+            }
         }
 
         let ref mut l0_pt = unsafe { &mut (*(l0pt_virt as *mut LeafPageTable)) };
@@ -453,7 +458,7 @@ pub fn map_page_inner(
     // Allocate a new level 1 pagetable entry if one doesn't exist.
     if unsafe { l1_pt.add(vpn1).read_volatile() } & MMUFlags::VALID.bits() == 0 {
         // Allocate a fresh page for the level 1 page table.
-        let l0_pt_phys = mm.alloc_page(pid)?;
+        let (l0_pt_phys, zeroed) = mm.alloc_zeroed_page(pid)?;
 
         // Mark this entry as a leaf node (WRX as 0), and indicate
         // it is a valid page by setting "V".
@@ -475,7 +480,9 @@ pub fn map_page_inner(
         )?;
 
         // Zero-out the new page
-        unsafe { memset(l0_pt as *mut u8, 0, PAGE_SIZE) };
+        if !zeroed {
+            unsafe { memset(l0_pt as *mut u8, 0, PAGE_SIZE) };
+        }
     }
 
     // Ensure the entry hasn't already been mapped.
@@ -607,6 +614,7 @@ pub fn lend_page_inner(
     dest_space: &MemoryMapping,
     dest_addr: *mut u8,
     mutable: bool,
+    shared: bool,
 ) -> Result<usize, xous_kernel::Error> {
     //klog!("***lend - src: {:08x} dest: {:08x}***", src_addr as u32, dest_addr as u32);
     let entry = pagetable_entry(src_addr as usize)?;
@@ -625,8 +633,13 @@ pub fn lend_page_inner(
         Err(xous_kernel::Error::ShareViolation)?;
     }
 
-    // Strip the `VALID` flag, and set the `SHARED` flag.
-    *entry = (*entry & !MMUFlags::VALID.bits()) | MMUFlags::S.bits();
+    // Set the `SHARED` flag. Unless the page is to remain accessible to this
+    // process, also strip the `VALID` flag.
+    *entry = if shared {
+        *entry | MMUFlags::S.bits()
+    } else {
+        (*entry & !MMUFlags::VALID.bits()) | MMUFlags::S.bits()
+    };
 
     // Ensure the change takes effect.
     unsafe { flush_mmu() };
@@ -758,12 +771,22 @@ pub fn ensure_page_exists_inner(address: usize) -> Result<usize, xous_kernel::Er
         Err(xous_kernel::Error::BadAddress)?;
     }
 
-    let new_page = MemoryManager::with_mut(|mm| {
-        mm.alloc_page(crate::arch::process::current_pid())
+    let (new_page, zeroed) = MemoryManager::with_mut(|mm| {
+        mm.alloc_zeroed_page(crate::arch::process::current_pid())
             .expect("Couldn't allocate new page")
     });
-    let ppn1 = (new_page >> 22) & ((1 << 12) - 1);
-    let ppn0 = (new_page >> 12) & ((1 << 10) - 1);
+    back_reserved_page(entry, virt, new_page, zeroed);
+
+    Ok(new_page)
+}
+
+/// Map the physical page `phys` into the reserved page table entry `entry`
+/// that describes `virt`, then zero it unless it's already `zeroed` and hand
+/// it to userspace.
+fn back_reserved_page(entry: &mut usize, virt: usize, phys: usize, zeroed: bool) {
+    let flags = *entry & 0x1ff;
+    let ppn1 = (phys >> 22) & ((1 << 12) - 1);
+    let ppn0 = (phys >> 12) & ((1 << 10) - 1);
     unsafe {
         // Map the page to our process
         *entry = (ppn1 << 20)
@@ -772,7 +795,9 @@ pub fn ensure_page_exists_inner(address: usize) -> Result<usize, xous_kernel::Er
         flush_mmu();
 
         // Zero-out the page
-        memset(virt as *mut u8, 0, PAGE_SIZE);
+        if !zeroed {
+            memset(virt as *mut u8, 0, PAGE_SIZE);
+        }
 
         // Move the page into userspace
         *entry = (ppn1 << 20)
@@ -780,8 +805,80 @@ pub fn ensure_page_exists_inner(address: usize) -> Result<usize, xous_kernel::Er
             | (flags | (1 << 0) /* valid */ | (1 << 4) /* USER */ | (1 << 6) /* D */ | (1 << 7)/* A */);
         flush_mmu();
     };
+}
 
-    Ok(new_page)
+/// Ensure every page in the range `address..address + len` is backed by
+/// physical memory. This is equivalent to calling `ensure_page_exists_inner()`
+/// on each page, except reserved pages are allocated in batches, and running
+/// out of memory is reported rather than causing a panic.
+pub fn ensure_range_exists_inner(
+    mm: &mut MemoryManager,
+    address: usize,
+    len: usize,
+) -> Result<(), xous_kernel::Error> {
+    const BATCH: usize = 32;
+    let pid = crate::arch::process::current_pid();
+    let start = address & !0xfff;
+    let end = address
+        .checked_add(len)
+        .ok_or(xous_kernel::Error::BadAddress)?;
+
+    let mut virt = start;
+    while virt < end {
+        // Gather up the next batch of reserved pages.
+        let mut pending = [0usize; BATCH];
+        let mut count = 0;
+        while virt < end && count < BATCH {
+            let entry = pagetable_entry(virt).or(Err(xous_kernel::Error::BadAddress))?;
+            let flags = *entry & 0x1ff;
+            if flags & MMUFlags::VALID.bits() == 0 {
+                if flags == 0 || flags & MMUFlags::S.bits() != 0 {
+                    return Err(xous_kernel::Error::BadAddress);
+                }
+                pending[count] = virt;
+                count += 1;
+            }
+            virt += PAGE_SIZE;
+        }
+        if count == 0 {
+            continue;
+        }
+
+        let mut phys = [0usize; BATCH];
+        let zeroed = mm.alloc_zeroed_pages(pid, &mut phys[..count])?;
+        for idx in 0..count {
+            let entry = pagetable_entry(pending[idx]).expect("reserved page vanished");
+            back_reserved_page(entry, pending[idx], phys[idx], idx < zeroed);
+        }
+    }
+    Ok(())
+}
+
+/// Zero the physical page `phys`, which must not be mapped anywhere else.
+pub fn zero_page(mm: &mut MemoryManager, phys: usize) -> Result<(), xous_kernel::Error> {
+    map_page_inner(
+        mm,
+        crate::arch::process::current_pid(),
+        phys,
+        ZERO_PAGE_WINDOW,
+        MemoryFlags::R | MemoryFlags::W,
+        false,
+    )?;
+    unsafe {
+        (ZERO_PAGE_WINDOW as *mut usize).write_bytes(0, PAGE_SIZE / core::mem::size_of::<usize>())
+    };
+    unmap_page_inner(mm, ZERO_PAGE_WINDOW)?;
+    Ok(())
+}
+
+/// Copy a value out of the current process' memory. Userspace pages are not
+/// normally accessible to the kernel, so this briefly sets `sstatus.SUM`.
+/// The caller must ensure `src` is mapped and lies below `USER_AREA_END`.
+pub unsafe fn read_user<T: Copy>(src: *const T) -> T {
+    riscv::register::sstatus::set_sum();
+    let val = core::ptr::read_volatile(src);
+    riscv::register::sstatus::clear_sum();
+    val
 }
 
 /// Determine whether a virtual address has been mapped
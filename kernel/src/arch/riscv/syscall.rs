@@ -35,6 +35,10 @@ fn set_supervisor(supervisor: bool) {
 }
 
 pub fn resume(supervisor: bool, thread: &Thread) -> ! {
+    crate::trace::leave_kernel(
+        crate::arch::current_pid(),
+        crate::arch::process::current_tid(),
+    );
     sepc::write(thread.sepc);
 
     // Return to the appropriate CPU mode
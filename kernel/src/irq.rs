@@ -9,6 +9,7 @@ static mut IRQ_HANDLERS: [Option<(PID, MemoryAddress, Option<MemoryAddress>)>; 3
 #[cfg(baremetal)]
 pub fn handle(irqs_pending: usize) -> Result<xous_kernel::Result, xous_kernel::Error> {
     use crate::services::SystemServices;
+    use xous_kernel::TraceEventKind;
     // Unsafe is required here because we're accessing a static
     // mutable value, and it could be modified from various threads.
     // However, this is fine because this is run from an IRQ context
@@ -19,6 +20,7 @@ pub fn handle(irqs_pending: usize) -> Result<xous_kernel::Result, xous_kernel::E
         for irq_no in 0..IRQ_HANDLERS.len() {
             if irqs_pending & (1 << irq_no) != 0 {
                 if let Some((pid, f, arg)) = IRQ_HANDLERS[irq_no] {
+                    crate::trace::record(TraceEventKind::Irq, pid, 0, [irq_no, 0]);
                     return SystemServices::with_mut(|ss| {
                         // Disable all other IRQs and redirect into userspace
                         arch::irq::disable_all_irqs();
@@ -24,6 +24,7 @@ mod mem;
 mod server;
 mod services;
 mod syscall;
+mod trace;
 
 use services::SystemServices;
 use xous_kernel::*;
@@ -97,7 +98,9 @@ pub extern "C" fn init(arg_offset: *const u32, init_offset: *const u32, rpt_offs
 }
 
 /// Loop through the SystemServices list to determine the next PID to be run.
-/// If no process is ready, return `None`.
+/// This is the process with the highest-priority thread that is ready to run.
+/// Processes whose best threads share a priority take turns, starting with the
+/// one after `last_pid`. If no process is ready, return `None`.
 fn next_pid_to_run(last_pid: Option<PID>) -> Option<PID> {
     // PIDs are 1-indexed but arrays are 0-indexed.  By not subtracting
     // 1 from the PID when we use it as an array index, we automatically
@@ -105,33 +108,23 @@ fn next_pid_to_run(last_pid: Option<PID>) -> Option<PID> {
     let current_pid = last_pid.unwrap_or(unsafe { PID::new_unchecked(1) }).get() as usize;
 
     SystemServices::with(|system_services| {
-        for test_idx in current_pid..system_services.processes.len() {
-            if system_services.processes[test_idx].ppid.get() == 1 {
-                // print!("PID {} is owned by PID1... ", test_idx + 1);
-                if system_services.processes[test_idx].runnable() {
-                    // println!(" and is runnable");
-                    return match pid_from_usize(test_idx + 1) {
-                        Ok(x) => Some(x),
-                        Err(_) => None,
-                    };
-                }
-                // println!(" and is NOT RUNNABLE");
+        let process_count = system_services.processes.len();
+        let mut best: Option<(usize, u8)> = None;
+        for offset in 0..process_count {
+            let test_idx = (current_pid + offset) % process_count;
+            let process = &system_services.processes[test_idx];
+            if process.ppid.get() != 1 {
+                continue;
             }
-        }
-        for test_idx in 0..current_pid {
-            if system_services.processes[test_idx].ppid.get() == 1 {
-                // print!("PID {} is owned by PID1... ", test_idx + 1);
-                if system_services.processes[test_idx].runnable() {
-                    // println!(" and is runnable");
-                    return match pid_from_usize(test_idx + 1) {
-                        Ok(x) => Some(x),
-                        Err(_) => None,
-                    };
+            // print!("PID {} is owned by PID1... ", test_idx + 1);
+            if let Some(priority) = process.ready_priority() {
+                match best {
+                    Some((_, best_priority)) if best_priority >= priority => (),
+                    _ => best = Some((test_idx, priority)),
                 }
-                // println!(" and is NOT RUNNABLE");
             }
         }
-        None
+        best.and_then(|(test_idx, _)| pid_from_usize(test_idx + 1).ok())
     })
 }
 
@@ -174,6 +167,10 @@ pub extern "C" fn kmain() {
                     }
                 });
 
+                // Use the spare time to zero pages ahead of when they're needed.
+                #[cfg(baremetal)]
+                mem::MemoryManager::with_mut(|mm| mm.refill_zero_pool());
+
                 // Special case for testing: idle can return `false` to indicate exit
                 if !arch::idle() {
                     return;
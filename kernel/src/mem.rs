@@ -40,13 +40,155 @@ impl fmt::Display for MemoryRangeExtra {
     }
 }
 
+/// Largest number of main-RAM pages tracked by the free page map. This
+/// covers 64 MiB of RAM, which is well beyond what current hardware ships.
+#[cfg(baremetal)]
+const FREE_MAP_PAGES: usize = 16384;
+#[cfg(baremetal)]
+const FREE_MAP_WORDS: usize = FREE_MAP_PAGES / 32;
+#[cfg(baremetal)]
+const FREE_MAP_SUMMARY_WORDS: usize = FREE_MAP_WORDS / 32;
+
+/// A two-level bitmap of main-RAM pages. A set bit in `words` indicates that
+/// the corresponding page is in use, and a set bit in `summary` indicates that
+/// the corresponding entry in `words` has no free pages left. Finding a free
+/// page therefore touches at most `FREE_MAP_SUMMARY_WORDS` summary words and
+/// one bitmap word, regardless of how fragmented RAM is.
+#[cfg(baremetal)]
+pub struct FreePageMap {
+    words: [u32; FREE_MAP_WORDS],
+    summary: [u32; FREE_MAP_SUMMARY_WORDS],
+}
+
+#[cfg(baremetal)]
+impl FreePageMap {
+    pub const fn new() -> Self {
+        FreePageMap {
+            words: [0; FREE_MAP_WORDS],
+            summary: [0; FREE_MAP_SUMMARY_WORDS],
+        }
+    }
+
+    /// Track `pages` pages, all of which start out free. Any pages beyond
+    /// what the map can hold are marked as permanently in use, and must be
+    /// found by other means.
+    pub fn reset(&mut self, pages: usize) {
+        for word in self.words.iter_mut() {
+            *word = 0;
+        }
+        for word in self.summary.iter_mut() {
+            *word = 0;
+        }
+        for page in pages.min(FREE_MAP_PAGES)..FREE_MAP_PAGES {
+            self.mark_used(page);
+        }
+    }
+
+    /// The number of pages that this map is able to track
+    pub const fn capacity() -> usize {
+        FREE_MAP_PAGES
+    }
+
+    pub fn mark_used(&mut self, page: usize) {
+        if page >= FREE_MAP_PAGES {
+            return;
+        }
+        let word = page / 32;
+        self.words[word] |= 1 << (page & 31);
+        if self.words[word] == u32::MAX {
+            self.summary[word / 32] |= 1 << (word & 31);
+        }
+    }
+
+    pub fn mark_free(&mut self, page: usize) {
+        if page >= FREE_MAP_PAGES {
+            return;
+        }
+        let word = page / 32;
+        self.words[word] &= !(1 << (page & 31));
+        self.summary[word / 32] &= !(1 << (word & 31));
+    }
+
+    /// Return the index of a word in `words` that has at least one free page.
+    fn free_word(&self) -> Option<usize> {
+        for (idx, summary) in self.summary.iter().enumerate() {
+            if *summary != u32::MAX {
+                return Some(idx * 32 + (!*summary).trailing_zeros() as usize);
+            }
+        }
+        None
+    }
+
+    /// Find the lowest-numbered free page and mark it as used.
+    pub fn take(&mut self) -> Option<usize> {
+        let word = self.free_word()?;
+        let page = word * 32 + (!self.words[word]).trailing_zeros() as usize;
+        self.mark_used(page);
+        Some(page)
+    }
+
+    /// Fill `pages` with free page indices, taking a whole bitmap word at a
+    /// time. If there aren't enough free pages, nothing is taken.
+    pub fn take_many(&mut self, pages: &mut [usize]) -> bool {
+        let mut taken = 0;
+        while taken < pages.len() {
+            let word = match self.free_word() {
+                Some(w) => w,
+                None => {
+                    for page in &pages[..taken] {
+                        self.mark_free(*page);
+                    }
+                    return false;
+                }
+            };
+            let mut free = !self.words[word];
+            while free != 0 && taken < pages.len() {
+                let bit = free.trailing_zeros() as usize;
+                free &= free - 1;
+                pages[taken] = word * 32 + bit;
+                taken += 1;
+            }
+            // Claim every bit handed out from this word in one go.
+            let claimed = !self.words[word] & !free;
+            self.words[word] |= claimed;
+            if self.words[word] == u32::MAX {
+                self.summary[word / 32] |= 1 << (word & 31);
+            }
+        }
+        true
+    }
+}
+
+/// Number of zeroed pages to keep on hand, so that mapping fresh memory
+/// doesn't have to wait for a page to be cleared
+#[cfg(baremetal)]
+const ZERO_POOL_LEN: usize = 16;
+
+/// Number of pages to zero on each pass through the idle loop. Interrupts
+/// are held off while pages are being zeroed, so this is kept small.
+#[cfg(baremetal)]
+const ZERO_POOL_REFILL_BATCH: usize = 4;
+
+/// Owner recorded for pages in the zero pool. This is past the last PID any
+/// process can have, so pool pages aren't counted as anybody's memory, and no
+/// process can claim them.
+#[cfg(baremetal)]
+const ZERO_POOL_OWNER: PID = unsafe { PID::new_unchecked(u8::MAX) };
+
+/// Main-RAM pages that have been zeroed ahead of time. Pages in the pool are
+/// owned by `ZERO_POOL_OWNER` and aren't mapped anywhere, so nothing can
+/// dirty them.
+#[cfg(baremetal)]
+struct ZeroPool {
+    pages: [usize; ZERO_POOL_LEN],
+    len: usize,
+}
+
 pub struct MemoryManager {
     ram_start: usize,
     ram_size: usize,
     #[allow(dead_code)]
     ram_name: u32,
-    #[allow(dead_code)]
-    last_ram_page: usize,
 }
 
 impl Default for MemoryManager {
@@ -64,6 +206,13 @@ static mut MEMORY_MANAGER: MemoryManager = MemoryManager::default_hack();
 static mut MEMORY_ALLOCATIONS: &mut [Option<PID>] = &mut [];
 #[cfg(baremetal)]
 static mut EXTRA_REGIONS: &[MemoryRangeExtra] = &[];
+#[cfg(baremetal)]
+static mut FREE_PAGES: FreePageMap = FreePageMap::new();
+#[cfg(baremetal)]
+static mut ZERO_POOL: ZeroPool = ZeroPool {
+    pages: [0; ZERO_POOL_LEN],
+    len: 0,
+};
 
 /// Initialize the memory map.
 /// This will go through memory and map anything that the kernel is
@@ -76,7 +225,6 @@ impl MemoryManager {
             ram_start: 0,
             ram_size: 0,
             ram_name: 0,
-            last_ram_page: 0,
         }
     }
 
@@ -172,11 +320,24 @@ impl MemoryManager {
         unsafe {
             MEMORY_ALLOCATIONS = slice::from_raw_parts_mut(base as *mut Option<PID>, mem_size)
         };
+
+        // The loader has already assigned pages to the initial processes, so
+        // seed the free page map with its view of main RAM.
+        let ram_pages = self.ram_size / PAGE_SIZE;
+        unsafe {
+            FREE_PAGES.reset(ram_pages);
+            for (idx, owner) in MEMORY_ALLOCATIONS[0..ram_pages].iter().enumerate() {
+                if owner.is_some() {
+                    FREE_PAGES.mark_used(idx);
+                }
+            }
+        }
         Ok(())
     }
 
     /// Print the number of RAM bytes used by the specified process.
-    /// This does not include memory such as peripherals and CSRs.
+    /// This does not include memory such as peripherals and CSRs, nor pages
+    /// waiting in the zero pool.
     pub fn ram_used_by(&self, pid: PID) -> usize {
         let mut owned_bytes = 0;
         #[cfg(baremetal)]
@@ -248,30 +409,151 @@ impl MemoryManager {
     /// This function CANNOT zero the page, as it hasn't been mapped yet.
     #[cfg(baremetal)]
     pub fn alloc_page(&mut self, pid: PID) -> Result<usize, xous_kernel::Error> {
-        // Go through all RAM pages looking for a free page.
-        // Optimization: start from the previous address.
         // println!("Allocating page for PID {}", pid);
         unsafe {
-            for index in self.last_ram_page..((self.ram_size as usize) / PAGE_SIZE) {
-                // println!("    Checking {:08x}...", index * PAGE_SIZE + self.ram_start as usize);
+            if let Some(index) = FREE_PAGES.take() {
+                MEMORY_ALLOCATIONS[index] = Some(pid);
+                let page = index * PAGE_SIZE + self.ram_start;
+                crate::trace::record(xous_kernel::TraceEventKind::PageAlloc, pid, 0, [page, 0]);
+                return Ok(page);
+            }
+
+            // Pages past the end of the free page map are not tracked, so
+            // fall back to searching for them.
+            for index in FreePageMap::capacity()..(self.ram_size / PAGE_SIZE) {
                 if MEMORY_ALLOCATIONS[index].is_none() {
                     MEMORY_ALLOCATIONS[index] = Some(pid);
-                    self.last_ram_page = index + 1;
                     let page = index * PAGE_SIZE + self.ram_start;
+                    crate::trace::record(xous_kernel::TraceEventKind::PageAlloc, pid, 0, [page, 0]);
                     return Ok(page);
                 }
             }
-            for index in 0..self.last_ram_page {
-                // println!("    Checking {:08x}...", index * PAGE_SIZE + self.ram_start as usize);
-                if MEMORY_ALLOCATIONS[index].is_none() {
-                    MEMORY_ALLOCATIONS[index] = Some(pid);
-                    self.last_ram_page = index + 1;
-                    let page = index * PAGE_SIZE + self.ram_start;
-                    return Ok(page);
+        }
+
+        // Hand out the zero pool before admitting that memory has run out.
+        self.take_zeroed_page(pid)
+            .ok_or(xous_kernel::Error::OutOfMemory)
+    }
+
+    /// Take a page out of the zero pool and give it to `pid`.
+    #[cfg(baremetal)]
+    fn take_zeroed_page(&mut self, pid: PID) -> Option<usize> {
+        unsafe {
+            if ZERO_POOL.len == 0 {
+                return None;
+            }
+            ZERO_POOL.len -= 1;
+            let page = ZERO_POOL.pages[ZERO_POOL.len];
+            MEMORY_ALLOCATIONS[(page - self.ram_start) / PAGE_SIZE] = Some(pid);
+            crate::trace::record(xous_kernel::TraceEventKind::PageAlloc, pid, 0, [page, 0]);
+            Some(page)
+        }
+    }
+
+    /// Allocate a single page to the given process, preferring one that has
+    /// already been zeroed. Returns the page along with `true` if it is known
+    /// to be zero, in which case the caller can skip clearing it.
+    #[cfg(baremetal)]
+    pub fn alloc_zeroed_page(&mut self, pid: PID) -> Result<(usize, bool), xous_kernel::Error> {
+        if let Some(page) = self.take_zeroed_page(pid) {
+            return Ok((page, true));
+        }
+        self.alloc_page(pid).map(|page| (page, false))
+    }
+
+    /// Allocate pages in the same way as `alloc_pages()`, taking as many as
+    /// possible from the zero pool. These come first in `pages`, and their
+    /// number is returned. The rest of the pages still need to be zeroed.
+    #[cfg(baremetal)]
+    pub fn alloc_zeroed_pages(
+        &mut self,
+        pid: PID,
+        pages: &mut [usize],
+    ) -> Result<usize, xous_kernel::Error> {
+        let mut zeroed = 0;
+        while zeroed < pages.len() {
+            match self.take_zeroed_page(pid) {
+                Some(page) => pages[zeroed] = page,
+                None => break,
+            }
+            zeroed += 1;
+        }
+        if let Err(e) = self.alloc_pages(pid, &mut pages[zeroed..]) {
+            for page in &pages[..zeroed] {
+                self.release_page(*page as *mut usize, pid).ok();
+            }
+            return Err(e);
+        }
+        Ok(zeroed)
+    }
+
+    /// Zero a few free pages and add them to the zero pool. This is meant to
+    /// be called when there is nothing else to do, so that the work of
+    /// clearing pages is kept off the path of whoever needs them.
+    #[cfg(baremetal)]
+    pub fn refill_zero_pool(&mut self) {
+        for _ in 0..ZERO_POOL_REFILL_BATCH {
+            if unsafe { ZERO_POOL.len } == ZERO_POOL_LEN {
+                return;
+            }
+            // Only take pages from the free page map, so a full system
+            // doesn't go looking through every untracked page each time it
+            // goes idle.
+            let index = match unsafe { FREE_PAGES.take() } {
+                Some(index) => index,
+                None => return,
+            };
+            unsafe { MEMORY_ALLOCATIONS[index] = Some(ZERO_POOL_OWNER) };
+            let page = index * PAGE_SIZE + self.ram_start;
+            if crate::arch::mem::zero_page(self, page).is_err() {
+                unsafe {
+                    MEMORY_ALLOCATIONS[index] = None;
+                    FREE_PAGES.mark_free(index);
+                }
+                return;
+            }
+            unsafe {
+                ZERO_POOL.pages[ZERO_POOL.len] = page;
+                ZERO_POOL.len += 1;
+            }
+        }
+    }
+
+    /// Allocate `pages.len()` pages to the given process and store their
+    /// physical addresses in `pages`. Either every page is allocated, or none
+    /// are. As with `alloc_page()`, THE PAGES ARE NOT ZEROED.
+    #[cfg(baremetal)]
+    pub fn alloc_pages(&mut self, pid: PID, pages: &mut [usize]) -> Result<(), xous_kernel::Error> {
+        unsafe {
+            if FREE_PAGES.take_many(pages) {
+                for page in pages.iter_mut() {
+                    MEMORY_ALLOCATIONS[*page] = Some(pid);
+                    *page = *page * PAGE_SIZE + self.ram_start;
+                    crate::trace::record(
+                        xous_kernel::TraceEventKind::PageAlloc,
+                        pid,
+                        0,
+                        [*page, 0],
+                    );
+                }
+                return Ok(());
+            }
+        }
+
+        // The bitmap couldn't satisfy the whole request, so go one page at a
+        // time to pick up any untracked pages, undoing everything on failure.
+        for idx in 0..pages.len() {
+            match self.alloc_page(pid) {
+                Ok(page) => pages[idx] = page,
+                Err(e) => {
+                    for page in &pages[..idx] {
+                        self.release_page(*page as *mut usize, pid).ok();
+                    }
+                    return Err(e);
                 }
             }
         }
-        Err(xous_kernel::Error::OutOfMemory)
+        Ok(())
     }
 
     /// Find a virtual address in the current process that is big enough
@@ -404,7 +686,7 @@ impl MemoryManager {
         )? as usize;
 
         // Grab the next available page.  This claims it for this process.
-        let phys = self.alloc_page(pid)?;
+        let (phys, zeroed) = self.alloc_zeroed_page(pid)?;
 
         // Actually perform the map.  At this stage, every physical page should be owned by us.
         if let Err(e) = crate::arch::mem::map_page_inner(
@@ -422,7 +704,9 @@ impl MemoryManager {
         let virt = virt as *mut usize;
 
         // Zero-out the page
-        unsafe { virt.write_bytes(0, PAGE_SIZE / core::mem::size_of::<usize>()) };
+        if !zeroed {
+            unsafe { virt.write_bytes(0, PAGE_SIZE / core::mem::size_of::<usize>()) };
+        }
         if is_user {
             crate::arch::mem::hand_page_to_user(virt as _)?;
         }
@@ -546,6 +830,7 @@ impl MemoryManager {
         dest_mapping: &MemoryMapping,
         dest_addr: *mut u8,
         mutable: bool,
+        shared: bool,
     ) -> Result<usize, xous_kernel::Error> {
         // If this page is to be writable, detach it from this process.
         // Otherwise, mark it as read-only to prevent a process from modifying
@@ -558,6 +843,7 @@ impl MemoryManager {
             &dest_mapping,
             dest_addr as _,
             mutable,
+            shared,
         )
     }
 
@@ -589,6 +875,17 @@ impl MemoryManager {
         crate::arch::mem::ensure_page_exists_inner(address).and(Ok(()))
     }
 
+    /// Ensure every page in the given range is backed by physical memory.
+    /// Reserved pages are allocated in batches rather than one at a time.
+    #[cfg(baremetal)]
+    pub fn ensure_range_exists(
+        &mut self,
+        address: usize,
+        len: usize,
+    ) -> Result<(), xous_kernel::Error> {
+        crate::arch::mem::ensure_range_exists_inner(self, address, len)
+    }
+
     /// Claim the given memory for the given process, or release the memory
     /// back to the free pool.
     #[cfg(not(baremetal))]
@@ -653,11 +950,28 @@ impl MemoryManager {
             }
         }
 
+        let page_event = match action {
+            ClaimReleaseMove::Claim => Some(xous_kernel::TraceEventKind::PageAlloc),
+            ClaimReleaseMove::Release => Some(xous_kernel::TraceEventKind::PageFree),
+            ClaimReleaseMove::Move(_) => None,
+        };
+
         let mut offset = 0;
         // Happy path: The address is in main RAM
         if addr >= self.ram_start && addr < self.ram_start + self.ram_size {
             offset += (addr - self.ram_start) / PAGE_SIZE;
-            return unsafe { action_inner(&mut MEMORY_ALLOCATIONS[offset], pid, action) };
+            return unsafe {
+                action_inner(&mut MEMORY_ALLOCATIONS[offset], pid, action).map(|_| {
+                    if MEMORY_ALLOCATIONS[offset].is_some() {
+                        FREE_PAGES.mark_used(offset);
+                    } else {
+                        FREE_PAGES.mark_free(offset);
+                    }
+                    if let Some(kind) = page_event {
+                        crate::trace::record(kind, pid, 0, [addr, 0]);
+                    }
+                })
+            };
         }
 
         offset += self.ram_size / PAGE_SIZE;
@@ -722,7 +1036,9 @@ impl MemoryManager {
     }
 
     /// Free all memory that belongs to a process. This does not unmap the
-    /// memory from the process, it only marks it as free.
+    /// memory from the process, it only marks it as free. Nor does it clear
+    /// it: pages are zeroed while the system is idle, or when they are next
+    /// handed out.
     /// This is very unsafe because the memory can immediately be re-allocated
     /// to another process, so only call this as part of destroying a process.
     pub unsafe fn release_all_memory_for_process(&mut self, _pid: PID) {
@@ -739,6 +1055,15 @@ impl MemoryManager {
                 } else {
                     // Mark this page as free, which allows it to be re-allocated.
                     *owner = None;
+                    if idx < self.ram_size / PAGE_SIZE {
+                        FREE_PAGES.mark_free(idx);
+                        crate::trace::record(
+                            xous_kernel::TraceEventKind::PageFree,
+                            _pid,
+                            0,
+                            [phys_addr, 0],
+                        );
+                    }
                 }
             }
         }
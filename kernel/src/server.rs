@@ -558,6 +558,17 @@ impl Server {
         }
     }
 
+    /// Return the client that is blocked waiting for a reply to the message at
+    /// `message_index`, if any.
+    pub fn waiting_client(&self, message_index: usize) -> Option<(PID, TID)> {
+        let (pid, tid) = match self.queue.get(message_index)? {
+            QueuedMessage::WaitingReturnMemory(pid, tid, _, _, _, _)
+            | QueuedMessage::WaitingReturnScalar(pid, tid, _, _) => (*pid, *tid),
+            _ => return None,
+        };
+        Some((PID::new(pid as _)?, tid as TID))
+    }
+
     /// Convert a `QueuedMesage::WaitingReturnMemory` into `QueuedMessage::Empty`
     /// and return the pair.  Advance the tail.  Note that the `idx` could be
     /// somewhere other than the tail, but as long as it points to a valid
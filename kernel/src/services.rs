@@ -18,8 +18,23 @@ use xous_kernel::{
 
 const MAX_SERVER_COUNT: usize = 128;
 
+/// Number of slots in the SID hash index. This is kept at twice the number of
+/// servers so that probe sequences stay short.
+const SERVER_INDEX_SIZE: usize = 256;
+
+/// Return the slot in the SID hash index where a search for `sid` begins.
+fn sid_hash(sid: &SID) -> usize {
+    let (a, b, c, d) = sid.to_u32();
+    let mixed = a ^ b.rotate_left(8) ^ c.rotate_left(16) ^ d.rotate_left(24);
+    (mixed.wrapping_mul(0x9e37_79b1) >> 24) as usize % SERVER_INDEX_SIZE
+}
+
 pub use crate::arch::process::{INITIAL_TID, MAX_PROCESS_COUNT};
 
+/// Number of entries in per-thread tables. Thread IDs run from 0 through
+/// `MAX_THREAD` on baremetal, and from 1 through `MAX_THREAD + 1` when hosted.
+const THREAD_COUNT: usize = arch::process::MAX_THREAD + 2;
+
 // fn log_process_update(f: &str, l: u32, process: &Process, old_state: ProcessState) {
 //     if process.pid.get() == 3 {
 //         println!("[{}:{}] Updated PID {:?} state: {:?} -> {:?}", f, l, process.pid, old_state, process.state);
@@ -34,6 +49,10 @@ pub struct SystemServices {
 
     /// A table of all servers in the system
     servers: [Option<Server>; MAX_SERVER_COUNT],
+
+    /// A hash index from SID to server index, using linear probing. Each
+    /// nonzero entry is a server index plus one.
+    server_index: [u8; SERVER_INDEX_SIZE],
 }
 
 #[derive(Copy, Clone, PartialEq)]
@@ -111,6 +130,14 @@ pub struct Process {
     /// The context number that was active before this process was switched
     /// away.
     previous_thread: TID,
+
+    /// The scheduling priority of each thread. This may be higher than
+    /// `base_priority` while the thread is handling a message from a client
+    /// with a higher priority.
+    priority: [u8; THREAD_COUNT],
+
+    /// The priority each thread was created with or last set to.
+    base_priority: [u8; THREAD_COUNT],
 }
 
 impl Default for Process {
@@ -186,6 +213,36 @@ impl Process {
         }
     }
 
+    /// The priority of the most important thread that is ready to run, or
+    /// `None` if no threads are ready.
+    pub fn ready_priority(&self) -> Option<u8> {
+        match self.state {
+            ProcessState::Setup(_) => Some(self.priority[INITIAL_TID]),
+            ProcessState::Ready(x) => self
+                .pick_thread(x, self.current_thread)
+                .map(|tid| self.priority[tid]),
+            _ => None,
+        }
+    }
+
+    /// Pick the thread in `threads` with the highest priority. Threads with
+    /// the same priority take turns, starting with the one after `after`.
+    fn pick_thread(&self, threads: usize, after: TID) -> Option<TID> {
+        let slots = THREAD_COUNT.min(core::mem::size_of::<usize>() * 8);
+        let mut best: Option<TID> = None;
+        for offset in 1..=slots {
+            let tid = (after + offset) % slots;
+            if threads & (1 << tid) == 0 {
+                continue;
+            }
+            match best {
+                Some(b) if self.priority[b] >= self.priority[tid] => (),
+                _ => best = Some(tid),
+            }
+        }
+        best
+    }
+
     /// This process slot is unallocated and may be turn into a process
     pub fn free(&self) -> bool {
         match self.state {
@@ -230,10 +287,13 @@ std::thread_local!(static SYSTEM_SERVICES: core::cell::RefCell<SystemServices> =
         mapping: arch::mem::DEFAULT_MEMORY_MAPPING,
         current_thread: 0 as TID,
         previous_thread: INITIAL_TID as TID,
+        priority: [xous_kernel::THREAD_PRIORITY_DEFAULT as u8; THREAD_COUNT],
+        base_priority: [xous_kernel::THREAD_PRIORITY_DEFAULT as u8; THREAD_COUNT],
     }; MAX_PROCESS_COUNT],
     // Note we can't use MAX_SERVER_COUNT here because of how Rust's
     // macro tokenization works
     servers: filled_array![None; 128],
+    server_index: [0; SERVER_INDEX_SIZE],
 }));
 
 #[cfg(baremetal)]
@@ -245,10 +305,13 @@ static mut SYSTEM_SERVICES: SystemServices = SystemServices {
         mapping: arch::mem::DEFAULT_MEMORY_MAPPING,
         current_thread: 0 as TID,
         previous_thread: INITIAL_TID as TID,
+        priority: [xous_kernel::THREAD_PRIORITY_DEFAULT as u8; THREAD_COUNT],
+        base_priority: [xous_kernel::THREAD_PRIORITY_DEFAULT as u8; THREAD_COUNT],
     }; MAX_PROCESS_COUNT],
     // Note we can't use MAX_SERVER_COUNT here because of how Rust's
     // macro tokenization works
     servers: filled_array![None; 128],
+    server_index: [0; SERVER_INDEX_SIZE],
 };
 
 impl core::fmt::Debug for Process {
@@ -370,6 +433,9 @@ impl SystemServices {
             entry.state = ProcessState::Allocated;
             entry.ppid = ppid;
             entry.pid = new_pid;
+            entry.priority = [xous_kernel::THREAD_PRIORITY_DEFAULT as u8; THREAD_COUNT];
+            entry.base_priority = entry.priority;
+            crate::trace::process_created(new_pid);
             return Ok(new_pid);
         }
         Err(xous_kernel::Error::ProcessNotFound)
@@ -404,6 +470,17 @@ impl SystemServices {
         Ok(&mut self.processes[pid_idx])
     }
 
+    /// Whether `pid` may use system-wide facilities such as the trace ring.
+    /// That is PID 1 itself, plus the services PID 1 started, which are the
+    /// same processes that are allowed to start servers. Processes that those
+    /// services create in turn are not privileged.
+    pub fn is_privileged(&self, pid: PID) -> bool {
+        pid.get() == 1
+            || self
+                .get_process(pid)
+                .map_or(false, |process| !process.free() && process.ppid.get() == 1)
+    }
+
     // pub fn current_thread(&self, pid: PID) -> usize {
     //     self.processes[pid.get() as usize - 1].current_thread as usize
     // }
@@ -626,6 +703,71 @@ impl SystemServices {
         Ok(())
     }
 
+    /// Set the priority that thread `tid` runs at. If the thread has inherited
+    /// a higher priority from a client it's serving, it keeps that until it
+    /// is done with the client.
+    pub fn set_thread_priority(
+        &mut self,
+        pid: PID,
+        tid: TID,
+        priority: usize,
+    ) -> Result<(), xous_kernel::Error> {
+        if tid >= THREAD_COUNT {
+            return Err(xous_kernel::Error::InvalidThread);
+        }
+        let priority = priority.min(xous_kernel::THREAD_PRIORITY_MAX) as u8;
+        let process = self.get_process_mut(pid)?;
+        let inherited = process.priority[tid] > process.base_priority[tid];
+        process.base_priority[tid] = priority;
+        if !inherited || priority > process.priority[tid] {
+            process.priority[tid] = priority;
+        }
+        Ok(())
+    }
+
+    /// Return the priority that thread `tid` was created with or last set to.
+    pub fn thread_priority(&self, pid: PID, tid: TID) -> Result<usize, xous_kernel::Error> {
+        if tid >= THREAD_COUNT {
+            return Err(xous_kernel::Error::InvalidThread);
+        }
+        Ok(self.get_process(pid)?.base_priority[tid] as usize)
+    }
+
+    /// Return the priority that thread `tid` is currently running at,
+    /// including any it inherited from a client.
+    #[cfg(test)]
+    pub fn current_priority(&self, pid: PID, tid: TID) -> Result<usize, xous_kernel::Error> {
+        if tid >= THREAD_COUNT {
+            return Err(xous_kernel::Error::InvalidThread);
+        }
+        Ok(self.get_process(pid)?.priority[tid] as usize)
+    }
+
+    /// Raise the priority of a server thread to match that of the client
+    /// that is blocked waiting for it, so that a less important thread can't
+    /// hold up the client by keeping the server from running.
+    pub fn inherit_priority(
+        &mut self,
+        client_pid: PID,
+        client_tid: TID,
+        server_pid: PID,
+        server_tid: TID,
+    ) -> Result<(), xous_kernel::Error> {
+        let priority = self.get_process(client_pid)?.priority[client_tid];
+        let server = self.get_process_mut(server_pid)?;
+        if priority > server.priority[server_tid] {
+            server.priority[server_tid] = priority;
+        }
+        Ok(())
+    }
+
+    /// Drop any priority that thread `tid` inherited from a client.
+    pub fn restore_priority(&mut self, pid: PID, tid: TID) -> Result<(), xous_kernel::Error> {
+        let process = self.get_process_mut(pid)?;
+        process.priority[tid] = process.base_priority[tid];
+        Ok(())
+    }
+
     /// Mark the current process as "Ready to run".
     ///
     /// # Panics
@@ -675,17 +817,9 @@ impl SystemServices {
             }
             ProcessState::Ready(x) => {
                 let new_thread = match tid {
-                    None => {
-                        let mut new_context = 0;
-
-                        while x & (1 << new_context) == 0 {
-                            new_context += 1;
-                            if new_context > arch::process::MAX_THREAD {
-                                new_context = 0;
-                            }
-                        }
-                        new_context
-                    }
+                    None => process
+                        .pick_thread(x, process.current_thread)
+                        .expect("no thread was ready"),
                     Some(ctx) => {
                         // Ensure the specified context is ready to run
                         if x & (1 << ctx) == 0 {
@@ -716,17 +850,9 @@ impl SystemServices {
                 let mut p = crate::arch::process::Process::current();
                 // let current_thread = p.current_thread();
                 let new_thread = match tid {
-                    None => {
-                        let mut new_thread = 0;
-
-                        while ready_threads & (1 << new_thread) == 0 {
-                            new_thread += 1;
-                            if new_thread > arch::process::MAX_THREAD {
-                                new_thread = 0;
-                            }
-                        }
-                        new_thread
-                    }
+                    None => process
+                        .pick_thread(ready_threads, process.current_thread)
+                        .expect("no thread was ready"),
                     Some(tid) => {
                         // Ensure the specified context is ready to run, or is
                         // currently running.
@@ -836,9 +962,17 @@ impl SystemServices {
         tid: TID,
         result: xous_kernel::Result,
     ) -> Result<(), xous_kernel::Error> {
+        let current_pid = self.current_pid();
+
+        // When a server replies, the target is often the process that is
+        // already running. Avoid switching memory spaces in that case.
+        if pid == current_pid {
+            crate::arch::process::Process::current().set_thread_result(tid, result);
+            return Ok(());
+        }
+
         // Temporarily switch into the target process memory space
         // in order to pass the return value.
-        let current_pid = self.current_pid();
         {
             let target_process = self.get_process(pid)?;
             target_process.activate()?;
@@ -886,26 +1020,18 @@ impl SystemServices {
                 }
                 ProcessState::Setup(_) | ProcessState::Allocated => new_tid = INITIAL_TID,
                 ProcessState::Running(x) | ProcessState::Ready(x) => {
-                    // If no new context is specified, take the previous
-                    // context.  If that is not runnable, do a round-robin
-                    // search for the next available context.
+                    // If no new context is specified, pick the ready context
+                    // with the highest priority, taking turns among contexts
+                    // that share a priority.
                     assert!(
                         x != 0,
                         "process was {:?} but had no free contexts",
                         new.state
                     );
                     if new_tid == 0 {
-                        new_tid = (new.current_thread + 1) as usize;
-                        while x & (1 << new_tid) == 0 {
-                            new_tid += 1;
-                            if new_tid > arch::process::MAX_THREAD {
-                                new_tid = 0;
-                            } else if new_tid == (new.current_thread + 1) as usize {
-                                // If we've looped around, return an error.
-                                // println!("Looked through all contexts and couldn't find one that was ready");
-                                return Err(xous_kernel::Error::ProcessNotFound);
-                            }
-                        }
+                        new_tid = new
+                            .pick_thread(x, new.current_thread)
+                            .ok_or(xous_kernel::Error::ProcessNotFound)?;
                         new.current_thread = new_tid as _;
                         klog!("picked thread ID {}", new_tid);
                     } else if x & (1 << new_tid) == 0 {
@@ -953,7 +1079,11 @@ impl SystemServices {
                 ProcessState::Debug(_) => panic!("Process was being debugged"),
             };
             // log_process_update(file!(), line!(), new, old_state);
-            new.activate()?;
+
+            // The memory space was activated above, so there's no need to
+            // flush the MMU a second time with `new.activate()`.
+            crate::arch::process::set_current_pid(new_pid);
+            crate::arch::process::Process::current().activate()?;
 
             // Mark the previous process as ready to run, since we just switched
             // away
@@ -1123,10 +1253,7 @@ impl SystemServices {
         // If the dest and src PID is the same, do nothing.
         if current_pid == dest_pid {
             crate::mem::MemoryManager::with_mut(|mm| {
-                for offset in (0..usize_len).step_by(usize_page) {
-                    mm.ensure_page_exists(src_virt.wrapping_add(offset) as usize)?;
-                }
-                Ok(())
+                mm.ensure_range_exists(src_virt as usize, len)
             })?;
             return Ok(src_virt);
         }
@@ -1146,13 +1273,15 @@ impl SystemServices {
                 .activate()
                 .expect("Couldn't switch back to source mapping");
 
+            // Back any reserved pages in one go before moving them.
+            mm.ensure_range_exists(src_virt as usize, len)?;
+
             let mut error = None;
 
             // Move each subsequent page.
             for offset in (0..usize_len).step_by(usize_page) {
                 assert!(((src_virt.wrapping_add(offset) as usize) & 0xfff) == 0);
                 assert!(((dest_virt.wrapping_add(offset) as usize) & 0xfff) == 0);
-                mm.ensure_page_exists(src_virt.wrapping_add(offset) as usize)?;
                 mm.move_page(
                     current_pid,
                     &src_mapping,
@@ -1194,6 +1323,10 @@ impl SystemServices {
     /// If the share is mutable and the memory is already shared, then an error
     /// is returned.
     ///
+    /// If `shared` is set, the memory remains accessible to the source process
+    /// while it is lent. It still may not be lent again, moved, or unmapped
+    /// until it is returned.
+    ///
     /// # Returns
     ///
     /// Returns the virtual address of the memory region in the target process.
@@ -1212,6 +1345,7 @@ impl SystemServices {
         dest_virt: *mut usize,
         len: usize,
         mutable: bool,
+        shared: bool,
     ) -> Result<*mut usize, xous_kernel::Error> {
         if len == 0 {
             return Err(xous_kernel::Error::BadAddress);
@@ -1235,11 +1369,8 @@ impl SystemServices {
         // just ensure the pages actually exist.
         if current_pid == dest_pid {
             MemoryManager::with_mut(|mm| {
-                for offset in (0..usize_len).step_by(usize_page) {
-                    assert!(((src_virt.wrapping_add(offset) as usize) & 0xfff) == 0);
-                    mm.ensure_page_exists(src_virt.wrapping_add(offset) as usize)?;
-                }
-                Ok(())
+                assert!(((src_virt as usize) & 0xfff) == 0);
+                mm.ensure_range_exists(src_virt as usize, len)
             })?;
             return Ok(src_virt);
         }
@@ -1258,13 +1389,15 @@ impl SystemServices {
                 })? as *mut usize;
             src_mapping.activate().unwrap();
 
+            // Back any reserved pages in one go before lending them.
+            mm.ensure_range_exists(src_virt as usize, len)?;
+
             let mut error = None;
 
             // Lend each subsequent page.
             for offset in (0..usize_len).step_by(usize_page) {
                 assert!(((src_virt.wrapping_add(offset) as usize) & 0xfff) == 0);
                 assert!(((dest_virt.wrapping_add(offset) as usize) & 0xfff) == 0);
-                mm.ensure_page_exists(src_virt.wrapping_add(offset) as usize)?;
                 mm.lend_page(
                     &src_mapping,
                     src_virt.wrapping_add(offset) as *mut u8,
@@ -1272,6 +1405,7 @@ impl SystemServices {
                     &dest_mapping,
                     dest_virt.wrapping_add(offset) as *mut u8,
                     mutable,
+                    shared,
                 )
                 .unwrap_or_else(|e| {
                     error = Some(e);
@@ -1304,6 +1438,7 @@ impl SystemServices {
         _dest_virt: *mut usize,
         _len: usize,
         _mutable: bool,
+        _shared: bool,
     ) -> Result<*mut usize, xous_kernel::Error> {
         Ok(src_virt)
     }
@@ -1555,6 +1690,43 @@ impl SystemServices {
         }
     }
 
+    /// Wake up to `count` threads of the current process that are parked in
+    /// `FutexWait` on `address`, returning how many were woken. A parked
+    /// thread still has its syscall arguments in its registers, so there is
+    /// no need to keep a separate list of waiters.
+    #[cfg(baremetal)]
+    pub fn futex_wake(
+        &mut self,
+        pid: PID,
+        address: usize,
+        count: usize,
+    ) -> Result<usize, xous_kernel::Error> {
+        let current_pid = self.current_pid();
+        assert_eq!(pid, current_pid);
+
+        let arch_process = crate::arch::process::Process::current();
+        let mut woken = 0;
+        while woken < count {
+            let ready_threads = match self.get_process(pid)?.state {
+                ProcessState::Running(x) => x,
+                state => panic!("Process was in an invalid state: {:?}", state),
+            };
+            let waiter = arch_process.find_thread(|waiting_tid, thr| {
+                (ready_threads & (1 << waiting_tid)) == 0 // Thread is waiting (i.e. not ready to run)
+                    && thr.a0() == (xous_kernel::SysCallNumber::FutexWait as usize) // Thread called `FutexWait`
+                    && thr.a1() == address // It is waiting on this futex
+            });
+            let waiting_tid = match waiter {
+                Some((waiting_tid, _thread)) => waiting_tid,
+                None => break,
+            };
+            self.set_thread_result(pid, waiting_tid, xous_kernel::Result::Ok)?;
+            self.ready_thread(pid, waiting_tid)?;
+            woken += 1;
+        }
+        Ok(woken)
+    }
+
     /// Allocate a new server ID for this process and return the address. If the
     /// server table is full, or if there is not enough memory to map the server queue,
     /// return an error.
@@ -1584,7 +1756,7 @@ impl SystemServices {
             );
         }
 
-        for entry in self.servers.iter_mut() {
+        for (sidx, entry) in self.servers.iter_mut().enumerate() {
             if entry == &None {
                 #[cfg(baremetal)]
                 // Allocate a single page for the server queue
@@ -1606,6 +1778,7 @@ impl SystemServices {
 
                 // Initialize the server with the given memory page.
                 Server::init(entry, pid, sid, backing).map_err(|x| x)?;
+                self.index_server(sid, sidx);
 
                 let cid = self.connect_to_server(sid)?;
                 return Ok((sid, cid));
@@ -1650,18 +1823,9 @@ impl SystemServices {
     /// Destroy the provided server ID and disconnect any processes that are
     /// connected.
     pub fn destroy_server(&mut self, pid: PID, sid: SID) -> Result<(), xous_kernel::Error> {
-        let mut idx_to_destroy = None;
-        // Look through the server list for a server that matches this SID
-        for (idx, entry) in self.servers.iter().enumerate() {
-            if let Some(server) = entry {
-                if server.sid == sid && server.pid == pid {
-                    idx_to_destroy = Some(idx);
-                    break;
-                }
-            }
-        }
-
-        let server_idx = idx_to_destroy.ok_or(xous_kernel::Error::ServerNotFound)?;
+        let server_idx = self
+            .sidx_from_sid(sid, pid)
+            .ok_or(xous_kernel::Error::ServerNotFound)?;
         let server = self.servers[server_idx].take().unwrap();
         // Try to destroy the server. This will fail if the server
         // has any outstanding memory requests.
@@ -1669,6 +1833,7 @@ impl SystemServices {
             self.servers[server_idx] = Some(server);
             xous_kernel::Error::ServerQueueFull
         })?;
+        self.rebuild_server_index();
 
         let pid = crate::arch::process::current_pid();
         // println!("KERNEL({}): Server table: {:?}", _pid.get(), self.servers);
@@ -1722,6 +1887,10 @@ impl SystemServices {
         // yet connected.
 
         let pid = crate::arch::process::current_pid();
+        let server_idx = self
+            .lookup_server(sid)
+            .ok_or(xous_kernel::Error::ServerNotFound)?;
+        let mapping = NonZeroU8::new((server_idx as u8) + 2).unwrap();
         ArchProcess::with_inner_mut(|process_inner| {
             assert_eq!(pid, process_inner.pid);
             let mut slot_idx = None;
@@ -1737,39 +1906,20 @@ impl SystemServices {
                 }
 
                 // If a connection to this server ID exists already, return it.
-                let server_idx = (server_idx.unwrap().get() as usize) - 2;
-                if let Some(allocated_server) = &self.servers[server_idx] {
-                    if allocated_server.sid == sid {
-                        // println!("KERNEL({}): Existing connection to SID {:?} found in this process @ {}, process connection map is: {:?}",
-                        //     _pid.get(),
-                        //     sid,
-                        //     (connection_idx as CID) + 2,
-                        //     process_inner.connection_map,
-                        // );
-                        return Ok((connection_idx as CID) + 2);
-                    }
+                if *server_idx == Some(mapping) {
+                    return Ok((connection_idx as CID) + 2);
                 }
             }
             let slot_idx = slot_idx.ok_or_else(|| Error::OutOfMemory)?;
-
-            // Look through all servers for one whose SID matches.
-            for (server_idx, server) in self.servers.iter().enumerate() {
-                if let Some(allocated_server) = server {
-                    if allocated_server.sid == sid {
-                        process_inner.connection_map[slot_idx] =
-                            Some(NonZeroU8::new((server_idx as u8) + 2).unwrap());
-                        // println!(
-                        //     "KERNEL({}): New connection to {:?}. After connection, cid is {} and process connection map is: {:?}",
-                        //     pid.get(),
-                        //     sid,
-                        //     slot_idx + 2,
-                        //     process_inner.connection_map
-                        // );
-                        return Ok((slot_idx as CID) + 2);
-                    }
-                }
-            }
-            Err(xous_kernel::Error::ServerNotFound) // May also be OutOfMemory if the table is full
+            process_inner.connection_map[slot_idx] = Some(mapping);
+            // println!(
+            //     "KERNEL({}): New connection to {:?}. After connection, cid is {} and process connection map is: {:?}",
+            //     pid.get(),
+            //     sid,
+            //     slot_idx + 2,
+            //     process_inner.connection_map
+            // );
+            Ok((slot_idx as CID) + 2)
         })
     }
 
@@ -1814,16 +1964,56 @@ impl SystemServices {
     /// the current process.
     pub fn sidx_from_sid(&mut self, sid: SID, pid: PID) -> Option<usize> {
         // println!("KERNEL({}): Server table: {:?}", pid.get(), self.servers);
-        for (idx, slot) in self.servers.iter().enumerate() {
-            if let Some(server) = slot {
-                if server.pid == pid && server.sid == sid {
-                    return Some(idx);
+        let sidx = self.lookup_server(sid)?;
+        if self.servers[sidx].as_ref()?.pid == pid {
+            Some(sidx)
+        } else {
+            None
+        }
+    }
+
+    /// Find the index of the server with the given SID, regardless of which
+    /// process owns it.
+    fn lookup_server(&self, sid: SID) -> Option<usize> {
+        let mut slot = sid_hash(&sid);
+        for _ in 0..SERVER_INDEX_SIZE {
+            let entry = self.server_index[slot];
+            if entry == 0 {
+                return None;
+            }
+            let sidx = entry as usize - 1;
+            if let Some(server) = &self.servers[sidx] {
+                if server.sid == sid {
+                    return Some(sidx);
                 }
             }
+            slot = (slot + 1) % SERVER_INDEX_SIZE;
         }
         None
     }
 
+    /// Add the server at `sidx` to the SID index.
+    fn index_server(&mut self, sid: SID, sidx: usize) {
+        let mut slot = sid_hash(&sid);
+        // There are more index slots than servers, so this always finds room.
+        while self.server_index[slot] != 0 {
+            slot = (slot + 1) % SERVER_INDEX_SIZE;
+        }
+        self.server_index[slot] = (sidx + 1) as u8;
+    }
+
+    /// Recreate the SID index from the server table. Linear probing doesn't
+    /// allow entries to simply be cleared, and servers are removed rarely
+    /// enough that starting over is the simplest way to drop them.
+    fn rebuild_server_index(&mut self) {
+        self.server_index = [0; SERVER_INDEX_SIZE];
+        for sidx in 0..self.servers.len() {
+            if let Some(sid) = self.servers[sidx].as_ref().map(|server| server.sid) {
+                self.index_server(sid, sidx);
+            }
+        }
+    }
+
     /// Return a server based on the connection id and the current process
     pub fn server_from_sidx(&self, sidx: usize) -> Option<&Server> {
         if sidx > self.servers.len() {
@@ -2011,11 +2201,13 @@ impl SystemServices {
                 }
             }
         }
+        self.rebuild_server_index();
 
         let process = self.get_process_mut(target_pid)?;
         process.activate()?;
         let parent_pid = process.ppid;
         process.terminate()?;
+        crate::trace::process_exited(target_pid);
 
         self.switch_to_thread(parent_pid, None).unwrap();
 
@@ -2086,6 +2278,7 @@ impl SystemServices {
                 server.destroy(self).unwrap();
             }
         }
+        self.rebuild_server_index();
 
         // Destroy all processes. This will cause them to immediately terminate.
         for process in &mut self.processes {
@@ -7,6 +7,7 @@ use crate::irq::interrupt_claim;
 use crate::mem::{MemoryManager, PAGE_SIZE};
 use crate::server::{SenderID, WaitingMessage};
 use crate::services::SystemServices;
+use crate::trace;
 use core::mem;
 use xous_kernel::*;
 
@@ -64,7 +65,15 @@ fn do_yield(_pid: PID, tid: TID) -> SysCallResult {
     })
 }
 
-fn send_message(pid: PID, thread: TID, cid: CID, message: Message) -> SysCallResult {
+/// Send `message` to the server behind `cid`. If `shared` is set, memory that
+/// is mutably lent remains accessible to the sender.
+fn send_message(
+    pid: PID,
+    thread: TID,
+    cid: CID,
+    message: Message,
+    shared: bool,
+) -> SysCallResult {
     SystemServices::with_mut(|ss| {
         let sidx = ss
             .sidx_from_cid(cid)
@@ -111,6 +120,7 @@ fn send_message(pid: PID, thread: TID, cid: CID, message: Message) -> SysCallRes
                     core::ptr::null_mut(),
                     msg.buf.len(),
                     true,
+                    shared,
                 )?;
                 Message::MutableBorrow(MemoryMessage {
                     id: msg.id,
@@ -126,6 +136,7 @@ fn send_message(pid: PID, thread: TID, cid: CID, message: Message) -> SysCallRes
                     core::ptr::null_mut(),
                     msg.buf.len(),
                     false,
+                    false,
                 )?;
                 // println!(
                 //     "Lending {} bytes from {:08x} in PID {} to {:08x} in PID {}",
@@ -166,6 +177,9 @@ fn send_message(pid: PID, thread: TID, cid: CID, message: Message) -> SysCallRes
             } else {
                 0
             };
+            if blocking {
+                ss.inherit_priority(pid, thread, server_pid, server_tid)?;
+            }
             let sender = SenderID::new(sidx, sender_idx, Some(pid));
             klog!(
                 "server connection data: sidx: {}, idx: {}, server pid: {}",
@@ -186,6 +200,13 @@ fn send_message(pid: PID, thread: TID, cid: CID, message: Message) -> SysCallRes
                     .return_available_thread(server_tid);
                 e
             })?;
+            trace::message_sent(pid);
+            trace::record(
+                TraceEventKind::MessageDelivered,
+                pid,
+                thread,
+                [sidx, envelope.body.id()],
+            );
 
             let runnable = ss
                 .runnable(server_pid, Some(server_tid))
@@ -253,8 +274,11 @@ fn send_message(pid: PID, thread: TID, cid: CID, message: Message) -> SysCallRes
         );
         // Add this message to the queue.  If the queue is full, this
         // returns an error.
+        let id = message.id();
         let _queue_idx = ss.queue_server_message(sidx, pid, thread, message, client_address)?;
         klog!("queued into index {:x}", _queue_idx);
+        trace::message_sent(pid);
+        trace::record(TraceEventKind::MessageQueued, pid, thread, [sidx, id]);
 
         // Park this context if it's blocking.  This is roughly
         // equivalent to a "Yield".
@@ -278,6 +302,115 @@ fn send_message(pid: PID, thread: TID, cid: CID, message: Message) -> SysCallRes
     })
 }
 
+/// Park thread `tid` until another thread calls `FutexWake` on `address`,
+/// unless the word there no longer holds `expected`. Nothing else in the
+/// process can run between the check and parking, so no wakeup is missed.
+#[cfg(baremetal)]
+fn futex_wait(pid: PID, tid: TID, address: usize, expected: usize) -> SysCallResult {
+    if address & (mem::align_of::<usize>() - 1) != 0 {
+        return Err(xous_kernel::Error::BadAlignment);
+    }
+    if address
+        .checked_add(mem::size_of::<usize>())
+        .map(|end| end > arch::mem::USER_AREA_END)
+        .unwrap_or(true)
+    {
+        return Err(xous_kernel::Error::BadAddress);
+    }
+    MemoryManager::with_mut(|mm| mm.ensure_range_exists(address, mem::size_of::<usize>()))?;
+    if unsafe { arch::mem::read_user(address as *const usize) } != expected {
+        return Ok(xous_kernel::Result::Ok);
+    }
+
+    // The thread's registers keep the address it is waiting on, which is how
+    // `futex_wake()` finds it again.
+    SystemServices::with_mut(|ss| {
+        unsafe { SWITCHTO_CALLER = None };
+        let ppid = ss.get_process(pid)?.ppid;
+        ss.activate_process_thread(tid, ppid, 0, false)
+            .map(|_| Ok(xous_kernel::Result::ResumeProcess))
+            .unwrap_or(Err(xous_kernel::Error::ProcessNotFound))
+    })
+}
+
+#[cfg(baremetal)]
+fn futex_wake(pid: PID, address: usize, count: usize) -> SysCallResult {
+    SystemServices::with_mut(|ss| ss.futex_wake(pid, address, count))
+        .map(xous_kernel::Result::Scalar1)
+}
+
+/// Hosted processes don't share memory with the kernel, so libxous parks
+/// their threads itself and never makes these calls.
+#[cfg(not(baremetal))]
+fn futex_wait(_pid: PID, _tid: TID, _address: usize, _expected: usize) -> SysCallResult {
+    Err(xous_kernel::Error::UnhandledSyscall)
+}
+
+#[cfg(not(baremetal))]
+fn futex_wake(_pid: PID, _address: usize, _count: usize) -> SysCallResult {
+    Err(xous_kernel::Error::UnhandledSyscall)
+}
+
+/// Send each `ScalarMessage` in `batch` to the server behind `cid`, stopping
+/// at the first one that can't be delivered. Returns the number of messages
+/// that were sent, or an error if not even the first one could be sent.
+fn send_message_batch(pid: PID, tid: TID, cid: CID, batch: MemoryRange) -> SysCallResult {
+    let entry_size = mem::size_of::<ScalarMessage>();
+    if batch.len() % entry_size != 0 {
+        return Err(xous_kernel::Error::BadAlignment);
+    }
+    let base = batch.as_ptr() as *const ScalarMessage;
+
+    // Make sure the whole batch is present before reading any of it.
+    #[cfg(baremetal)]
+    {
+        if (base as usize) & (mem::align_of::<ScalarMessage>() - 1) != 0 {
+            return Err(xous_kernel::Error::BadAlignment);
+        }
+        if (base as usize)
+            .checked_add(batch.len())
+            .map(|end| end > arch::mem::USER_AREA_END)
+            .unwrap_or(true)
+        {
+            return Err(xous_kernel::Error::BadAddress);
+        }
+        MemoryManager::with_mut(|mm| mm.ensure_range_exists(base as usize, batch.len()))?;
+    }
+
+    let mut sent = 0;
+    let mut error = None;
+    for idx in 0..(batch.len() / entry_size) {
+        let msg = unsafe { arch::mem::read_user(base.add(idx)) };
+        let result = send_message(pid, tid, cid, Message::Scalar(msg), false);
+
+        // Handing the message straight to a waiting server thread leaves the
+        // server active when running hosted, so switch back to the client.
+        #[cfg(not(baremetal))]
+        SystemServices::with(|ss| ss.get_process(pid).and_then(|p| p.activate()))?;
+
+        if let Err(e) = result {
+            error = Some(e);
+            break;
+        }
+        sent += 1;
+    }
+
+    // The hosted transport copied the batch into a kernel buffer, which is
+    // no longer needed.
+    #[cfg(not(baremetal))]
+    unsafe {
+        drop(Box::from_raw(core::slice::from_raw_parts_mut(
+            batch.as_mut_ptr(),
+            batch.len(),
+        )));
+    }
+
+    match error {
+        Some(e) if sent == 0 => Err(e),
+        _ => Ok(xous_kernel::Result::Scalar1(sent)),
+    }
+}
+
 fn return_memory(
     server_pid: PID,
     server_tid: TID,
@@ -297,6 +430,7 @@ fn return_memory(
             return Err(xous_kernel::Error::ServerNotFound);
         }
         let result = server.take_waiting_message(sender.idx, Some(&buf))?;
+        ss.restore_priority(server_pid, server_tid)?;
         klog!("waiting message was: {:?}", result);
         let (client_pid, client_tid, _server_addr, client_addr, len) = match result {
             WaitingMessage::BorrowedMemory(
@@ -409,6 +543,7 @@ fn return_scalar(
             return Err(xous_kernel::Error::ServerNotFound);
         }
         let result = server.take_waiting_message(sender.idx, None)?;
+        ss.restore_priority(server_pid, server_tid)?;
         let (client_pid, client_tid) = match result {
             WaitingMessage::ScalarMessage(pid, tid) => (pid, tid),
             WaitingMessage::ForgetMemory(_) => {
@@ -482,6 +617,7 @@ fn return_scalar2(
             return Err(xous_kernel::Error::ServerNotFound);
         }
         let result = server.take_waiting_message(sender.idx, None)?;
+        ss.restore_priority(server_pid, server_tid)?;
         let (client_pid, client_tid) = match result {
             WaitingMessage::ScalarMessage(pid, tid) => (pid, tid),
             WaitingMessage::ForgetMemory(_) => {
@@ -544,6 +680,9 @@ fn receive_message(pid: PID, tid: TID, sid: SID, blocking: ExecutionType) -> Sys
             ss.thread_is_running(pid, tid),
             "current thread is not running"
         );
+        // Asking for another message means this thread is done with any
+        // client whose priority it inherited.
+        ss.restore_priority(pid, tid)?;
         // See if there is a pending message.  If so, return immediately.
         let sidx = ss
             .sidx_from_sid(sid, pid)
@@ -561,6 +700,20 @@ fn receive_message(pid: PID, tid: TID, sid: SID, blocking: ExecutionType) -> Sys
         // If there is a pending message, return it immediately.
         if let Some(msg) = server.take_next_message(sidx) {
             klog!("waiting messages found -- returning {:x?}", msg);
+            trace::record(
+                TraceEventKind::MessageDequeued,
+                pid,
+                tid,
+                [sidx, msg.body.id()],
+            );
+            let client = if msg.body.is_blocking() {
+                server.waiting_client(SenderID::from(msg.sender).idx)
+            } else {
+                None
+            };
+            if let Some((client_pid, client_tid)) = client {
+                ss.inherit_priority(client_pid, client_tid, pid, tid)?;
+            }
             return Ok(xous_kernel::Result::Message(msg));
         }
 
@@ -601,12 +754,33 @@ pub fn handle(pid: PID, tid: TID, in_irq: bool, call: SysCall) -> SysCallResult
     #[cfg(feature = "debug-print")]
     print!("KERNEL({}:{}): Syscall {:x?}", pid, tid, call);
 
+    // Reading the trace ring would otherwise fill it up with its own syscalls.
+    let traced_args = if !matches!(call, SysCall::ReadTrace)
+        && (trace::enabled(TraceEventKind::SyscallEnter)
+            || trace::enabled(TraceEventKind::SyscallExit))
+    {
+        let args = call.as_args();
+        trace::record(TraceEventKind::SyscallEnter, pid, tid, [args[0], args[1]]);
+        Some(args)
+    } else {
+        None
+    };
+
     let result = if in_irq && !call.can_call_from_interrupt() {
         Err(xous_kernel::Error::InvalidSyscall)
     } else {
         handle_inner(pid, tid, in_irq, call)
     };
 
+    if let Some(args) = traced_args {
+        let tag = match &result {
+            Ok(response) => response.to_args()[0],
+            // The tag of `Result::Error`
+            Err(_) => 1,
+        };
+        trace::record(TraceEventKind::SyscallExit, pid, tid, [args[0], tag]);
+    }
+
     #[cfg(feature = "debug-print")]
     println!(
         " -> ({}:{}) {:x?}",
@@ -794,7 +968,12 @@ pub fn handle_inner(pid: PID, tid: TID, in_irq: bool, call: SysCall) -> SysCallR
             }
         }),
         SysCall::CreateThread(thread_init) => SystemServices::with_mut(|ss| {
+            let priority = ss.thread_priority(pid, tid)?;
             ss.create_thread(pid, thread_init).map(|new_tid| {
+                // New threads start out with the priority of their creator
+                ss.set_thread_priority(pid, new_tid, priority)
+                    .and_then(|_| ss.restore_priority(pid, new_tid))
+                    .expect("new thread ID was out of range");
                 if !cfg!(baremetal) {
                     ss.switch_to_thread(pid, Some(new_tid))
                         .expect("couldn't activate new thread");
@@ -829,7 +1008,7 @@ pub fn handle_inner(pid: PID, tid: TID, in_irq: bool, call: SysCall) -> SysCallR
         SysCall::ReturnScalar2(sender, arg1, arg2) => {
             return_scalar2(pid, tid, in_irq, sender, arg1, arg2)
         }
-        SysCall::TrySendMessage(cid, message) => send_message(pid, tid, cid, message),
+        SysCall::TrySendMessage(cid, message) => send_message(pid, tid, cid, message, false),
         SysCall::TerminateProcess(_ret) => SystemServices::with_mut(|ss| {
             ss.switch_from_thread(pid, tid)?;
             ss.terminate_process(pid)?;
@@ -866,13 +1045,40 @@ pub fn handle_inner(pid: PID, tid: TID, in_irq: bool, call: SysCall) -> SysCallR
             }
         }
         SysCall::SendMessage(cid, message) => {
-            let result = send_message(pid, tid, cid, message);
+            let result = send_message(pid, tid, cid, message, false);
             match result {
                 Ok(o) => Ok(o),
                 Err(xous_kernel::Error::ServerQueueFull) => retry_syscall(pid, tid),
                 Err(e) => Err(e),
             }
         }
+        SysCall::SendMessageBatch(cid, batch) => send_message_batch(pid, tid, cid, batch),
+        SysCall::ShareMemory(cid, message) => {
+            // Processes in a hosted environment don't share an address space
+            // with the kernel, so there is no way to share memory between them.
+            if !cfg!(baremetal) {
+                return Err(xous_kernel::Error::UnhandledSyscall);
+            }
+            match send_message(pid, tid, cid, Message::MutableBorrow(message), true) {
+                Err(xous_kernel::Error::ServerQueueFull) => retry_syscall(pid, tid),
+                result => result,
+            }
+        }
+        SysCall::SetThreadPriority(target_tid, priority) => SystemServices::with_mut(|ss| {
+            // Only privileged processes may run threads above the default
+            // priority, since they could otherwise keep core services such as
+            // the ticktimer from running.
+            if priority > xous_kernel::THREAD_PRIORITY_DEFAULT && !ss.is_privileged(pid) {
+                return Err(xous_kernel::Error::AccessDenied);
+            }
+            ss.set_thread_priority(pid, target_tid, priority)
+                .map(|_| xous_kernel::Result::Ok)
+        }),
+        SysCall::SetTraceMask(mask) => trace::set_mask(pid, mask),
+        SysCall::ReadTrace => trace::read(pid),
+        SysCall::GetProcessStats(target_pid) => trace::process_stats(pid, target_pid),
+        SysCall::FutexWait(address, expected) => futex_wait(pid, tid, address, expected),
+        SysCall::FutexWake(address, count) => futex_wake(pid, address, count),
         SysCall::Disconnect(cid) => SystemServices::with_mut(|ss| {
             ss.disconnect_from_server(cid)
                 .and(Ok(xous_kernel::Result::Ok))
@@ -329,6 +329,336 @@ fn send_scalar_message() {
     main_thread.join().expect("couldn't join kernel process");
 }
 
+#[test]
+fn send_message_batch() {
+    // Start the server in another thread
+    let main_thread = start_kernel(SERVER_SPEC);
+
+    let (server_addr_send, server_addr_recv) = unbounded();
+    let batch_size = 8;
+
+    // Spawn the server "process" and receive every message in the batch,
+    // in order.
+    let xous_server = xous_kernel::create_process_as_thread(xous_kernel::ProcessArgsAsThread::new(
+        "send_message_batch server",
+        move || {
+            let sid = xous_kernel::create_server().expect("couldn't create test server");
+            server_addr_send.send(sid).unwrap();
+            for i in 0..batch_size {
+                let envelope =
+                    xous_kernel::receive_message(sid).expect("couldn't receive messages");
+                assert_eq!(
+                    envelope.body,
+                    xous_kernel::Message::Scalar(xous_kernel::ScalarMessage {
+                        id: i,
+                        arg1: i + 1,
+                        arg2: i + 2,
+                        arg3: i + 3,
+                        arg4: i + 4,
+                    }),
+                    "batched messages were not delivered in order"
+                );
+            }
+        },
+    ))
+    .expect("couldn't spawn server process");
+
+    // Spawn the client "process" and send the whole batch at once.
+    let xous_client = xous_kernel::create_process_as_thread(xous_kernel::ProcessArgsAsThread::new(
+        "send_message_batch client",
+        move || {
+            let sid = server_addr_recv.recv().unwrap();
+            let conn = xous_kernel::try_connect(sid).expect("couldn't connect to server");
+            let mut batch = vec![];
+            for i in 0..batch_size {
+                batch.push(xous_kernel::ScalarMessage {
+                    id: i,
+                    arg1: i + 1,
+                    arg2: i + 2,
+                    arg3: i + 3,
+                    arg4: i + 4,
+                });
+            }
+            let sent =
+                xous_kernel::send_message_batch(conn, &batch).expect("couldn't send batch");
+            assert_eq!(sent, batch_size, "not every message in the batch was sent");
+        },
+    ))
+    .expect("couldn't spawn client process");
+
+    // Wait for both processes to finish
+    crate::wait_process_as_thread(xous_server).expect("couldn't join server process");
+    crate::wait_process_as_thread(xous_client).expect("couldn't join client process");
+    shutdown_kernel();
+
+    main_thread.join().expect("couldn't join kernel process");
+}
+
+#[test]
+fn thread_priority() {
+    // Start the server in another thread
+    let main_thread = start_kernel(SERVER_SPEC);
+
+    let (server_addr_send, server_addr_recv) = unbounded();
+
+    // Spawn the server "process". It runs below the default priority, and
+    // picks up the client's priority while it answers the client's message.
+    let xous_server = xous_kernel::create_process_as_thread(xous_kernel::ProcessArgsAsThread::new(
+        "thread_priority server",
+        move || {
+            let tid = xous_kernel::current_tid().expect("couldn't get thread ID");
+            xous_kernel::set_thread_priority(tid, xous_kernel::THREAD_PRIORITY_DEFAULT - 1)
+                .expect("couldn't set thread priority");
+            let sid = xous_kernel::create_server().expect("couldn't create test server");
+            server_addr_send.send(sid).unwrap();
+            let envelope = xous_kernel::receive_message(sid).expect("couldn't receive message");
+            xous_kernel::return_scalar(envelope.sender, 42).expect("couldn't return scalar");
+        },
+    ))
+    .expect("couldn't spawn server process");
+
+    // Spawn the client "process", which raises its own priority and then
+    // blocks on the server.
+    let xous_client = xous_kernel::create_process_as_thread(xous_kernel::ProcessArgsAsThread::new(
+        "thread_priority client",
+        move || {
+            let tid = xous_kernel::current_tid().expect("couldn't get thread ID");
+            xous_kernel::set_thread_priority(tid, xous_kernel::THREAD_PRIORITY_MAX)
+                .expect("a service couldn't raise its priority");
+
+            // A process started by this one isn't privileged, so it may not
+            // go above the default. It needs a key of its own to connect with.
+            use rand::{thread_rng, Rng};
+            let mut child_key = [0u8; 16];
+            let mut rng = thread_rng();
+            for b in child_key.iter_mut() {
+                *b = rng.gen();
+            }
+            xous_kernel::arch::set_process_key(&child_key);
+            let child = xous_kernel::create_process_as_thread(xous_kernel::ProcessArgsAsThread::new(
+                "thread_priority child",
+                move || {
+                    let tid = xous_kernel::current_tid().expect("couldn't get thread ID");
+                    assert_eq!(
+                        xous_kernel::set_thread_priority(tid, xous_kernel::THREAD_PRIORITY_MAX),
+                        Err(xous_kernel::Error::AccessDenied),
+                        "an unprivileged process raised its priority"
+                    );
+                    xous_kernel::set_thread_priority(tid, xous_kernel::THREAD_PRIORITY_DEFAULT)
+                        .expect("couldn't set thread priority");
+                },
+            ))
+            .expect("couldn't spawn child process");
+            xous_kernel::wait_process_as_thread(child).expect("couldn't join child process");
+            assert_eq!(
+                xous_kernel::set_thread_priority(999, xous_kernel::THREAD_PRIORITY_DEFAULT),
+                Err(xous_kernel::Error::InvalidThread),
+                "an out-of-range thread ID was accepted"
+            );
+
+            let sid = server_addr_recv.recv().unwrap();
+            let conn = xous_kernel::try_connect(sid).expect("couldn't connect to server");
+            let result = xous_kernel::send_message(
+                conn,
+                xous_kernel::Message::BlockingScalar(xous_kernel::ScalarMessage {
+                    id: 1,
+                    arg1: 0,
+                    arg2: 0,
+                    arg3: 0,
+                    arg4: 0,
+                }),
+            )
+            .expect("couldn't send message");
+            assert_eq!(result, xous_kernel::Result::Scalar1(42));
+        },
+    ))
+    .expect("couldn't spawn client process");
+
+    // Wait for both processes to finish
+    crate::wait_process_as_thread(xous_server).expect("couldn't join server process");
+    crate::wait_process_as_thread(xous_client).expect("couldn't join client process");
+    shutdown_kernel();
+    main_thread.join().expect("couldn't join kernel process");
+}
+
+#[test]
+fn priority_inheritance() {
+    use crate::services::SystemServices;
+
+    // This works on the test thread's own process table, without a kernel.
+    let server = xous_kernel::PID::new(2).unwrap();
+    let client = xous_kernel::PID::new(3).unwrap();
+    let tid = 1;
+    let low = xous_kernel::THREAD_PRIORITY_DEFAULT - 1;
+    let high = xous_kernel::THREAD_PRIORITY_MAX;
+
+    SystemServices::with_mut(|ss| {
+        ss.set_thread_priority(server, tid, low).unwrap();
+        ss.set_thread_priority(client, tid, high).unwrap();
+
+        // A blocked client lends the server its priority
+        ss.inherit_priority(client, tid, server, tid).unwrap();
+        assert_eq!(ss.current_priority(server, tid), Ok(high));
+        assert_eq!(ss.thread_priority(server, tid), Ok(low));
+
+        // Lowering the server while it's boosted doesn't end the boost early
+        ss.set_thread_priority(server, tid, 0).unwrap();
+        assert_eq!(ss.current_priority(server, tid), Ok(high));
+
+        // Replying to the client drops the server back to its own priority
+        ss.restore_priority(server, tid).unwrap();
+        assert_eq!(ss.current_priority(server, tid), Ok(0));
+
+        // A less important client doesn't lower the server
+        ss.set_thread_priority(server, tid, low).unwrap();
+        ss.set_thread_priority(client, tid, 0).unwrap();
+        ss.inherit_priority(client, tid, server, tid).unwrap();
+        assert_eq!(ss.current_priority(server, tid), Ok(low));
+        ss.restore_priority(server, tid).unwrap();
+        assert_eq!(ss.current_priority(server, tid), Ok(low));
+    });
+}
+
+#[cfg(feature = "trace")]
+#[test]
+fn trace_ring_overwrite() {
+    use crate::trace;
+    use xous_kernel::TraceEventKind;
+
+    // This works on the test thread's own trace ring, without a kernel.
+    let pid1 = xous_kernel::PID::new(1).unwrap();
+    let unprivileged = xous_kernel::PID::new(3).unwrap();
+    let events = trace::TRACE_RING_LEN + 44;
+
+    assert_eq!(
+        trace::set_mask(unprivileged, TraceEventKind::Irq.mask()),
+        Err(xous_kernel::Error::AccessDenied)
+    );
+    assert_eq!(
+        trace::set_mask(pid1, TraceEventKind::Irq.mask()),
+        Ok(xous_kernel::Result::Scalar1(0))
+    );
+    assert_eq!(trace::read(unprivileged), Err(xous_kernel::Error::AccessDenied));
+
+    // Only the kinds in the mask are recorded
+    trace::record(TraceEventKind::MessageQueued, pid1, 0, [0, 0]);
+    for irq in 0..events {
+        trace::record(TraceEventKind::Irq, pid1, 0, [irq, 0]);
+    }
+
+    // The reader hears about the overwritten events first, then gets the
+    // newest ones in order.
+    match trace::read(pid1) {
+        Ok(xous_kernel::Result::TraceEvent(_, _, kind, _, _, lost, _)) => {
+            assert_eq!(kind, TraceEventKind::Lost as usize);
+            assert_eq!(lost, events - trace::TRACE_RING_LEN);
+        }
+        other => panic!("unexpected trace result {:?}", other),
+    }
+    for expected in events - trace::TRACE_RING_LEN..events {
+        match trace::read(pid1) {
+            Ok(xous_kernel::Result::TraceEvent(_, _, kind, pid, _, irq, _)) => {
+                assert_eq!(kind, TraceEventKind::Irq as usize);
+                assert_eq!(pid, 1);
+                assert_eq!(irq, expected);
+            }
+            other => panic!("unexpected trace result {:?}", other),
+        }
+    }
+    assert_eq!(trace::read(pid1), Ok(xous_kernel::Result::None));
+
+    assert_eq!(
+        trace::set_mask(pid1, 0),
+        Ok(xous_kernel::Result::Scalar1(TraceEventKind::Irq.mask()))
+    );
+}
+
+#[test]
+fn process_stats() {
+    const MESSAGE_COUNT: usize = 4;
+
+    // Start the server in another thread
+    let main_thread = start_kernel(SERVER_SPEC);
+
+    let (server_addr_send, server_addr_recv) = unbounded();
+
+    let xous_server = xous_kernel::create_process_as_thread(xous_kernel::ProcessArgsAsThread::new(
+        "process_stats server",
+        move || {
+            let sid = xous_kernel::create_server().expect("couldn't create test server");
+            server_addr_send.send(sid).unwrap();
+            for _ in 0..MESSAGE_COUNT {
+                let envelope = xous_kernel::receive_message(sid).expect("couldn't receive message");
+                xous_kernel::return_scalar(envelope.sender, 0).expect("couldn't return scalar");
+            }
+        },
+    ))
+    .expect("couldn't spawn server process");
+
+    let xous_client = xous_kernel::create_process_as_thread(xous_kernel::ProcessArgsAsThread::new(
+        "process_stats client",
+        move || {
+            let sid = server_addr_recv.recv().unwrap();
+            let conn = xous_kernel::try_connect(sid).expect("couldn't connect to server");
+            for id in 0..MESSAGE_COUNT {
+                xous_kernel::send_message(
+                    conn,
+                    xous_kernel::Message::BlockingScalar(xous_kernel::ScalarMessage {
+                        id,
+                        arg1: 0,
+                        arg2: 0,
+                        arg3: 0,
+                        arg4: 0,
+                    }),
+                )
+                .expect("couldn't send message");
+            }
+            let pid = xous_kernel::current_pid().expect("couldn't get process ID");
+            let stats = xous_kernel::process_stats(pid).expect("couldn't get own stats");
+            assert_eq!(stats.messages_sent, MESSAGE_COUNT);
+
+            // A process started by this one may look at itself, but not at
+            // its parent. It needs a key of its own to connect with.
+            use rand::{thread_rng, Rng};
+            let mut child_key = [0u8; 16];
+            let mut rng = thread_rng();
+            for b in child_key.iter_mut() {
+                *b = rng.gen();
+            }
+            xous_kernel::arch::set_process_key(&child_key);
+            let child = xous_kernel::create_process_as_thread(xous_kernel::ProcessArgsAsThread::new(
+                "process_stats child",
+                move || {
+                    let own = xous_kernel::current_pid().expect("couldn't get process ID");
+                    let stats = xous_kernel::process_stats(own).expect("couldn't get own stats");
+                    assert_eq!(stats.messages_sent, 0);
+                    assert_eq!(
+                        xous_kernel::process_stats(pid),
+                        Err(xous_kernel::Error::AccessDenied),
+                        "an unprivileged process read another process's counters"
+                    );
+                },
+            ))
+            .expect("couldn't spawn child process");
+            xous_kernel::wait_process_as_thread(child).expect("couldn't join child process");
+        },
+    ))
+    .expect("couldn't spawn client process");
+
+    crate::wait_process_as_thread(xous_server).expect("couldn't join server process");
+    crate::wait_process_as_thread(xous_client).expect("couldn't join client process");
+
+    // PID 1 may look at any process that exists
+    let unused = xous_kernel::PID::new(crate::arch::process::MAX_PROCESS_COUNT as u8).unwrap();
+    assert_eq!(
+        xous_kernel::process_stats(unused),
+        Err(xous_kernel::Error::ProcessNotFound)
+    );
+
+    shutdown_kernel();
+    main_thread.join().expect("couldn't join kernel process");
+}
+
 #[test]
 fn try_receive_message() {
     // Start the server in another thread
@@ -695,6 +1025,96 @@ fn send_interleved_blocking_scalar_message() {
     main_thread.join().expect("couldn't join kernel process");
 }
 
+/// Measures how many blocking scalar round trips a thread gets through per
+/// second while another thread in the same process is blocked in a call of its
+/// own, which is what most services look like: a main loop plus a thread
+/// parked waiting for events. The threads of a hosted process share one socket
+/// to the kernel, so this measures how quickly a thread notices a response that
+/// the blocked thread read off the socket for it. Run it explicitly with
+/// `cargo test -p kernel hosted_round_trips -- --ignored --nocapture`.
+#[test]
+#[ignore]
+fn hosted_round_trips() {
+    const ROUND_TRIPS: usize = 500;
+
+    let main_thread = start_kernel(SERVER_SPEC);
+    let (fast_addr_send, fast_addr_recv) = unbounded();
+    let (slow_addr_send, slow_addr_recv) = unbounded();
+    let (done_send, done_recv) = unbounded::<()>();
+
+    // answers every message straight away
+    let fast_server = xous_kernel::create_process_as_thread(xous_kernel::ProcessArgsAsThread::new(
+        "hosted_round_trips fast server",
+        move || {
+            let sid = xous_kernel::create_server().expect("couldn't create test server");
+            fast_addr_send.send(sid).unwrap();
+            for _ in 0..ROUND_TRIPS {
+                let envelope = xous_kernel::receive_message(sid).expect("couldn't receive message");
+                if let xous_kernel::Message::BlockingScalar(bs) = envelope.body {
+                    xous_kernel::return_scalar(envelope.sender, bs.arg1 + 1).expect("couldn't return scalar");
+                } else {
+                    panic!("unexpected message");
+                }
+            }
+        },
+    ))
+    .expect("couldn't spawn fast server process");
+
+    // holds on to its one message until the measurement is done
+    let slow_server = xous_kernel::create_process_as_thread(xous_kernel::ProcessArgsAsThread::new(
+        "hosted_round_trips slow server",
+        move || {
+            let sid = xous_kernel::create_server().expect("couldn't create test server");
+            slow_addr_send.send(sid).unwrap();
+            let envelope = xous_kernel::receive_message(sid).expect("couldn't receive message");
+            done_recv.recv().unwrap();
+            xous_kernel::return_scalar(envelope.sender, 0).expect("couldn't return scalar");
+        },
+    ))
+    .expect("couldn't spawn slow server process");
+
+    let fast_sid = fast_addr_recv.recv().unwrap();
+    let slow_sid = slow_addr_recv.recv().unwrap();
+    let client = xous_kernel::create_process_as_thread(xous_kernel::ProcessArgsAsThread::new(
+        "hosted_round_trips client",
+        move || {
+            let slow_conn = xous_kernel::try_connect(slow_sid).expect("couldn't connect to slow server");
+            let parked = xous_kernel::create_thread(move || {
+                xous_kernel::send_message(slow_conn, xous_kernel::Message::new_blocking_scalar(1, 0, 0, 0, 0))
+                    .expect("couldn't send message");
+            })
+            .expect("couldn't start parked thread");
+            // give the parked thread time to block
+            std::thread::sleep(std::time::Duration::from_millis(100));
+
+            let conn = xous_kernel::try_connect(fast_sid).expect("couldn't connect to fast server");
+            let start = std::time::Instant::now();
+            for i in 0..ROUND_TRIPS {
+                let result =
+                    xous_kernel::send_message(conn, xous_kernel::Message::new_blocking_scalar(1, i, 0, 0, 0))
+                        .expect("couldn't send message");
+                assert_eq!(result, xous_kernel::Result::Scalar1(i + 1));
+            }
+            let elapsed = start.elapsed();
+            println!(
+                "{} round trips in {:?}, {:.0} per second",
+                ROUND_TRIPS,
+                elapsed,
+                ROUND_TRIPS as f64 / elapsed.as_secs_f64()
+            );
+            done_send.send(()).unwrap();
+            xous_kernel::wait_thread(parked).expect("couldn't wait for parked thread");
+        },
+    ))
+    .expect("couldn't spawn client process");
+
+    crate::wait_process_as_thread(fast_server).expect("couldn't join fast server process");
+    crate::wait_process_as_thread(slow_server).expect("couldn't join slow server process");
+    crate::wait_process_as_thread(client).expect("couldn't join client process");
+    shutdown_kernel();
+    main_thread.join().expect("couldn't join kernel process");
+}
+
 #[test]
 fn send_move_message() {
     let test_str = "Hello, world!";
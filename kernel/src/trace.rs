@@ -0,0 +1,322 @@
+// SPDX-License-Identifier: Apache-2.0
+
+//! Kernel trace events and per-process counters.
+//!
+//! When the kernel is built with the `trace` feature, it can record events
+//! such as syscalls, context switches and message traffic into a fixed-size
+//! ring as they happen. Nothing is recorded until a privileged process claims
+//! the ring by setting a trace mask, which also picks the kinds of event to
+//! record. That process then reads the events out one at a time. If it falls behind, the
+//! oldest events are overwritten, and the next read reports how many were
+//! lost.
+//!
+//! The per-process counters are always kept, since they cost no more than a
+//! few additions on each trap. A process may read its own counters, but only
+//! a privileged process may read another's.
+
+use crate::arch::process::MAX_PROCESS_COUNT;
+use crate::services::SystemServices;
+use xous_kernel::{SysCallResult, TraceEventKind, PID, TID};
+
+/// Number of events the trace ring holds before it starts overwriting them
+#[cfg(feature = "trace")]
+pub const TRACE_RING_LEN: usize = 256;
+
+#[cfg(feature = "trace")]
+#[derive(Copy, Clone)]
+struct Event {
+    timestamp: u64,
+    kind: u8,
+    pid: u8,
+    tid: u8,
+    args: [usize; 2],
+}
+
+#[cfg(feature = "trace")]
+struct TraceRing {
+    /// The process that set the mask, and is allowed to read events
+    owner: Option<PID>,
+    mask: usize,
+    events: [Event; TRACE_RING_LEN],
+    /// Number of events that have ever been written
+    written: usize,
+    /// Number of events that have ever been read or overwritten
+    read: usize,
+    /// Number of events overwritten since the last read
+    lost: usize,
+}
+
+#[derive(Copy, Clone)]
+struct Counters {
+    cpu_time: u64,
+    messages_sent: usize,
+}
+
+pub struct Trace {
+    counters: [Counters; MAX_PROCESS_COUNT],
+
+    /// The thread the kernel last returned to, and when it did so
+    running: Option<(PID, TID)>,
+    resumed_at: u64,
+
+    #[cfg(feature = "trace")]
+    ring: TraceRing,
+}
+
+#[cfg(not(baremetal))]
+std::thread_local!(static TRACE: core::cell::RefCell<Trace> = core::cell::RefCell::new(Trace::new()));
+
+#[cfg(baremetal)]
+static mut TRACE: Trace = Trace::new();
+
+impl Trace {
+    const fn new() -> Trace {
+        Trace {
+            counters: [Counters {
+                cpu_time: 0,
+                messages_sent: 0,
+            }; MAX_PROCESS_COUNT],
+            running: None,
+            resumed_at: 0,
+            #[cfg(feature = "trace")]
+            ring: TraceRing {
+                owner: None,
+                mask: 0,
+                events: [Event {
+                    timestamp: 0,
+                    kind: 0,
+                    pid: 0,
+                    tid: 0,
+                    args: [0; 2],
+                }; TRACE_RING_LEN],
+                written: 0,
+                read: 0,
+                lost: 0,
+            },
+        }
+    }
+
+    fn with_mut<F, R>(f: F) -> R
+    where
+        F: FnOnce(&mut Trace) -> R,
+    {
+        #[cfg(baremetal)]
+        unsafe {
+            f(&mut TRACE)
+        }
+
+        #[cfg(not(baremetal))]
+        TRACE.with(|trace| f(&mut trace.borrow_mut()))
+    }
+
+    fn counters_mut(&mut self, pid: PID) -> &mut Counters {
+        &mut self.counters[pid.get() as usize - 1]
+    }
+
+    #[cfg(feature = "trace")]
+    fn push(&mut self, kind: TraceEventKind, pid: PID, tid: TID, args: [usize; 2]) {
+        let ring = &mut self.ring;
+        if ring.mask & kind.mask() == 0 {
+            return;
+        }
+        if ring.written - ring.read == TRACE_RING_LEN {
+            ring.read += 1;
+            ring.lost += 1;
+        }
+        ring.events[ring.written % TRACE_RING_LEN] = Event {
+            timestamp: crate::arch::timestamp(),
+            kind: kind as u8,
+            pid: pid.get(),
+            tid: tid as u8,
+            args,
+        };
+        ring.written += 1;
+    }
+}
+
+/// Returns `true` if events of this kind are being recorded. Use this to
+/// avoid working out the arguments to `record()` when nobody is listening.
+#[inline]
+pub fn enabled(kind: TraceEventKind) -> bool {
+    #[cfg(feature = "trace")]
+    {
+        Trace::with_mut(|trace| trace.ring.mask & kind.mask() != 0)
+    }
+
+    #[cfg(not(feature = "trace"))]
+    {
+        let _ = kind;
+        false
+    }
+}
+
+/// Add an event to the trace ring, if events of this kind are enabled.
+#[inline]
+pub fn record(kind: TraceEventKind, pid: PID, tid: TID, args: [usize; 2]) {
+    #[cfg(feature = "trace")]
+    Trace::with_mut(|trace| trace.push(kind, pid, tid, args));
+
+    #[cfg(not(feature = "trace"))]
+    let _ = (kind, pid, tid, args);
+}
+
+/// Charge the time since the kernel last returned to userspace to the process
+/// it returned to. This is called as soon as a trap lands in the kernel.
+pub fn enter_kernel() {
+    Trace::with_mut(|trace| {
+        if let Some((pid, _)) = trace.running {
+            let elapsed = crate::arch::timestamp().wrapping_sub(trace.resumed_at);
+            trace.counters_mut(pid).cpu_time += elapsed;
+        }
+    })
+}
+
+/// Note that the kernel is about to return to thread `tid` of process `pid`.
+pub fn leave_kernel(pid: PID, tid: TID) {
+    Trace::with_mut(|trace| {
+        #[cfg(feature = "trace")]
+        if let Some((previous_pid, previous_tid)) = trace.running {
+            if (previous_pid, previous_tid) != (pid, tid) {
+                trace.push(
+                    TraceEventKind::ContextSwitch,
+                    pid,
+                    tid,
+                    [previous_pid.get() as usize, previous_tid],
+                );
+            }
+        }
+        trace.running = Some((pid, tid));
+        trace.resumed_at = crate::arch::timestamp();
+    })
+}
+
+pub fn message_sent(pid: PID) {
+    Trace::with_mut(|trace| trace.counters_mut(pid).messages_sent += 1)
+}
+
+/// Start a new process off with empty counters.
+pub fn process_created(pid: PID) {
+    Trace::with_mut(|trace| {
+        *trace.counters_mut(pid) = Counters {
+            cpu_time: 0,
+            messages_sent: 0,
+        }
+    })
+}
+
+/// Stop tracing if the process that owned the ring has gone away.
+pub fn process_exited(pid: PID) {
+    #[cfg(feature = "trace")]
+    Trace::with_mut(|trace| {
+        if trace.ring.owner == Some(pid) {
+            trace.ring.owner = None;
+            trace.ring.mask = 0;
+        }
+    });
+
+    #[cfg(not(feature = "trace"))]
+    let _ = pid;
+}
+
+/// Handle `SetTraceMask` for process `pid`. Only a privileged process may
+/// claim the ring, and since only the owner may read it, that also covers
+/// `ReadTrace`.
+pub fn set_mask(pid: PID, mask: usize) -> SysCallResult {
+    #[cfg(feature = "trace")]
+    {
+        if !SystemServices::with(|ss| ss.is_privileged(pid)) {
+            return Err(xous_kernel::Error::AccessDenied);
+        }
+        Trace::with_mut(|trace| {
+            let ring = &mut trace.ring;
+            if ring.owner.map_or(false, |owner| owner != pid) {
+                return Err(xous_kernel::Error::AccessDenied);
+            }
+            let previous = ring.mask;
+            ring.mask = mask;
+            if mask == 0 {
+                ring.owner = None;
+            } else if ring.owner.is_none() {
+                // A new owner doesn't want to see what the last one left behind.
+                ring.owner = Some(pid);
+                ring.read = ring.written;
+                ring.lost = 0;
+            }
+            Ok(xous_kernel::Result::Scalar1(previous))
+        })
+    }
+
+    #[cfg(not(feature = "trace"))]
+    {
+        let _ = (pid, mask);
+        Err(xous_kernel::Error::UnhandledSyscall)
+    }
+}
+
+/// Handle `ReadTrace` for process `pid`.
+pub fn read(pid: PID) -> SysCallResult {
+    #[cfg(feature = "trace")]
+    {
+        Trace::with_mut(|trace| {
+            let ring = &mut trace.ring;
+            if ring.owner != Some(pid) {
+                return Err(xous_kernel::Error::AccessDenied);
+            }
+            let event = if ring.lost != 0 {
+                let lost = ring.lost;
+                ring.lost = 0;
+                Event {
+                    timestamp: crate::arch::timestamp(),
+                    kind: TraceEventKind::Lost as u8,
+                    pid: 0,
+                    tid: 0,
+                    args: [lost, 0],
+                }
+            } else if ring.read != ring.written {
+                let event = ring.events[ring.read % TRACE_RING_LEN];
+                ring.read += 1;
+                event
+            } else {
+                return Ok(xous_kernel::Result::None);
+            };
+            Ok(xous_kernel::Result::TraceEvent(
+                event.timestamp as usize,
+                (event.timestamp >> 32) as usize,
+                event.kind as usize,
+                event.pid as usize,
+                event.tid as usize,
+                event.args[0],
+                event.args[1],
+            ))
+        })
+    }
+
+    #[cfg(not(feature = "trace"))]
+    {
+        let _ = pid;
+        Err(xous_kernel::Error::UnhandledSyscall)
+    }
+}
+
+/// Handle `GetProcessStats` from process `pid`, asking about `target_pid`.
+pub fn process_stats(pid: PID, target_pid: PID) -> SysCallResult {
+    SystemServices::with(|ss| {
+        if pid != target_pid && !ss.is_privileged(pid) {
+            return Err(xous_kernel::Error::AccessDenied);
+        }
+        if ss.get_process(target_pid)?.free() {
+            return Err(xous_kernel::Error::ProcessNotFound);
+        }
+        Ok(())
+    })?;
+    let pid = target_pid;
+    let counters = Trace::with_mut(|trace| *trace.counters_mut(pid));
+    let pages_owned =
+        crate::mem::MemoryManager::with(|mm| mm.ram_used_by(pid)) / crate::mem::PAGE_SIZE;
+    Ok(xous_kernel::Result::ProcessStats(
+        counters.cpu_time as usize,
+        (counters.cpu_time >> 32) as usize,
+        counters.messages_sent,
+        pages_owned,
+    ))
+}
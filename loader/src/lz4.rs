@@ -0,0 +1,65 @@
+//! LZ4 block decompression, for program sections that `create-image` stored
+//! compressed. Each block expands to exactly one chunk of a page, so matches
+//! never reach outside of the memory that is being filled.
+
+unsafe fn read_length(src: &mut *const u8, mut length: usize) -> usize {
+    loop {
+        let byte = src.read();
+        *src = src.add(1);
+        length += byte as usize;
+        if byte != 255 {
+            return length;
+        }
+    }
+}
+
+/// Expand the block at `src` into the `len` bytes at `dest`, returning the
+/// address just past the end of the block.
+///
+/// # Safety
+///
+/// `src` must point to a valid LZ4 block, and `dest` must be valid for `len`
+/// bytes of writes.
+pub unsafe fn decompress(dest: *mut u8, len: usize, mut src: *const u8) -> *const u8 {
+    let mut written = 0;
+    loop {
+        let token = src.read();
+        src = src.add(1);
+
+        let mut literals = (token >> 4) as usize;
+        if literals == 15 {
+            literals = read_length(&mut src, literals);
+        }
+        assert!(
+            literals <= len - written,
+            "compressed section overruns its page"
+        );
+        for _ in 0..literals {
+            dest.add(written).write(src.read());
+            src = src.add(1);
+            written += 1;
+        }
+
+        // The last sequence in a block has no match.
+        if written == len {
+            return src;
+        }
+
+        let offset = src.read() as usize | (src.add(1).read() as usize) << 8;
+        src = src.add(2);
+        let mut length = (token & 0xf) as usize;
+        if length == 15 {
+            length = read_length(&mut src, length);
+        }
+        length += 4;
+        assert!(
+            offset != 0 && offset <= written && length <= len - written,
+            "compressed section has an invalid match"
+        );
+        // Matches may overlap the bytes they produce, so copy one byte at a time.
+        for _ in 0..length {
+            dest.add(written).write(dest.add(written - offset).read());
+            written += 1;
+        }
+    }
+}
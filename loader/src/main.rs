@@ -5,6 +5,7 @@
 mod args;
 use args::{KernelArgument, KernelArguments};
 
+mod lz4;
 mod murmur3;
 
 use core::num::NonZeroUsize;
@@ -183,6 +184,22 @@ impl MiniElfSection {
     pub fn no_copy(&self) -> bool {
         self.size_and_flags & (1 << 25) != 0
     }
+
+    /// The section is stored as one LZ4 block per page that it touches
+    pub fn compressed(&self) -> bool {
+        self.size_and_flags & (1 << 27) != 0
+    }
+
+    /// Fill `len` bytes at `dest` from the section data at `src`, returning
+    /// where the data for the next chunk of the section starts.
+    unsafe fn load_chunk(&self, dest: *mut u8, src: *const u8, len: usize) -> *const u8 {
+        if self.compressed() {
+            lz4::decompress(dest, len, src)
+        } else {
+            memcpy(dest, src, len);
+            src.add(len)
+        }
+    }
 }
 
 /// Describes a Mini ELF file, suitable for loading into RAM
@@ -704,8 +721,11 @@ fn copy_processes(cfg: &mut BootConfig) {
                 // Perform the copy, if NOCOPY is not set
                 if !section.no_copy() {
                     unsafe {
-                        memcpy(top.add(first_chunk_offset), src_addr, first_chunk_size);
-                        src_addr = src_addr.add(first_chunk_size);
+                        src_addr = section.load_chunk(
+                            top.add(first_chunk_offset),
+                            src_addr,
+                            first_chunk_size,
+                        );
                     }
                 } else {
                     unsafe {
@@ -727,8 +747,7 @@ fn copy_processes(cfg: &mut BootConfig) {
                     // );
                     if !section.no_copy() {
                         unsafe {
-                            memcpy(top, src_addr, PAGE_SIZE);
-                            src_addr = src_addr.add(PAGE_SIZE);
+                            src_addr = section.load_chunk(top, src_addr, PAGE_SIZE);
                         }
                     } else {
                         unsafe { bzero(top, top.add(PAGE_SIZE)) };
@@ -747,8 +766,7 @@ fn copy_processes(cfg: &mut BootConfig) {
                     top = cfg.get_top() as *mut u8;
                     if !section.no_copy() {
                         unsafe {
-                            memcpy(top, src_addr, bytes_to_copy);
-                            src_addr = src_addr.add(bytes_to_copy);
+                            src_addr = section.load_chunk(top, src_addr, bytes_to_copy);
                         }
                     } else {
                         unsafe { bzero(top, top.add(bytes_to_copy)) };
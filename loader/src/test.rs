@@ -400,6 +400,21 @@ fn tracker_sane() {
     }
 }
 
+#[test]
+fn decompress_section() {
+    // An overlapping match, followed by the closing run of literals
+    let block = [
+        0x5f, b'X', b'o', b'u', b's', b' ', 5, 0, 1, 0xb0, b'm', b'i', b'c', b'r', b'o', b'k', b'e',
+        b'r', b'n', b'e', b'l',
+    ];
+    let expected = b"Xous Xous Xous Xous Xous microkernel";
+    let mut page = [0u8; 64];
+    let end = unsafe { crate::lz4::decompress(page.as_mut_ptr(), expected.len(), block.as_ptr()) };
+    assert_eq!(end as usize - block.as_ptr() as usize, block.len());
+    assert_eq!(&page[..expected.len()], &expected[..]);
+    assert!(page[expected.len()..].iter().all(|&b| b == 0));
+}
+
 // Create a fake "start_kernel" function to allow
 // this module to compile when not running natively.
 #[export_name = "start_kernel"]
@@ -13,6 +13,7 @@
 
 mod soft;
 mod vex;
+pub mod modes;
 
 pub use soft::{Aes128Soft, Aes192, Aes256Soft};
 
@@ -0,0 +1,557 @@
+//! Bulk block cipher modes.
+//!
+//! These take any of the AES types in this crate, and hand the cipher eight
+//! blocks at a time through `encrypt_par_blocks()`/`decrypt_par_blocks()`
+//! wherever the mode allows it. That lets each backend batch the work in
+//! whatever way suits it: the fixslice implementation, for one, encrypts two
+//! blocks per pass. `Aes128` and `Aes256` are already the fastest backend for
+//! the target they're built for.
+//!
+//! Data is processed in place. Modes that need whole blocks return
+//! `Error::BadAlignment` if the data isn't a multiple of `BLOCK_SIZE`, and
+//! leave it untouched.
+//!
+//! `Ctr` and the CBC functions carry their keystream and chaining state
+//! between calls, so a long message can be passed in any number of pieces,
+//! e.g. one lent page at a time. `Xts` works on one whole sector per call, and
+//! `Gcm` on one whole message, since the tag covers all of it.
+
+use crate::{Block, ParBlocks, BLOCK_SIZE};
+use cipher::{
+    consts::{U16, U8},
+    BlockCipher, BlockDecrypt, BlockEncrypt,
+};
+use xous::Error;
+
+/// Number of blocks handed to the cipher at once
+const PAR_BLOCKS: usize = 8;
+/// Number of bytes handed to the cipher at once
+const PAR_BYTES: usize = PAR_BLOCKS * BLOCK_SIZE;
+
+fn u128_le(block: &Block) -> u128 {
+    let mut bytes = [0u8; BLOCK_SIZE];
+    bytes.copy_from_slice(block);
+    u128::from_le_bytes(bytes)
+}
+
+fn u128_be(block: &Block) -> u128 {
+    let mut bytes = [0u8; BLOCK_SIZE];
+    bytes.copy_from_slice(block);
+    u128::from_be_bytes(bytes)
+}
+
+fn xor_in_place(dst: &mut [u8], src: &[u8]) {
+    for (d, s) in dst.iter_mut().zip(src.iter()) {
+        *d ^= s;
+    }
+}
+
+/// Encrypt the first `count` blocks of `blocks`.
+fn encrypt_blocks<C>(cipher: &C, blocks: &mut ParBlocks, count: usize)
+where
+    C: BlockCipher<BlockSize = U16, ParBlocks = U8> + BlockEncrypt,
+{
+    if count == PAR_BLOCKS {
+        cipher.encrypt_par_blocks(blocks);
+    } else {
+        for block in blocks[..count].iter_mut() {
+            cipher.encrypt_block(block);
+        }
+    }
+}
+
+/// Decrypt the first `count` blocks of `blocks`.
+fn decrypt_blocks<C>(cipher: &C, blocks: &mut ParBlocks, count: usize)
+where
+    C: BlockCipher<BlockSize = U16, ParBlocks = U8> + BlockDecrypt,
+{
+    if count == PAR_BLOCKS {
+        cipher.decrypt_par_blocks(blocks);
+    } else {
+        for block in blocks[..count].iter_mut() {
+            cipher.decrypt_block(block);
+        }
+    }
+}
+
+/// XOR `data` with the keystream starting at counter block `counter`, and
+/// return the counter that follows it. `data` is only allowed to end partway
+/// through a block if this is the last call for the message.
+fn ctr_xor<C>(cipher: &C, mut counter: u128, data: &mut [u8]) -> u128
+where
+    C: BlockCipher<BlockSize = U16, ParBlocks = U8> + BlockEncrypt,
+{
+    let mut keystream = ParBlocks::default();
+    for chunk in data.chunks_mut(PAR_BYTES) {
+        let count = (chunk.len() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        for block in keystream[..count].iter_mut() {
+            block.copy_from_slice(&counter.to_be_bytes());
+            counter = counter.wrapping_add(1);
+        }
+        encrypt_blocks(cipher, &mut keystream, count);
+        for (data, key) in chunk.chunks_mut(BLOCK_SIZE).zip(keystream.iter()) {
+            xor_in_place(data, key);
+        }
+    }
+    counter
+}
+
+/// AES in counter mode, with a 128-bit big-endian counter.
+///
+/// The keystream is generated eight blocks ahead, so calls of any length can
+/// be mixed freely.
+pub struct Ctr<C> {
+    cipher: C,
+    /// the next counter block to be encrypted
+    counter: u128,
+    keystream: ParBlocks,
+    /// offset of the next unused byte in `keystream`
+    pos: usize,
+}
+
+impl<C> Ctr<C>
+where
+    C: BlockCipher<BlockSize = U16, ParBlocks = U8> + BlockEncrypt,
+{
+    /// Start a keystream with `iv` as the first counter block.
+    pub fn new(cipher: C, iv: &[u8; BLOCK_SIZE]) -> Self {
+        Ctr {
+            cipher,
+            counter: u128::from_be_bytes(*iv),
+            keystream: ParBlocks::default(),
+            pos: PAR_BYTES,
+        }
+    }
+
+    /// Encrypt or decrypt `data` in place, continuing from where the last call
+    /// left off.
+    pub fn apply_keystream(&mut self, data: &mut [u8]) {
+        // use up whatever was left over from the last call
+        let mut start = 0;
+        while self.pos < PAR_BYTES && start < data.len() {
+            data[start] ^= self.keystream[self.pos / BLOCK_SIZE][self.pos % BLOCK_SIZE];
+            self.pos += 1;
+            start += 1;
+        }
+        let data = &mut data[start..];
+        // whole runs of blocks don't need to go through the keystream buffer
+        let whole = data.len() - data.len() % PAR_BYTES;
+        let (bulk, tail) = data.split_at_mut(whole);
+        self.counter = ctr_xor(&self.cipher, self.counter, bulk);
+        if !tail.is_empty() {
+            for block in self.keystream.iter_mut() {
+                block.copy_from_slice(&self.counter.to_be_bytes());
+                self.counter = self.counter.wrapping_add(1);
+            }
+            self.cipher.encrypt_par_blocks(&mut self.keystream);
+            for (i, byte) in tail.iter_mut().enumerate() {
+                *byte ^= self.keystream[i / BLOCK_SIZE][i % BLOCK_SIZE];
+            }
+            self.pos = tail.len();
+        }
+    }
+}
+
+/// Encrypt `data` in place with AES-CBC. On return `iv` holds the last
+/// ciphertext block, so that the next call carries on the chain.
+///
+/// Each block depends on the one before it, so this can only go a block at a
+/// time. Decryption has no such limit.
+pub fn cbc_encrypt<C>(cipher: &C, iv: &mut [u8; BLOCK_SIZE], data: &mut [u8]) -> Result<(), Error>
+where
+    C: BlockCipher<BlockSize = U16, ParBlocks = U8> + BlockEncrypt,
+{
+    if data.len() % BLOCK_SIZE != 0 {
+        return Err(Error::BadAlignment);
+    }
+    for chunk in data.chunks_exact_mut(BLOCK_SIZE) {
+        xor_in_place(chunk, iv);
+        cipher.encrypt_block(Block::from_mut_slice(chunk));
+        iv.copy_from_slice(chunk);
+    }
+    Ok(())
+}
+
+/// Decrypt `data` in place with AES-CBC. On return `iv` holds the last
+/// ciphertext block, so that the next call carries on the chain.
+pub fn cbc_decrypt<C>(cipher: &C, iv: &mut [u8; BLOCK_SIZE], data: &mut [u8]) -> Result<(), Error>
+where
+    C: BlockCipher<BlockSize = U16, ParBlocks = U8> + BlockDecrypt,
+{
+    if data.len() % BLOCK_SIZE != 0 {
+        return Err(Error::BadAlignment);
+    }
+    let mut blocks = ParBlocks::default();
+    let mut ciphertext = [0u8; PAR_BYTES];
+    for chunk in data.chunks_mut(PAR_BYTES) {
+        let count = chunk.len() / BLOCK_SIZE;
+        ciphertext[..chunk.len()].copy_from_slice(chunk);
+        for (block, src) in blocks.iter_mut().zip(chunk.chunks_exact(BLOCK_SIZE)) {
+            block.copy_from_slice(src);
+        }
+        decrypt_blocks(cipher, &mut blocks, count);
+        for (i, (dst, block)) in chunk.chunks_exact_mut(BLOCK_SIZE).zip(blocks.iter()).enumerate() {
+            dst.copy_from_slice(block);
+            if i == 0 {
+                xor_in_place(dst, iv);
+            } else {
+                xor_in_place(dst, &ciphertext[(i - 1) * BLOCK_SIZE..i * BLOCK_SIZE]);
+            }
+        }
+        iv.copy_from_slice(&ciphertext[(count - 1) * BLOCK_SIZE..count * BLOCK_SIZE]);
+    }
+    Ok(())
+}
+
+/// AES-XTS (IEEE P1619), for encrypting storage a sector at a time.
+///
+/// Sectors must be a whole number of blocks; ciphertext stealing isn't
+/// supported.
+pub struct Xts<C> {
+    data: C,
+    tweak: C,
+}
+
+impl<C> Xts<C>
+where
+    C: BlockCipher<BlockSize = U16, ParBlocks = U8> + BlockEncrypt,
+{
+    /// `data` is keyed with the first half of the XTS key, and `tweak` with the
+    /// second half.
+    pub fn new(data: C, tweak: C) -> Self {
+        Xts { data, tweak }
+    }
+
+    fn process<F>(&self, sector: u128, data: &mut [u8], mut f: F) -> Result<(), Error>
+    where
+        F: FnMut(&C, &mut ParBlocks, usize),
+    {
+        if data.len() % BLOCK_SIZE != 0 {
+            return Err(Error::BadAlignment);
+        }
+        let mut t = Block::default();
+        t.copy_from_slice(&sector.to_le_bytes());
+        self.tweak.encrypt_block(&mut t);
+        let mut tweak = u128_le(&t);
+
+        let mut tweaks = [0u128; PAR_BLOCKS];
+        let mut blocks = ParBlocks::default();
+        for chunk in data.chunks_mut(PAR_BYTES) {
+            let count = chunk.len() / BLOCK_SIZE;
+            for ((block, src), t) in blocks.iter_mut().zip(chunk.chunks_exact(BLOCK_SIZE)).zip(tweaks.iter_mut()) {
+                *t = tweak;
+                block.copy_from_slice(src);
+                xor_in_place(block, &tweak.to_le_bytes());
+                // multiply the tweak by x in GF(2^128)
+                tweak = (tweak << 1) ^ ((tweak >> 127) * 0x87);
+            }
+            f(&self.data, &mut blocks, count);
+            for ((dst, block), t) in chunk.chunks_exact_mut(BLOCK_SIZE).zip(blocks.iter()).zip(tweaks.iter()) {
+                dst.copy_from_slice(block);
+                xor_in_place(dst, &t.to_le_bytes());
+            }
+        }
+        Ok(())
+    }
+
+    /// Encrypt the sector numbered `sector` in place.
+    pub fn encrypt_sector(&self, sector: u128, data: &mut [u8]) -> Result<(), Error> {
+        self.process(sector, data, |cipher, blocks, count| encrypt_blocks(cipher, blocks, count))
+    }
+}
+
+impl<C> Xts<C>
+where
+    C: BlockCipher<BlockSize = U16, ParBlocks = U8> + BlockEncrypt + BlockDecrypt,
+{
+    /// Decrypt the sector numbered `sector` in place.
+    pub fn decrypt_sector(&self, sector: u128, data: &mut [u8]) -> Result<(), Error> {
+        self.process(sector, data, |cipher, blocks, count| decrypt_blocks(cipher, blocks, count))
+    }
+}
+
+/// Multiply two elements of GF(2^128) in the GCM representation. This goes a
+/// bit at a time with masks rather than with a table, so that it takes the
+/// same time whatever the key.
+fn gf128_mul(x: u128, y: u128) -> u128 {
+    let mut z = 0;
+    let mut v = y;
+    for i in 0..128 {
+        z ^= v & 0u128.wrapping_sub((x >> (127 - i)) & 1);
+        v = (v >> 1) ^ ((0xe1 << 120) & 0u128.wrapping_sub(v & 1));
+    }
+    z
+}
+
+/// The GHASH universal hash used by GCM.
+struct Ghash {
+    h: u128,
+    y: u128,
+}
+
+impl Ghash {
+    /// Hash `data`, padding it with zeroes to a whole number of blocks.
+    fn update_padded(&mut self, data: &[u8]) {
+        for chunk in data.chunks(BLOCK_SIZE) {
+            let mut block = [0u8; BLOCK_SIZE];
+            block[..chunk.len()].copy_from_slice(chunk);
+            self.y = gf128_mul(self.y ^ u128::from_be_bytes(block), self.h);
+        }
+    }
+}
+
+/// AES-GCM with a 96-bit nonce and a 128-bit tag.
+pub struct Gcm<C> {
+    cipher: C,
+    /// the hash key, E(K, 0)
+    h: u128,
+}
+
+impl<C> Gcm<C>
+where
+    C: BlockCipher<BlockSize = U16, ParBlocks = U8> + BlockEncrypt,
+{
+    pub fn new(cipher: C) -> Self {
+        let mut h = Block::default();
+        cipher.encrypt_block(&mut h);
+        Gcm { cipher, h: u128_be(&h) }
+    }
+
+    /// The initial counter block, J0
+    fn j0(nonce: &[u8; 12]) -> u128 {
+        let mut j0 = [0u8; BLOCK_SIZE];
+        j0[..12].copy_from_slice(nonce);
+        j0[15] = 1;
+        u128::from_be_bytes(j0)
+    }
+
+    fn tag(&self, j0: u128, aad: &[u8], ciphertext: &[u8]) -> [u8; BLOCK_SIZE] {
+        let mut ghash = Ghash { h: self.h, y: 0 };
+        ghash.update_padded(aad);
+        ghash.update_padded(ciphertext);
+        let lengths = ((aad.len() as u128 * 8) << 64) | (ciphertext.len() as u128 * 8);
+        ghash.update_padded(&lengths.to_be_bytes());
+        let mut tag = Block::default();
+        tag.copy_from_slice(&j0.to_be_bytes());
+        self.cipher.encrypt_block(&mut tag);
+        let mut out = [0u8; BLOCK_SIZE];
+        out.copy_from_slice(&tag);
+        xor_in_place(&mut out, &ghash.y.to_be_bytes());
+        out
+    }
+
+    /// Encrypt `data` in place, and return the tag over `aad` and the
+    /// ciphertext.
+    pub fn encrypt_in_place_detached(&self, nonce: &[u8; 12], aad: &[u8], data: &mut [u8]) -> [u8; BLOCK_SIZE] {
+        let j0 = Self::j0(nonce);
+        // GCM only increments the low 32 bits of the counter, but a 96-bit nonce
+        // starts them at 2, and messages are limited to 2^32 - 2 blocks, so
+        // they never carry.
+        ctr_xor(&self.cipher, j0 + 1, data);
+        self.tag(j0, aad, data)
+    }
+
+    /// Check `tag` and decrypt `data` in place. If the tag doesn't match,
+    /// `data` is left as it was and `Error::AccessDenied` is returned.
+    pub fn decrypt_in_place_detached(&self, nonce: &[u8; 12], aad: &[u8], data: &mut [u8], tag: &[u8; BLOCK_SIZE]) -> Result<(), Error> {
+        let j0 = Self::j0(nonce);
+        let expected = self.tag(j0, aad, data);
+        let mut diff = 0;
+        for (a, b) in expected.iter().zip(tag.iter()) {
+            diff |= a ^ b;
+        }
+        if diff != 0 {
+            return Err(Error::AccessDenied);
+        }
+        ctr_xor(&self.cipher, j0 + 1, data);
+        Ok(())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::{Aes128, Aes256, NewBlockCipher};
+    use cipher::generic_array::GenericArray;
+    use hex_literal::hex;
+
+    // NIST SP 800-38A, appendix F
+    const PLAINTEXT: [u8; 64] = hex!("6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e5130c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710");
+    const KEY128: [u8; 16] = hex!("2b7e151628aed2a6abf7158809cf4f3c");
+    const KEY256: [u8; 32] = hex!("603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4");
+    const CBC_IV: [u8; 16] = hex!("000102030405060708090a0b0c0d0e0f");
+    const CTR_IV: [u8; 16] = hex!("f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff");
+
+    fn aes128() -> Aes128 {
+        Aes128::new(GenericArray::from_slice(&KEY128))
+    }
+
+    fn aes256() -> Aes256 {
+        Aes256::new(GenericArray::from_slice(&KEY256))
+    }
+
+    fn check_cbc<C>(cipher: &C, expected: &[u8; 64])
+    where
+        C: BlockCipher<BlockSize = U16, ParBlocks = U8> + BlockEncrypt + BlockDecrypt,
+    {
+        let mut data = PLAINTEXT;
+        let mut iv = CBC_IV;
+        cbc_encrypt(cipher, &mut iv, &mut data).unwrap();
+        assert_eq!(&data[..], &expected[..]);
+        assert_eq!(&iv[..], &expected[48..]);
+
+        // the chain carries on across calls
+        let mut iv = CBC_IV;
+        cbc_decrypt(cipher, &mut iv, &mut data[..16]).unwrap();
+        cbc_decrypt(cipher, &mut iv, &mut data[16..]).unwrap();
+        assert_eq!(&data[..], &PLAINTEXT[..]);
+    }
+
+    fn check_ctr<C>(cipher: C, expected: &[u8; 64])
+    where
+        C: Clone + BlockCipher<BlockSize = U16, ParBlocks = U8> + BlockEncrypt,
+    {
+        let mut data = PLAINTEXT;
+        Ctr::new(cipher.clone(), &CTR_IV).apply_keystream(&mut data);
+        assert_eq!(&data[..], &expected[..]);
+
+        // pieces that don't line up with blocks give the same keystream
+        let mut ctr = Ctr::new(cipher, &CTR_IV);
+        for piece in data.chunks_mut(7) {
+            ctr.apply_keystream(piece);
+        }
+        assert_eq!(&data[..], &PLAINTEXT[..]);
+    }
+
+    #[test]
+    fn cbc_aes128() {
+        check_cbc(&aes128(), &hex!("7649abac8119b246cee98e9b12e9197d5086cb9b507219ee95db113a917678b273bed6b8e3c1743b7116e69e222295163ff1caa1681fac09120eca307586e1a7"));
+    }
+
+    #[test]
+    fn cbc_aes256() {
+        check_cbc(&aes256(), &hex!("f58c4c04d6e5f1ba779eabfb5f7bfbd69cfc4e967edb808d679f777bc6702c7d39f23369a9d9bacfa530e26304231461b2eb05e2c39be9fcda6c19078c6a9d1b"));
+    }
+
+    #[test]
+    fn cbc_partial_block() {
+        let mut data = [0u8; 20];
+        let mut iv = CBC_IV;
+        assert_eq!(cbc_encrypt(&aes128(), &mut iv, &mut data), Err(Error::BadAlignment));
+        assert_eq!(data, [0u8; 20]);
+    }
+
+    #[test]
+    fn ctr_aes128() {
+        check_ctr(aes128(), &hex!("874d6191b620e3261bef6864990db6ce9806f66b7970fdff8617187bb9fffdff5ae4df3edbd5d35e5b4f09020db03eab1e031dda2fbe03d1792170a0f3009cee"));
+    }
+
+    #[test]
+    fn ctr_aes256() {
+        check_ctr(aes256(), &hex!("601ec313775789a5b7a7f504bbf3d228f443e3ca4d62b59aca84e990cacaf5c52b0930daa23de94ce87017ba2d84988ddfc9c58db67aada613c2dd08457941a6"));
+    }
+
+    fn xts(key: &[u8; 32]) -> Xts<Aes128> {
+        Xts::new(Aes128::new(GenericArray::from_slice(&key[..16])), Aes128::new(GenericArray::from_slice(&key[16..])))
+    }
+
+    // IEEE 1619-2007, appendix B, vector 2
+    #[test]
+    fn xts_aes128() {
+        let xts = xts(&hex!("1111111111111111111111111111111122222222222222222222222222222222"));
+        let mut data = [0x44u8; 32];
+        xts.encrypt_sector(0x3333333333, &mut data).unwrap();
+        assert_eq!(data, hex!("c454185e6a16936e39334038acef838bfb186fff7480adc4289382ecd6d394f0"));
+        xts.decrypt_sector(0x3333333333, &mut data).unwrap();
+        assert_eq!(data, [0x44u8; 32]);
+    }
+
+    // IEEE 1619-2007, appendix B, vectors 4 and 5: vector 5 is vector 4's ciphertext
+    // encrypted again as the next sector, so the two make up a pair of adjacent sectors
+    const XTS_KEY: [u8; 32] = hex!("2718281828459045235360287471352631415926535897932384626433832795");
+    const XTS_SECTOR0: [u8; 512] = hex!("27a7479befa1d476489f308cd4cfa6e2a96e4bbe3208ff25287dd3819616e89cc78cf7f5e543445f8333d8fa7f56000005279fa5d8b5e4ad40e736ddb4d35412328063fd2aab53e5ea1e0a9f332500a5df9487d07a5c92cc512c8866c7e860ce93fdf166a24912b422976146ae20ce846bb7dc9ba94a767aaef20c0d61ad02655ea92dc4c4e41a8952c651d33174be51a10c421110e6d81588ede82103a252d8a750e8768defffed9122810aaeb99f9172af82b604dc4b8e51bcb08235a6f4341332e4ca60482a4ba1a03b3e65008fc5da76b70bf1690db4eae29c5f1badd03c5ccf2a55d705ddcd86d449511ceb7ec30bf12b1fa35b913f9f747a8afd1b130e94bff94effd01a91735ca1726acd0b197c4e5b03393697e126826fb6bbde8ecc1e08298516e2c9ed03ff3c1b7860f6de76d4cecd94c8119855ef5297ca67e9f3e7ff72b1e99785ca0a7e7720c5b36dc6d72cac9574c8cbbc2f801e23e56fd344b07f22154beba0f08ce8891e643ed995c94d9a69c9f1b5f499027a78572aeebd74d20cc39881c213ee770b1010e4bea718846977ae119f7a023ab58cca0ad752afe656bb3c17256a9f6e9bf19fdd5a38fc82bbe872c5539edb609ef4f79c203ebb140f2e583cb2ad15b4aa5b655016a8449277dbd477ef2c8d6c017db738b18deb4a427d1923ce3ff262735779a418f20a282df920147beabe421ee5319d0568");
+    const XTS_SECTOR1: [u8; 512] = hex!("264d3ca8512194fec312c8c9891f279fefdd608d0c027b60483a3fa811d65ee59d52d9e40ec5672d81532b38b6b089ce951f0f9c35590b8b978d175213f329bb1c2fd30f2f7f30492a61a532a79f51d36f5e31a7c9a12c286082ff7d2394d18f783e1a8e72c722caaaa52d8f065657d2631fd25bfd8e5baad6e527d763517501c68c5edc3cdd55435c532d7125c8614deed9adaa3acade5888b87bef641c4c994c8091b5bcd387f3963fb5bc37aa922fbfe3df4e5b915e6eb514717bdd2a74079a5073f5c4bfd46adf7d282e7a393a52579d11a028da4d9cd9c77124f9648ee383b1ac763930e7162a8d37f350b2f74b8472cf09902063c6b32e8c2d9290cefbd7346d1c779a0df50edcde4531da07b099c638e83a755944df2aef1aa31752fd323dcb710fb4bfbb9d22b925bc3577e1b8949e729a90bbafeacf7f7879e7b1147e28ba0bae940db795a61b15ecf4df8db07b824bb062802cc98a9545bb2aaeed77cb3fc6db15dcd7d80d7d5bc406c4970a3478ada8899b329198eb61c193fb6275aa8ca340344a75a862aebe92eee1ce032fd950b47d7704a3876923b4ad62844bf4a09c4dbe8b4397184b7471360c9564880aedddb9baa4af2e75394b08cd32ff479c57a07d3eab5d54de5f9738b8d27f27a9f0ab11799d7b7ffefb2704c95c6ad12c39f1e867a4b7b1d7818a4b753dfd2a89ccb45e001a03a867b187f225dd");
+
+    #[test]
+    fn xts_aes128_sectors() {
+        let xts = xts(&XTS_KEY);
+        let mut data = [0u8; 1024];
+        for (i, byte) in data[..512].iter_mut().enumerate() {
+            *byte = i as u8;
+        }
+        data[512..].copy_from_slice(&XTS_SECTOR0);
+        for (sector, chunk) in data.chunks_mut(512).enumerate() {
+            xts.encrypt_sector(sector as u128, chunk).unwrap();
+        }
+        assert_eq!(&data[..512], &XTS_SECTOR0[..]);
+        assert_eq!(&data[512..], &XTS_SECTOR1[..]);
+
+        for (sector, chunk) in data.chunks_mut(512).enumerate() {
+            xts.decrypt_sector(sector as u128, chunk).unwrap();
+        }
+        for (i, &byte) in data[..512].iter().enumerate() {
+            assert_eq!(byte, i as u8);
+        }
+        assert_eq!(&data[512..], &XTS_SECTOR0[..]);
+    }
+
+    #[test]
+    fn xts_partial_block() {
+        let mut data = [0u8; 40];
+        assert_eq!(xts(&XTS_KEY).encrypt_sector(0, &mut data), Err(Error::BadAlignment));
+        assert_eq!(data, [0u8; 40]);
+    }
+
+    // Test case 4 from McGrew and Viega, "The Galois/Counter Mode of Operation"
+    const GCM_KEY: [u8; 16] = hex!("feffe9928665731c6d6a8f9467308308");
+    const GCM_NONCE: [u8; 12] = hex!("cafebabefacedbaddecaf888");
+    const GCM_AAD: [u8; 20] = hex!("feedfacedeadbeeffeedfacedeadbeefabaddad2");
+    const GCM_PLAINTEXT: [u8; 60] = hex!("d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39");
+    const GCM_CIPHERTEXT: [u8; 60] = hex!("42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091");
+    const GCM_TAG: [u8; 16] = hex!("5bc94fbc3221a5db94fae95ae7121a47");
+
+    fn gcm() -> Gcm<Aes128> {
+        Gcm::new(Aes128::new(GenericArray::from_slice(&GCM_KEY)))
+    }
+
+    #[test]
+    fn gcm_aes128() {
+        let gcm = gcm();
+        let mut data = GCM_PLAINTEXT;
+        let tag = gcm.encrypt_in_place_detached(&GCM_NONCE, &GCM_AAD, &mut data);
+        assert_eq!(&data[..], &GCM_CIPHERTEXT[..]);
+        assert_eq!(tag, GCM_TAG);
+
+        gcm.decrypt_in_place_detached(&GCM_NONCE, &GCM_AAD, &mut data, &tag).unwrap();
+        assert_eq!(&data[..], &GCM_PLAINTEXT[..]);
+    }
+
+    #[test]
+    fn gcm_rejects_forgery() {
+        let gcm = gcm();
+
+        let mut tag = GCM_TAG;
+        tag[15] ^= 1;
+        let mut data = GCM_CIPHERTEXT;
+        assert_eq!(
+            gcm.decrypt_in_place_detached(&GCM_NONCE, &GCM_AAD, &mut data, &tag),
+            Err(Error::AccessDenied)
+        );
+        // nothing is decrypted if the tag doesn't match
+        assert_eq!(&data[..], &GCM_CIPHERTEXT[..]);
+
+        data[0] ^= 1;
+        assert_eq!(
+            gcm.decrypt_in_place_detached(&GCM_NONCE, &GCM_AAD, &mut data, &GCM_TAG),
+            Err(Error::AccessDenied)
+        );
+
+        let mut data = GCM_CIPHERTEXT;
+        let mut aad = GCM_AAD;
+        aad[0] ^= 1;
+        assert_eq!(
+            gcm.decrypt_in_place_detached(&GCM_NONCE, &aad, &mut data, &GCM_TAG),
+            Err(Error::AccessDenied)
+        );
+    }
+}
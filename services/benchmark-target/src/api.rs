@@ -18,4 +18,20 @@ pub enum Opcode {
     TestScalar, //(u32),
     TestMemory, //(TestStruct),
     TestMemorySend,
+
+    /// A non-blocking scalar that the target only counts
+    CountScalar,
+
+    /// Blocking scalar that returns the number of `CountScalar` messages seen so far.
+    /// Because messages are handled in order, this also waits for earlier ones to drain.
+    CountSync,
+
+    /// An immutable borrow of a buffer of any size. Only the first byte is read.
+    TestLend,
+
+    /// A mutable borrow of a buffer of any size. Only the first byte is written.
+    TestLendMut,
+
+    /// A move of a buffer of any size, which the target frees.
+    TestSend,
 }
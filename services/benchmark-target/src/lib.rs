@@ -36,3 +36,30 @@ pub fn test_memory_send(cid: CID, testvar: u32) -> Result<u32, xous::Error> {
     buf.send(cid, Opcode::TestMemorySend.to_u32().unwrap()).or(Err(xous::Error::InternalError))?;
     Ok(testvar+2)
 }
+
+pub fn count_scalar(cid: CID) -> Result<(), xous::Error> {
+    send_message(cid,
+        xous::Message::new_scalar(Opcode::CountScalar.to_usize().unwrap(), 0, 0, 0, 0)).map(|_| ())
+}
+
+pub fn count_sync(cid: CID) -> Result<usize, xous::Error> {
+    let response = send_message(cid,
+        xous::Message::new_blocking_scalar(Opcode::CountSync.to_usize().unwrap(), 0, 0, 0, 0))?;
+    if let xous::Result::Scalar1(r) = response {
+        Ok(r)
+    } else {
+        panic!("unexpected return value: {:#?}", response);
+    }
+}
+
+pub fn test_lend(cid: CID, buf: &Buffer) -> Result<(), xous::Error> {
+    buf.lend(cid, Opcode::TestLend.to_u32().unwrap()).map(|_| ())
+}
+
+pub fn test_lend_mut(cid: CID, buf: &mut Buffer) -> Result<(), xous::Error> {
+    buf.lend_mut(cid, Opcode::TestLendMut.to_u32().unwrap()).map(|_| ())
+}
+
+pub fn test_send(cid: CID, buf: Buffer) -> Result<(), xous::Error> {
+    buf.send(cid, Opcode::TestSend.to_u32().unwrap()).map(|_| ())
+}
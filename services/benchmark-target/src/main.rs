@@ -20,6 +20,7 @@ fn xmain() -> ! {
     info!("BENCHTARGET: registered with NS -- {:?}", bench_sid);
 
     let mut state: u32 = 0;
+    let mut scalars: usize = 0;
     loop {
         let mut envelope = xous::receive_message(bench_sid).unwrap();
         match FromPrimitive::from_usize(envelope.body.id()) {
@@ -40,6 +41,26 @@ fn xmain() -> ! {
                 let reg = buffer.to_original::<TestStruct, _>().unwrap();
                 state += reg.challenge[0];
             }
+            Some(Opcode::CountScalar) => {
+                scalars += 1;
+            }
+            Some(Opcode::CountSync) => msg_blocking_scalar_unpack!(envelope, _, _, _, _, {
+                xous::return_scalar(envelope.sender, scalars)
+                .expect("BENCHTARGET: couldn't return CountSync request");
+            }),
+            Some(Opcode::TestLend) => {
+                let mem = envelope.body.memory_message().unwrap();
+                state = state.wrapping_add(mem.buf.as_slice::<u8>()[0] as u32);
+            }
+            Some(Opcode::TestLendMut) => {
+                let mem = envelope.body.memory_message_mut().unwrap();
+                mem.buf.as_slice_mut::<u8>()[0] = state as u8;
+            }
+            Some(Opcode::TestSend) => {
+                // The buffer is freed when the envelope is dropped
+                let mem = envelope.body.memory_message().unwrap();
+                state = state.wrapping_add(mem.buf.as_slice::<u8>()[0] as u32);
+            }
             None => {error!("BENCHTARGET: couldn't convert opcode");}
         }
     }
@@ -5,58 +5,163 @@
 NOTE: this assumes that you turn off the watchdog timer. This code does not include enough sleeps to reset the WDT
 Do this by removing the watchdog feature in the ticktimer-server Cargo.toml crate
 ****************/
-use blitstr_ref as blitstr;
-use blitstr::{GlyphStyle};
-use core::fmt::Write;
-use graphics_server::{DrawStyle, PixelColor, Point, Rectangle, TextView, TextBounds, TextOp};
-
-use log::{error, info};
-use num_traits::{ToPrimitive, FromPrimitive};
-
-#[derive(Debug, num_derive::FromPrimitive, num_derive::ToPrimitive)]
-pub enum Opcode {
-    Start,
-    Stop,
+
+//! IPC microbenchmarks. Each IPC class is run against `benchmark-target` and
+//! the results are printed to the log console as comma-separated lines that
+//! start with `BENCH,`, so they can be picked out of the log and tracked.
+//!
+//! The ticktimer only counts milliseconds, so rather than timing single calls,
+//! every sample times a batch of calls that is sized to take roughly
+//! `SAMPLE_MS`. The reported figures are nanoseconds per call.
+
+use log::info;
+use ticktimer_server::Ticktimer;
+use xous_ipc::Buffer;
+
+/// Number of samples taken of each benchmark
+const SAMPLES: usize = 100;
+
+/// How long each sample should run for, in milliseconds
+const SAMPLE_MS: u64 = 10;
+
+/// Payload sizes used for the memory benchmarks
+const SIZES: [usize; 4] = [4096, 16384, 65536, 262144];
+
+/// Run `op` repeatedly and log the time it takes. `finish` is run at the end of
+/// every batch, and is counted as part of it.
+fn measure<F, G>(tt: &Ticktimer, name: &str, bytes: usize, mut op: F, mut finish: G)
+where
+    F: FnMut(),
+    G: FnMut(),
+{
+    // Warm up, and work out how many calls fit into one sample
+    op();
+    finish();
+    let mut batch: u64 = 1;
+    loop {
+        let start = tt.elapsed_ms();
+        for _ in 0..batch {
+            op();
+        }
+        finish();
+        if tt.elapsed_ms() - start >= SAMPLE_MS {
+            break;
+        }
+        batch *= 2;
+    }
+
+    let mut samples = [0u64; SAMPLES];
+    for sample in samples.iter_mut() {
+        let start = tt.elapsed_ms();
+        for _ in 0..batch {
+            op();
+        }
+        finish();
+        *sample = (tt.elapsed_ms() - start) * 1_000_000 / batch;
+    }
+    samples.sort_unstable();
+
+    let p99 = (SAMPLES * 99 + 99) / 100 - 1;
+    info!(
+        "BENCH,{},{},{},{},{},{}",
+        name,
+        bytes,
+        batch,
+        samples[0],
+        samples[SAMPLES / 2],
+        samples[p99]
+    );
 }
 
-const SERVER_NAME_SHELL: &str    = "_Shell_";
+fn run_suite(tt: &Ticktimer, target_conn: xous::CID) {
+    info!("BENCH,name,bytes,calls_per_sample,min_ns,median_ns,p99_ns");
+
+    // Non-blocking scalars are queued, so finish each batch with a blocking
+    // call that waits for the target to get through all of them.
+    measure(
+        tt,
+        "scalar",
+        0,
+        || benchmark_target::count_scalar(target_conn).expect("BENCHMARK: couldn't send scalar"),
+        || {
+            benchmark_target::count_sync(target_conn).expect("BENCHMARK: couldn't sync");
+        },
+    );
+
+    let mut count = 0;
+    measure(
+        tt,
+        "blocking_scalar",
+        0,
+        || {
+            count = benchmark_target::test_scalar(target_conn, count)
+                .expect("BENCHMARK: couldn't send blocking scalar")
+        },
+        || (),
+    );
+
+    for &size in SIZES.iter() {
+        let buf = Buffer::new(size);
+        measure(
+            tt,
+            "lend",
+            size,
+            || benchmark_target::test_lend(target_conn, &buf).expect("BENCHMARK: couldn't lend"),
+            || (),
+        );
+    }
 
-fn stopwatch_thread() {
-    info!("BENCHMARK|stopwatch: starting");
+    for &size in SIZES.iter() {
+        let mut buf = Buffer::new(size);
+        measure(
+            tt,
+            "lend_mut",
+            size,
+            || {
+                benchmark_target::test_lend_mut(target_conn, &mut buf)
+                    .expect("BENCHMARK: couldn't lend_mut")
+            },
+            || (),
+        );
+    }
 
-    let ticktimer = ticktimer_server::Ticktimer::new().expect("Couldn't connect to Ticktimer");
+    // A moved buffer is gone once it's sent, so this includes the cost of
+    // mapping a new one. Compare against `map_memory` to separate the two.
+    for &size in SIZES.iter() {
+        measure(
+            tt,
+            "send",
+            size,
+            || {
+                benchmark_target::test_send(target_conn, Buffer::new(size))
+                    .expect("BENCHMARK: couldn't send")
+            },
+            || {
+                benchmark_target::count_sync(target_conn).expect("BENCHMARK: couldn't sync");
+            },
+        );
+    }
 
-    let xns = xous_names::XousNames::new().unwrap();
-    let shell_conn = xns.request_connection_blocking(SERVER_NAME_SHELL).expect("BENCHMARK|stopwatch: can't connect to main program");
-    let mut last_time: u64 = ticktimer.elapsed_ms();
-    let mut start_sent = false;
-    loop {
-        let elapsed_time = ticktimer.elapsed_ms();
-        if false {
-            if elapsed_time - last_time > 500 && !start_sent {
-                last_time = elapsed_time;
-                xous::send_message(shell_conn,
-                    xous::Message::new_scalar(Opcode::Start.to_usize().unwrap(), 0, 0, 0, 0)).expect("BENCHMARK|stopwatch: couldn't send Start message");
-                start_sent = true;
-            } else if elapsed_time - last_time > 10_000 && start_sent {
-                last_time = elapsed_time;
-                start_sent = false;
-                xous::send_message(shell_conn,
-                    xous::Message::new_scalar(Opcode::Stop.to_usize().unwrap(), 0, 0, 0, 0)).expect("BENCHMARK|stopwatch: couldn't send Start message");
-            }
-        } else {
-            // send a start loop message
-            xous::send_message(shell_conn,
-                xous::Message::new_scalar(Opcode::Start.to_usize().unwrap(), 0, 0, 0, 0)).expect("BENCHMARK|stopwatch: couldn't send Start message");
-            ticktimer.sleep_ms(10_000).expect("couldn't sleep");
-            // send a stop loop message
-            xous::send_message(shell_conn,
-                xous::Message::new_scalar(Opcode::Stop.to_usize().unwrap(), 0, 0, 0, 0)).expect("BENCHMARK|stopwatch: couldn't send Start message");
-            // give a moment for the result to update
-            ticktimer.sleep_ms(500).expect("couldn't sleep");
-        }
-        xous::yield_slice();
+    for &size in SIZES.iter() {
+        measure(
+            tt,
+            "map_memory",
+            size,
+            || {
+                let range = xous::map_memory(
+                    None,
+                    None,
+                    size,
+                    xous::MemoryFlags::R | xous::MemoryFlags::W,
+                )
+                .expect("BENCHMARK: couldn't map memory");
+                xous::unmap_memory(range).expect("BENCHMARK: couldn't unmap memory");
+            },
+            || (),
+        );
     }
+
+    info!("BENCH,done");
 }
 
 #[xous::xous_main]
@@ -64,111 +169,16 @@ fn shell_main() -> ! {
     log_server::init_wait().unwrap();
     info!("BENCHMARK: my PID is {}", xous::process::id());
 
-    info!("BENCHMARK: ticktimer");
-    let ticktimer = ticktimer_server::Ticktimer::new().expect("Couldn't connect to Ticktimer");
+    let ticktimer = Ticktimer::new().expect("Couldn't connect to Ticktimer");
 
     let xns = xous_names::XousNames::new().unwrap();
-    let shell_server = xns.register_name(SERVER_NAME_SHELL, None).expect("BENCHMARK: can't register server");
+    let target_conn = xns
+        .request_connection_blocking(benchmark_target::api::SERVER_NAME_BENCHMARK)
+        .expect("BENCHMARK: can't connect to benchmark target");
 
-    let gfx = graphics_server::Gfx::new(&xns).unwrap();
-    let target_conn = xns.request_connection_blocking(benchmark_target::api::SERVER_NAME_BENCHMARK).expect("BENCHMARK: can't connect to COM");
+    run_suite(&ticktimer, target_conn);
 
-    xous::create_thread_0(stopwatch_thread).unwrap();
-    info!("BENCHMARK: stopwatch thread started");
-
-    let screensize = gfx.screen_size().expect("Couldn't get screen size");
-
-    let font_h: i16 = gfx.glyph_height_hint(GlyphStyle::Small).expect("couldn't get glyph height") as i16;
-
-    let status_clipregion =
-        Rectangle::new_coords_with_style(4, 0, screensize.x, font_h as i16 * 4, DrawStyle::new(PixelColor::Light, PixelColor::Light, 1));
-
-    gfx.draw_rectangle(Rectangle::new_with_style(Point::new(0, 0), screensize,
-            DrawStyle::new(PixelColor::Light, PixelColor::Light, 0)
-        ))
-        .expect("unable to clear region");
-
-    let mut result_tv = TextView::new(graphics_server::Gid::new([0, 0, 0, 0]),
-        TextBounds::BoundingBox(Rectangle::new(Point::new(0,0),
-                Point::new(screensize.x, screensize.y - 1))));
-    result_tv.set_op(TextOp::Render);
-    result_tv.clip_rect = Some(status_clipregion.into());
-    result_tv.untrusted = false;
-    result_tv.style = blitstr::GlyphStyle::Small;
-    result_tv.draw_border = false;
-    result_tv.margin = Point::new(3, 0);
-    write!(result_tv, "Initializing...").expect("couldn't init text");
-    gfx.draw_textview(&mut result_tv).unwrap();
-
-    gfx.flush().expect("unable to draw to screen");
-
-    let mut start_time: u64 = 0;
-    let mut stop_time: u64 = 0;
-    let mut update_result: bool = false;
-    let mut count: u32 = 0;
-    let mut check_count: u32 = 0;
     loop {
-        let maybe_env = xous::try_receive_message(shell_server).unwrap();
-        match maybe_env {
-            Some(envelope) => {
-                info!("BENCHMARK: Message: {:?}", envelope);
-                match FromPrimitive::from_usize(envelope.body.id()) {
-                    Some(Opcode::Start) => {
-                        start_time = ticktimer.elapsed_ms();
-                    },
-                    Some(Opcode::Stop) => {
-                        stop_time = ticktimer.elapsed_ms();
-                        update_result = true;
-                    },
-                    None => {
-                        error!("BENCHMARK: couldn't convert opcode");
-                    }
-                }
-            }
-            None => (), // don't yield, we are trying to run the loop as fast as we can...
-        }
-
-        // actual benchmark
-        // get a scalar message
-        if false {
-            // measured at 1479.2 iterations per second in this loop (hardware); 55/s (hosted)
-
-            // xous v0.8
-            // 29729 per 10s = 2972.9/s (hardware)
-            // 485 per 10s = 48.5/s (hosted)
-            count = benchmark_target::test_scalar(target_conn, count).expect("BENCHMARK: couldn't send test message");
-            check_count = check_count + 1;
-        } else {
-            if false {
-                // works on hosted mode, 35/s (hosted)
-                // measured at 762.6 iterations per second (hardware)
-
-                // xous v0.8
-                // 9,928 per 10s = 992.8/s (hardware)
-                // 243 per 10s = 24.3/s (hosted)
-                count = benchmark_target::test_memory(target_conn, count).expect("BENCHMARK: couldn't send test message");
-                check_count = check_count + 1;
-            } else {
-                // simple send benchmark, instead of lend
-                count = benchmark_target::test_memory_send(target_conn, count).expect("BENCHMARK: couldn't send test message");
-                check_count = check_count + 1;
-            }
-        }
-
-        if update_result {
-            update_result = false;
-
-            gfx.draw_rectangle(status_clipregion)
-            .expect("unable to clear region");
-
-            result_tv.clear_str();
-            write!(&mut result_tv, "Elapsed: {}, count: {}, check: {}",
-                stop_time - start_time, count, check_count).unwrap();
-            gfx.draw_textview(&mut result_tv).unwrap();
-            gfx.flush().expect("unable to draw to screen");
-
-            count = 0;
-            check_count = 0;
-        }
+        ticktimer.sleep_ms_slack(60_000, 10_000).expect("couldn't sleep");
     }
 }
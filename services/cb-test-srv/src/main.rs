@@ -23,10 +23,12 @@ fn pump_thread() {
 
     let xns = xous_names::XousNames::new().unwrap();
     let server_conn = xns.request_connection_blocking(api::SERVER_NAME).expect("can't connect to main program");
+    let tick = ticktimer.timer().expect("couldn't allocate tick timer");
+    tick.start(100, 100, 16).expect("couldn't start tick timer");
     loop {
         xous::send_message(server_conn,
             xous::Message::new_scalar(Opcode::Tick.to_usize().unwrap(), 0, 0, 0, 0)).expect("couldn't send Tick message");
-        ticktimer.sleep_ms(100).expect("couldn't sleep");
+        tick.wait().expect("couldn't wait for tick");
     }
 }
 
@@ -3,7 +3,7 @@
 use utralib::generated::*;
 use xous::MemoryRange;
 use susres::{RegManager, RegOrField, SuspendResume};
-use llio::I2cStatus;
+use llio::{I2cBatch, I2cStatus};
 use crate::api::*;
 use num_traits::*;
 
@@ -231,6 +231,15 @@ impl Codec {
         }
     }
 
+    /// runs every register op in `batch` with a single request to the I2C server
+    fn run(&mut self, batch: &mut I2cBatch) -> bool {
+        match self.llio.i2c_batch(batch) {
+            Ok(I2cStatus::ResponseWriteOk) | Ok(I2cStatus::ResponseReadOk) => true,
+            Ok(status) => {log::error!("i2c batch failed at op {} of {}: {:?}", batch.completed, batch.len, status); false},
+            Err(e) => {log::error!("i2c batch couldn't be sent: {:?}", e); false}
+        }
+    }
+
     pub fn get_headset_code(&mut self) -> u8 {
         self.w(0, &[0]);
         let mut code: [u8; 1] = [0; 1];
@@ -274,38 +283,42 @@ impl Codec {
     /// 8_000 * 128 * 12 = 12_288_000 Hz
     ///
     fn audio_clocks(&mut self) {
-        self.w(0, &[0]);  // select page 0
-        self.w(1, &[1]);  // software reset
+        let mut batch = I2cBatch::new(TLV320AIC3100_I2C_ADR);
+        batch.write(0, &[0]);  // select page 0
+        batch.write(1, &[1]);  // software reset
+        self.run(&mut batch);
         self.ticktimer.sleep_ms(2).unwrap(); // reset happens in 1 ms; +1 ms due to timing jitter uncertainty
 
-        self.w(0, &[0]);  // select page 0
+        let mut batch = I2cBatch::new(TLV320AIC3100_I2C_ADR);
+        batch.write(0, &[0]);  // select page 0
 
         // select PLL_CLKIN = MCLK; CODEC_CLKIN = PLL_CLK
-        self.w(4, &[0b0000_0011]);
+        batch.write(4, &[0b0000_0011]);
 
         // fs = 8kHz
         // PLL_CLKIN = 12MHz
         // PLLP = 1, PLLR = 1, PLLJ = 7, PLLD = 1680, NDAC = *12*, MDAC = 7, DOSR = 128, MADC = 2 , NADC = *42*
         // ^^ from page 68 of datasheet, fs=48kHz/12MHz clkin line, with *bold* items multiplied by 6 to get to 8kHz
-        self.w(5, &[
+        batch.write(5, &[
             0b1001_0001,  // P, R = 1, 1 and pll powered up
             7,            // PLLJ = 7
             ((1680 >> 8) & 0xFF) as u8, // D MSB of 1680
             (1680 & 0xFF) as u8,        // D LSB of 1680
             ]);
 
-        self.w(11, &[
+        batch.write(11, &[
             0x80 | 12,  // NADC = 12 (set to 2 for 48kHz)
             0x80 | 7,   // MDAC = 7
             0,   // DOSR = MSB of 128
             128, // DOSR = LSB of 128
         ]);
 
-        self.w(18, &[
+        batch.write(18, &[
             0x80 | 42,  // NADC = 42 (set to 7 for 48kHz)
             0x80 | 2,   // MADC = 2
             128, // AOSR = 128
         ]);
+        self.run(&mut batch);
     }
 
     /// audio_ports() sets up the digital port bitwidths, modes, and syncs
@@ -313,11 +326,12 @@ impl Codec {
     /// From the hardware i2s block as implemented on betrusted-soc:
     /// 16 bits per sample, 32 bit word width, stero, master mode, left-justified, MSB first
     fn audio_ports(&mut self) {
-        self.w(0, &[0]); // select page 0
+        let mut batch = I2cBatch::new(TLV320AIC3100_I2C_ADR);
+        batch.write(0, &[0]); // select page 0
 
         // 32 bits/word * 2 channels * 8000 samples/s = 512_000 = BCLK
         // pick off of DAC_MOD_CLK = 1.024MHz
-        self.w(27, &[
+        batch.write(27, &[
             0b00_00_1_1_0_1, // I2S standard, 16 bits per sample, BCLK output, WCLK output, DOUT is Hi-Z when unused
             0b0,           // no offset on left justification
             0b0000_0_1_01, // BDIV_CLKIN = DAC_MOD_CLK, BCLK active even when powered down
@@ -329,94 +343,98 @@ impl Codec {
         // explicit WCLK divider
 
         // turn on headset detection
-        self.w(0, &[0]); // select page 0
+        batch.write(0, &[0]); // select page 0
         // detection enabled, 64ms glitch reject, 8ms button glitch reject
-        self.w(67, &[0b1_00_010_01] );
+        batch.write(67, &[0b1_00_010_01] );
 
         // use auto volume control -- DO WE WANT THIS???
-        //self.w(116, &[0b1_1_01_0_001] );
+        //batch.write(116, &[0b1_1_01_0_001] );
+        self.run(&mut batch);
     }
 
     pub fn audio_loopback(&mut self, do_loop:bool) {
-        self.w(0, &[1]); // select page 1
+        let mut batch = I2cBatch::new(TLV320AIC3100_I2C_ADR);
+        batch.write(0, &[1]); // select page 1
 
         // DAC routing -- route DAC to mixer channel, don't loopback MIC
         if do_loop {
-            self.w(35, &[0b01_0_0_01_0_0]);
+            batch.write(35, &[0b01_0_0_01_0_0]);
         } else {
-            self.w(35, &[0b01_0_1_01_1_0]);
+            batch.write(35, &[0b01_0_1_01_1_0]);
         }
+        self.run(&mut batch);
     }
 
     /// set up the audio mixer to sane defaults
     fn audio_mixer(&mut self) {
+        let mut batch = I2cBatch::new(TLV320AIC3100_I2C_ADR);
         ////////// SETUP DAC -- this is on page 0
-        self.w(0, &[0]); // select page 0
+        batch.write(0, &[0]); // select page 0
         // DAC setup - both channels on, soft-stepping enabled, left-to-left, right-to-right
-        self.w(63, &[0b1_1_01_01_00]);
+        batch.write(63, &[0b1_1_01_01_00]);
         // DAC volume - neither DACs muted, independent volume controls
-        self.w(64, &[0b0000_0_0_00]);
+        batch.write(64, &[0b0000_0_0_00]);
         // DAC left volume control
-        self.w(65, &[0b1111_0110]); // -5dB
+        batch.write(65, &[0b1111_0110]); // -5dB
         // DAC right volume control
-        self.w(66, &[0b1111_0110]); // -5dB
+        batch.write(66, &[0b1111_0110]); // -5dB
 
         ///////// VOLUME, PGA CONTROLS -- PAGE 1
-        self.w(0, &[1]); // select page 1
+        batch.write(0, &[1]); // select page 1
 
         // DAC routing -- route DAC to mixer channel, don't loopback MIC
-        self.w(35, &[0b01_0_0_01_0_0]);
-        //self.w(35, &[0b01_0_1_01_1_0]);
+        batch.write(35, &[0b01_0_0_01_0_0]);
+        //batch.write(35, &[0b01_0_1_01_1_0]);
 
         // internal volume control
-        self.w(36, &[
+        batch.write(36, &[
             0b1_001_1110, // HPL channel control on, -15dB
             0b1_001_1110, // HPR channel control on, -15dB
             0b1_000_1100, // SPK control on, -6dB
             ]);
 
         // driver PGA control
-        self.w(40, &[
+        batch.write(40, &[
             0b0_0011_111, // HPL driver PGA = 3dB, not muted, all gains applied
             0b0_0011_111, // HPR driver PGA = 3dB, not muted, all gains applied
             0b000_01_1_0_1, // SPK gain = 12 dB, driver not muted, all gains applied
             ]);
 
             // HP driver control -- 16us short circuit debounce, best DAC performance, HPL/HPR as headphone drivers
-        self.w(44, &[0b010_11_0_0_0]);
+        batch.write(44, &[0b010_11_0_0_0]);
 
         // MICBIAS control -- micbias always on, set to 2.5V
-        self.w(46, &[0b0_000_1_0_10]);
+        batch.write(46, &[0b0_000_1_0_10]);
 
         // MIC PGA
-        self.w(47, &[60]); // target 30dB, code is (target * 2)dB
+        batch.write(47, &[60]); // target 30dB, code is (target * 2)dB
 
         // fine-gain input selection for P_terminal -- only MIC1RP selected, with RIN=10kohm
-        self.w(48, &[0b00_01_00_00]);
+        batch.write(48, &[0b00_01_00_00]);
         // M_terminal select -- CM selected with RIN = 10k
-        self.w(49, &[0b01_00_00_00]);
+        batch.write(49, &[0b01_00_00_00]);
         // CM settincgs - MIC1LP/MIC1LM connected to CM; MIC1RP is floating
-        self.w(50, &[0b1_0_1_00000]);
+        batch.write(50, &[0b1_0_1_00000]);
 
         // don't change power control bits on SC
-        self.w(30, &[0b1_1]);
+        batch.write(30, &[0b1_1]);
 
         // class D amp is powered on
-        self.w(32, &[0b1_0_00011_0]);
+        batch.write(32, &[0b1_0_00011_0]);
 
         // HPL on, HPR on, OCM = 1.65V, limit on short circuit
-        self.w(31, &[0b1_1_0_10_1_0_0]);
+        batch.write(31, &[0b1_1_0_10_1_0_0]);
 
         ////////// SETUP ADC & AGC -- this is on page 0
-        self.w(0, &[0]); // select page 0
+        batch.write(0, &[0]); // select page 0
         // ADC setup -- ADC powered on, digital MIC not used
-        self.w(81, &[0b1_0_00_0_0_00]);
+        batch.write(81, &[0b1_0_00_0_0_00]);
         // ADC digital volume conrol -- not muted, 0dB gain
-        self.w(82, &[0b0_000_0000]);
+        batch.write(82, &[0b0_000_0000]);
         // ADC digital volume control coarse adjust
-        self.w(83, &[0b0]); // +0.0 dB
+        batch.write(83, &[0b0]); // +0.0 dB
 
-        self.w(86, &[
+        batch.write(86, &[
             0b1_011_0000, // AGC enabled, target level = -12dB
             0b00_10101_0, // hysteresis 1dB, noise threshold = -((value-1)*2 + 30): 21 => -70dB
             100, // max gain = code/2 dB
@@ -426,6 +444,7 @@ impl Codec {
             0x01, // signal debounce time = code*4 / fs
             ]);
 
+        self.run(&mut batch);
     }
 
     /// set up the betrusted-side signals
@@ -39,7 +39,7 @@ fn xmain() -> ! {
 
     // register a suspend/resume listener
     let sr_cid = xous::connect(codec_sid).expect("couldn't create suspend callback connection");
-    let mut susres = susres::Susres::new(&xns, api::Opcode::SuspendResume as u32, sr_cid).expect("couldn't create suspend/resume object");
+    let mut susres = susres::Susres::new(Some(susres::SuspendOrder::Early), &xns, api::Opcode::SuspendResume as u32, sr_cid).expect("couldn't create suspend/resume object");
     /*
     let trng = trng::Trng::new(&xns).unwrap();
     let mut noise: [u32; codec::FIFO_DEPTH] = [0; codec::FIFO_DEPTH];
@@ -48,6 +48,12 @@ fn xmain() -> ! {
     }
     */
 
+    // frames have to be swapped in before the FIFO runs dry, no matter what else is running. This
+    // thread must block rather than spin from here on, or it would starve everything at a lower priority.
+    if let Err(e) = xous::set_thread_priority(xous::current_tid().unwrap(), xous::THREAD_PRIORITY_DEFAULT + 2) {
+        log::warn!("couldn't raise codec priority: {:?}", e);
+    }
+
     let mut audio_cb_conns: [Option<ScalarCallback>; 32] = [None; 32];
     loop {
         let mut msg = xous::receive_message(codec_sid).unwrap();
@@ -57,6 +63,7 @@ fn xmain() -> ! {
                 codec.suspend();
                 susres.suspend_until_resume(token).expect("couldn't execute suspend/resume");
                 codec.resume();
+                susres.resumed().expect("couldn't report resume");
             }),
             Some(api::Opcode::PowerOff) => xous::msg_scalar_unpack!(msg, _, _, _, _, {
                 codec.power(false);
@@ -108,7 +115,8 @@ fn xmain() -> ! {
                                 log::debug!("swap overrun");
                                 printed = true;
                             }
-                            xous::yield_slice();
+                            // a yield would come straight back to us at this priority, so sleep instead
+                            ticktimer.sleep_ms(1).unwrap();
                             if !codec.is_live() {
                                 // handle the case that play stopped while we're trying to run the swap
                                 break;
@@ -289,7 +289,7 @@ fn xmain() -> ! {
 
     // register a suspend/resume listener
     let sr_cid = xous::connect(com_sid).expect("couldn't create suspend callback connection");
-    let mut susres = susres::Susres::new(&xns, Opcode::SuspendResume as u32, sr_cid).expect("couldn't create suspend/resume object");
+    let mut susres = susres::Susres::new(Some(susres::SuspendOrder::Early), &xns, Opcode::SuspendResume as u32, sr_cid).expect("couldn't create suspend/resume object");
 
     // create an array to track return connections for battery stats
     let mut battstats_conns: [Option<xous::CID>; 32] = [None; 32];
@@ -317,6 +317,7 @@ fn xmain() -> ! {
                 if bl_main != 0 || bl_sec != 0 { // restore the backlight settings, if they are not 0
                     com.txrx(ComState::BL_START.verb | (bl_main as u16) & 0x1f | (((bl_sec as u16) & 0x1f) << 5));
                 }
+                susres.resumed().expect("couldn't report resume");
             }),
             Some(Opcode::FlashAcquire) => msg_blocking_scalar_unpack!(msg, id0, id1, id2, id3, {
                 let acquired = if flash_id.is_none() {
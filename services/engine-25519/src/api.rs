@@ -20,7 +20,6 @@ pub(crate) const RF_TOTAL_U8_SIZE: usize = 0x4000;
 
 pub(crate) const NUM_REGS: usize = 32;
 pub(crate) const BITWIDTH: usize = 256;
-#[allow(dead_code)] // not used in hosted
 pub(crate) const NUM_WINDOWS: usize = 16;
 pub const RF_SIZE_IN_U32: usize = NUM_REGS*(BITWIDTH/32); // 32 registers, 256 bits/register/32 bits per u32
 #[allow(dead_code)] // not used in hosted
@@ -53,6 +52,58 @@ pub struct MontgomeryJob {
     pub scalar: [u8; 32],
 }
 
+/// Maximum number of jobs in a `MontgomeryBatch`: one per register window
+pub const MONTGOMERY_BATCH_LEN: usize = NUM_WINDOWS;
+/// Maximum number of jobs in a `JobBatch`. Each job carries a whole register file, so this is
+/// kept below the number of windows to keep the batch to a handful of pages.
+pub const JOB_BATCH_LEN: usize = 8;
+
+#[derive(Debug, rkyv::Archive, rkyv::Serialize, rkyv::Deserialize, Clone, Copy, PartialEq, Eq)]
+pub enum BatchStatus {
+    /// the batch has not been run
+    Pending,
+    /// every job in the batch ran to completion
+    Complete,
+    EngineUnavailable,
+    /// the job at index `completed` hit an illegal opcode
+    IllegalOpcodeException,
+    /// a suspend interrupted the job at index `completed`
+    SuspendError,
+}
+
+/// A set of Montgomery ladder jobs that are run back to back. Every job is loaded into its own
+/// register window up front, so the engine goes from one job to the next without waiting for
+/// the register file to be copied in.
+#[derive(Debug, rkyv::Archive, rkyv::Serialize, rkyv::Deserialize, Clone, Copy)]
+pub struct MontgomeryBatch {
+    pub jobs: [MontgomeryJob; MONTGOMERY_BATCH_LEN],
+    /// number of valid entries in `jobs`
+    pub len: u32,
+    /// on return, the result of each job
+    pub results: [[u8; 32]; MONTGOMERY_BATCH_LEN],
+    /// on return, the number of jobs that completed
+    pub completed: u32,
+    pub status: BatchStatus,
+}
+
+/// A set of jobs that share one microcode program, each with its own register file.
+#[derive(Debug, rkyv::Archive, rkyv::Serialize, rkyv::Deserialize, Clone, Copy)]
+pub struct JobBatch {
+    /// start location for microcode load
+    pub uc_start: u32,
+    /// length of the microcode to run
+    pub uc_len: u32,
+    /// microcode program, shared by every job in the batch
+    pub ucode: [u32; 1024],
+    /// number of valid entries in `rf`
+    pub len: u32,
+    /// the initial register file of each job. On return, the register file each job finished with.
+    pub rf: [[u32; RF_SIZE_IN_U32]; JOB_BATCH_LEN],
+    /// on return, the number of jobs that completed
+    pub completed: u32,
+    pub status: BatchStatus,
+}
+
 #[derive(num_derive::FromPrimitive, num_derive::ToPrimitive, Debug)]
 pub(crate) enum Opcode {
     /// Runs a job, if the server is not already occupied
@@ -61,6 +112,12 @@ pub(crate) enum Opcode {
     /// MontgomeryJob
     MontgomeryJob,
 
+    /// Runs a MontgomeryBatch synchronously
+    MontgomeryBatch,
+
+    /// Runs a JobBatch synchronously
+    RunBatch,
+
     /// a function that can be polled to determine if the block has been currently acquired
     IsFree,
 
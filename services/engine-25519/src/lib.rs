@@ -100,6 +100,30 @@ impl Engine25519 {
         }
     }
 
+    /// Runs a set of Montgomery ladder jobs, writing the result of each into `results`. Jobs are
+    /// sent to the engine up to `MONTGOMERY_BATCH_LEN` at a time, which saves a round trip and a
+    /// microcode check per job compared to calling `montgomery_job()` in a loop.
+    pub fn montgomery_batch(&mut self, jobs: &[MontgomeryJob], results: &mut [[u8; 32]]) -> Result<(), xous::Error> {
+        let conn = self.conn;
+        montgomery_batches(jobs, results, |batch| {
+            let mut buf = Buffer::into_buf(batch).or(Err(xous::Error::OutOfMemory))?;
+            buf.lend_mut(conn, Opcode::MontgomeryBatch.to_u32().unwrap())?;
+            Ok(buf.to_original().unwrap())
+        })
+    }
+
+    /// Runs the microcode in `ucode` once for each register file in `rf`, replacing each register
+    /// file with the one its job finished with. Register files are sent up to `JOB_BATCH_LEN`
+    /// at a time, and the microcode is only loaded once per batch.
+    pub fn spawn_job_batch(&mut self, uc_start: u32, uc_len: u32, ucode: &[u32; 1024], rf: &mut [[u32; RF_SIZE_IN_U32]]) -> Result<(), xous::Error> {
+        let conn = self.conn;
+        job_batches(uc_start, uc_len, ucode, rf, |batch| {
+            let mut buf = Buffer::into_buf(batch).or(Err(xous::Error::OutOfMemory))?;
+            buf.lend_mut(conn, Opcode::RunBatch.to_u32().unwrap())?;
+            Ok(buf.to_original().unwrap())
+        })
+    }
+
     /// this is a blocking version of spawn_async_job.
     /// if the engine is free, it will block until a result is returned
     /// if the engine is busy, it will return an EngineUnavailable result.
@@ -141,6 +165,72 @@ impl Engine25519 {
     }
 }
 
+/// Packs `jobs` into `MontgomeryBatch`es and hands each to `run`, which returns the batch as the
+/// engine left it. Results are copied out in job order. Kept apart from the IPC so the packing
+/// can be checked on a host without an engine.
+fn montgomery_batches<F>(jobs: &[MontgomeryJob], results: &mut [[u8; 32]], mut run: F) -> Result<(), xous::Error>
+where F: FnMut(MontgomeryBatch) -> Result<MontgomeryBatch, xous::Error> {
+    if results.len() < jobs.len() {
+        return Err(xous::Error::InvalidSyscall);
+    }
+    for (chunk, chunk_results) in jobs.chunks(MONTGOMERY_BATCH_LEN).zip(results.chunks_mut(MONTGOMERY_BATCH_LEN)) {
+        let mut batch = MontgomeryBatch {
+            jobs: [chunk[0]; MONTGOMERY_BATCH_LEN],
+            len: chunk.len() as u32,
+            results: [[0; 32]; MONTGOMERY_BATCH_LEN],
+            completed: 0,
+            status: BatchStatus::Pending,
+        };
+        batch.jobs[..chunk.len()].copy_from_slice(chunk);
+        let returned = run(batch)?;
+        batch_status(returned.status)?;
+        chunk_results[..chunk.len()].copy_from_slice(&returned.results[..chunk.len()]);
+    }
+    Ok(())
+}
+
+/// Packs the register files in `rf` into `JobBatch`es and hands each to `run`, replacing each
+/// register file with the one its job finished with.
+fn job_batches<F>(uc_start: u32, uc_len: u32, ucode: &[u32; 1024], rf: &mut [[u32; RF_SIZE_IN_U32]], mut run: F) -> Result<(), xous::Error>
+where F: FnMut(JobBatch) -> Result<JobBatch, xous::Error> {
+    for chunk in rf.chunks_mut(JOB_BATCH_LEN) {
+        let mut batch = JobBatch {
+            uc_start,
+            uc_len,
+            ucode: *ucode,
+            len: chunk.len() as u32,
+            rf: [[0; RF_SIZE_IN_U32]; JOB_BATCH_LEN],
+            completed: 0,
+            status: BatchStatus::Pending,
+        };
+        batch.rf[..chunk.len()].copy_from_slice(chunk);
+        let returned = run(batch)?;
+        batch_status(returned.status)?;
+        let len = chunk.len();
+        chunk.copy_from_slice(&returned.rf[..len]);
+    }
+    Ok(())
+}
+
+/// map the status of a batch onto the errors returned by the single-job calls
+fn batch_status(status: BatchStatus) -> Result<(), xous::Error> {
+    match status {
+        BatchStatus::Complete => Ok(()),
+        BatchStatus::EngineUnavailable => {
+            log::debug!("batch job: engine unavailable");
+            Err(xous::Error::ServerQueueFull)
+        },
+        BatchStatus::IllegalOpcodeException => {
+            log::error!("batch job: illegal opcode");
+            Err(xous::Error::InvalidString)
+        },
+        _ => {
+            log::error!("batch job: other error");
+            Err(xous::Error::UnknownError)
+        }
+    }
+}
+
 use core::sync::atomic::{AtomicU32, Ordering};
 static REFCOUNT: AtomicU32 = AtomicU32::new(0);
 impl Drop for Engine25519 {
@@ -182,3 +272,130 @@ fn engine_cb_server(sid0: usize, sid1: usize, sid2: usize, sid3: usize) {
     }
     xous::destroy_server(sid).unwrap();
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use rkyv::{archived_value, ser::{Serializer, serializers::BufferSerializer}, Archive, Deserialize, Serialize};
+    use xous_ipc::XousDeserializer;
+
+    /// Sends `value` through rkyv the way a lent `Buffer` carries it: serialized into
+    /// word-aligned memory, then deserialized from the archived form on the other side.
+    fn wire<T>(value: T) -> T
+    where
+        T: Archive + for<'a> Serialize<BufferSerializer<&'a mut [u8]>>,
+        T::Archived: Deserialize<T, XousDeserializer>,
+    {
+        let mut mem = vec![0u64; core::mem::size_of::<T>() / 8 + 64];
+        let bytes = unsafe { core::slice::from_raw_parts_mut(mem.as_mut_ptr() as *mut u8, mem.len() * 8) };
+        let mut ser = BufferSerializer::new(bytes);
+        let pos = ser.serialize_value(&value).unwrap();
+        let bytes = ser.into_inner();
+        let archived = unsafe { archived_value::<T>(bytes, pos) };
+        archived.deserialize(&mut XousDeserializer {}).unwrap()
+    }
+
+    fn numbered_job(i: usize) -> MontgomeryJob {
+        let mut job = MontgomeryJob {
+            x0_u: [0; 32],
+            x0_w: [0; 32],
+            x1_u: [0; 32],
+            x1_w: [0; 32],
+            affine_u: [0; 32],
+            scalar: [0; 32],
+        };
+        job.scalar[..4].copy_from_slice(&(i as u32).to_le_bytes());
+        job.affine_u[31] = 0x40;
+        job
+    }
+
+    /// a stand-in for the engine server: each job's result is its scalar
+    fn fake_montgomery(batch: MontgomeryBatch) -> MontgomeryBatch {
+        let mut batch = wire(batch);
+        for i in 0..batch.len as usize {
+            assert_eq!(batch.jobs[i].affine_u[31], 0x40, "job {} was mangled in transit", i);
+            batch.results[i] = batch.jobs[i].scalar;
+        }
+        batch.completed = batch.len;
+        batch.status = BatchStatus::Complete;
+        wire(batch)
+    }
+
+    #[test]
+    fn montgomery_batch_order() {
+        // enough jobs for two full batches and a partial one
+        let count = MONTGOMERY_BATCH_LEN * 2 + 5;
+        let jobs: Vec<MontgomeryJob> = (0..count).map(numbered_job).collect();
+        let mut results = vec![[0xFFu8; 32]; count];
+        let mut lens = Vec::new();
+        montgomery_batches(&jobs, &mut results, |batch| {
+            lens.push(batch.len);
+            Ok(fake_montgomery(batch))
+        }).unwrap();
+        assert_eq!(lens, vec![MONTGOMERY_BATCH_LEN as u32, MONTGOMERY_BATCH_LEN as u32, 5]);
+        for (i, result) in results.iter().enumerate() {
+            assert_eq!(*result, numbered_job(i).scalar, "result {} is out of order", i);
+        }
+
+        // results that can't hold every job are refused before anything is sent
+        let mut short = vec![[0u8; 32]; count - 1];
+        let ret = montgomery_batches(&jobs, &mut short, |_| panic!("batch sent with too few results"));
+        assert_eq!(ret, Err(xous::Error::InvalidSyscall));
+    }
+
+    #[test]
+    fn montgomery_batch_error() {
+        let count = MONTGOMERY_BATCH_LEN + 1;
+        let jobs: Vec<MontgomeryJob> = (0..count).map(numbered_job).collect();
+        let mut results = vec![[0u8; 32]; count];
+        let mut sent = 0;
+        let ret = montgomery_batches(&jobs, &mut results, |batch| {
+            sent += 1;
+            if sent == 1 {
+                Ok(fake_montgomery(batch))
+            } else {
+                let mut batch = wire(batch);
+                batch.status = BatchStatus::EngineUnavailable;
+                Ok(wire(batch))
+            }
+        });
+        assert_eq!(ret, Err(xous::Error::ServerQueueFull));
+        // the first batch finished, so its results are still reported
+        for i in 0..MONTGOMERY_BATCH_LEN {
+            assert_eq!(results[i], numbered_job(i).scalar);
+        }
+        assert_eq!(results[MONTGOMERY_BATCH_LEN], [0; 32]);
+    }
+
+    #[test]
+    fn job_batch_order() {
+        let mut ucode = [0u32; 1024];
+        for (i, word) in ucode.iter_mut().enumerate() {
+            *word = i as u32 ^ 0x5A5A;
+        }
+        let count = JOB_BATCH_LEN * 2 + 3;
+        let mut rf = vec![[0u32; RF_SIZE_IN_U32]; count];
+        for (i, r) in rf.iter_mut().enumerate() {
+            r[0] = i as u32;
+        }
+        let mut lens = Vec::new();
+        job_batches(3, 17, &ucode, &mut rf, |batch| {
+            let mut batch = wire(batch);
+            assert_eq!(batch.uc_start, 3);
+            assert_eq!(batch.uc_len, 17);
+            assert!(batch.ucode[..] == ucode[..], "microcode was mangled in transit");
+            lens.push(batch.len);
+            for r in batch.rf[..batch.len as usize].iter_mut() {
+                r[31 * 8] = r[0] * 2 + 1;
+            }
+            batch.completed = batch.len;
+            batch.status = BatchStatus::Complete;
+            Ok(wire(batch))
+        }).unwrap();
+        assert_eq!(lens, vec![JOB_BATCH_LEN as u32, JOB_BATCH_LEN as u32, 3]);
+        for (i, r) in rf.iter().enumerate() {
+            assert_eq!(r[0], i as u32, "register file {} is out of order", i);
+            assert_eq!(r[31 * 8], i as u32 * 2 + 1);
+        }
+    }
+}
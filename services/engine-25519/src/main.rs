@@ -30,6 +30,9 @@ mod implementation {
     use crate::DISALLOW_SUSPEND;
     use core::convert::TryInto;
 
+    /// where the Montgomery ladder microcode is loaded
+    const MONTGOMERY_MPSTART: u32 = 0;
+
     pub struct Engine25519Hw {
         csr: utralib::CSR<u32>,
         // these are slices mapped directly to the hardware memory space
@@ -606,7 +609,13 @@ mod implementation {
             DISALLOW_SUSPEND.store(true, Ordering::Relaxed);
 
             let window: usize = 0;
+            self.load_montgomery_regs(&job, window);
+            let mplen = self.ensure_montgomery();
 
+            log::trace!("sanity check uc{:08x}, rf{:08x}", self.ucode_hw[0], self.rf_hw[0]);
+            self.start_sync(window, MONTGOMERY_MPSTART, mplen);
+        }
+        fn load_montgomery_regs(&mut self, job: &MontgomeryJob, window: usize) {
             self.copy_reg(job.x0_u, 25, window);
             self.copy_reg(job.x0_w, 26, window);
             self.copy_reg(job.x1_u, 27, window);
@@ -619,17 +628,21 @@ mod implementation {
                0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
                0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
             ], 19, window); // 254 as loop counter
-
-            let mpstart = 0;
+        }
+        /// make sure the Montgomery microcode is loaded, and return its length
+        fn ensure_montgomery(&mut self) -> u32 {
             // this optimization shaves off about 0.13ms per iteration
             if self.montgomery_len.is_none() {
-                self.montgomery_len = Some(self.load_montgomery(mpstart) as usize);
+                self.montgomery_len = Some(self.load_montgomery(MONTGOMERY_MPSTART) as usize);
             }
-            self.csr.wfo(utra::engine::WINDOW_WINDOW, window as u32); // this value should now be validated because an invalid window would cause a panic on slice copy
+            self.montgomery_len.unwrap() as u32
+        }
+        /// start the microcode that's already loaded on the register file in `window`, without a
+        /// completion message. Must be called with DISALLOW_SUSPEND set.
+        fn start_sync(&mut self, window: usize, mpstart: u32, mplen: u32) {
+            self.csr.wfo(utra::engine::WINDOW_WINDOW, window as u32);
             self.csr.wfo(utra::engine::MPSTART_MPSTART, mpstart);
-            self.csr.wfo(utra::engine::MPLEN_MPLEN, self.montgomery_len.unwrap() as u32);
-
-            log::trace!("sanity check uc{:08x}, rf{:08x}", self.ucode_hw[0], self.rf_hw[0]);
+            self.csr.wfo(utra::engine::MPLEN_MPLEN, mplen);
 
             // sync calls poll a state variable, and thus no message is sent
             self.do_notify = false;
@@ -642,6 +655,79 @@ mod implementation {
             // we are now in a stable config, suspends are allowed
             DISALLOW_SUSPEND.store(false, Ordering::Relaxed);
         }
+        /// the status of the job that just finished, if it failed
+        fn job_error(&self) -> Option<BatchStatus> {
+            if self.clean_resume == Some(false) {
+                Some(BatchStatus::SuspendError)
+            } else if self.illegal_opcode {
+                Some(BatchStatus::IllegalOpcodeException)
+            } else {
+                None
+            }
+        }
+        /// Run the windows `0..len` one after the other, calling `done` as each one finishes.
+        /// Returns the number of windows that completed and the status of the batch.
+        fn run_windows<F>(&mut self, len: usize, mpstart: u32, mplen: u32, mut done: F) -> (u32, BatchStatus)
+            where F: FnMut(&mut Self, usize) {
+            for window in 0..len {
+                DISALLOW_SUSPEND.store(true, Ordering::Relaxed);
+                self.start_sync(window, mpstart, mplen);
+                while RUN_IN_PROGRESS.load(Ordering::Relaxed) {
+                    xous::yield_slice();
+                }
+                if let Some(err) = self.job_error() {
+                    DISALLOW_SUSPEND.store(false, Ordering::Relaxed);
+                    return (window as u32, err);
+                }
+                done(self, window);
+            }
+            DISALLOW_SUSPEND.store(false, Ordering::Relaxed);
+            (len as u32, BatchStatus::Complete)
+        }
+        pub fn montgomery_batch(&mut self, batch: &mut MontgomeryBatch) {
+            // block any suspends from happening while we set up the engine
+            DISALLOW_SUSPEND.store(true, Ordering::Relaxed);
+            let len = (batch.len as usize).min(MONTGOMERY_BATCH_LEN);
+            // the windows don't share any state, so every job is loaded before the first one starts
+            for (window, job) in batch.jobs[..len].iter().enumerate() {
+                self.load_montgomery_regs(job, window);
+            }
+            let mplen = self.ensure_montgomery();
+            let results = &mut batch.results;
+            let (completed, status) = self.run_windows(len, MONTGOMERY_MPSTART, mplen, |engine, window| {
+                results[window] = engine.read_reg(31, window);
+            });
+            batch.completed = completed;
+            batch.status = status;
+        }
+        pub fn run_batch(&mut self, batch: &mut JobBatch) {
+            self.montgomery_len = None;
+            DISALLOW_SUSPEND.store(true, Ordering::Relaxed);
+            let len = (batch.len as usize).min(JOB_BATCH_LEN);
+            for (window, rf) in batch.rf[..len].iter().enumerate() {
+                for (&src, dst) in rf.iter().zip(self.rf_hw[window * RF_SIZE_IN_U32..(window+1) * RF_SIZE_IN_U32].iter_mut()) {
+                    unsafe { (dst as *mut u32).write_volatile(src) };
+                }
+            }
+            for (&src, dst) in batch.ucode.iter().zip(self.ucode_hw.iter_mut()) {
+                unsafe { (dst as *mut u32).write_volatile(src) };
+            }
+            let rf_out = &mut batch.rf;
+            let (completed, status) = self.run_windows(len, batch.uc_start, batch.uc_len, |engine, window| {
+                for (&src, dst) in engine.rf_hw[window * RF_SIZE_IN_U32..(window+1) * RF_SIZE_IN_U32].iter().zip(rf_out[window].iter_mut()) {
+                    unsafe { (dst as *mut u32).write_volatile(src) };
+                }
+            });
+            batch.completed = completed;
+            batch.status = status;
+        }
+        fn read_reg(&self, r: usize, window: usize) -> [u8; 32] {
+            let mut ret_r: [u8; 32] = [0; 32];
+            for (&src, dst) in self.rf_hw[window * RF_SIZE_IN_U32 + r * 8..window * RF_SIZE_IN_U32 + (r+1) * 8].iter().zip(ret_r.chunks_exact_mut(4)) {
+                dst.copy_from_slice(&src.to_le_bytes());
+            }
+            ret_r
+        }
 
         pub fn get_result(&mut self) -> JobResult {
             if let Some(clean_resume) = self.clean_resume {
@@ -679,15 +765,8 @@ mod implementation {
                 return JobResult::IllegalOpcodeException;
             }
 
-            let mut ret_r: [u8; 32] = [0; 32];
             let window = self.csr.rf(utra::engine::WINDOW_WINDOW) as usize;
-            for (&src, dst) in self.rf_hw[window * RF_SIZE_IN_U32 + r * 8..window * RF_SIZE_IN_U32 + (r+1) * 8].iter().zip(ret_r.chunks_exact_mut(4)) {
-                for (&src_byte, dst_byte) in src.to_le_bytes().iter().zip(dst.iter_mut()) {
-                    *dst_byte = src_byte;
-                }
-            }
-
-            JobResult::SingleResult(ret_r)
+            JobResult::SingleResult(self.read_reg(r, window))
         }
     }
 }
@@ -721,10 +800,26 @@ mod implementation {
         pub fn get_single_result(&mut self, _r: usize) -> JobResult {
             JobResult::EngineUnavailable
         }
+        pub fn montgomery_batch(&mut self, batch: &mut MontgomeryBatch) {
+            batch.completed = 0;
+            batch.status = BatchStatus::EngineUnavailable;
+        }
+        pub fn run_batch(&mut self, batch: &mut JobBatch) {
+            batch.completed = 0;
+            batch.status = BatchStatus::EngineUnavailable;
+        }
     }
 }
 
 
+/// Logs the job count each time it passes a multiple of 100. A batch adds many jobs at once, so
+/// this checks whether `count..count + len` contains a multiple rather than whether `count` is one.
+fn log_job_count(kind: &str, count: u32, len: u32) {
+    if len != 0 && (count + 99) / 100 * 100 < count.saturating_add(len) {
+        log::info!("{} job {}", kind, count);
+    }
+}
+
 fn susres_thread(engine_arg: usize) {
     use crate::implementation::Engine25519Hw;
     let engine25519 = unsafe { &mut *(engine_arg as *mut Engine25519Hw) };
@@ -734,7 +829,7 @@ fn susres_thread(engine_arg: usize) {
 
     // register a suspend/resume listener
     let sr_cid = xous::connect(susres_sid).expect("couldn't create suspend callback connection");
-    let mut susres = susres::Susres::new(&xns, api::SusResOps::SuspendResume as u32, sr_cid).expect("couldn't create suspend/resume object");
+    let mut susres = susres::Susres::new(None, &xns, api::SusResOps::SuspendResume as u32, sr_cid).expect("couldn't create suspend/resume object");
 
     log::trace!("starting engine25519 suspend/resume manager loop");
     loop {
@@ -760,6 +855,7 @@ fn susres_thread(engine_arg: usize) {
                 engine25519.suspend();
                 susres.suspend_until_resume(token).expect("couldn't execute suspend/resume");
                 engine25519.resume();
+                susres.resumed().expect("couldn't report resume");
                 SUSPEND_IN_PROGRESS.store(false, Ordering::Relaxed);
             }),
             Some(SusResOps::Quit) => {
@@ -797,16 +893,15 @@ fn xmain() -> ! {
     xous::create_thread_1(susres_thread, (&mut engine25519) as *mut Engine25519Hw as usize).expect("couldn't start susres handler thread");
 
     let mut client_cid: Option<xous::CID> = None;
-    let mut job_count = 0;
-    let mut mont_count = 0;
+    let mut job_count: u32 = 0;
+    let mut mont_count: u32 = 0;
     loop {
         let mut msg = xous::receive_message(engine25519_sid).unwrap();
         log::trace!("Message: {:?}", msg);
         match FromPrimitive::from_usize(msg.body.id()) {
             Some(Opcode::MontgomeryJob) => {
-                if mont_count % 100 == 0 {
-                    log::info!("montgomery job {}", mont_count); // leave this here for now so we can confirm that HW acceleration is being selected when we think it is!
-                }
+                // leave this here for now so we can confirm that HW acceleration is being selected when we think it is!
+                log_job_count("montgomery", mont_count, 1);
                 mont_count += 1;
                 // don't start a new job if a suspend is in progress
                 while SUSPEND_IN_PROGRESS.load(Ordering::Relaxed) {
@@ -825,10 +920,47 @@ fn xmain() -> ! {
                 engine25519.power_on(false);
                 buffer.replace(result).unwrap();
             }
-            Some(Opcode::RunJob) => {
-                if job_count % 100 == 0 {
-                    log::info!("engine job {}", job_count); // leave this here for now so we can confirm that HW acceleration is being selected when we think it is!
+            Some(Opcode::MontgomeryBatch) => {
+                let mut buffer = unsafe { Buffer::from_memory_message_mut(msg.body.memory_message_mut().unwrap()) };
+                let mut batch = buffer.to_original::<MontgomeryBatch, _>().unwrap();
+                if client_cid.is_none() {
+                    log_job_count("montgomery", mont_count, batch.len);
+                    mont_count += batch.len;
+                    while SUSPEND_IN_PROGRESS.load(Ordering::Relaxed) {
+                        log::trace!("waiting for suspend to finish");
+                        xous::yield_slice();
+                    }
+                    engine25519.power_on(true);
+                    engine25519.montgomery_batch(&mut batch);
+                    engine25519.power_on(false);
+                } else {
+                    batch.completed = 0;
+                    batch.status = BatchStatus::EngineUnavailable;
+                }
+                buffer.replace(batch).unwrap();
+            }
+            Some(Opcode::RunBatch) => {
+                let mut buffer = unsafe { Buffer::from_memory_message_mut(msg.body.memory_message_mut().unwrap()) };
+                let mut batch = buffer.to_original::<JobBatch, _>().unwrap();
+                if client_cid.is_none() {
+                    log_job_count("engine", job_count, batch.len);
+                    job_count += batch.len;
+                    while SUSPEND_IN_PROGRESS.load(Ordering::Relaxed) {
+                        log::trace!("waiting for suspend to finish");
+                        xous::yield_slice();
+                    }
+                    engine25519.power_on(true);
+                    engine25519.run_batch(&mut batch);
+                    engine25519.power_on(false);
+                } else {
+                    batch.completed = 0;
+                    batch.status = BatchStatus::EngineUnavailable;
                 }
+                buffer.replace(batch).unwrap();
+            }
+            Some(Opcode::RunJob) => {
+                // leave this here for now so we can confirm that HW acceleration is being selected when we think it is!
+                log_job_count("engine", job_count, 1);
                 job_count += 1;
                 // don't start a new job if a suspend is in progress
                 while SUSPEND_IN_PROGRESS.load(Ordering::Relaxed) {
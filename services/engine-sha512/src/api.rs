@@ -41,6 +41,11 @@ pub(crate) enum Opcode {
     /// Acquisition will always fail if a Suspend request is pending.
     AcquireExclusive,
 
+    /// Like AcquireExclusive, but if the hardware is busy the caller is put in a queue, and the
+    /// message returns true once the lock has been handed to it. Returns false if the queue
+    /// is full, a suspend is pending, or the hardware didn't come free within a second.
+    AcquireExclusiveWait,
+
     /// Used by higher level coordination processes to acquire a lock on the hardware unit
     /// to prevent any new transactions from occuring. The lock is automatically cleared on
     /// a resume, or by an explicit release
@@ -52,6 +57,11 @@ pub(crate) enum Opcode {
     /// This function will fail if the hardware was shut down with a suspend/resume while hashing
     Update,
 
+    /// lends a raw buffer for updating the hash, with the number of bytes to hash in the `valid`
+    /// field. The buffer may span many pages and isn't serialized, so large inputs are hashed
+    /// straight out of the caller's memory. Only accepted from the process holding the lock.
+    UpdateRaw,
+
     /// finalizes a hash, but exclusive lock is kept. Return value is the requested hash.
     /// This function will fail if the hardware was shut down with a suspend/resume while hashing
     Finalize,
@@ -63,10 +73,20 @@ pub(crate) enum Opcode {
     /// a function that can be polled to determine if the block has been currently acquired
     IsIdle,
 
+    /// sent by the suspend/resume thread after a resume, to hand the hardware to any queued clients
+    ServeQueue,
+
+    /// sent by the wait timeout thread, to fail back clients that have waited too long for the
+    /// hardware. Returns the number of milliseconds until the next check.
+    ExpireWaiters,
+
     /// exit the server
     Quit,
 }
 
+/// Inputs larger than one `Sha2Update` are sent with `UpdateRaw`, up to this many bytes at a time
+pub(crate) const UPDATE_RAW_MAX: usize = 64 * 1024;
+
 #[derive(num_derive::FromPrimitive, num_derive::ToPrimitive, Debug)]
 pub(crate) enum SusResOps {
     /// Suspend/resume callback
@@ -76,6 +76,40 @@ impl Engine512 {
     }
 }
 
+/// The buffer that large updates are copied into before being lent to the hardware. It's
+/// mapped on the first large update and kept until the hasher is dropped, rather than being
+/// mapped and unmapped for every update. A clone maps its own, so two hashers never share one.
+#[derive(Default)]
+struct Scratch(Option<xous::MemoryRange>);
+
+impl Scratch {
+    fn get(&mut self) -> xous::MemoryRange {
+        if self.0.is_none() {
+            self.0 = Some(xous::map_memory(
+                None,
+                None,
+                UPDATE_RAW_MAX,
+                xous::MemoryFlags::R | xous::MemoryFlags::W,
+            ).expect("couldn't map scratch buffer for hashing"));
+        }
+        self.0.unwrap()
+    }
+}
+
+impl Clone for Scratch {
+    fn clone(&self) -> Self {
+        Scratch(None)
+    }
+}
+
+impl Drop for Scratch {
+    fn drop(&mut self) {
+        if let Some(scratch) = self.0.take() {
+            xous::unmap_memory(scratch).expect("couldn't free scratch buffer");
+        }
+    }
+}
+
 // a macro for common communications libraries for SHA2 hardware interfacing
 // you can't reference fields in a trait. looks like a macro is the accepted way
 // of not having to repeat this code over and over again.
@@ -132,8 +166,14 @@ macro_rules! sha512_comms {
             if !self.in_progress && (self.strategy != FallbackStrategy::SoftwareOnly) {
                 loop {
                     let conn = self.ensure_conn(); // also ensures the ID
+                    // when waiting for the hardware, let the server queue us up rather than polling it
+                    let acquire = if self.strategy == FallbackStrategy::WaitForHardware {
+                        Opcode::AcquireExclusiveWait
+                    } else {
+                        Opcode::AcquireExclusive
+                    };
                     let response = send_message(conn,
-                        Message::new_blocking_scalar(Opcode::AcquireExclusive.to_usize().unwrap(),
+                        Message::new_blocking_scalar(acquire.to_usize().unwrap(),
                             TOKEN[0].load(Ordering::Relaxed) as usize,
                             TOKEN[1].load(Ordering::Relaxed) as usize,
                             TOKEN[2].load(Ordering::Relaxed) as usize,
@@ -151,7 +191,8 @@ macro_rules! sha512_comms {
                                 self.in_progress = true;
                                 break;
                             } else {
-                                // this is hardware-exclusive mode, we block until we can get the hardware
+                                // this is hardware-exclusive mode, and the wait queue is full or a suspend
+                                // is pending: back off and try again
                                 xous::yield_slice();
                             }
                         }
@@ -165,6 +206,38 @@ macro_rules! sha512_comms {
                 self.in_progress = true;
             }
         }
+        /// Send `input` to the hardware. Small inputs are copied into a `Sha2Update`; anything larger
+        /// is copied into this hasher's scratch buffer and lent with `UpdateRaw`, so it costs one
+        /// message per `UPDATE_RAW_MAX` bytes instead of one per 3968.
+        pub(crate) fn update_hw(&mut self, input: &[u8]) {
+            if input.len() <= 3968 {
+                // one SHA512 block (128 bytes) short of 4096 to give space for struct overhead in page remap handling
+                let mut update = Sha2Update {
+                    id: [TOKEN[0].load(Ordering::Relaxed), TOKEN[1].load(Ordering::Relaxed), TOKEN[2].load(Ordering::Relaxed)],
+                    buffer: [0; 3968],
+                    len: 0,
+                };
+                self.length += (input.len() as u64) * 8; // we need to keep track of length in bits
+                update.buffer[..input.len()].copy_from_slice(input);
+                update.len = input.len() as u16;
+                let buf = Buffer::into_buf(update).expect("couldn't map chunk into IPC buffer");
+                buf.lend(self.ensure_conn(), Opcode::Update.to_u32().unwrap()).expect("hardware rejected our hash chunk!");
+                return;
+            }
+            let scratch = self.scratch.get();
+            for chunk in input.chunks(UPDATE_RAW_MAX) {
+                scratch.as_slice_mut::<u8>()[..chunk.len()].copy_from_slice(chunk);
+                self.length += (chunk.len() as u64) * 8;
+                send_message(self.ensure_conn(),
+                    Message::Borrow(xous::MemoryMessage {
+                        id: Opcode::UpdateRaw.to_usize().unwrap(),
+                        buf: scratch,
+                        offset: None,
+                        valid: xous::MemorySize::new(chunk.len()),
+                    })
+                ).expect("hardware rejected our hash chunk!");
+            }
+        }
         pub(crate) fn reset_hw(&mut self) {
             send_message(self.ensure_conn(),
                 Message::new_blocking_scalar(Opcode::Reset.to_usize().unwrap(),
@@ -194,6 +267,8 @@ pub struct Sha512 {
     in_progress: bool,
     /// track the length of the message processed so far
     length: u64,
+    /// buffer for lending large updates to the hardware
+    scratch: Scratch,
 }
 impl Sha512 {
     // use this function instead of default for more control over configuration of the hardware engine
@@ -209,6 +284,7 @@ impl Sha512 {
             engine: Engine512::new(&H512),
             in_progress: false,
             length: 0,
+            scratch: Scratch::default(),
         }
     }
     // make all the boilerplate comms code shared between all sizes of digest
@@ -240,25 +316,10 @@ impl BlockInput for Sha512 {
 impl Update for Sha512 {
     fn update(&mut self, input: impl AsRef<[u8]>) {
         self.try_acquire_hw(Sha2Config::Sha512);
-        // split the incoming blocks to page size and send to the engine
         if self.use_soft {
             self.engine.update(input.as_ref());
         } else {
-            for chunk in input.as_ref().chunks(3968) {
-                // one SHA512 block (128 bytes) short of 4096 to give space for struct overhead in page remap handling
-                let mut update = Sha2Update {
-                    id: [TOKEN[0].load(Ordering::Relaxed), TOKEN[1].load(Ordering::Relaxed), TOKEN[2].load(Ordering::Relaxed)],
-                    buffer: [0; 3968],
-                    len: 0,
-                };
-                self.length += (chunk.len() as u64) * 8; // we need to keep track of length in bits
-                for (&src, dest) in chunk.iter().zip(&mut update.buffer) {
-                    *dest = src;
-                }
-                update.len = chunk.len() as u16;
-                let buf = Buffer::into_buf(update).expect("couldn't map chunk into IPC buffer");
-                buf.lend(self.ensure_conn(), Opcode::Update.to_u32().unwrap()).expect("hardware rejected our hash chunk!");
-            }
+            self.update_hw(input.as_ref());
         }
     }
 }
@@ -337,6 +398,8 @@ pub struct Sha512Trunc256 {
     in_progress: bool,
     /// track the length of the message processed so far
     length: u64,
+    /// buffer for lending large updates to the hardware
+    scratch: Scratch,
 }
 impl Sha512Trunc256 {
     // use this function instead of default for more control over configuration of the hardware engine
@@ -352,6 +415,7 @@ impl Sha512Trunc256 {
             engine: Engine512::new(&H512_TRUNC_256),
             in_progress: false,
             length: 0,
+            scratch: Scratch::default(),
         }
     }
     // make all the boilerplate comms code shared between all sizes of digest
@@ -382,21 +446,7 @@ impl Update for Sha512Trunc256 {
         if self.use_soft {
             self.engine.update(input.as_ref());
         } else {
-            for chunk in input.as_ref().chunks(3968) {
-                // one SHA512 block (128 bytes) short of 4096 to give space for struct overhead in page remap handling
-                let mut update = Sha2Update {
-                    id: [TOKEN[0].load(Ordering::Relaxed), TOKEN[1].load(Ordering::Relaxed), TOKEN[2].load(Ordering::Relaxed)],
-                    buffer: [0; 3968],
-                    len: 0,
-                };
-                self.length += (chunk.len() as u64) * 8; // we need to keep track of length in bits
-                for (&src, dest) in chunk.iter().zip(&mut update.buffer) {
-                    *dest = src;
-                }
-                update.len = chunk.len() as u16;
-                let buf = Buffer::into_buf(update).expect("couldn't map chunk into IPC buffer");
-                buf.lend(self.ensure_conn(), Opcode::Update.to_u32().unwrap()).expect("hardware rejected our hash chunk!");
-            }
+            self.update_hw(input.as_ref());
         }
     }
 }
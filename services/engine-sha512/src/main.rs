@@ -14,7 +14,7 @@ use xous::msg_blocking_scalar_unpack;
 
 use log::info;
 
-use core::sync::atomic::{AtomicBool, Ordering};
+use core::sync::atomic::{AtomicBool, AtomicU32, AtomicUsize, Ordering};
 
 #[cfg(target_os = "none")]
 mod implementation {
@@ -24,9 +24,16 @@ mod implementation {
     // Note: there is no susres manager for the Sha512 engine, because its state cannot be saved through a full power off
     // instead, we try to delay a suspend until the caller is finished hashing, and if not, we note that and return a failure
     // for the hash result.
+    /// Number of times to poll a full FIFO before giving up the rest of our time slice. The
+    /// hardware drains a word in a few dozen cycles, so yielding right away mostly just leaves
+    /// the FIFO empty until we're next scheduled.
+    const FIFO_SPIN_LIMIT: usize = 256;
+
     pub(crate) struct Engine512 {
         csr: utralib::CSR<u32>,
         fifo: xous::MemoryRange,
+        /// the block is kept powered for the length of a hash, rather than for each update
+        powered: bool,
         #[cfg(feature = "event_wait")]
         done: bool,
     }
@@ -68,6 +75,7 @@ mod implementation {
             let mut engine512 = Engine512 {
                 csr: CSR::new(csr.as_mut_ptr() as *mut u32),
                 fifo,
+                powered: false,
             };
 
             #[cfg(feature = "event_wait")]
@@ -75,6 +83,7 @@ mod implementation {
                 let mut engine512 = Engine512 {
                     csr: CSR::new(csr.as_mut_ptr() as *mut u32),
                     fifo,
+                    powered: false,
                     done: false,
                 };
                 xous::claim_interrupt(
@@ -97,8 +106,32 @@ mod implementation {
             engine512
         }
 
+        fn power_on(&mut self) {
+            if !self.powered {
+                self.csr.wfo(utra::sha512::POWER_ON, 1);
+                self.powered = true;
+            }
+        }
+
+        fn power_off(&mut self) {
+            self.csr.wfo(utra::sha512::POWER_ON, 0);
+            self.powered = false;
+        }
+
+        /// Wait until there's room in the FIFO for another write
+        fn wait_fifo(&self) {
+            let mut spins = 0;
+            while self.csr.rf(utra::sha512::FIFO_ALMOST_FULL) != 0 {
+                spins += 1;
+                if spins >= FIFO_SPIN_LIMIT {
+                    xous::yield_slice();
+                    spins = 0;
+                }
+            }
+        }
+
         pub(crate) fn setup(&mut self, config: Sha2Config) {
-            self.csr.wfo(utra::sha512::POWER_ON, 1);
+            self.power_on();
             match config {
                 Sha2Config::Sha512 => {
                     self.csr.wo(utra::sha512::CONFIG,
@@ -118,49 +151,28 @@ mod implementation {
             }
             self.csr.wfo(utra::sha512::COMMAND_HASH_START, 1);
             self.csr.wfo(utra::sha512::EV_ENABLE_SHA512_DONE, 1);
-            self.csr.wfo(utra::sha512::POWER_ON, 0);
+            // power stays on until the hash is finalized or reset
         }
 
         pub(crate) fn update(&mut self, buf: &[u8]) {
-            self.csr.wfo(utra::sha512::POWER_ON, 1);
+            self.power_on();
             let sha = self.fifo.as_mut_ptr() as *mut u32;
             let sha_byte = self.fifo.as_mut_ptr() as *mut u8;
 
-            // this unsafe version is very slightly faster than the safe version below
-            /*
-            let src_bfr = buf.as_ptr() as *mut u32;
-            for offset in 0 .. buf.len() / 4 {
-                unsafe { sha.write_volatile(src_bfr.add(offset).read_volatile()); }
+            let words = buf.chunks_exact(4);
+            let tail = words.remainder();
+            for word in words {
+                self.wait_fifo();
+                unsafe { sha.write_volatile(u32::from_le_bytes([word[0], word[1], word[2], word[3]])); }
             }
-            if (buf.len() % 4) != 0 {
-                for index in (buf.len() - (buf.len() % 4))..buf.len() {
-                    unsafe{ sha_byte.write_volatile(buf[index]); }
-                }
-            } */
-            for (_reg, chunk) in buf.chunks(4).enumerate() {
-                let mut temp: [u8; 4] = Default::default();
-                if chunk.len() == 4 {
-                    temp.copy_from_slice(chunk);
-                    let dword: u32 = u32::from_le_bytes(temp);
-
-                    while self.csr.rf(utra::sha512::FIFO_ALMOST_FULL) != 0 {
-                        xous::yield_slice();
-                    }
-                    unsafe { sha.write_volatile(dword); }
-                } else {
-                    for index in 0..chunk.len() {
-                        while self.csr.rf(utra::sha512::FIFO_ALMOST_FULL) != 0 {
-                            xous::yield_slice();
-                        }
-                        unsafe{ sha_byte.write_volatile(chunk[index]); }
-                    }
-                }
+            for &byte in tail {
+                self.wait_fifo();
+                unsafe { sha_byte.write_volatile(byte); }
             }
-            self.csr.wfo(utra::sha512::POWER_ON, 0);
         }
 
         pub(crate) fn finalize(&mut self) -> ([u8; 64], u64) {
-            self.csr.wfo(utra::sha512::POWER_ON, 1);
+            self.power_on();
             #[cfg(feature = "event_wait")]
             {
                 engine512.csr.wfo(utra::sha512::EV_ENABLE_SHA512_DONE, 1);
@@ -207,28 +219,28 @@ mod implementation {
             }
             self.csr.wo(utra::sha512::CONFIG, 0);  // clear all config bits, including EN, which resets the unit
 
-            self.csr.wfo(utra::sha512::POWER_ON, 0);
+            self.power_off();
             (hash, length_in_bits)
         }
 
         pub(crate) fn reset(&mut self) {
-            self.csr.wfo(utra::sha512::POWER_ON, 1);
+            self.power_on();
             self.csr.wfo(utra::sha512::CONFIG_RESET, 1);
             self.csr.wfo(utra::sha512::EV_PENDING_SHA512_DONE, 1);
             self.csr.wo(utra::sha512::CONFIG, 0);  // clear all config bits, including EN, which resets the unit
             while self.csr.rf(utra::sha512::FIFO_RESET_STATUS) == 1 { } // wait for the reset block to finish, if it's not already done by now
-            self.csr.wfo(utra::sha512::POWER_ON, 0);
+            self.power_off();
         }
 
         pub(crate) fn is_idle(&mut self) -> bool {
-            self.csr.wfo(utra::sha512::POWER_ON, 1);
-            if self.csr.rf(utra::sha512::CONFIG_SHA_EN) == 0 && self.csr.rf(utra::sha512::FIFO_RUNNING) == 0 {
-                self.csr.wfo(utra::sha512::POWER_ON, 0);
-                true
-            } else {
-                self.csr.wfo(utra::sha512::POWER_ON, 0);
-                false
+            // don't cut the power to a hash that's in progress
+            let was_powered = self.powered;
+            self.power_on();
+            let idle = self.csr.rf(utra::sha512::CONFIG_SHA_EN) == 0 && self.csr.rf(utra::sha512::FIFO_RUNNING) == 0;
+            if !was_powered {
+                self.power_off();
             }
+            idle
         }
     }
 }
@@ -266,9 +278,120 @@ mod implementation {
     }
 }
 
-static HASH_IN_PROGRESS: AtomicBool = AtomicBool::new(false);
+/// 1 while a client holds the hardware. This is a futex, so the suspend/resume thread can sleep
+/// until the hash is done instead of polling it.
+static HASH_IN_PROGRESS: AtomicUsize = AtomicUsize::new(0);
 static SUSPEND_FAILURE: AtomicBool = AtomicBool::new(false);
 static SUSPEND_PENDING: AtomicBool = AtomicBool::new(false);
+/// connection to our own server, used by the suspend/resume thread to restart the queue on resume
+static SERVE_CONN: AtomicU32 = AtomicU32::new(0);
+
+/// Number of clients that can wait for the hardware with AcquireExclusiveWait
+const WAIT_QUEUE_LEN: usize = 8;
+/// How long a client is kept in the queue before it's told the hardware is busy, so it can
+/// fall back or ask again instead of being stuck behind a client that never finishes
+const WAIT_TIMEOUT_MS: u64 = 1000;
+
+/// A client blocked in AcquireExclusiveWait
+struct Waiter {
+    sender: xous::MessageSender,
+    id: [u32; 3],
+    pid: Option<xous::PID>,
+    config: Sha2Config,
+    /// `elapsed_ms()` after which the client is failed back
+    deadline: u64,
+}
+
+/// The client that currently holds the hardware
+struct Owner {
+    id: [u32; 3],
+    pid: Option<xous::PID>,
+    mode: Sha2Config,
+}
+
+fn lock_hardware(engine512: &mut implementation::Engine512, owner: &mut Option<Owner>, id: [u32; 3], pid: Option<xous::PID>, config: Sha2Config) {
+    *owner = Some(Owner { id, pid, mode: config });
+    SUSPEND_FAILURE.store(false, Ordering::Relaxed);
+    HASH_IN_PROGRESS.store(1, Ordering::Relaxed);
+    engine512.setup(config);
+}
+
+fn unlock_hardware(engine512: &mut implementation::Engine512, owner: &mut Option<Owner>) {
+    SUSPEND_FAILURE.store(false, Ordering::Relaxed);
+    HASH_IN_PROGRESS.store(0, Ordering::Relaxed);
+    xous::futex_wake(&HASH_IN_PROGRESS, 1).ok();
+    *owner = None;
+    engine512.reset();
+}
+
+/// Hand the hardware to the clients waiting for it, in the order they asked, for as long as
+/// it's free and no suspend is pending.
+fn serve_queue(engine512: &mut implementation::Engine512, owner: &mut Option<Owner>, queue: &mut [Option<Waiter>; WAIT_QUEUE_LEN]) {
+    while owner.is_none() && !SUSPEND_PENDING.load(Ordering::Relaxed) {
+        let next = match queue[0].take() {
+            Some(waiter) => waiter,
+            None => return,
+        };
+        queue.rotate_left(1);
+        lock_hardware(engine512, owner, next.id, next.pid, next.config);
+        if xous::return_scalar(next.sender, 1).is_err() {
+            // the client went away while it was waiting
+            unlock_hardware(engine512, owner);
+        }
+    }
+}
+
+/// Drop the lock if the process that holds it has gone away, since it will never send the
+/// Reset that would have released it.
+fn release_dead_owner(engine512: &mut implementation::Engine512, owner: &mut Option<Owner>) {
+    let pid = match owner {
+        Some(Owner { pid: Some(pid), .. }) => *pid,
+        _ => return,
+    };
+    if let Err(xous::Error::ProcessNotFound) = xous::process_stats(pid) {
+        log::warn!("process {} exited while holding the hardware, releasing it", pid);
+        unlock_hardware(engine512, owner);
+    }
+}
+
+/// Fail back every waiter whose deadline has passed, keeping the rest in order. Returns the
+/// number of milliseconds until the next deadline, if anyone is still waiting.
+fn expire_waiters(queue: &mut [Option<Waiter>; WAIT_QUEUE_LEN], now: u64) -> Option<u64> {
+    let mut kept = 0;
+    for index in 0..WAIT_QUEUE_LEN {
+        match queue[index].take() {
+            Some(waiter) if waiter.deadline <= now => {
+                // same answer as a busy AcquireExclusive; the client may already be gone
+                xous::return_scalar(waiter.sender, 0).ok();
+            }
+            Some(waiter) => {
+                queue[kept] = Some(waiter);
+                kept += 1;
+            }
+            None => {}
+        }
+    }
+    // waiters are queued in order, so the first one is always the next to time out
+    queue[0].as_ref().map(|waiter| waiter.deadline - now)
+}
+
+/// Tells the main loop when to check for waiters that have timed out. The server replies
+/// with how long to sleep for, holding the reply while nobody is waiting, and 0 on quit.
+fn wait_timeout_thread(conn: usize) {
+    let ticktimer = ticktimer_server::Ticktimer::new().expect("couldn't connect to ticktimer");
+    loop {
+        match xous::send_message(conn as u32,
+            xous::Message::new_blocking_scalar(Opcode::ExpireWaiters.to_usize().unwrap(), 0, 0, 0, 0)
+        ) {
+            Ok(xous::Result::Scalar1(0)) => break,
+            Ok(xous::Result::Scalar1(ms)) => ticktimer.sleep_ms_slack(ms, 16).expect("couldn't sleep until wait timeout"),
+            _ => {
+                log::error!("wait timeout thread got an unexpected reply, exiting");
+                break;
+            }
+        }
+    }
+}
 
 fn susres_thread(sid0: usize, sid1: usize, sid2: usize, sid3: usize) {
     let susres_sid = xous::SID::from_u32(sid0 as u32, sid1 as u32, sid2 as u32, sid3 as u32);
@@ -276,7 +399,7 @@ fn susres_thread(sid0: usize, sid1: usize, sid2: usize, sid3: usize) {
 
     // register a suspend/resume listener
     let sr_cid = xous::connect(susres_sid).expect("couldn't create suspend callback connection");
-    let mut susres = susres::Susres::new(&xns, api::SusResOps::SuspendResume as u32, sr_cid).expect("couldn't create suspend/resume object");
+    let mut susres = susres::Susres::new(None, &xns, api::SusResOps::SuspendResume as u32, sr_cid).expect("couldn't create suspend/resume object");
 
     log::trace!("starting Sha512 suspend/resume manager loop");
     loop {
@@ -285,8 +408,8 @@ fn susres_thread(sid0: usize, sid1: usize, sid2: usize, sid3: usize) {
         match FromPrimitive::from_usize(msg.body.id()) {
             Some(SusResOps::SuspendResume) => xous::msg_scalar_unpack!(msg, token, _, _, _, {
                 SUSPEND_PENDING.store(true, Ordering::Relaxed);
-                while HASH_IN_PROGRESS.load(Ordering::Relaxed) {
-                    xous::yield_slice();
+                while HASH_IN_PROGRESS.load(Ordering::Relaxed) != 0 {
+                    xous::futex_wait(&HASH_IN_PROGRESS, 1).ok();
                 }
                 if susres.suspend_until_resume(token).expect("couldn't execute suspend/resume") == false {
                     SUSPEND_FAILURE.store(true, Ordering::Relaxed);
@@ -294,6 +417,13 @@ fn susres_thread(sid0: usize, sid1: usize, sid2: usize, sid3: usize) {
                     SUSPEND_FAILURE.store(false, Ordering::Relaxed);
                 }
                 SUSPEND_PENDING.store(false, Ordering::Relaxed);
+                susres.resumed().expect("couldn't report resume");
+                // clients may have queued up while we were waiting to suspend
+                xous::send_message(SERVE_CONN.load(Ordering::Relaxed),
+                    xous::Message::Scalar(xous::ScalarMessage {
+                        id: Opcode::ServeQueue.to_usize().unwrap(), arg1: 0, arg2: 0, arg3: 0, arg4: 0
+                    })
+                ).ok();
             }),
             Some(SusResOps::Quit) => {
                 log::info!("Received quit opcode, exiting!");
@@ -328,43 +458,65 @@ fn xmain() -> ! {
 
     // handle suspend/resume with a separate thread, which monitors our in-progress state
     // we can't save hardware state of a hash, so the hash MUST finish before we can suspend.
+    SERVE_CONN.store(xous::connect(engine512_sid).expect("couldn't connect to our own server"), Ordering::Relaxed);
     let susres_mgr_sid = xous::create_server().unwrap();
     let (sid0, sid1, sid2, sid3) = susres_mgr_sid.to_u32();
     xous::create_thread_4(susres_thread, sid0 as usize, sid1 as usize, sid2 as usize, sid3 as usize).expect("couldn't start susres handler thread");
 
-    let mut client_id: Option<[u32; 3]> = None;
-    let mut mode: Option<Sha2Config> = None;
+    let ticktimer = ticktimer_server::Ticktimer::new().expect("couldn't connect to ticktimer");
+    let timeout_conn = xous::connect(engine512_sid).expect("couldn't connect to our own server");
+    xous::create_thread_1(wait_timeout_thread, timeout_conn as usize).expect("couldn't start wait timeout thread");
+    // the wait timeout thread, while nobody is waiting
+    let mut timeout_waiter: Option<xous::MessageSender> = None;
+
+    let mut owner: Option<Owner> = None;
+    let mut queue: [Option<Waiter>; WAIT_QUEUE_LEN] = Default::default();
     let mut job_count = 0;
     loop {
         let mut msg = xous::receive_message(engine512_sid).unwrap();
         match FromPrimitive::from_usize(msg.body.id()) {
             Some(Opcode::AcquireExclusive) => msg_blocking_scalar_unpack!(msg, id0, id1, id2, flags, {
-                if client_id.is_none() && !SUSPEND_PENDING.load(Ordering::Relaxed) {
-                    client_id = Some([id0 as u32, id1 as u32, id2 as u32]);
-                    //log::trace!("giving {:x?} an exclusive lock", client_id);
-                    mode = Some(FromPrimitive::from_usize(flags).unwrap());
-                    SUSPEND_FAILURE.store(false, Ordering::Relaxed);
-                    HASH_IN_PROGRESS.store(true, Ordering::Relaxed);
-                    engine512.setup(mode.unwrap());
+                release_dead_owner(&mut engine512, &mut owner);
+                // clients that are already waiting go first
+                if owner.is_none() && queue[0].is_none() && !SUSPEND_PENDING.load(Ordering::Relaxed) {
+                    //log::trace!("giving {:x?} an exclusive lock", [id0, id1, id2]);
+                    lock_hardware(&mut engine512, &mut owner, [id0 as u32, id1 as u32, id2 as u32],
+                        msg.sender.pid(), FromPrimitive::from_usize(flags).unwrap());
                     xous::return_scalar(msg.sender, 1).unwrap();
                 } else {
                     xous::return_scalar(msg.sender, 0).unwrap();
                 }
             }),
-            Some(Opcode::Reset) => msg_blocking_scalar_unpack!(msg, r_id0, r_id1, r_id2, _, {
-                match client_id {
-                    Some([id0, id1, id2]) => {
-                        if id0 == r_id0 as u32 && id1 == r_id1 as u32 && id2 == r_id2 as u32 {
-                            SUSPEND_FAILURE.store(false, Ordering::Relaxed);
-                            HASH_IN_PROGRESS.store(false, Ordering::Relaxed);
-                            client_id = None;
-                            mode = None;
-                            engine512.reset();
-                            xous::return_scalar(msg.sender, 1).unwrap();
-                        } else {
-                            xous::return_scalar(msg.sender, 0).unwrap();
+            Some(Opcode::AcquireExclusiveWait) => msg_blocking_scalar_unpack!(msg, id0, id1, id2, flags, {
+                let waiter = Waiter {
+                    sender: msg.sender,
+                    id: [id0 as u32, id1 as u32, id2 as u32],
+                    pid: msg.sender.pid(),
+                    config: FromPrimitive::from_usize(flags).unwrap(),
+                    deadline: ticktimer.elapsed_ms() + WAIT_TIMEOUT_MS,
+                };
+                release_dead_owner(&mut engine512, &mut owner);
+                match queue.iter_mut().find(|slot| slot.is_none()) {
+                    Some(slot) if !SUSPEND_PENDING.load(Ordering::Relaxed) => {
+                        // the reply is sent once the hardware is handed to this client
+                        *slot = Some(waiter);
+                        serve_queue(&mut engine512, &mut owner, &mut queue);
+                        if queue[0].is_some() {
+                            if let Some(sender) = timeout_waiter.take() {
+                                xous::return_scalar(sender, WAIT_TIMEOUT_MS as usize).unwrap();
+                            }
                         }
                     }
+                    _ => xous::return_scalar(msg.sender, 0).unwrap(),
+                }
+            }),
+            Some(Opcode::Reset) => msg_blocking_scalar_unpack!(msg, r_id0, r_id1, r_id2, _, {
+                match &owner {
+                    Some(o) if o.id == [r_id0 as u32, r_id1 as u32, r_id2 as u32] => {
+                        unlock_hardware(&mut engine512, &mut owner);
+                        xous::return_scalar(msg.sender, 1).unwrap();
+                        serve_queue(&mut engine512, &mut owner, &mut queue);
+                    }
                     _ => {
                         xous::return_scalar(msg.sender, 0).unwrap();
                     }
@@ -373,17 +525,28 @@ fn xmain() -> ! {
             Some(Opcode::Update) => {
                 let buffer = unsafe { Buffer::from_memory_message(msg.body.memory_message().unwrap()) };
                 let update = buffer.as_flat::<Sha2Update, _>().unwrap();
-                match client_id {
-                    Some(id) => {
-                        if id == update.id {
-                            engine512.update(&update.buffer[..update.len as usize]);
-                        }
+                match &owner {
+                    Some(o) if o.id == update.id => {
+                        engine512.update(&update.buffer[..(update.len as usize).min(update.buffer.len())]);
                     }
                     _ => {
                         log::error!("Received a SHA-2 block, but the client ID did not match! Ignoring block.");
                     }
                 }
             }
+            Some(Opcode::UpdateRaw) => {
+                let sender_pid = msg.sender.pid();
+                let mem = msg.body.memory_message().unwrap();
+                match &owner {
+                    Some(o) if o.pid.is_some() && o.pid == sender_pid => {
+                        let len = mem.valid.map(|v| v.get()).unwrap_or(0).min(mem.buf.len());
+                        engine512.update(&mem.buf.as_slice::<u8>()[..len]);
+                    }
+                    _ => {
+                        log::error!("Received a raw SHA-2 block from a process that doesn't hold the lock! Ignoring block.");
+                    }
+                }
+            }
             Some(Opcode::Finalize) => {
                 if job_count % 100 == 0 {
                     log::info!("sha512 job {}", job_count); // leave this here for now so we can confirm HW accel is being used when we think it is!
@@ -391,28 +554,25 @@ fn xmain() -> ! {
                 job_count += 1;
                 let mut buffer = unsafe { Buffer::from_memory_message_mut(msg.body.memory_message_mut().unwrap()) };
                 let mut finalized = buffer.to_original::<Sha2Finalize, _>().unwrap();
-                match client_id {
-                    Some(id) => {
-                        if id == finalized.id {
+                match &owner {
+                    Some(o) => {
+                        if o.id == finalized.id {
                             if SUSPEND_FAILURE.load(Ordering::Relaxed) {
                                 finalized.result = Sha2Result::SuspendError;
                                 finalized.length_in_bits = None;
                             } else {
                                 let (hash, length_in_bits) = engine512.finalize();
-                                match mode {
-                                    Some(Sha2Config::Sha512) => {
+                                match o.mode {
+                                    Sha2Config::Sha512 => {
                                         finalized.result = Sha2Result::Sha512Result(hash);
                                         finalized.length_in_bits = Some(length_in_bits);
                                     },
-                                    Some(Sha2Config::Sha512Trunc256) => {
+                                    Sha2Config::Sha512Trunc256 => {
                                         let mut trunc: [u8; 32] = [0; 32];
                                         trunc.clone_from_slice(&hash[..32]);
                                         finalized.result = Sha2Result::Sha512Trunc256Result(trunc);
                                         finalized.length_in_bits = Some(length_in_bits);
                                     },
-                                    None => {
-                                        finalized.result = Sha2Result::Uninitialized;
-                                    }
                                 }
                             }
                         } else {
@@ -434,7 +594,7 @@ fn xmain() -> ! {
                 }
             }),
             Some(Opcode::AcquireSuspendLock) => msg_blocking_scalar_unpack!(msg, _, _, _, _, {
-                if client_id.is_none() {
+                if owner.is_none() {
                     SUSPEND_PENDING.store(true, Ordering::Relaxed);
                     xous::return_scalar(msg.sender, 1).expect("couldn't ack AcquireSuspendLock");
                 } else {
@@ -444,9 +604,25 @@ fn xmain() -> ! {
             Some(Opcode::AbortSuspendLock) => msg_blocking_scalar_unpack!(msg, _, _, _, _, {
                 SUSPEND_PENDING.store(false, Ordering::Relaxed);
                 xous::return_scalar(msg.sender, 1).expect("couldn't ack AbortSuspendLock");
+                serve_queue(&mut engine512, &mut owner, &mut queue);
+            }),
+            Some(Opcode::ServeQueue) => {
+                serve_queue(&mut engine512, &mut owner, &mut queue);
+            }
+            Some(Opcode::ExpireWaiters) => msg_blocking_scalar_unpack!(msg, _, _, _, _, {
+                release_dead_owner(&mut engine512, &mut owner);
+                serve_queue(&mut engine512, &mut owner, &mut queue);
+                match expire_waiters(&mut queue, ticktimer.elapsed_ms()) {
+                    // never reply 0 while someone is waiting, as that tells the thread to quit
+                    Some(ms) => xous::return_scalar(msg.sender, (ms as usize).max(1)).unwrap(),
+                    None => timeout_waiter = Some(msg.sender),
+                }
             }),
             Some(Opcode::Quit) => {
                 log::info!("Received quit opcode, exiting!");
+                if let Some(sender) = timeout_waiter.take() {
+                    xous::return_scalar(sender, 0).ok();
+                }
                 break;
             }
             None => {
@@ -17,6 +17,45 @@ pub struct GamObject {
     pub obj: GamObjectType,
 }
 
+/// Number of objects in a `GamObjectList`. The GAM hands the whole list on to the
+/// graphics server as one `ClipObjectList`, so it can't be any longer than that.
+pub const GAM_OBJECT_LIST_LEN: usize = graphics_server::api::CLIP_OBJECT_LIST_LEN;
+
+/// A batch of objects that are drawn in order on one canvas with a single message
+#[derive(Debug, rkyv::Archive, rkyv::Serialize, rkyv::Deserialize, Copy, Clone)]
+pub struct GamObjectList {
+    pub canvas: Gid,
+    list: [Option<GamObjectType>; GAM_OBJECT_LIST_LEN],
+    free: usize,
+}
+impl GamObjectList {
+    pub fn new(canvas: Gid) -> Self {
+        GamObjectList {
+            canvas,
+            list: [None; GAM_OBJECT_LIST_LEN],
+            free: 0,
+        }
+    }
+    /// Hands the object back if the list is already full
+    pub fn push(&mut self, item: GamObjectType) -> Result<(), GamObjectType> {
+        if self.free >= GAM_OBJECT_LIST_LEN {
+            return Err(item);
+        }
+        self.list[self.free] = Some(item);
+        self.free += 1;
+        Ok(())
+    }
+    pub fn is_empty(&self) -> bool { self.free == 0 }
+    pub fn is_full(&self) -> bool { self.free >= GAM_OBJECT_LIST_LEN }
+    pub fn clear(&mut self) {
+        self.list = [None; GAM_OBJECT_LIST_LEN];
+        self.free = 0;
+    }
+    pub fn iter(&self) -> impl Iterator<Item = &GamObjectType> {
+        self.list[..self.free.min(GAM_OBJECT_LIST_LEN)].iter().filter_map(|obj| obj.as_ref())
+    }
+}
+
 #[derive(Debug, rkyv::Archive, rkyv::Serialize, rkyv::Deserialize, Copy, Clone, Eq, PartialEq)]
 pub enum TokenType {
     /// GAM tokens are for objects that the GAM delegates to do app logic.
@@ -88,6 +127,9 @@ pub(crate) enum Opcode {
     // draws an object
     RenderObject, //(GamObject),
 
+    // draws a batch of objects on one canvas
+    RenderObjectList, //(GamObjectList),
+
     // renders a TextView
     RenderTextView, //(TextView),
 
@@ -119,7 +161,8 @@ pub(crate) enum Opcode {
     /// it basically checks that all tokens have been claimed by trusted OS procesess, thus blocking any further token creation
     TrustedInitDone,
 
-    /// this is used internally to route input lines from the IMEF
+    /// this is used internally to route input lines from the IMEF. The line arrives as a `Move`,
+    /// so its pages can be handed on to the focused app without another copy
     InputLine,
 
     /// passed to the keyboard server to notify me of a keyboard event
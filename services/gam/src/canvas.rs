@@ -184,6 +184,8 @@ pub fn deface(gfx: &graphics_server::Gfx, trng: &trng::Trng, canvases: &mut FnvI
                     // log::debug!("deface width {} height {}, numlines {}, cliprect {:?}", width, height, num_lines, clip_rect);
 
                     // draw 32 lines, of random orientation and lengths, across the clip area.
+                    // the lines are sent to the graphics server as a batch, rather than one message per line.
+                    let mut hatching = ClipObjectList::new();
                     for _ in 0..num_lines {
                         // do the actual defacing
                         // get 64 bits of entropy, and express it geometrically
@@ -210,13 +212,17 @@ pub fn deface(gfx: &graphics_server::Gfx, trng: &trng::Trng, canvases: &mut FnvI
                         delta_x = delta_x % width;
                         delta_y = delta_y % width;
 
-                        gfx.draw_line_clipped(
-                            Line::new_with_style(
-                                Point::new(x, y),
-                                Point::new(x + delta_x, y + delta_y),
-                                DrawStyle::new(PixelColor::Dark, PixelColor::Dark, 1)),
-                                clip_rect).unwrap();
+                        let line = ClipObjectType::Line(Line::new_with_style(
+                            Point::new(x, y),
+                            Point::new(x + delta_x, y + delta_y),
+                            DrawStyle::new(PixelColor::Dark, PixelColor::Dark, 1)));
+                        if let Err(line) = hatching.push(line, clip_rect) {
+                            gfx.draw_object_list(&hatching).unwrap();
+                            hatching.clear();
+                            hatching.push(line, clip_rect).unwrap();
+                        }
                     }
+                    gfx.draw_object_list(&hatching).unwrap();
                 }
 
                 // indicate that the defacement has happened to the canvas state machine
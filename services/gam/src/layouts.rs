@@ -83,18 +83,15 @@ impl LayoutApi for ChatLayout {
         let content_canvas = canvases.get(&self.content).expect("couldn't find content canvas");
         let predictive_canvas = canvases.get(&self.predictive).expect("couldn't find predictive canvas");
 
-        let mut rect = content_canvas.clip_rect();
-        rect.style = DrawStyle {fill_color: Some(PixelColor::Light), stroke_color: None, stroke_width: 0,};
-        gfx.draw_rectangle(rect).expect("can't clear canvas");
-
-        let mut rect = predictive_canvas.clip_rect();
-        rect.style = DrawStyle {fill_color: Some(PixelColor::Light), stroke_color: None, stroke_width: 0,};
-        gfx.draw_rectangle(rect).expect("can't clear canvas");
-
-        let mut rect = input_canvas.clip_rect();
-        rect.style = DrawStyle {fill_color: Some(PixelColor::Light), stroke_color: None, stroke_width: 0,};
-        gfx.draw_rectangle(rect).expect("can't clear canvas");
-        Ok(())
+        // clear all three canvases with one message
+        let screen = Rectangle::new(Point::new(0, 0), self.screensize);
+        let mut clears = ClipObjectList::new();
+        for canvas in [content_canvas, predictive_canvas, input_canvas].iter() {
+            let mut rect = canvas.clip_rect();
+            rect.style = DrawStyle {fill_color: Some(PixelColor::Light), stroke_color: None, stroke_width: 0,};
+            clears.push(ClipObjectType::Rect(rect), screen).expect("can't clear canvas");
+        }
+        gfx.draw_object_list(&clears)
     }
     fn resize_height(&mut self, gfx: &graphics_server::Gfx, new_height: i16, status_canvas: &Canvas, canvases: &mut FnvIndexMap<Gid, Canvas, {crate::MAX_CANVASES}>) -> Result<Point, xous::Error> {
         let input_canvas = canvases.get(&self.input).expect("couldn't find input canvas");
@@ -121,6 +121,15 @@ impl Gam {
         buf.lend(self.conn, Opcode::RenderObject.to_u32().unwrap()).map(|_|())
     }
 
+    /// Draws every object in `list` with a single message, rather than one message per object.
+    pub fn draw_list(&self, list: GamObjectList) -> Result<(), xous::Error> {
+        if list.is_empty() {
+            return Ok(());
+        }
+        let buf = Buffer::into_buf(list).or(Err(xous::Error::InternalError))?;
+        buf.lend(self.conn, Opcode::RenderObjectList.to_u32().unwrap()).map(|_|())
+    }
+
     pub fn get_canvas_bounds(&self, gid: Gid) -> Result<Point, xous::Error> {
         log::trace!("GAM_API: get_canvas_bounds");
         let response = send_message(self.conn,
@@ -452,14 +461,18 @@ impl Menu {
             self.gam.post_textview(&mut item_tv).expect("couldn't render menu list item");
         }
     }
+    // the dividing line above the indexed item; only valid once the canvas width is known
+    fn divider(&self, index: i16) -> Line {
+        let canvas_width = self.canvas_width.unwrap_or(0);
+        Line::new_with_style(
+            Point::new(self.divider_margin, index * self.line_height + self.margin/2),
+            Point::new(canvas_width - self.divider_margin, index * self.line_height + self.margin/2),
+            DrawStyle::new(PixelColor::Dark, PixelColor::Dark, 1))
+    }
     // draw a dividing line above the indexed item
     pub fn draw_divider(&self, index: i16) {
-        if let Some(canvas_width) = self.canvas_width {
-            self.gam.draw_line(self.canvas, Line::new_with_style(
-                Point::new(self.divider_margin, index * self.line_height + self.margin/2),
-                Point::new(canvas_width - self.divider_margin, index * self.line_height + self.margin/2),
-                DrawStyle::new(PixelColor::Dark, PixelColor::Dark, 1))
-                ).expect("couldn't draw dividing line")
+        if self.canvas_width.is_some() {
+            self.gam.draw_line(self.canvas, self.divider(index)).expect("couldn't draw dividing line")
         } else {
             log::debug!("cant draw divider because our canvas width was not initialized. Ignoring request.");
         }
@@ -516,6 +529,8 @@ impl Menu {
 
         // draw the line items
         // we require that the items list be in index-order, with no holes: we abort at the first None item
+        // the dividers don't overlap the items they're drawn under, so they're collected and sent as one batch
+        let mut dividers = GamObjectList::new(self.canvas);
         let mut cur_index: i16 = 0;
         for maybe_item in self.items.iter() {
             if let Some(_item) = maybe_item {
@@ -525,7 +540,11 @@ impl Menu {
                     self.draw_item(cur_index as i16, false);
                 }
                 if cur_index != 0 {
-                    self.draw_divider(cur_index);
+                    if dividers.is_full() {
+                        self.gam.draw_list(dividers).expect("couldn't draw dividing lines");
+                        dividers.clear();
+                    }
+                    dividers.push(GamObjectType::Line(self.divider(cur_index))).unwrap();
                 }
 
                 cur_index += 1;
@@ -533,6 +552,7 @@ impl Menu {
                 break;
             }
         }
+        self.gam.draw_list(dividers).expect("couldn't draw dividing lines");
         self.gam.redraw().unwrap();
     }
     fn num_items(&self) -> usize {
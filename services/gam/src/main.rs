@@ -92,6 +92,33 @@ pub(crate) struct UxContext {
     pub audioframe_id: Option<u32>,
 }
 const MAX_UX_CONTEXTS: usize = 4;
+
+/// Move an object from its canvas' coordinates to the screen's, ready to be clipped to the canvas
+fn to_screen(canvas: &Canvas, obj: GamObjectType) -> ClipObjectType {
+    match obj {
+        GamObjectType::Line(mut line) => {
+            line.translate(canvas.clip_rect().tl);
+            line.translate(canvas.pan_offset());
+            ClipObjectType::Line(line)
+        },
+        GamObjectType::Circ(mut circ) => {
+            circ.translate(canvas.clip_rect().tl);
+            circ.translate(canvas.pan_offset());
+            ClipObjectType::Circ(circ)
+        },
+        GamObjectType::Rect(mut rect) => {
+            rect.translate(canvas.clip_rect().tl);
+            rect.translate(canvas.pan_offset());
+            ClipObjectType::Rect(rect)
+        },
+        GamObjectType::RoundRect(mut rr) => {
+            rr.translate(canvas.clip_rect().tl);
+            rr.translate(canvas.pan_offset());
+            ClipObjectType::RoundRect(rr)
+        },
+    }
+}
+
 pub(crate) const MAX_CANVASES: usize = 32;
 // const BOOT_APP_NAME: &'static str = "shellchat"; // this is the app to display on boot -- we will eventually need this once we have more than one app?
 pub const MAIN_MENU_NAME: &'static str = "main menu";
@@ -438,14 +465,15 @@ impl ContextManager {
     pub(crate) fn focused_app(&self) -> Option<[u32; 4]> {
         self.focused_context
     }
-    pub(crate) fn forward_input(&self, input: String::<4000>) -> Result<(), xous::Error> {
+    /// Pass an input line on to the focused app. `input` holds a serialized `String::<4000>`,
+    /// and its pages are moved on as they are rather than being copied again.
+    pub(crate) fn forward_input(&self, input: Buffer) -> Result<(), xous::Error> {
         if let Some(token) = self.focused_app() {
             for maybe_context in self.contexts.iter() {
                 if let Some(context) = maybe_context {
                     if token == context.app_token {
                         if let Some(input_op) = context.gotinput_id {
-                            let buf = Buffer::into_buf(input).or(Err(xous::Error::InternalError)).unwrap();
-                            return buf.send(context.listener, input_op).map(|_| ())
+                            return input.send(context.listener, input_op).map(|_| ())
                         }
                     }
                 }
@@ -546,7 +574,7 @@ fn imef_cb(s: String::<4000>) {
     if CB_TO_MAIN_CONN.load(Ordering::Relaxed) != 0 {
         let cb_to_main_conn = CB_TO_MAIN_CONN.load(Ordering::Relaxed);
         let buf = xous_ipc::Buffer::into_buf(s).or(Err(xous::Error::InternalError)).unwrap();
-        buf.lend(cb_to_main_conn, Opcode::InputLine.to_u32().unwrap()).unwrap();
+        buf.send(cb_to_main_conn, Opcode::InputLine.to_u32().unwrap()).unwrap();
     }
 }
 
@@ -817,6 +845,26 @@ fn xmain() -> ! {
                 }
                 log::trace!("leaving RenderObject");
             }
+            Some(Opcode::RenderObjectList) => {
+                let buffer = unsafe { Buffer::from_memory_message(msg.body.memory_message().unwrap()) };
+                let list = buffer.to_original::<GamObjectList, _>().unwrap();
+                log::trace!("renderobjectlist {:?}", list);
+                if let Some(canvas) = canvases.get_mut(&list.canvas) {
+                    if canvas.is_drawable() {
+                        // the lists are the same length, so everything fits
+                        let mut clip_list = ClipObjectList::new();
+                        for obj in list.iter() {
+                            clip_list.push(to_screen(canvas, *obj), canvas.clip_rect()).unwrap();
+                        }
+                        gfx.draw_object_list(&clip_list).expect("couldn't draw object list");
+                        canvas.do_drawn().expect("couldn't set canvas to drawn");
+                    } else {
+                        info!("attempt to draw Object list on non-drawable canvas. Not fatal, but request ignored.");
+                    }
+                } else {
+                    info!("bogus GID in Object list, not doing anything in response to draw request.");
+                }
+            }
             Some(Opcode::ClaimToken) => {
                 let mut buffer = unsafe { Buffer::from_memory_message_mut(msg.body.memory_message_mut().unwrap()) };
                 let mut tokenclaim = buffer.to_original::<TokenClaim, _>().unwrap();
@@ -853,10 +901,9 @@ fn xmain() -> ! {
             },
             Some(Opcode::InputLine) => {
                 // receive the keyboard input and pass it on to the context with focus
-                let buffer = unsafe { Buffer::from_memory_message(msg.body.memory_message().unwrap()) };
-                let inputline = buffer.to_original::<String::<4000>, _>().unwrap();
-                log::debug!("received input line, forwarding on... {}", inputline);
-                context_mgr.forward_input(inputline).expect("couldn't forward input line to focused app");
+                let buffer = Buffer::from_move(msg).expect("input line wasn't moved to us");
+                log::debug!("received input line, forwarding on...");
+                context_mgr.forward_input(buffer).expect("couldn't forward input line to focused app");
                 log::debug!("returned from forward_input");
             },
             Some(Opcode::KeyboardEvent) => msg_scalar_unpack!(msg, k1, k2, k3, k4, {
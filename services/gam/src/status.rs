@@ -42,6 +42,10 @@ pub fn dt_callback(dt: rtc::DateTime) {
 
 pub fn pump_thread(conn: usize) {
     let ticktimer = ticktimer_server::Ticktimer::new().unwrap();
+    // the status bar doesn't care exactly when it's redrawn, so let the pump share its
+    // wakeups with anything else that's due around the same time
+    let pump = ticktimer.timer().expect("|status: couldn't allocate pump timer");
+    pump.start(1000, 1000, 250).expect("|status: couldn't start pump timer");
     loop {
         match send_message(conn as u32,
             Message::new_scalar(StatusOpcode::Pump.to_usize().unwrap(), 0, 0, 0, 0)
@@ -50,7 +54,7 @@ pub fn pump_thread(conn: usize) {
             Ok(xous::Result::Ok) => {},
             _ => panic!("unhandled error in status pump thread")
         }
-        ticktimer.sleep_ms(1000).unwrap();
+        pump.wait().unwrap();
     }
 }
 
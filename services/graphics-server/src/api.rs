@@ -78,6 +78,9 @@ pub(crate) enum Opcode {
     /// draws an object that requires clipping
     DrawClipObject, //(ClipObject),
 
+    /// draws a list of objects that require clipping, in order
+    DrawClipObjectList, //(ClipObjectList),
+
     /// draws the sleep screen; assumes requests are vetted by GAM/xous-names
     DrawSleepScreen,
 
@@ -107,6 +110,40 @@ pub struct ClipObject {
     pub obj: ClipObjectType,
 }
 
+/// Number of objects in a `ClipObjectList`. This keeps the list within a single page.
+pub const CLIP_OBJECT_LIST_LEN: usize = 32;
+
+/// A batch of clipped objects that are drawn in order with a single message
+#[derive(Debug, rkyv::Archive, rkyv::Serialize, rkyv::Deserialize, Copy, Clone)]
+pub struct ClipObjectList {
+    pub list: [Option<ClipObject>; CLIP_OBJECT_LIST_LEN],
+    free: usize,
+}
+impl ClipObjectList {
+    pub fn new() -> Self {
+        ClipObjectList {
+            list: [None; CLIP_OBJECT_LIST_LEN],
+            free: 0,
+        }
+    }
+    /// Adds an object to the end of the list. If the list is full, the object is handed back.
+    pub fn push(&mut self, item: ClipObjectType, clip: Rectangle) -> Result<(), ClipObjectType> {
+        if self.free >= CLIP_OBJECT_LIST_LEN {
+            return Err(item);
+        }
+        self.list[self.free] = Some(ClipObject { clip, obj: item });
+        self.free += 1;
+        Ok(())
+    }
+    pub fn len(&self) -> usize { self.free }
+    pub fn is_empty(&self) -> bool { self.free == 0 }
+    pub fn is_full(&self) -> bool { self.free >= CLIP_OBJECT_LIST_LEN }
+    pub fn clear(&mut self) {
+        self.list = [None; CLIP_OBJECT_LIST_LEN];
+        self.free = 0;
+    }
+}
+
 #[derive(Debug, rkyv::Archive, rkyv::Serialize, rkyv::Deserialize, Copy, Clone)]
 pub struct TokenClaim {
     pub token: Option<[u32; 4]>,
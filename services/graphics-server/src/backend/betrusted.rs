@@ -15,6 +15,9 @@ pub struct XousDisplay {
     srfb: ManagedMem::<{utralib::generated::HW_MEMLCD_MEM_LEN}>,
     csr: utralib::CSR<u32>,
     susres: RegManager::<{utra::memlcd::MEMLCD_NUMREGS}>,
+    /// First and last lines that were marked dirty in `hwfb` by the previous update. Their
+    /// dirty bits have to be cleared before the next update, or they'd be sent again.
+    hw_dirty: Option<(usize, usize)>,
 }
 
 impl XousDisplay {
@@ -57,6 +60,8 @@ impl XousDisplay {
             csr: CSR::new(control.as_mut_ptr() as *mut u32),
             susres: RegManager::new(control.as_mut_ptr() as *mut u32),
             srfb: ManagedMem::new(hwfb),
+            // hwfb was filled with 1s above, which includes every dirty bit
+            hw_dirty: Some((0, FB_LINES - 1)),
          };
 
         display.set_clock(CONFIG_CLOCK_FREQUENCY);
@@ -118,6 +123,10 @@ impl XousDisplay {
                     (*hwfb)[lines * FB_WIDTH_WORDS + (FB_WIDTH_WORDS - 1)] |= 0x1_0000;
                 }
             }
+            self.hw_dirty = match self.hw_dirty {
+                Some((first, last)) => Some((first.min(start_line), last.max(start_line + note_lines - 1))),
+                None => Some((start_line, start_line + note_lines - 1)),
+            };
             self.update_dirty();
             while self.busy() {
                 // busy wait, blocking resume until this has happened
@@ -127,32 +136,60 @@ impl XousDisplay {
 
     pub fn screen_size(&self) -> Point { Point::new(FB_WIDTH_PIXELS as i16, FB_LINES as i16) }
 
+    /// Send the lines that were drawn on since the last redraw to the LCD. Only those lines
+    /// are copied into the hardware frame buffer, so a small update such as the status bar
+    /// doesn't cost a copy of the whole frame.
     pub fn redraw(&mut self) {
         let mut busy_count = 0;
         let mut dirty_count = 0;
+        let fb: *mut [u32; FB_SIZE] = self.fb.as_mut_ptr() as *mut [u32; FB_SIZE];
+        let hwfb: *mut [u32; FB_SIZE] = self.hwfb.as_mut_ptr() as *mut [u32; FB_SIZE];
+
+        // find the range of lines that have changed
+        let mut damage: Option<(usize, usize)> = None;
+        for lines in 0..FB_LINES {
+            if unsafe{(*fb)[lines * FB_WIDTH_WORDS + (FB_WIDTH_WORDS - 1)] & 0xFFFF_0000} != 0x0 {
+                damage = Some((damage.map_or(lines, |(first, _)| first), lines));
+            }
+        }
+        let (first, last) = match damage {
+            Some(range) => range,
+            None => {
+                log::trace!("redraw: nothing to do");
+                return;
+            }
+        };
+
         while self.busy() {
             xous::yield_slice();
             busy_count += 1;
         }
-        let fb: *mut [u32; FB_SIZE] = self.fb.as_mut_ptr() as *mut [u32; FB_SIZE];
-        let hwfb: *mut [u32; FB_SIZE] = self.hwfb.as_mut_ptr() as *mut [u32; FB_SIZE];
-        for words in 0..FB_SIZE {
-            unsafe {
-                (*hwfb)[words] = (*fb)[words];
+        // lines sent by the previous update still have their dirty bits set
+        if let Some((hw_first, hw_last)) = self.hw_dirty.take() {
+            for lines in hw_first..=hw_last {
+                unsafe {
+                    (*hwfb)[lines * FB_WIDTH_WORDS + (FB_WIDTH_WORDS - 1)] &= 0x0000_FFFF;
+                }
             }
         }
-        self.update_dirty();
-        // clear all the dirty bits, under the theory that it's time-wise cheaper on average
-        // to visit every line and clear the dirty bits than it is to do an update_all()
-        for lines in 0..FB_LINES {
-            if unsafe{(*fb)[lines * FB_WIDTH_WORDS + (FB_WIDTH_WORDS - 1)] & 0xFFFF_0000} != 0x0 {
+        // copy the dirty lines over, along with their dirty bits, then clear the bits in our copy
+        for lines in first..=last {
+            let dirty_word = lines * FB_WIDTH_WORDS + (FB_WIDTH_WORDS - 1);
+            if unsafe{(*fb)[dirty_word] & 0xFFFF_0000} != 0x0 {
                 dirty_count += 1;
-            }
-            unsafe {
-                (*fb)[lines * FB_WIDTH_WORDS + (FB_WIDTH_WORDS - 1)] &= 0x0000_FFFF;
+                for words in lines * FB_WIDTH_WORDS..(lines + 1) * FB_WIDTH_WORDS {
+                    unsafe {
+                        (*hwfb)[words] = (*fb)[words];
+                    }
+                }
+                unsafe {
+                    (*fb)[dirty_word] &= 0x0000_FFFF;
+                }
             }
         }
-        log::trace!("redraw {}/{}", busy_count, dirty_count);
+        self.hw_dirty = Some((first, last));
+        self.update_dirty();
+        log::trace!("redraw {}/{} lines {}-{}", busy_count, dirty_count, first, last);
     }
 
     // note: this API is used by emulation, don't remove calls to it
@@ -0,0 +1,162 @@
+//! A cache of text layouts.
+//!
+//! Laying out a `TextView` means walking every glyph of its text through blitstr, and
+//! `DrawTextView` does this once to size a growable bubble and again to draw it, every time the
+//! canvas is redrawn. blitstr only reports where the cursor ends up once the text is laid out, so
+//! that is what's kept here: for a given string, style, box size and insertion point, the final
+//! cursor relative to where the text started.
+//!
+//! Every key is built from the clip rectangle that is handed to blitstr, and a live draw goes
+//! through the same `draw()` call as a dry run, so drawing a text view leaves behind exactly the
+//! layout that a later `ComputeBounds` of it looks up.
+
+use blitstr_ref as blitstr;
+use blitstr::Cursor;
+use hash32::Hasher;
+use crate::api::Rectangle;
+
+/// Number of layouts kept. Each entry is small, and this covers a screenful of chat bubbles.
+const LAYOUT_CACHE_SIZE: usize = 32;
+
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub struct LayoutKey {
+    hash: u32,
+    len: usize,
+    style: usize,
+    width: i32,
+    height: i32,
+    insertion: Option<i32>,
+    ellipsis: bool,
+}
+
+impl LayoutKey {
+    /// Key for laying out `text` from the top left of `clip`. `clip`, `insertion` and `ellipsis`
+    /// are the values handed to `blitstr::paint_str()`, with `clip.into()` as its clip rectangle.
+    pub fn new(text: &str, style: usize, clip: &Rectangle, insertion: Option<i32>, ellipsis: bool) -> Self {
+        let mut hasher = hash32::FnvHasher::default();
+        hasher.write(text.as_bytes());
+        LayoutKey {
+            hash: hasher.finish(),
+            len: text.len(),
+            style,
+            width: (clip.br.x - clip.tl.x) as i32,
+            height: (clip.br.y - clip.tl.y) as i32,
+            insertion,
+            ellipsis,
+        }
+    }
+
+    fn slot(&self) -> usize {
+        // the same text is often laid out at several widths, so mix those in too
+        (self.hash ^ (self.width as u32).wrapping_mul(0x9e37_79b1) ^ self.style as u32) as usize % LAYOUT_CACHE_SIZE
+    }
+}
+
+pub struct LayoutCache {
+    entries: [Option<(LayoutKey, Cursor)>; LAYOUT_CACHE_SIZE],
+}
+
+impl LayoutCache {
+    pub fn new() -> Self {
+        LayoutCache {
+            entries: [None; LAYOUT_CACHE_SIZE],
+        }
+    }
+
+    /// Advance `cursor` past the text described by `key`. If the layout isn't cached, `paint` is
+    /// called to lay it out with blitstr and the result is remembered.
+    pub fn layout<F>(&mut self, key: LayoutKey, cursor: &mut Cursor, paint: F)
+    where
+        F: FnOnce(&mut Cursor),
+    {
+        if let Some((k, end)) = self.entries[key.slot()] {
+            if k == key {
+                *cursor = Cursor {
+                    pt: blitstr::Pt::new(cursor.pt.x + end.pt.x, cursor.pt.y + end.pt.y),
+                    line_height: end.line_height,
+                };
+                return;
+            }
+        }
+        let start = *cursor;
+        paint(cursor);
+        self.insert(key, start, *cursor);
+    }
+
+    /// Lay out the text described by `key` with `paint`. A live draw always paints, since the
+    /// glyphs have to reach the screen, and refreshes the cached layout as it goes; a dry run
+    /// only paints if the layout isn't cached.
+    pub fn draw<F>(&mut self, key: LayoutKey, cursor: &mut Cursor, live: bool, paint: F)
+    where
+        F: FnOnce(&mut Cursor),
+    {
+        if live {
+            let start = *cursor;
+            paint(cursor);
+            self.insert(key, start, *cursor);
+        } else {
+            self.layout(key, cursor, paint);
+        }
+    }
+
+    /// Remember that laying out `key` took the cursor from `start` to `end`.
+    fn insert(&mut self, key: LayoutKey, start: Cursor, end: Cursor) {
+        let relative = Cursor {
+            pt: blitstr::Pt::new(end.pt.x - start.pt.x, end.pt.y - start.pt.y),
+            line_height: end.line_height,
+        };
+        self.entries[key.slot()] = Some((key, relative));
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::api::Point;
+
+    /// stands in for `blitstr::paint_str()`: moves the cursor as if it had laid out some text
+    fn fake_paint(c: &mut Cursor) {
+        c.pt = blitstr::Pt::new(c.pt.x + 57, c.pt.y + 32);
+        c.line_height = 16;
+    }
+
+    #[test]
+    fn live_draw_then_compute_bounds() {
+        let mut layouts = LayoutCache::new();
+        let text = "the quick brown fox jumps over the lazy dog";
+        let clip = Rectangle::new(Point::new(12, 40), Point::new(200, 300));
+
+        // a live draw paints the text
+        let mut painted = 0;
+        let mut c = Cursor::new(12, 40, 0);
+        layouts.draw(LayoutKey::new(text, 0, &clip, Some(3), true), &mut c, true, |c| { painted += 1; fake_paint(c) });
+        assert_eq!(painted, 1);
+        let (x, y, h) = (c.pt.x, c.pt.y, c.line_height);
+
+        // a ComputeBounds of the same text view is a dry run over the same clip, and is served
+        // from what the live draw left behind
+        let mut c = Cursor::new(12, 40, 0);
+        layouts.draw(LayoutKey::new(text, 0, &clip, Some(3), true), &mut c, false, |_| panic!("ComputeBounds missed the cache"));
+        assert_eq!((c.pt.x, c.pt.y, c.line_height), (x, y, h));
+
+        // a second live draw still paints
+        let mut c = Cursor::new(12, 40, 0);
+        layouts.draw(LayoutKey::new(text, 0, &clip, Some(3), true), &mut c, true, |c| { painted += 1; fake_paint(c) });
+        assert_eq!(painted, 2);
+
+        // anything that changes the layout misses
+        let narrower = Rectangle::new(Point::new(12, 40), Point::new(150, 300));
+        for key in [
+            LayoutKey::new(text, 0, &narrower, Some(3), true),
+            LayoutKey::new(text, 1, &clip, Some(3), true),
+            LayoutKey::new(text, 0, &clip, None, true),
+            LayoutKey::new(text, 0, &clip, Some(3), false),
+            LayoutKey::new("the quick brown fox", 0, &clip, Some(3), true),
+        ].iter() {
+            let mut c = Cursor::new(12, 40, 0);
+            let mut missed = false;
+            layouts.draw(*key, &mut c, false, |c| { missed = true; fake_paint(c) });
+            assert!(missed, "{:?} should not have been cached", key);
+        }
+    }
+}
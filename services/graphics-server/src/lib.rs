@@ -2,7 +2,7 @@
 
 // pub mod size;
 pub mod api;
-pub use api::{Circle, DrawStyle, Line, PixelColor, Point, Rectangle, TextView, TextBounds, Gid, TextOp, RoundedRectangle, ClipObject, ClipObjectType, TokenClaim};
+pub use api::{Circle, DrawStyle, Line, PixelColor, Point, Rectangle, TextView, TextBounds, Gid, TextOp, RoundedRectangle, ClipObject, ClipObjectType, ClipObjectList, TokenClaim};
 use blitstr_ref as blitstr;
 pub use blitstr::{ClipRect, Cursor, GlyphStyle};
 pub mod op;
@@ -135,6 +135,16 @@ impl Gfx {
         buf.lend(self.conn, Opcode::DrawClipObject.to_u32().unwrap()).map(|_| ())
     }
 
+    /// Draws every object in `list` with a single message, which is much cheaper than sending
+    /// each one on its own when redrawing a whole canvas.
+    pub fn draw_object_list(&self, list: &ClipObjectList) -> Result<(), xous::Error> {
+        if list.is_empty() {
+            return Ok(());
+        }
+        let buf = Buffer::into_buf(*list).or(Err(xous::Error::InternalError))?;
+        buf.lend(self.conn, Opcode::DrawClipObjectList.to_u32().unwrap()).map(|_| ())
+    }
+
     pub fn draw_sleep_note(&self, flag: bool) -> Result<(), xous::Error> {
         let arg = if flag {1} else {0};
         send_message(self.conn,
@@ -8,12 +8,15 @@ use backend::XousDisplay;
 
 mod op;
 
+mod layout;
+use layout::{LayoutCache, LayoutKey};
+
 mod logo;
 mod poweron;
 mod sleep_note;
 
 use api::{DrawStyle, PixelColor, Rectangle, TextBounds, RoundedRectangle, Point, TextView, Line, Circle};
-use api::{Opcode, ClipObject, ClipObjectType};
+use api::{Opcode, ClipObject, ClipObjectType, ClipObjectList};
 use blitstr_ref as blitstr;
 use blitstr::GlyphStyle;
 
@@ -27,6 +30,23 @@ fn draw_boot_logo(display: &mut XousDisplay) {
     display.blit_screen(poweron::LOGO_MAP);
 }
 
+fn draw_clip_object(display: &mut XousDisplay, obj: ClipObject) {
+    match obj.obj {
+        ClipObjectType::Line(line) => {
+            op::line(display.native_buffer(), line, Some(obj.clip));
+        },
+        ClipObjectType::Circ(circ) => {
+            op::circle(display.native_buffer(), circ, Some(obj.clip));
+        },
+        ClipObjectType::Rect(rect) => {
+            op::rectangle(display.native_buffer(), rect, Some(obj.clip));
+        },
+        ClipObjectType::RoundRect(rr) => {
+            op::rounded_rectangle(display.native_buffer(), rr, Some(obj.clip));
+        }
+    }
+}
+
 #[cfg(target_os = "none")]
 fn map_fonts() {
     log::trace!("mapping fonts");
@@ -95,11 +115,14 @@ fn xmain() -> ! {
 
     let screen_clip = Rectangle::new(Point::new(0,0), display.screen_size());
 
+    // remembers how text was laid out, so unchanged text views don't need to be laid out again
+    let mut layouts = LayoutCache::new();
+
     display.redraw();
 
     // register a suspend/resume listener
     let sr_cid = xous::connect(sid).expect("couldn't create suspend callback connection");
-    let mut susres = susres::Susres::new(&xns, Opcode::SuspendResume as u32, sr_cid).expect("couldn't create suspend/resume object");
+    let mut susres = susres::Susres::new(Some(susres::SuspendOrder::Late), &xns, Opcode::SuspendResume as u32, sr_cid).expect("couldn't create suspend/resume object");
 
     loop {
         let mut msg = xous::receive_message(sid).unwrap();
@@ -109,6 +132,7 @@ fn xmain() -> ! {
                 display.suspend(use_sleep_note);
                 susres.suspend_until_resume(token).expect("couldn't execute suspend/resume");
                 display.resume(use_sleep_note);
+                susres.resumed().expect("couldn't report resume");
             }),
             Some(Opcode::SetSleepNote) => xous::msg_scalar_unpack!(msg, set_use, _, _, _, {
                 if set_use == 0 {
@@ -121,18 +145,16 @@ fn xmain() -> ! {
                 let buffer = unsafe { Buffer::from_memory_message(msg.body.memory_message().unwrap()) };
                 let obj = buffer.to_original::<ClipObject, _>().unwrap();
                 log::trace!("DrawClipObject {:?}", obj);
-                match obj.obj {
-                    ClipObjectType::Line(line) => {
-                        op::line(display.native_buffer(), line, Some(obj.clip));
-                    },
-                    ClipObjectType::Circ(circ) => {
-                        op::circle(display.native_buffer(), circ, Some(obj.clip));
-                    },
-                    ClipObjectType::Rect(rect) => {
-                        op::rectangle(display.native_buffer(), rect, Some(obj.clip));
-                    },
-                    ClipObjectType::RoundRect(rr) => {
-                        op::rounded_rectangle(display.native_buffer(), rr, Some(obj.clip));
+                draw_clip_object(&mut display, obj);
+            }
+            Some(Opcode::DrawClipObjectList) => {
+                let buffer = unsafe { Buffer::from_memory_message(msg.body.memory_message().unwrap()) };
+                let list = buffer.to_original::<ClipObjectList, _>().unwrap();
+                log::trace!("DrawClipObjectList of {} objects", list.len());
+                for &obj in list.list.iter() {
+                    match obj {
+                        Some(obj) => draw_clip_object(&mut display, obj),
+                        None => break,
                     }
                 }
             }
@@ -170,20 +192,23 @@ fn xmain() -> ! {
                                 (br.x - clip_rect.tl.x) as _
                             };
                             // first, create a clip that's the width of the growable, but as big as the height of the screen
-                            let clip = blitstr::ClipRect::new(0, 0, checkedwidth as _, display.screen_size().y as _);
+                            let clip = Rectangle::new(Point::new(0, 0), Point::new(checkedwidth, display.screen_size().y));
                             let mut c = blitstr::Cursor::new(0, 0, 0);
-                            // now simulate the string painting
-                            blitstr::paint_str(
-                                display.native_buffer(),
-                                clip,
-                                &mut c,
-                                tv.style.into(),
-                                tv.text.as_str().unwrap(),
-                                false,
-                                None,
-                                false,
-                                blitstr::simulate_char
-                            );
+                            // now simulate the string painting, unless we've laid this text out before
+                            let key = LayoutKey::new(tv.text.as_str().unwrap(), tv.style as usize, &clip, None, false);
+                            layouts.draw(key, &mut c, false, |c| {
+                                blitstr::paint_str(
+                                    display.native_buffer(),
+                                    clip.into(),
+                                    c,
+                                    tv.style.into(),
+                                    tv.text.as_str().unwrap(),
+                                    false,
+                                    None,
+                                    false,
+                                    blitstr::simulate_char
+                                );
+                            });
                             // the resulting cursor position + line_height + margin is the height of the bounds
                             let checkedheight: i16 = if (c.pt.y as i16 + c.line_height as i16 + (tv.margin.y as i16) * 2) <= (br.y - clip_rect.tl.y as i16) {
                                 c.pt.y as i16 + c.line_height as i16 + 2 * tv.margin.y
@@ -225,20 +250,23 @@ fn xmain() -> ! {
                                 (clip_rect.br.x - bl.x) as _
                             };
                             // first, create a clip that's the width of the growable, but as big as the height of the screen
-                            let clip = blitstr::ClipRect::new(0, 0, checkedwidth as _, display.screen_size().y as _);
+                            let clip = Rectangle::new(Point::new(0, 0), Point::new(checkedwidth, display.screen_size().y));
                             let mut c = blitstr::Cursor::new(0, 0, 0);
-                            // now simulate the string painting
-                            blitstr::paint_str(
-                                display.native_buffer(),
-                                clip,
-                                &mut c,
-                                tv.style.into(),
-                                tv.text.as_str().unwrap(),
-                                false,
-                                None,
-                                false,
-                                blitstr::simulate_char
-                            );
+                            // now simulate the string painting, unless we've laid this text out before
+                            let key = LayoutKey::new(tv.text.as_str().unwrap(), tv.style as usize, &clip, None, false);
+                            layouts.draw(key, &mut c, false, |c| {
+                                blitstr::paint_str(
+                                    display.native_buffer(),
+                                    clip.into(),
+                                    c,
+                                    tv.style.into(),
+                                    tv.text.as_str().unwrap(),
+                                    false,
+                                    None,
+                                    false,
+                                    blitstr::simulate_char
+                                );
+                            });
                             // the resulting cursor position + line_height is the height of the bounds
                             let checkedheight: i16 = if (c.pt.y as i16 + c.line_height as i16 + 2 * tv.margin.y as i16) <= (bl.y as i16 - clip_rect.tl.y as i16) {
                                 c.pt.y as i16 + c.line_height as i16 + 2 * tv.margin.y
@@ -325,17 +353,21 @@ fn xmain() -> ! {
                 if debugtv { log::trace!("(TV): paint_str with {:?} | {:?} | {:?} | {:?} len: {}", cr, ref_cursor, tv.style, tv.text, tv.text.as_str().unwrap().len()); }
                 log::debug!("{}", tv);
                 let do_xor = tv.invert;
-                blitstr::paint_str(
-                    display.native_buffer(),
-                    cr.into(),
-                    &mut ref_cursor,
-                    tv.style.into(),
-                    tv.text.as_str().unwrap(),
-                    do_xor,
-                    tv.insertion,
-                    tv.ellipsis,
-                    paintfn
-                );
+                let key = LayoutKey::new(tv.text.as_str().unwrap(), tv.style as usize, &cr, tv.insertion, tv.ellipsis);
+                // nothing is drawn on a dry run, so a cached layout is all that's needed there
+                layouts.draw(key, &mut ref_cursor, !tv.dry_run, |c| {
+                    blitstr::paint_str(
+                        display.native_buffer(),
+                        cr.into(),
+                        c,
+                        tv.style.into(),
+                        tv.text.as_str().unwrap(),
+                        do_xor,
+                        tv.insertion,
+                        tv.ellipsis,
+                        paintfn
+                    );
+                });
                 // translate the cursor return value back to canvas coordinates
                 tv.cursor = blitstr::Cursor {
                     pt: blitstr::Pt::new(
@@ -32,6 +32,87 @@ fn put_pixel(fb: &mut LcdFB, x: i16, y: i16, color: PixelColor) {
     fb[clip_y * LCD_WORDS_PER_LINE + (LCD_WORDS_PER_LINE - 1)] |= 0x1_0000;
 }
 
+/// Set or clear the pixels from `x0` to `x1` inclusive on line `y`, a word at a time, and
+/// mark the line as dirty. The span must already be clipped to the screen.
+fn fill_span(fb: &mut LcdFB, y: usize, x0: usize, x1: usize, color: PixelColor) {
+    let line = y * LCD_WORDS_PER_LINE;
+    let first_word = x0 / 32;
+    let last_word = x1 / 32;
+    for word in first_word..=last_word {
+        let lo = if word == first_word { x0 % 32 } else { 0 };
+        let hi = if word == last_word { x1 % 32 } else { 31 };
+        let mask = (0xFFFF_FFFF_u32 >> (31 - hi)) & (0xFFFF_FFFF_u32 << lo);
+        if color == PixelColor::Light {
+            fb[line + word] |= mask;
+        } else {
+            fb[line + word] &= !mask;
+        }
+    }
+    // the span stops at pixel 335, so it never touches the dirty bit in the last word
+    fb[line + (LCD_WORDS_PER_LINE - 1)] |= 0x1_0000;
+}
+
+/// Draw the pixels from `x0` to `x1` inclusive on line `y`, clipped to `clip` and to the screen.
+fn span(fb: &mut LcdFB, y: i16, x0: i16, x1: i16, clip: Option<Rectangle>, color: PixelColor) {
+    let (mut min_x, mut max_x, mut min_y, mut max_y) = (0, WIDTH - 1, 0, HEIGHT - 1);
+    if let Some(c) = clip {
+        min_x = min_x.max(c.tl.x);
+        max_x = max_x.min(c.br.x);
+        min_y = min_y.max(c.tl.y);
+        max_y = max_y.min(c.br.y);
+    }
+    if y < min_y || y > max_y {
+        return;
+    }
+    let x0 = x0.max(min_x);
+    let x1 = x1.min(max_x);
+    if x0 > x1 {
+        return;
+    }
+    fill_span(fb, y as usize, x0 as usize, x1 as usize, color);
+}
+
+/// Integer square root, rounded down
+fn isqrt(n: i32) -> i32 {
+    if n <= 0 {
+        return 0;
+    }
+    let mut x = n;
+    let mut y = (x + 1) / 2;
+    while y < x {
+        x = y;
+        y = (x + n / x) / 2;
+    }
+    x
+}
+
+/// Draw one line of a rectangle with the given border and fill, limited to the pixels between
+/// `min_x` and `max_x` inclusive. This matches what `RectangleIterator` produces for the line.
+fn rectangle_line(fb: &mut LcdFB, y: i16, tl: Point, br: Point, style: DrawStyle, clip: Option<Rectangle>, min_x: i16, max_x: i16) {
+    let bw = style.stroke_width.max(0);
+    let left = tl.x.max(min_x);
+    let right = br.x.min(max_x);
+    match style.stroke_color {
+        Some(stroke) if (y < tl.y + bw) || (y > br.y - bw) => {
+            span(fb, y, left, right, clip, stroke);
+        }
+        Some(stroke) => {
+            if bw > 0 {
+                span(fb, y, left, (tl.x + bw - 1).min(right), clip, stroke);
+                span(fb, y, (br.x - bw + 1).max(left), right, clip, stroke);
+            }
+            if let Some(fill) = style.fill_color {
+                span(fb, y, (tl.x + bw).max(left), (br.x - bw).min(right), clip, fill);
+            }
+        }
+        None => {
+            if let Some(fill) = style.fill_color {
+                span(fb, y, left, right, clip, fill);
+            }
+        }
+    }
+}
+
 pub fn line(fb: &mut LcdFB, l: Line, clip: Option<Rectangle>) {
     let color: PixelColor;
     if l.style.stroke_color.is_some() {
@@ -44,6 +125,12 @@ pub fn line(fb: &mut LcdFB, l: Line, clip: Option<Rectangle>) {
     let x1 = l.end.x;
     let y1 = l.end.y;
 
+    // horizontal lines are common enough to be worth filling a word at a time
+    if y0 == y1 {
+        span(fb, y0, x0.min(x1), x0.max(x1), clip, color);
+        return;
+    }
+
     let dx = (x1 - x0).abs();
     let sx = if x0 < x1 { 1 } else { -1 };
     let dy = -((y1 - y0).abs());
@@ -146,6 +233,10 @@ impl Iterator for CircleIterator {
 }
 
 pub fn circle(fb: &mut LcdFB, circle: Circle, clip: Option<Rectangle>) {
+    if circle.style.fill_color.is_some() {
+        filled_circle(fb, circle, clip);
+        return;
+    }
     let c = CircleIterator {
         center: circle.center,
         radius: circle.radius as _,
@@ -159,6 +250,60 @@ pub fn circle(fb: &mut LcdFB, circle: Circle, clip: Option<Rectangle>) {
     }
 }
 
+/// Draws a filled circle one line at a time, producing the same pixels as `CircleIterator`.
+/// Only the outline is left to the iterator, since it has no long runs to fill.
+fn filled_circle(fb: &mut LcdFB, circle: Circle, clip: Option<Rectangle>) {
+    let style = circle.style;
+    let outer_radius = circle.radius as i32;
+    let radius = outer_radius - style.stroke_width as i32 + 1;
+    let outer_radius_sq = outer_radius * outer_radius;
+    // a pixel at distance^2 `len` is border if `border_lo < len < border_hi`, and fill if `len <= fill_hi`
+    let border_lo = radius * radius - radius;
+    let border_hi = outer_radius_sq + radius;
+    let fill_hi = outer_radius_sq + 1;
+    let cx = circle.center.x as i32;
+    let cy = circle.center.y as i32;
+
+    for dy in -outer_radius..=outer_radius {
+        let y = (cy + dy) as i16;
+        let dy_sq = dy * dy;
+        // the furthest pixel from the center on this line that gets filled
+        let fill_max = if fill_hi - dy_sq >= 0 { Some(isqrt(fill_hi - dy_sq).min(outer_radius)) } else { None };
+        // the nearest and furthest pixels from the center on this line that are on the border
+        let border = if style.stroke_color.is_some() && border_hi - dy_sq - 1 >= 0 {
+            let border_max = isqrt(border_hi - dy_sq - 1).min(outer_radius);
+            let border_min = if border_lo - dy_sq < 0 { 0 } else { isqrt(border_lo - dy_sq) + 1 };
+            if border_min <= border_max { Some((border_min, border_max)) } else { None }
+        } else {
+            None
+        };
+
+        match (border, style.stroke_color) {
+            (Some((border_min, border_max)), Some(stroke)) => {
+                span(fb, y, (cx - border_max) as i16, (cx - border_min) as i16, clip, stroke);
+                span(fb, y, (cx + border_min) as i16, (cx + border_max) as i16, clip, stroke);
+                if let (Some(fill), Some(fill_max)) = (style.fill_color, fill_max) {
+                    // inside the border
+                    let inner = fill_max.min(border_min - 1);
+                    if inner >= 0 {
+                        span(fb, y, (cx - inner) as i16, (cx + inner) as i16, clip, fill);
+                    }
+                    // outside the border, if the fill reaches past it
+                    if fill_max > border_max {
+                        span(fb, y, (cx - fill_max) as i16, (cx - border_max - 1) as i16, clip, fill);
+                        span(fb, y, (cx + border_max + 1) as i16, (cx + fill_max) as i16, clip, fill);
+                    }
+                }
+            }
+            _ => {
+                if let (Some(fill), Some(fill_max)) = (style.fill_color, fill_max) {
+                    span(fb, y, (cx - fill_max) as i16, (cx + fill_max) as i16, clip, fill);
+                }
+            }
+        }
+    }
+}
+
 /// Pixel iterator for each pixel in the rect border
 /// lifted from embedded-graphics crate
 #[derive(Debug, Clone, Copy)]
@@ -232,16 +377,11 @@ impl Iterator for RectangleIterator {
 }
 
 pub fn rectangle(fb: &mut LcdFB, rect: Rectangle, clip: Option<Rectangle>) {
-    let r = RectangleIterator {
-        top_left: rect.tl,
-        bottom_right: rect.br,
-        style: rect.style,
-        p: rect.tl,
-        clip: clip,
-    };
-
-    for pixel in r {
-        put_pixel(fb, pixel.0.x, pixel.0.y, pixel.1);
+    if rect.style.stroke_color.is_none() && rect.style.fill_color.is_none() {
+        return;
+    }
+    for y in rect.tl.y.max(0)..=rect.br.y.min(HEIGHT - 1) {
+        rectangle_line(fb, y, rect.tl, rect.br, rect.style, clip, rect.tl.x, rect.br.x);
     }
 }
 
@@ -506,9 +646,17 @@ pub fn rounded_rectangle(fb: &mut LcdFB, rr: RoundedRectangle, clip: Option<Rect
             Point::new(rr.border.br.x - rr.radius, rr.border.br.y - rr.radius),
             rr.border.br),
     };
-    // draw the body
-    for pixel in rri {
-        put_pixel(fb, pixel.0.x, pixel.0.y, pixel.1);
+    // draw the body, leaving out the corner quadrants
+    if rr.border.style.stroke_color.is_some() || rr.border.style.fill_color.is_some() {
+        let tl = rr.border.tl;
+        let br = rr.border.br;
+        for y in tl.y.max(0)..=br.y.min(HEIGHT - 1) {
+            if (y <= tl.y + rr.radius) || (y >= br.y - rr.radius) {
+                rectangle_line(fb, y, tl, br, rr.border.style, clip, tl.x + rr.radius + 1, br.x - rr.radius - 1);
+            } else {
+                rectangle_line(fb, y, tl, br, rr.border.style, clip, tl.x, br.x);
+            }
+        }
     }
     //log::info!("GFX|OP: topleft {:?}, {:?}, {:?}, {:?}", rri.tlq.br, rr.radius, rr.border.style, clip);
     // now draw the corners
@@ -532,4 +680,31 @@ pub fn rounded_rectangle(fb: &mut LcdFB, rr: RoundedRectangle, clip: Option<Rect
         Quadrant::BottomRight,
         clip
     );
-}
\ No newline at end of file
+}
+#[cfg(test)]
+mod tests {
+    use super::*;
+    #[test]
+    fn span_fill_matches_pixels() {
+        let style = DrawStyle::new(PixelColor::Dark, PixelColor::Light, 2);
+        for &(x0, x1) in [(0, 335), (5, 6), (31, 32), (30, 97), (320, 335), (64, 95)].iter() {
+            let mut rect = Rectangle::new(Point::new(x0, 10), Point::new(x1, 20));
+            rect.style = style;
+
+            let mut spans = [0xFFFF_FFFF_u32; LCD_FRAME_BUF_SIZE];
+            rectangle(&mut spans, rect, None);
+
+            let mut pixels = [0xFFFF_FFFF_u32; LCD_FRAME_BUF_SIZE];
+            for Pixel(p, color) in (RectangleIterator {
+                top_left: rect.tl,
+                bottom_right: rect.br,
+                style: rect.style,
+                p: rect.tl,
+                clip: None,
+            }) {
+                put_pixel(&mut pixels, p.x, p.y, color);
+            }
+            assert!(spans[..] == pixels[..], "span {}..{} differs", x0, x1);
+        }
+    }
+}
@@ -4,7 +4,7 @@
 mod emoji;
 use emoji::*;
 
-use gam::api::SetCanvasBoundsRequest;
+use gam::api::{SetCanvasBoundsRequest, GamObjectList, GamObjectType};
 use ime_plugin_api::{ImefCallback, ImefDescriptor, ImefOpcode};
 
 use log::{error, info};
@@ -116,16 +116,17 @@ impl InputTracker {
     pub fn clear_area(&mut self) -> Result<(), xous::Error> {
         if let Some(pc) = self.pred_canvas {
             let pc_bounds: Point = self.gam.get_canvas_bounds(pc).expect("Couldn't get prediction canvas bounds");
-            self.gam.draw_rectangle(pc,
+            let mut objects = GamObjectList::new(pc);
+            objects.push(GamObjectType::Rect(
                 Rectangle::new_with_style(Point::new(0, 0), pc_bounds,
                 DrawStyle {
                     fill_color: Some(PixelColor::Light),
                     stroke_color: None,
                     stroke_width: 0
                 }
-            )).expect("can't clear prediction area");
+            ))).unwrap();
             // add the border line on top
-            self.gam.draw_line(pc,
+            objects.push(GamObjectType::Line(
                 Line::new_with_style(
                     Point::new(0,0),
                     Point::new(pc_bounds.x, 0),
@@ -134,22 +135,24 @@ impl InputTracker {
                        stroke_color: Some(PixelColor::Dark),
                        stroke_width: 1,
                    })
-            ).expect("can't draw prediction top border");
+            )).unwrap();
+            self.gam.draw_list(objects).expect("can't clear prediction area");
         }
 
         if let Some(ic) = self.input_canvas {
             let ic_bounds: Point = self.gam.get_canvas_bounds(ic).expect("Couldn't get input canvas bounds");
-            self.gam.draw_rectangle(ic,
+            let mut objects = GamObjectList::new(ic);
+            objects.push(GamObjectType::Rect(
                 Rectangle::new_with_style(Point::new(0, 0), ic_bounds,
                 DrawStyle {
                     fill_color: Some(PixelColor::Light),
                     stroke_color: None,
                     stroke_width: 0
                 }
-            )).expect("can't clear input area");
+            ))).unwrap();
 
             // add the border line on top
-            self.gam.draw_line(ic,
+            objects.push(GamObjectType::Line(
                 Line::new_with_style(
                     Point::new(0,0),
                     Point::new(ic_bounds.x, 0),
@@ -157,8 +160,8 @@ impl InputTracker {
                         fill_color: None,
                         stroke_color: Some(PixelColor::Dark),
                         stroke_width: 1,
-                    }))
-                    .expect("can't draw input top line border");
+                    }))).unwrap();
+            self.gam.draw_list(objects).expect("can't clear input area");
         }
 
         Ok(())
@@ -554,13 +557,23 @@ impl InputTracker {
                 if debug_canvas { info!("pc canvas {:?}", pc) }
                 self.gam.post_textview(&mut empty_tv).expect("can't draw prediction TextView");
             } else if update_predictor || force_redraw {
-                // alright, first, let's clear the area
-                self.gam.draw_rectangle(pc, pc_clip).expect("couldn't clear predictor area");
-
                 if debug1{info!("valid_predictions: {}", valid_predictions);}
                 // OK, let's start initially with just a naive, split-by-N layout of the prediction area
                 let approx_width = pc_bounds.x / valid_predictions as i16;
 
+                // alright, first, let's clear the area and draw the dividing lines, all in one go
+                let mut objects = GamObjectList::new(pc);
+                objects.push(GamObjectType::Rect(pc_clip)).unwrap();
+                for i in 1..valid_predictions as i16 {
+                    objects.push(GamObjectType::Line(
+                    Line::new_with_style(
+                    Point::new(i * approx_width, 1),
+                    Point::new( i * approx_width, pc_bounds.y),
+                    DrawStyle { fill_color: None, stroke_color: Some(PixelColor::Dark), stroke_width: 1 }
+                    ))).expect("too many dividing lines in prediction area");
+                }
+                self.gam.draw_list(objects).expect("couldn't clear predictor area");
+
                 let mut i = 0;
                 for p in self.pred_options.iter() {
                     if let Some(pred_str) = p {
@@ -568,14 +581,6 @@ impl InputTracker {
                         let p_clip = Rectangle::new(
                             Point::new(i * approx_width, 1),
                             Point::new((i+1) * approx_width, pc_bounds.y)).clip_with(pc_clip).unwrap();
-                        if i > 0 {
-                            self.gam.draw_line(pc,
-                            Line::new_with_style(
-                            Point::new(i * approx_width, 1),
-                            Point::new( i * approx_width, pc_bounds.y),
-                            DrawStyle { fill_color: None, stroke_color: Some(PixelColor::Dark), stroke_width: 1 }
-                            )).expect("couldn't draw dividing lines in prediction area");
-                        }
                         let mut p_tv = TextView::new(pc,
                             TextBounds::BoundingBox(p_clip));
                         p_tv.draw_border = false;
@@ -852,7 +852,7 @@ fn xmain() -> ! {
 
     // register a suspend/resume listener
     let sr_cid = xous::connect(kbd_sid).expect("couldn't create suspend callback connection");
-    let mut susres = susres::Susres::new(&xns, Opcode::SuspendResume as u32, sr_cid).expect("couldn't create suspend/resume object");
+    let mut susres = susres::Susres::new(Some(susres::SuspendOrder::Late), &xns, Opcode::SuspendResume as u32, sr_cid).expect("couldn't create suspend/resume object");
 
     // reduce connection count to 1, but leave the option to add more later
     // for now, we only expect to ever foward events to the GAM, which is capable of doing authentication
@@ -863,6 +863,12 @@ fn xmain() -> ! {
     let mut vibe = false;
     let llio = llio::Llio::new(&xns).unwrap();
 
+    // key presses should reach the screen even while something long-running is hogging the CPU.
+    // This thread only ever blocks on its message queue, so it can't starve anyone else.
+    if let Err(e) = xous::set_thread_priority(xous::current_tid().unwrap(), xous::THREAD_PRIORITY_DEFAULT + 1) {
+        log::warn!("couldn't raise keyboard priority: {:?}", e);
+    }
+
     log::trace!("starting main loop");
     loop {
         let msg = xous::receive_message(kbd_sid).unwrap(); // this blocks until we get a message
@@ -872,6 +878,7 @@ fn xmain() -> ! {
                 kbd.suspend();
                 susres.suspend_until_resume(token).expect("couldn't execute suspend/resume");
                 kbd.resume();
+                susres.resumed().expect("couldn't report resume");
             }),
             Some(Opcode::Vibe) => msg_scalar_unpack!(msg, ena, _,  _,  _, {
                 if ena != 0 { vibe = true }
@@ -92,13 +92,99 @@ impl I2cTransaction {
         I2cTransaction{ bus_addr: 0, txbuf: None, txlen: 0, rxbuf: None, rxlen: 0, timeout_ms: 500, status: I2cStatus::Uninitialized, listener: None, callback_id: 0 }
     }
 }
+
+/// most register operations that fit in one `I2cBatch`
+pub const I2C_BATCH_LEN: usize = 32;
+/// most bytes one operation in an `I2cBatch` can write or read
+pub const I2C_BATCH_DATA_LEN: usize = 8;
+/// A single register write or read within an `I2cBatch`. This is its own transaction on the bus,
+/// with a START and a STOP.
+#[derive(Debug, Copy, Clone, rkyv::Archive, rkyv::Serialize, rkyv::Deserialize)]
+pub struct I2cRegOp {
+    pub adr: u8,
+    /// `true` to read `len` bytes starting at `adr` into `data`, `false` to write them from `data`
+    pub read: bool,
+    pub len: u8,
+    pub data: [u8; I2C_BATCH_DATA_LEN],
+}
+/// A list of register operations on one device, submitted to the I2C server in a single message.
+/// The ops are run back to back from the interrupt handler, without any other client's
+/// transactions in between, so e.g. a page select and the registers on that page can go in the same batch.
+#[derive(Debug, Copy, Clone, rkyv::Archive, rkyv::Serialize, rkyv::Deserialize)]
+pub struct I2cBatch {
+    pub bus_addr: u8,
+    pub ops: [I2cRegOp; I2C_BATCH_LEN],
+    pub len: u32,
+    /// how long the whole batch may take
+    pub timeout_ms: u32,
+    pub status: I2cStatus,
+    /// number of ops that have finished. If the batch failed, this is the index of the op that failed.
+    pub completed: u32,
+}
+impl I2cBatch {
+    pub fn new(bus_addr: u8) -> Self {
+        I2cBatch {
+            bus_addr,
+            ops: [I2cRegOp { adr: 0, read: false, len: 0, data: [0; I2C_BATCH_DATA_LEN] }; I2C_BATCH_LEN],
+            len: 0,
+            timeout_ms: 500,
+            status: I2cStatus::Uninitialized,
+            completed: 0,
+        }
+    }
+    /// Add a write of `data` to register `adr`. If the batch is full or `data` is too long, the
+    /// op is dropped and the batch is marked with `ResponseFormatError`, so it won't be run.
+    pub fn write(&mut self, adr: u8, data: &[u8]) {
+        if let Some(op) = self.push(adr, false, data.len()) {
+            op.data[..data.len()].copy_from_slice(data);
+        }
+    }
+    /// Add a read of `len` bytes from register `adr`, returning the index to hand to `data()`
+    /// once the batch has run. Errors are handled the same way as in `write()`.
+    pub fn read(&mut self, adr: u8, len: usize) -> usize {
+        let index = self.len as usize;
+        self.push(adr, true, len);
+        index
+    }
+    /// The bytes read by the op at `index`, if it was a read that has finished.
+    pub fn data(&self, index: usize) -> Option<&[u8]> {
+        if index < self.completed as usize && self.ops[index].read {
+            Some(&self.ops[index].data[..self.ops[index].len as usize])
+        } else {
+            None
+        }
+    }
+    fn push(&mut self, adr: u8, read: bool, len: usize) -> Option<&mut I2cRegOp> {
+        if self.len as usize == I2C_BATCH_LEN || len > I2C_BATCH_DATA_LEN || (read && len == 0) {
+            self.status = I2cStatus::ResponseFormatError;
+            return None;
+        }
+        let op = &mut self.ops[self.len as usize];
+        self.len += 1;
+        op.adr = adr;
+        op.read = read;
+        op.len = len as u8;
+        Some(op)
+    }
+    /// the status to report once every op has run
+    pub(crate) fn ok_status(&self) -> I2cStatus {
+        if self.ops[..self.len as usize].iter().any(|op| op.read) {
+            I2cStatus::ResponseReadOk
+        } else {
+            I2cStatus::ResponseWriteOk
+        }
+    }
+}
 #[derive(Debug, num_derive::FromPrimitive, num_derive::ToPrimitive)]
 pub(crate) enum I2cOpcode {
     /// initiate an I2C transaction
     I2cTxRx,
+    /// run an `I2cBatch`; the message is returned once the whole batch is done
+    I2cBatch,
     /// from i2c interrupt handler (internal API only)
-    IrqI2cTxrxWriteDone,
-    IrqI2cTxrxReadDone,
+    IrqI2cTxrxDone,
+    /// from the i2c timeout thread, asking how long to sleep before the job on the bus is due (internal API only)
+    I2cTimeout,
     /// checks if the I2C engine is currently busy, for polling implementations
     I2cIsBusy,
     /// SuspendResume callback
@@ -6,6 +6,11 @@ use num_traits::ToPrimitive;
 use susres::{RegManager, RegOrField, SuspendResume};
 use heapless::spsc::Queue;
 
+/// most requests that can be waiting for the bus at once, including the one on it
+const I2C_QUEUE_DEPTH: usize = 8;
+// heapless queues hold one element less than their length
+const I2C_QUEUE_LEN: usize = I2C_QUEUE_DEPTH + 1;
+
 #[derive(Eq, PartialEq)]
 enum I2cState {
     Idle,
@@ -13,21 +18,55 @@ enum I2cState {
     Read,
 }
 
+/// A request that is waiting for the bus, using it, or waiting to be reported back to its client.
+enum Job {
+    Transaction(I2cTransaction),
+    /// The message the batch came in is held until every op has run, and the batch is then written back into it.
+    Batch(I2cBatch, xous::MessageEnvelope),
+}
+impl Job {
+    fn set_status(&mut self, status: I2cStatus) {
+        match self {
+            Job::Transaction(transaction) => transaction.status = status,
+            Job::Batch(batch, _) => batch.status = status,
+        }
+    }
+    fn timeout_ms(&self) -> u32 {
+        match self {
+            Job::Transaction(transaction) => transaction.timeout_ms,
+            Job::Batch(batch, _) => batch.timeout_ms,
+        }
+    }
+}
+
+/// The transaction that puts op `index` of `batch` on the bus.
+fn batch_op(batch: &I2cBatch, index: usize) -> I2cTransaction {
+    let op = &batch.ops[index];
+    let mut transaction = I2cTransaction::new();
+    let mut txbuf = [0; I2C_MAX_LEN];
+    txbuf[0] = op.adr;
+    transaction.bus_addr = batch.bus_addr;
+    if op.read {
+        transaction.txlen = 1;
+        transaction.rxbuf = Some([0; I2C_MAX_LEN]);
+        transaction.rxlen = op.len as u32;
+    } else {
+        txbuf[1..1 + op.len as usize].copy_from_slice(&op.data[..op.len as usize]);
+        transaction.txlen = 1 + op.len as u32;
+    }
+    transaction.txbuf = Some(txbuf);
+    transaction
+}
+
 // ASSUME: we are only ever handling txrx done interrupts. If implementing ARB interrupts, this needs to be refactored to read the source and dispatch accordingly.
 fn handle_i2c_irq(_irq_no: usize, arg: *mut usize) {
     let i2c = unsafe { &mut *(arg as *mut I2cStateMachine) };
 
     if let Some(conn) = i2c.handler_conn {
-        match i2c.handler_i() {
-            I2cHandlerReport::WriteDone => {
-                xous::try_send_message(conn,
-                    xous::Message::new_scalar(I2cOpcode::IrqI2cTxrxWriteDone.to_usize().unwrap(), 0, 0, 0, 0)).map(|_| ()).unwrap();
-            },
-            I2cHandlerReport::ReadDone => {
-                xous::try_send_message(conn,
-                    xous::Message::new_scalar(I2cOpcode::IrqI2cTxrxReadDone.to_usize().unwrap(), 0, 0, 0, 0)).map(|_| ()).unwrap();
-            },
-            _ => {}, // don't send any message if we're in progress
+        if i2c.handler_i() == I2cHandlerReport::Done {
+            // the next job is already on the bus by now, so the main loop only has to report the finished one
+            xous::try_send_message(conn,
+                xous::Message::new_scalar(I2cOpcode::IrqI2cTxrxDone.to_usize().unwrap(), 0, 0, 0, 0)).map(|_| ()).unwrap();
         }
     } else {
         panic!("|handle_i2c_irq: TXRX done interrupt, but no connection for notification!");
@@ -38,8 +77,8 @@ fn handle_i2c_irq(_irq_no: usize, arg: *mut usize) {
 
 #[derive(Debug, Eq, PartialEq)]
 pub(crate) enum I2cHandlerReport {
-    WriteDone,
-    ReadDone,
+    /// a job has finished and is waiting in the done queue
+    Done,
     InProgress,
 }
 pub(crate) struct I2cStateMachine {
@@ -47,15 +86,25 @@ pub(crate) struct I2cStateMachine {
     i2c_susres: RegManager::<{utra::i2c::I2C_NUMREGS}>,
     handler_conn: Option<xous::CID>,
 
-    transaction: I2cTransaction,
+    transaction: I2cTransaction, // the transaction that is on the bus
     state: I2cState,
     index: u32,  // index of the current buffer in the state machine
-    timestamp: u64, // timestamp of the last transaction
+    // when the job on the bus was started. The interrupt handler can't read the time, so the jobs it
+    // starts are left at `None` until the main loop next looks at them.
+    timestamp: Option<u64>,
     ticktimer: ticktimer_server::Ticktimer, // a connection to the ticktimer so we can measure timeouts
-    listener: Option<xous::SID>,
+    /// the timeout thread, waiting to be told how long to sleep for
+    timeout_waiter: Option<xous::MessageSender>,
     error: bool, // set if the interrupt handler encountered some kind of error
 
-    workqueue: Queue<I2cTransaction, 8>,
+    // jobs are started by the interrupt handler as soon as the one before them finishes, and
+    // left in `done` for the main loop to report. The main loop keeps the handler out with
+    // `without_irq()` whenever it touches these.
+    current: Option<Job>,
+    workqueue: Queue<Job, I2C_QUEUE_LEN>,
+    done: Queue<Job, I2C_QUEUE_LEN>,
+    /// jobs that have been accepted but not yet reported back. Only used by the main loop.
+    outstanding: usize,
 }
 
 impl I2cStateMachine {
@@ -76,13 +125,16 @@ impl I2cStateMachine {
 
             transaction: I2cTransaction::new(),
             state: I2cState::Idle,
-            timestamp: ticktimer.elapsed_ms(),
+            timestamp: None,
             ticktimer,
+            timeout_waiter: None,
             index: 0,
-            listener: None,
             error: false,
 
+            current: None,
             workqueue: Queue::new(),
+            done: Queue::new(),
+            outstanding: 0,
         };
 
         // disable interrupt, just in case it's enabled from e.g. a warm boot
@@ -123,145 +175,267 @@ impl I2cStateMachine {
         self.i2c_susres.resume();
     }
 
-    pub fn initiate(&mut self, transaction: I2cTransaction ) -> I2cStatus {
-        // state idle means the transaction is done
-        // listener None means any callback notifications are also done
-        // workqueue empty means, we have a clear path to do our thing
-        if self.workqueue.is_empty() && self.state == I2cState::Idle && self.listener == None {
-            self.checked_initiate(transaction)
+    /// Queue up a transaction, putting it straight on the bus if nothing else is using it.
+    /// Its result goes to the transaction's listener once it has run.
+    pub fn initiate(&mut self, transaction: I2cTransaction) -> I2cStatus {
+        log::trace!("I2C initiated with {:x?}", transaction);
+        // sanity-check the bounds limits
+        if transaction.status != I2cStatus::RequestIncoming
+        || transaction.txlen as usize > I2C_MAX_LEN || transaction.rxlen as usize > I2C_MAX_LEN
+        || (transaction.txbuf.is_some() && transaction.txlen == 0)
+        || (transaction.rxbuf.is_some() && transaction.rxlen == 0)
+        || (transaction.txbuf.is_none() && transaction.rxbuf.is_none()) {
+            log::trace!("initiation format error");
+            return I2cStatus::ResponseFormatError
+        }
+        match self.submit(Job::Transaction(transaction)) {
+            Ok(()) => I2cStatus::ResponseInProgress,
+            Err(_) => I2cStatus::ResponseBusy,
+        }
+    }
+
+    /// Queue up a batch. `msg` is the message it came in, which is held until the batch has
+    /// run, or returned right away with an error status if it can't be accepted.
+    pub fn initiate_batch(&mut self, mut batch: I2cBatch, msg: xous::MessageEnvelope) {
+        log::trace!("I2C batch of {} ops to {:x}", batch.len, batch.bus_addr);
+        let valid = batch.status == I2cStatus::RequestIncoming
+            && batch.len > 0 && batch.len as usize <= I2C_BATCH_LEN
+            && batch.ops[..batch.len as usize].iter().all(|op| op.len as usize <= I2C_BATCH_DATA_LEN && !(op.read && op.len == 0));
+        let mut job = if valid {
+            batch.status = I2cStatus::ResponseInProgress;
+            batch.completed = 0;
+            match self.submit(Job::Batch(batch, msg)) {
+                Ok(()) => return,
+                Err(mut job) => {
+                    job.set_status(I2cStatus::ResponseBusy);
+                    job
+                }
+            }
         } else {
-            match self.workqueue.enqueue(transaction) {
-                Ok(_) => return I2cStatus::ResponseInProgress,
-                _ => return I2cStatus::ResponseBusy,
+            batch.status = I2cStatus::ResponseFormatError;
+            Job::Batch(batch, msg)
+        };
+        self.report(&mut job);
+    }
+
+    /// Run `f` with the TXRX done interrupt masked, so the handler can't touch the job queues
+    /// at the same time. An event that comes in meanwhile stays pending, and the interrupt
+    /// fires as soon as it is unmasked.
+    fn without_irq<R>(&mut self, f: impl FnOnce(&mut Self) -> R) -> R {
+        self.i2c_csr.wfo(utra::i2c::EV_ENABLE_TXRX_DONE, 0);
+        let result = f(self);
+        self.i2c_csr.wfo(utra::i2c::EV_ENABLE_TXRX_DONE, 1);
+        result
+    }
+
+    /// Add `job` to the queue, handing it back if the queue is full.
+    fn submit(&mut self, job: Job) -> Result<(), Job> {
+        if self.outstanding == I2C_QUEUE_DEPTH {
+            log::trace!("I2C queue is full");
+            return Err(job);
+        }
+        self.outstanding += 1;
+        let now = self.ticktimer.elapsed_ms();
+        self.without_irq(|i2c| {
+            i2c.check_timeout(now);
+            // `outstanding` is never more than the queue can hold
+            i2c.workqueue.enqueue(job).ok();
+            if i2c.current.is_none() {
+                i2c.start_next(Some(now));
             }
+        });
+        self.trace();
+        self.report_done();
+        Ok(())
+    }
+
+    /// Called on behalf of the timeout thread, once it has slept for as long as it was last told
+    /// to. Fails the job on the bus if it has run out of time, and then holds on to `sender` until
+    /// there is a job on the bus whose deadline the thread can sleep until.
+    pub fn timeout_wait(&mut self, sender: xous::MessageSender) {
+        self.timeout_waiter = Some(sender);
+        let now = self.ticktimer.elapsed_ms();
+        self.without_irq(|i2c| i2c.check_timeout(now));
+        self.report_done();
+    }
+
+    /// Let the timeout thread go, so that it exits.
+    pub fn release_timeout_waiter(&mut self) {
+        if let Some(waiter) = self.timeout_waiter.take() {
+            xous::return_scalar(waiter, 0).expect("couldn't release I2C timeout thread");
         }
     }
 
-    fn checked_initiate(&mut self, transaction: I2cTransaction) -> I2cStatus {
-        log::trace!("I2C initated with {:x?}", transaction);
-        // sanity-check the bounds limits
-        if transaction.txlen > 258 || transaction.rxlen > 258 {
-            return I2cStatus::ResponseFormatError
+    /// Send the timeout thread off to sleep until the job on the bus is due, if it's waiting and
+    /// there is such a job.
+    fn arm_timeout(&mut self, now: u64) {
+        if self.timeout_waiter.is_none() {
+            return;
+        }
+        let remaining = self.without_irq(|i2c| match (&i2c.current, i2c.timestamp) {
+            (Some(job), Some(started)) => Some((job.timeout_ms() as u64).saturating_sub(now.saturating_sub(started))),
+            _ => None,
+        });
+        if let Some(ms) = remaining {
+            let waiter = self.timeout_waiter.take().unwrap();
+            // 0 tells the thread to exit
+            xous::return_scalar(waiter, ms.max(1) as usize).expect("couldn't arm I2C timeout");
         }
+    }
 
-        let now = self.ticktimer.elapsed_ms();
-        if self.state != I2cState::Idle && ((now - self.timestamp) < self.transaction.timeout_ms as u64) {
-            // we're in a transaction that hadn't timed out, can't accept a new one
-            log::trace!("bus is busy");
-            I2cStatus::ResponseBusy
-        } else {
-            if self.state != I2cState::Idle {
-                // we're in a transaction, but previous transaction had timed out...
-                self.report_timeout();
-                // reset our state parameter
+    /// Give up on the job that is on the bus if it hasn't finished within its timeout.
+    /// Call this with the interrupt masked.
+    fn check_timeout(&mut self, now: u64) {
+        let job_timeout = match (self.current.as_ref(), self.timestamp) {
+            (Some(job), Some(started)) => Some((job.timeout_ms(), started)),
+            _ => None,
+        };
+        if let Some((timeout_ms, started)) = job_timeout {
+            if now.saturating_sub(started) >= timeout_ms as u64 {
+                log::error!("I2C timeout on transaction {:?}", self.transaction);
+                // drop any event from the abandoned transaction, so it isn't taken for one from the next
+                self.i2c_csr.wo(utra::i2c::EV_PENDING, self.i2c_csr.r(utra::i2c::EV_PENDING));
+                if let Some(job) = self.current.as_mut() {
+                    job.set_status(I2cStatus::ResponseTimeout);
+                }
                 self.state = I2cState::Idle;
                 self.index = 0;
-                // reset the block - this resest just the state machine and not the prescaler or interrupt enable configs
+                self.retire(Some(now));
             }
-            self.i2c_csr.wfo(utra::i2c::CORE_RESET_RESET, 1);
-            self.error = false;
+        }
+    }
+
+    /// Move the job on the bus to the done queue, and start the next one. `now` is the time if
+    /// the caller knows it, which the interrupt handler doesn't.
+    fn retire(&mut self, now: Option<u64>) {
+        if let Some(job) = self.current.take() {
+            // `outstanding` is never more than the queue can hold
+            self.done.enqueue(job).ok();
+        }
+        self.start_next(now);
+    }
+
+    fn start_next(&mut self, now: Option<u64>) {
+        self.timestamp = None;
+        if let Some(job) = self.workqueue.dequeue() {
+            let transaction = match &job {
+                Job::Transaction(transaction) => *transaction,
+                Job::Batch(batch, _) => batch_op(batch, 0),
+            };
+            self.current = Some(job);
             self.timestamp = now;
-            self.transaction = transaction.clone();
-            assert!(self.listener == None, "initiating when previous transaction is still in progress!");
-            match transaction.listener {
-                None => self.listener = None,
-                Some((s0, s1, s2, s3)) => self.listener = Some(xous::SID::from_u32(s0, s1, s2, s3)),
+            self.start(transaction);
+        }
+    }
+
+    /// Put `transaction` on the bus, starting with the bus address. The interrupt handler takes it from there.
+    fn start(&mut self, transaction: I2cTransaction) {
+        // reset the block - this resets just the state machine and not the prescaler or interrupt enable configs
+        self.i2c_csr.wfo(utra::i2c::CORE_RESET_RESET, 1);
+        self.error = false;
+        self.transaction = transaction;
+        self.transaction.status = I2cStatus::ResponseInProgress;
+        self.index = 0;
+        if self.transaction.txbuf.is_some() {
+            // initiate bus address with write bit set
+            self.state = I2cState::Write;
+            self.i2c_csr.wfo(utra::i2c::TXR_TXR, (self.transaction.bus_addr << 1 | 0) as u32);
+        } else {
+            // initiate bus address with read bit set
+            self.state = I2cState::Read;
+            self.i2c_csr.wfo(utra::i2c::TXR_TXR, (self.transaction.bus_addr << 1 | 1) as u32);
+        }
+        self.i2c_csr.wo(utra::i2c::COMMAND,
+            self.i2c_csr.ms(utra::i2c::COMMAND_WR, 1) |
+            self.i2c_csr.ms(utra::i2c::COMMAND_STA, 1)
+        );
+    }
+
+    /// Called from the interrupt handler once the transaction on the bus is complete. Moves a
+    /// batch on to its next op, or else retires the job and starts the next one.
+    fn transaction_done(&mut self) -> I2cHandlerReport {
+        self.state = I2cState::Idle;
+        let next_op = match self.current.as_mut() {
+            Some(Job::Transaction(transaction)) => {
+                *transaction = self.transaction;
+                transaction.status = if transaction.rxbuf.is_some() {
+                    I2cStatus::ResponseReadOk
+                } else {
+                    I2cStatus::ResponseWriteOk
+                };
+                None
             }
-            log::trace!("initiate with listener {:?}", self.listener);
-
-            if self.transaction.status == I2cStatus::RequestIncoming {
-                self.transaction.status = I2cStatus::ResponseInProgress;
-                // now do the BusAddr stuff, so that the we can get the irq response
-                if let Some(_txbuf) = self.transaction.txbuf {
-                    // initiate bus address with write bit set
-                    self.state = I2cState::Write;
-                    self.i2c_csr.wfo(utra::i2c::TXR_TXR, (self.transaction.bus_addr << 1 | 0) as u32);
-                    self.index = 0;
-                    self.i2c_csr.wo(utra::i2c::COMMAND,
-                        self.i2c_csr.ms(utra::i2c::COMMAND_WR, 1) |
-                        self.i2c_csr.ms(utra::i2c::COMMAND_STA, 1)
-                    );
-                    self.trace();
-                    I2cStatus::ResponseInProgress
-                } else if let Some(_rxbuf) = self.transaction.rxbuf {
-                    // initiate bus address with read bit set
-                    self.state = I2cState::Read;
-                    self.i2c_csr.wfo(utra::i2c::TXR_TXR, (self.transaction.bus_addr << 1 | 1) as u32);
-                    self.index = 0;
-                    self.i2c_csr.wo(utra::i2c::COMMAND,
-                        self.i2c_csr.ms(utra::i2c::COMMAND_WR, 1) |
-                        self.i2c_csr.ms(utra::i2c::COMMAND_STA, 1)
-                    );
-                    self.trace();
-                    I2cStatus::ResponseInProgress
+            Some(Job::Batch(batch, _)) => {
+                let op = &mut batch.ops[batch.completed as usize];
+                if let Some(rxbuf) = self.transaction.rxbuf {
+                    op.data[..op.len as usize].copy_from_slice(&rxbuf[..op.len as usize]);
+                }
+                batch.completed += 1;
+                if batch.completed < batch.len {
+                    Some(batch_op(batch, batch.completed as usize))
                 } else {
-                    // no buffers specified, erase everything and go to idle
-                    self.state = I2cState::Idle;
-                    self.transaction = I2cTransaction::new();
-                    self.trace();
-                    I2cStatus::ResponseFormatError
+                    batch.status = batch.ok_status();
+                    None
                 }
-            } else {
-                log::trace!("initiation format error");
-                self.trace();
-                I2cStatus::ResponseFormatError  // the status field was not formatted correctly to accept the transaction
             }
+            None => {
+                // a completion with nothing on the bus; all we can do is flag an error
+                self.error = true;
+                return I2cHandlerReport::InProgress;
+            }
+        };
+        if let Some(transaction) = next_op {
+            self.start(transaction);
+            I2cHandlerReport::InProgress
+        } else {
+            self.retire(None);
+            I2cHandlerReport::Done
         }
     }
 
-    fn i2c_followup(&mut self, trans: I2cTransaction) -> Result<(), xous::Error> {
-        if let Some(listener) = self.listener.take() {
-            log::trace!("followup to listener {:?}: {:?}", listener, trans);
-            let cid = xous::connect(listener).unwrap();
-            let buf = xous_ipc::Buffer::into_buf(trans).or(Err(xous::Error::InternalError))?;
-            buf.lend(cid, I2cCallback::Result.to_u32().unwrap()).map(|_|())?;
-            unsafe{xous::disconnect(cid).unwrap()};
-        } else {
-            log::trace!("completed with transaction, but no listener! {:?}", trans);
-        };
-        if let Some(work) = self.workqueue.dequeue() {
-            if self.checked_initiate(work) != I2cStatus::ResponseInProgress {
-                log::error!("Unable to initiate I2C transaction even though machine should be idle: {:?}.", work);
-                log::error!("Probably, the I2C engine is going off the rails from here...");
+    /// Send the result of a finished job back to its client.
+    fn report(&self, job: &mut Job) {
+        match job {
+            Job::Transaction(transaction) => {
+                if let Some((s0, s1, s2, s3)) = transaction.listener {
+                    log::trace!("followup to listener {:?}", transaction);
+                    let cid = xous::connect(xous::SID::from_u32(s0, s1, s2, s3)).unwrap();
+                    let buf = xous_ipc::Buffer::into_buf(*transaction).expect("couldn't serialize I2C result");
+                    buf.lend(cid, I2cCallback::Result.to_u32().unwrap()).expect("couldn't send I2C result to listener");
+                    unsafe{xous::disconnect(cid).unwrap()};
+                } else {
+                    log::trace!("completed with transaction, but no listener! {:?}", transaction);
+                }
             }
-        };
-        Ok(())
+            Job::Batch(batch, msg) => {
+                // the client is blocked until `msg` is dropped, which happens right after this
+                if let Some(mem) = msg.body.memory_message_mut() {
+                    let mut buf = unsafe { xous_ipc::Buffer::from_memory_message_mut(mem) };
+                    buf.replace(*batch).expect("couldn't return I2C batch result");
+                } else {
+                    log::error!("I2C batch was not sent as a mutable lend, so its result can't be returned");
+                }
+            }
+        }
     }
 
-    #[allow(dead_code)] // keep this around in case we figure out the NACK issue
-    fn report_nack(&mut self) {
-        log::trace!("NACK");
-        // report the NACK situation to the listener
-        let mut nack = I2cTransaction::new();
-        nack.status = I2cStatus::ResponseNack;
-        self.i2c_followup(nack).expect("couldn't send NACK to listeners");
-    }
-    fn report_timeout(&mut self) {
-        log::error!("I2C timeout on transaction {:?}", self.transaction);
-        let mut timeout = I2cTransaction::new();
-        timeout.status = I2cStatus::ResponseTimeout;
-        self.i2c_followup(timeout).expect("couldn't send timeout error to liseners");
-    }
-    pub fn report_write_done(&mut self) {
-        log::trace!("write_done");
-        // report the end of a write-only transaction to all the listeners
-        let mut ack = I2cTransaction::new();
-        ack.status = I2cStatus::ResponseWriteOk;
-        self.i2c_followup(ack).expect("couldn't send write ACK to listeners");
-    }
-    pub fn report_read_done(&mut self) {
-        log::trace!("read_done");
-        // report the result of a read transaction to all the listeners
-        self.transaction.status = I2cStatus::ResponseReadOk;
-        log::trace!("Sending read done {:?}", self.transaction);
-        self.i2c_followup(self.transaction).expect("couldn't send read response to listeners");
+    /// Report every job the interrupt handler has finished since this was last called.
+    pub fn report_done(&mut self) {
+        let now = self.ticktimer.elapsed_ms();
+        self.without_irq(|i2c| {
+            // the interrupt handler sends for us as soon as it starts a job, so that job started about now
+            if i2c.current.is_some() && i2c.timestamp.is_none() {
+                i2c.timestamp = Some(now);
+            }
+        });
+        while let Some(mut job) = self.without_irq(|i2c| i2c.done.dequeue()) {
+            self.outstanding -= 1;
+            self.report(&mut job);
+        }
+        self.arm_timeout(now);
     }
     pub fn is_busy(&self) -> bool {
-        if self.state == I2cState::Idle {
-            false
-        } else {
-            true
-        }
+        self.current.is_some()
     }
     fn trace(&self) {
         log::trace!("I2C trace: PENDING: {:x}, ENABLE: {:x}, CMD: {:x}, STATUS: {:x}, CONTROL: {:x}, PRESCALE: {:x}",
@@ -305,8 +479,7 @@ impl I2cStateMachine {
                                 self.i2c_csr.ms(utra::i2c::COMMAND_STA, 1)
                             );
                         } else {
-                            report = I2cHandlerReport::WriteDone;
-                            self.state = I2cState::Idle;
+                            report = self.transaction_done();
                         }
                     }
                 } else {
@@ -332,8 +505,7 @@ impl I2cStateMachine {
                         }
                         self.index += 1;
                     } else {
-                        report = I2cHandlerReport::ReadDone;
-                        self.state = I2cState::Idle;
+                        report = self.transaction_done();
                     }
                 } else {
                     // we should never get here, because rxbuf was checked as Some() by the setup routine
@@ -42,8 +42,10 @@ pub struct Llio {
 impl Llio {
     pub fn new(xns: &xous_names::XousNames) -> Result<Self, xous::Error> {
         REFCOUNT.store(REFCOUNT.load(Ordering::Relaxed) + 1, Ordering::Relaxed);
-        let conn = xns.request_connection_blocking(api::SERVER_NAME_LLIO).expect("Can't connect to LLIO");
-        let i2c_conn = xns.request_connection_blocking(api::SERVER_NAME_I2C).expect("Can't connect to I2C");
+        let mut cids: [CID; 2] = [0; 2];
+        xns.request_connections_blocking(&[api::SERVER_NAME_LLIO, api::SERVER_NAME_I2C], &mut cids)
+            .expect("Can't connect to LLIO and I2C");
+        let (conn, i2c_conn) = (cids[0], cids[1]);
         Ok(Llio {
           conn,
           com_sid: None,
@@ -209,6 +211,23 @@ impl Llio {
             Ok(result)
         }
     }
+    /// run every op in `batch` back to back, with a single message to the I2C server. This blocks until the
+    /// whole batch is done, and the data from any reads can then be fetched with `batch.data()`. Since nothing
+    /// else can get onto the bus in the middle of a batch, this is also the way to issue e.g. a page select
+    /// along with the registers on that page. The timeout set with `i2c_set_timeout()` applies to each op.
+    pub fn i2c_batch(&mut self, batch: &mut I2cBatch) -> Result<I2cStatus, xous::Error> {
+        if batch.status == I2cStatus::ResponseFormatError {
+            // an op didn't fit when the batch was put together
+            return Err(xous::Error::OutOfMemory)
+        }
+        batch.status = I2cStatus::RequestIncoming;
+        batch.timeout_ms = self.i2c_timeout_ms * batch.len.max(1);
+
+        let mut buf = Buffer::into_buf(*batch).or(Err(xous::Error::InternalError))?;
+        buf.lend_mut(self.i2c_conn, I2cOpcode::I2cBatch.to_u32().unwrap()).or(Err(xous::Error::InternalError))?;
+        *batch = buf.to_original::<I2cBatch, _>().unwrap();
+        Ok(batch.status)
+    }
     // used by async callback handlers to indicate their completion, allowing e.g. later synchronous operations
     pub fn i2c_async_done(&self) {
         unsafe{I2C_CB = None};
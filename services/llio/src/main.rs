@@ -563,6 +563,24 @@ mod implementation {
     }
 }
 
+/// Sleeps until the I2C job on the bus is due, then has the I2C thread check on it, so that a
+/// wedged bus fails the job even if no other I2C request comes in.
+fn i2c_timeout_thread(conn: usize) {
+    let ticktimer = ticktimer_server::Ticktimer::new().expect("couldn't connect to ticktimer");
+    loop {
+        match xous::send_message(conn as CID,
+            xous::Message::new_blocking_scalar(I2cOpcode::I2cTimeout.to_usize().unwrap(), 0, 0, 0, 0)
+        ) {
+            Ok(xous::Result::Scalar1(0)) => break,
+            Ok(xous::Result::Scalar1(ms)) => ticktimer.sleep_ms(ms).expect("couldn't sleep until I2C timeout"),
+            _ => {
+                log::error!("I2C timeout thread got an unexpected reply, exiting");
+                break;
+            }
+        }
+    }
+}
+
 fn i2c_thread(sid0: usize, sid1: usize, sid2: usize, sid3: usize) {
     let i2c_sid = xous::SID::from_u32(sid0 as u32, sid1 as u32, sid2 as u32, sid3 as u32);
     let xns = xous_names::XousNames::new().unwrap();
@@ -572,7 +590,10 @@ fn i2c_thread(sid0: usize, sid1: usize, sid2: usize, sid3: usize) {
 
     // register a suspend/resume listener
     let sr_cid = xous::connect(i2c_sid).expect("couldn't create suspend callback connection");
-    let mut susres = susres::Susres::new(&xns, I2cOpcode::SuspendResume as u32, sr_cid).expect("couldn't create suspend/resume object");
+    let mut susres = susres::Susres::new(None, &xns, I2cOpcode::SuspendResume as u32, sr_cid).expect("couldn't create suspend/resume object");
+
+    let timeout_cid = xous::connect(i2c_sid).expect("couldn't create timeout connection");
+    xous::create_thread_1(i2c_timeout_thread, timeout_cid as usize).expect("couldn't start I2C timeout thread");
 
     log::trace!("starting i2c main loop");
     loop {
@@ -583,14 +604,15 @@ fn i2c_thread(sid0: usize, sid1: usize, sid2: usize, sid3: usize) {
                 i2c.suspend();
                 susres.suspend_until_resume(token).expect("couldn't execute suspend/resume");
                 i2c.resume();
+                susres.resumed().expect("couldn't report resume");
             }),
-            Some(I2cOpcode::IrqI2cTxrxWriteDone) => msg_scalar_unpack!(msg, _, _, _, _, {
+            Some(I2cOpcode::IrqI2cTxrxDone) => msg_scalar_unpack!(msg, _, _, _, _, {
                 // I2C state machine handler irq result
-                i2c.report_write_done();
+                i2c.report_done();
             }),
-            Some(I2cOpcode::IrqI2cTxrxReadDone) => msg_scalar_unpack!(msg, _, _, _, _, {
-                // I2C state machine handler irq result
-                i2c.report_read_done();
+            Some(I2cOpcode::I2cTimeout) => msg_blocking_scalar_unpack!(msg, _, _, _, _, {
+                // the state machine holds on to the sender, and replies once there is something to time
+                i2c.timeout_wait(msg.sender);
             }),
             Some(I2cOpcode::I2cTxRx) => {
                 let mut buffer = unsafe { Buffer::from_memory_message_mut(msg.body.memory_message_mut().unwrap()) };
@@ -598,12 +620,21 @@ fn i2c_thread(sid0: usize, sid1: usize, sid2: usize, sid3: usize) {
                 let status = i2c.initiate(i2c_txrx);
                 buffer.replace(status).unwrap();
             },
+            Some(I2cOpcode::I2cBatch) => {
+                let batch = {
+                    let buffer = unsafe { Buffer::from_memory_message(msg.body.memory_message().unwrap()) };
+                    buffer.to_original::<api::I2cBatch, _>().unwrap()
+                };
+                // the state machine holds on to the message, and returns it once the batch is done
+                i2c.initiate_batch(batch, msg);
+            },
             Some(I2cOpcode::I2cIsBusy) => msg_blocking_scalar_unpack!(msg, _, _, _, _, {
                 let busy = if i2c.is_busy() {1} else {0};
                 xous::return_scalar(msg.sender, busy as _).expect("couldn't return I2cIsBusy");
             }),
             Some(I2cOpcode::Quit) => {
                 log::info!("Received quit opcode, exiting!");
+                i2c.release_timeout_waiter();
                 break;
             }
             None => {
@@ -658,7 +689,7 @@ fn xmain() -> ! {
 
     // register a suspend/resume listener
     let sr_cid = xous::connect(llio_sid).expect("couldn't create suspend callback connection");
-    let mut susres = susres::Susres::new(&xns, Opcode::SuspendResume as u32, sr_cid).expect("couldn't create suspend/resume object");
+    let mut susres = susres::Susres::new(None, &xns, Opcode::SuspendResume as u32, sr_cid).expect("couldn't create suspend/resume object");
     let mut latest_activity = 0;
 
     let mut usb_cb_conns: [Option<ScalarCallback>; 32] = [None; 32];
@@ -677,6 +708,7 @@ fn xmain() -> ! {
                 llio.suspend();
                 susres.suspend_until_resume(token).expect("couldn't execute suspend/resume");
                 llio.resume();
+                susres.resumed().expect("couldn't report resume");
                 lockstatus_force_update = true; // notify the status bar that yes, it does need to redraw the lock status, even if the value hasn't changed since the last read
             }),
             Some(Opcode::CrgMode) => msg_scalar_unpack!(msg, _mode, _, _, _, {
@@ -7,6 +7,28 @@ pub struct LogRecord {
     pub args: xous_ipc::String<2800>,
 }
 
+/// Size of the ring each process logs into
+pub const LOG_RING_LEN: usize = 8000;
+
+/// Records in a log ring start with this many bytes of header:
+///
+/// | bytes | field                                             |
+/// |-------|---------------------------------------------------|
+/// | 0..2  | length of the record after these two bytes        |
+/// | 2     | level                                             |
+/// | 3     | length of the module path                         |
+/// | 4     | length of the file name                           |
+/// | 5     | reserved                                          |
+/// | 6..8  | number of records dropped just before this one    |
+/// | 8..12 | line number, or `u32::MAX` if there isn't one     |
+///
+/// The module path, file name and message follow, in that order. All fields
+/// are little-endian.
+pub const RING_RECORD_HEADER: usize = 12;
+
+/// Largest record that can be written to a log ring, including its header
+pub const RING_RECORD_MAX: usize = 3072;
+
 #[derive(Debug, PartialEq, num_derive::FromPrimitive, num_derive::ToPrimitive)]
 pub enum Opcode {
     /// A `LogRecord` message, delivering structured log output
@@ -21,6 +43,12 @@ pub enum Opcode {
     /// A `xous::StringBuffer` containing this program's name
     ProgramName = 3,
 
+    /// A client is sharing a ring of log records with us, opened with `xous_ipc::RingSender`
+    OpenRing = 4,
+
+    /// A client wrote records to its ring while we were idle
+    RingDoorbell = 5,
+
     /// A panic occurred, and a panic log is forthcoming
     PanicStarted = 1000,
 
@@ -2,7 +2,7 @@
 use core::fmt::Write;
 use core::sync::atomic::{AtomicBool, Ordering};
 use num_traits::ToPrimitive;
-use xous_ipc::{Buffer, String};
+use xous_ipc::{Buffer, RingSender, String};
 
 pub mod api;
 
@@ -31,30 +31,83 @@ static mut XOUS_LOGGER_BACKING: Option<XousLoggerBacking> = None;
 struct XousLoggerBacking<'a> {
     conn: xous::CID,
     buffer: Buffer<'a>,
+    /// If the server accepted a ring from us, records are written here
+    /// instead of being lent one at a time.
+    ring: Option<RingSender>,
+    /// Records that didn't fit in the ring, reported along with the next one that does
+    dropped: u16,
 }
 
 impl<'a> XousLoggerBacking<'a> {
     pub fn new() -> Result<Self, xous::Error> {
+        let conn = xous::connect(xous::SID::from_bytes(b"xous-log-server ").unwrap())?;
         Ok(XousLoggerBacking {
-            conn: xous::connect(xous::SID::from_bytes(b"xous-log-server ").unwrap())?,
+            conn,
             // why 4000? tests non-power of 2 sizes in rkyv APIs. Could make it 4096 as well...
             buffer: Buffer::new(4000),
+            // hosted mode can't share memory, so it always lends
+            ring: RingSender::new(
+                conn,
+                api::Opcode::OpenRing.to_usize().unwrap(),
+                api::Opcode::RingDoorbell.to_usize().unwrap(),
+                api::LOG_RING_LEN,
+            )
+            .ok(),
+            dropped: 0,
         })
     }
 }
 
 impl Default for XousLoggerBacking<'_> {
     fn default() -> Self {
-        XousLoggerBacking {
-            conn: xous::connect(xous::SID::from_bytes(b"xous-log-server ").unwrap()).unwrap(),
-            // why 4000? tests non-power of 2 sizes in rkyv APIs. Could make it 4096 as well...
-            buffer: Buffer::new(4000),
+        XousLoggerBacking::new().unwrap()
+    }
+}
+
+/// Longest module path or file name that is put in a ring record
+const RING_FIELD_MAX: usize = 128;
+
+/// How many times a warning or error yields to the server waiting for room in
+/// a full ring, before it is counted as dropped like any other record
+const RING_FULL_YIELDS: usize = 1000;
+
+/// Fills a byte slice, silently dropping whatever doesn't fit. Only whole
+/// characters are copied, so the result is always valid UTF-8.
+struct RecordWriter<'a> {
+    buf: &'a mut [u8],
+    len: usize,
+}
+
+impl Write for RecordWriter<'_> {
+    fn write_str(&mut self, s: &str) -> core::fmt::Result {
+        for c in s.chars() {
+            let width = c.len_utf8();
+            if self.len + width > self.buf.len() {
+                break;
+            }
+            c.encode_utf8(&mut self.buf[self.len..]);
+            self.len += width;
         }
+        Ok(())
     }
 }
 
+fn write_field(buf: &mut [u8], field: &str) -> usize {
+    let mut writer = RecordWriter { buf, len: 0 };
+    writer.write_str(field).unwrap();
+    writer.len
+}
+
 impl XousLoggerBacking<'_> {
     fn log_impl(&mut self, record: &log::Record) {
+        if self.ring.is_some() {
+            if self.log_to_ring(record) {
+                return;
+            }
+            // The server stopped reading the ring, so go back to lending
+            // records to it one at a time.
+            self.ring = None;
+        }
         let mut args = String::<2800>::new();
         write!(args, "{}", record.args()).unwrap();
         let lr = api::LogRecord {
@@ -70,6 +123,56 @@ impl XousLoggerBacking<'_> {
             .lend(self.conn, crate::api::Opcode::LogRecord.to_u32().unwrap())
             .unwrap();
     }
+
+    /// Put a record in the ring and carry on, without waiting for the server to
+    /// print it. If the ring is full, `Info` and less severe records are
+    /// dropped, while warnings and errors wait a while for room. Returns
+    /// `false` if the ring can't be used any more.
+    fn log_to_ring(&mut self, record: &log::Record) -> bool {
+        let mut bytes = [0u8; api::RING_RECORD_MAX];
+        let module_start = api::RING_RECORD_HEADER;
+        let module_len = write_field(
+            &mut bytes[module_start..module_start + RING_FIELD_MAX],
+            record.module_path().unwrap_or(""),
+        );
+        let file_start = module_start + module_len;
+        let file_len = write_field(
+            &mut bytes[file_start..file_start + RING_FIELD_MAX],
+            record.file().unwrap_or(""),
+        );
+        let args_start = file_start + file_len;
+        let mut args = RecordWriter {
+            buf: &mut bytes[args_start..],
+            len: 0,
+        };
+        write!(args, "{}", record.args()).unwrap();
+        let len = args_start + args.len;
+
+        bytes[0..2].copy_from_slice(&((len - 2) as u16).to_le_bytes());
+        bytes[2] = record.level() as u8;
+        bytes[3] = module_len as u8;
+        bytes[4] = file_len as u8;
+        bytes[6..8].copy_from_slice(&self.dropped.to_le_bytes());
+        bytes[8..12].copy_from_slice(&record.line().unwrap_or(u32::MAX).to_le_bytes());
+
+        let ring = self.ring.as_mut().unwrap();
+        // the whole record goes in at once, so the server never sees part of one
+        let mut yields = 0;
+        while ring.available() < len {
+            if record.level() > log::Level::Warn || yields >= RING_FULL_YIELDS {
+                self.dropped = self.dropped.saturating_add(1);
+                return true;
+            }
+            xous::yield_slice();
+            yields += 1;
+        }
+        if ring.write(&bytes[..len]).is_err() {
+            return false;
+        }
+        self.dropped = 0;
+        true
+    }
+
     fn resume(&self) {
         xous::send_message(
             self.conn,
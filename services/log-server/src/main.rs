@@ -220,6 +220,151 @@ mod implementation {
     }
 }
 
+/// Maximum number of processes that can log through a ring at once
+const MAX_RINGS: usize = 32;
+
+struct ClientRing {
+    pid: xous::PID,
+    ring: xous_ipc::RingReceiver,
+}
+
+fn level_name(level: u32) -> &'static str {
+    if log::Level::Error as u32 == level {
+        "ERR "
+    } else if log::Level::Warn as u32 == level {
+        "WARN"
+    } else if log::Level::Info as u32 == level {
+        "INFO"
+    } else if log::Level::Debug as u32 == level {
+        "DBG "
+    } else if log::Level::Trace as u32 == level {
+        "TRCE"
+    } else {
+        "UNKNOWN"
+    }
+}
+
+fn open_ring(
+    output: &mut implementation::OutputWriter,
+    rings: &mut [Option<ClientRing>; MAX_RINGS],
+    record: &mut [u8; RING_RECORD_MAX],
+    envelope: xous::MessageEnvelope,
+) {
+    let pid = match envelope.sender.pid() {
+        Some(pid) => pid,
+        None => return,
+    };
+    // A ring that is still around for this PID belonged to a process that has
+    // since exited, so there's nobody left to hand its memory back to.
+    if let Some(stale) = rings
+        .iter_mut()
+        .find(|slot| slot.as_ref().map_or(false, |client| client.pid == pid))
+    {
+        core::mem::forget(stale.take());
+    }
+    let slot = match rings.iter_mut().find(|slot| slot.is_none()) {
+        Some(slot) => slot,
+        None => {
+            // Dropping the envelope returns the memory, and the client falls
+            // back to sending `LogRecord` messages.
+            writeln!(
+                output,
+                "LOG: too many log rings, refusing one from PID {}",
+                pid
+            )
+            .unwrap();
+            return;
+        }
+    };
+    match xous_ipc::RingReceiver::new(envelope) {
+        Ok(ring) => {
+            *slot = Some(ClientRing { pid, ring });
+            // The client doesn't ring the doorbell until the ring has been
+            // drained once, so pick up whatever it has written so far.
+            drain_ring(output, rings, record, pid);
+        }
+        Err(e) => writeln!(
+            output,
+            "LOG: couldn't open log ring from PID {}: {:?}",
+            pid, e
+        )
+        .unwrap(),
+    }
+}
+
+/// Print one record from a log ring. `record` includes the header.
+fn write_ring_record(output: &mut implementation::OutputWriter, pid: xous::PID, record: &[u8]) {
+    let level = level_name(record[2] as u32);
+    let module_len = record[3] as usize;
+    let file_len = record[4] as usize;
+    let dropped = u16::from_le_bytes([record[6], record[7]]);
+    let line = u32::from_le_bytes([record[8], record[9], record[10], record[11]]);
+
+    let text = |range: core::ops::Range<usize>| {
+        record
+            .get(range)
+            .and_then(|bytes| core::str::from_utf8(bytes).ok())
+            .unwrap_or("<invalid>")
+    };
+    let module_start = RING_RECORD_HEADER;
+    let file_start = module_start + module_len;
+    let args_start = file_start + file_len;
+    let module = text(module_start..file_start);
+    let file = text(file_start..args_start);
+    let args = text(args_start.min(record.len())..record.len());
+
+    if dropped != 0 {
+        writeln!(output, "LOG: PID {} dropped {} messages", pid, dropped).unwrap();
+    }
+    if line != u32::MAX {
+        writeln!(output, "{}:{}: {} ({}:{})", level, module, args, file, line).unwrap();
+    } else {
+        writeln!(output, "{}:{}: {} ({})", level, module, args, file).unwrap();
+    }
+}
+
+/// Print everything that `pid` has written to its ring so far.
+fn drain_ring(
+    output: &mut implementation::OutputWriter,
+    rings: &mut [Option<ClientRing>; MAX_RINGS],
+    record: &mut [u8; RING_RECORD_MAX],
+    pid: xous::PID,
+) {
+    let slot = match rings
+        .iter_mut()
+        .find(|slot| slot.as_ref().map_or(false, |client| client.pid == pid))
+    {
+        Some(slot) => slot,
+        None => return,
+    };
+    let client = slot.as_mut().unwrap();
+    loop {
+        // Records are written to the ring in one go, so once the length is
+        // there the rest of the record is too.
+        if client.ring.read(&mut record[..2]) == 0 {
+            break;
+        }
+        let len = u16::from_le_bytes([record[0], record[1]]) as usize + 2;
+        if len < RING_RECORD_HEADER
+            || len > RING_RECORD_MAX
+            || client.ring.read(&mut record[2..len]) != len - 2
+        {
+            writeln!(
+                output,
+                "LOG: log ring from PID {} is corrupt, closing it",
+                pid
+            )
+            .unwrap();
+            *slot = None;
+            return;
+        }
+        write_ring_record(output, pid, &record[..len]);
+    }
+    if client.ring.is_closed() {
+        *slot = None;
+    }
+}
+
 fn handle_scalar(
     output: &mut implementation::OutputWriter,
     sender: xous::MessageSender,
@@ -282,19 +427,7 @@ fn handle_opcode(
             api::Opcode::LogRecord => {
                 let buffer = unsafe { xous_ipc::Buffer::from_memory_message(mem) };
                 let lr: LogRecord = buffer.to_original::<LogRecord, _>().unwrap();
-                let level = if log::Level::Error as u32 == lr.level {
-                    "ERR "
-                } else if log::Level::Warn as u32 == lr.level {
-                    "WARN"
-                } else if log::Level::Info as u32 == lr.level {
-                    "INFO"
-                } else if log::Level::Debug as u32 == lr.level {
-                    "DBG "
-                } else if log::Level::Trace as u32 == lr.level {
-                    "TRCE"
-                } else {
-                    "UNKNOWN"
-                };
+                let level = level_name(lr.level);
                 if let Some(line) = lr.line {
                     writeln!(
                         output,
@@ -369,6 +502,8 @@ fn reader_thread(arg: usize) {
     let server_addr = xous::create_server_with_address(b"xous-log-server ").unwrap();
     writeln!(output, "LOG: Server listening on address {:?}", server_addr).unwrap();
 
+    let mut rings: [Option<ClientRing>; MAX_RINGS] = Default::default();
+    let mut record = [0u8; RING_RECORD_MAX];
     let mut counter: usize = 0;
     loop {
         if counter.trailing_zeros() >= 12 {
@@ -378,7 +513,17 @@ fn reader_thread(arg: usize) {
         // writeln!(output, "LOG: Waiting for an event...").unwrap();
         let envelope = xous::syscall::receive_message(server_addr).expect("couldn't get address");
         let sender = envelope.sender;
-        if let Some(opcode) = FromPrimitive::from_usize(envelope.body.id()) {
+        // Anything else a process sends us, such as a panic, comes after the
+        // records that are already sitting in its ring.
+        if let Some(pid) = sender.pid() {
+            drain_ring(output, &mut rings, &mut record, pid);
+        }
+        let opcode: Option<api::Opcode> = FromPrimitive::from_usize(envelope.body.id());
+        if let Some(api::Opcode::OpenRing) = opcode {
+            open_ring(output, &mut rings, &mut record, envelope);
+        } else if let Some(api::Opcode::RingDoorbell) = opcode {
+            // The ring was drained above
+        } else if let Some(opcode) = opcode {
             handle_opcode(output, sender, opcode, &envelope.body);
         } else {
             writeln!(
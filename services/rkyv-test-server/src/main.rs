@@ -104,7 +104,7 @@ fn local_lender(){
         write!(message_string, "LOCAL loop # {:^4}", idx).unwrap();
         idx += 1;
         rkyv_test_server::log_message("LOCAL LENDER", message_string);
-        ticktimer.sleep_ms(500).unwrap();
+        ticktimer.sleep_ms_slack(500, 100).unwrap();
     }
 }
 
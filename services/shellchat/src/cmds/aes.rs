@@ -107,6 +107,7 @@ use aes_xous::*;
 use cipher::{BlockDecrypt, BlockEncrypt, NewBlockCipher};
 
 use num_traits::*;
+use rand_core::RngCore;
 
 use core::sync::atomic::{AtomicU32, Ordering};
 static CB_ID: AtomicU32 = AtomicU32::new(0);
@@ -147,18 +148,14 @@ pub fn benchmark_thread(sid0: usize, sid1: usize, sid2: usize, sid3: usize) {
     let sid = xous::SID::from_u32(sid0 as u32, sid1 as u32, sid2 as u32, sid3 as u32);
     let mut dataset_ref: [u8; TEST_MAX_LEN] = [0; TEST_MAX_LEN];
     let xns = xous_names::XousNames::new().unwrap();
-    let trng = trng::Trng::new(&xns).unwrap();
+    let mut csprng = trng::Csprng::new(&xns).unwrap();
     let callback_conn = xns.request_connection_blocking(crate::SERVER_NAME_SHELLCHAT).unwrap();
 
     // fill a random array with words
-    for chunk in dataset_ref.chunks_exact_mut(8) {
-        chunk.clone_from_slice(&trng.get_u64().unwrap().to_be_bytes());
-    }
+    csprng.fill_bytes(&mut dataset_ref);
     // pick a random key
     let mut key_array: [u8; 32] = [0; 32];
-    for k in key_array.chunks_exact_mut(8) {
-        k.clone_from_slice(&trng.get_u64().unwrap().to_be_bytes());
-    }
+    csprng.fill_bytes(&mut key_array);
     let key = GenericArray::from_slice(&key_array);
     let cipher_hw = Aes256::new(&key);
     let cipher_sw = Aes256Soft::new(&key);
@@ -55,61 +55,67 @@ fn run_vectors(engine: &mut Engine25519) -> (usize, usize) {
         let code_len = vector_read(test_offset) & 0xFFFF;
         test_offset += 1;
         let num_args = (vector_read(test_offset) >> 27) & 0x1F;
-        let window = (vector_read(test_offset) >> 23) & 0xF;
+        // batched jobs each get their own register window from the engine, so the suite's window is unused
+        let _window = (vector_read(test_offset) >> 23) & 0xF;
         let num_vectors = (vector_read(test_offset) >> 0) & 0x3F_FFFF;
         test_offset += 1;
 
-        let mut job = Job {
-            id: None,
-            uc_start: load_addr,
-            uc_len: code_len,
-            ucode: [0; 1024],
-            rf: [0; RF_SIZE_IN_U32],
-            window: Some(window as u8),
-        };
-
+        let mut ucode: [u32; 1024] = [0; 1024];
         for i in load_addr as usize..(load_addr + code_len) as usize {
-            job.ucode[i] = vector_read(test_offset);
+            ucode[i] = vector_read(test_offset);
             test_offset += 1;
         }
 
         test_offset = test_offset + (8 - (test_offset % 8)); // skip over padding
 
-        // copy in the arguments
-        for vector in 0..num_vectors {
-            // a test suite can have numerous vectors against a common code base
-            for argcnt in 0..num_args {
-                for word in 0..8 {
-                    job.rf[(/*window * 32 * 8 +*/ argcnt * 8 + word) as usize] = vector_read(test_offset);
-                    test_offset += 1;
+        // a test suite can have numerous vectors against a common code base, so they are sent
+        // to the engine as batches that share one copy of the microcode
+        let mut vector = 0;
+        while vector < num_vectors {
+            let batch_len = ((num_vectors - vector) as usize).min(JOB_BATCH_LEN);
+            let mut rf: [[u32; RF_SIZE_IN_U32]; JOB_BATCH_LEN] = [[0; RF_SIZE_IN_U32]; JOB_BATCH_LEN];
+            // the expected result of each vector follows its arguments
+            let mut expect_offset: [usize; JOB_BATCH_LEN] = [0; JOB_BATCH_LEN];
+            for (job_rf, expect) in rf[..batch_len].iter_mut().zip(expect_offset.iter_mut()) {
+                // copy in the arguments
+                for argcnt in 0..num_args {
+                    for word in 0..8 {
+                        job_rf[(/*window * 32 * 8 +*/ argcnt * 8 + word) as usize] = vector_read(test_offset);
+                        test_offset += 1;
+                    }
                 }
+                *expect = test_offset;
+                test_offset += 8;
             }
 
-            let mut passed = true;
-            log::trace!("spawning job");
-            match engine.spawn_job(job) {
-                Ok(rf_result) => {
-                    for word in 0..8 {
-                        let expect = vector_read(test_offset);
-                        test_offset += 1;
-                        let actual = rf_result[(/*window * 32 * 8 + */ 31 * 8 + word) as usize];
-                        if expect != actual {
-                            log::error!("e/a {:08x}/{:08x}", expect, actual);
-                            passed = false;
+            log::trace!("spawning batch of {} jobs", batch_len);
+            let status = engine.spawn_job_batch(load_addr, code_len, &ucode, &mut rf[..batch_len]);
+            for (job_rf, &expect) in rf[..batch_len].iter().zip(expect_offset.iter()) {
+                let mut passed = true;
+                match status {
+                    Ok(()) => {
+                        for word in 0..8 {
+                            let expect = vector_read(expect + word);
+                            let actual = job_rf[(/*window * 32 * 8 + */ 31 * 8 + word) as usize];
+                            if expect != actual {
+                                log::error!("e/a {:08x}/{:08x}", expect, actual);
+                                passed = false;
+                            }
                         }
+                    },
+                    Err(ref e) => {
+                        log::error!("system error {:?} in running test vector: {}/0x{:x}", e, vector, expect);
+                        passed = false;
                     }
-                },
-                Err(e) => {
-                    log::error!("system error {:?} in running test vector: {}/0x{:x}", e, vector, test_offset);
-                    passed = false;
                 }
-            }
 
-            if passed {
-                passes += 1;
-            } else {
-                log::error!("arithmetic or system error in running test vector: {}/0x{:x}", vector, test_offset);
-                fails += 1;
+                if passed {
+                    passes += 1;
+                } else {
+                    log::error!("arithmetic or system error in running test vector: {}/0x{:x}", vector, expect);
+                    fails += 1;
+                }
+                vector += 1;
             }
         }
     }
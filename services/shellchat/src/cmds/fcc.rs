@@ -32,7 +32,7 @@ pub fn callback_thread(callback_id: usize) {
                 })).unwrap();
             }
         } else {
-            ticktimer.sleep_ms(250).unwrap(); // a little more polite than simply busy-waiting
+            ticktimer.sleep_ms_slack(250, 64).unwrap(); // a little more polite than simply busy-waiting
         }
     }
 }
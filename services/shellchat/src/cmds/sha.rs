@@ -5,6 +5,7 @@ use engine_sha512::*;
 use digest::Digest;
 
 use num_traits::*;
+use rand_core::RngCore;
 
 use core::sync::atomic::{AtomicU32, Ordering};
 static CB_ID: AtomicU32 = AtomicU32::new(0);
@@ -53,16 +54,14 @@ pub fn benchmark_thread(sid0: usize, sid1: usize, sid2: usize, sid3: usize) {
     let sid = xous::SID::from_u32(sid0 as u32, sid1 as u32, sid2 as u32, sid3 as u32);
     let mut dataset: [u8; TEST_MAX_LEN] = [0; TEST_MAX_LEN];
     let xns = xous_names::XousNames::new().unwrap();
-    let trng = trng::Trng::new(&xns).unwrap();
+    let mut csprng = trng::Csprng::new(&xns).unwrap();
     let callback_conn = xns.request_connection_blocking(crate::SERVER_NAME_SHELLCHAT).unwrap();
 
     let mut last_result: [u8; 64] = [0; 64];
     let mut first_time = true;
 
     // fill a random array with words
-    for chunk in dataset.chunks_exact_mut(8) {
-        chunk.clone_from_slice(&trng.get_u64().unwrap().to_be_bytes());
-    }
+    csprng.fill_bytes(&mut dataset);
 
     loop {
         let msg = xous::receive_message(sid).unwrap();
@@ -95,7 +95,7 @@ fn xmain() -> ! {
 
     // register a suspend/resume listener
     let sr_cid = xous::connect(codec_sid).expect("couldn't create suspend callback connection");
-    let mut susres = susres::Susres::new(&xns, api::Opcode::SuspendResume as u32, sr_cid).expect("couldn't create suspend/resume object");
+    let mut susres = susres::Susres::new(None, &xns, api::Opcode::SuspendResume as u32, sr_cid).expect("couldn't create suspend/resume object");
 
     loop {
         let msg = xous::receive_message(codec_sid).unwrap();
@@ -104,6 +104,7 @@ fn xmain() -> ! {
                 codec.suspend();
                 susres.suspend_until_resume(token).expect("couldn't execute suspend/resume");
                 codec.resume();
+                susres.resumed().expect("couldn't report resume");
             }),
             None => {
                 log::error!("couldn't convert opcode");
@@ -69,3 +69,36 @@ pub enum SpinorError {
     NoId,
     AccessDenied,
 }
+
+/// Named partitions of FLASH that can be mapped read-only with `FlashMapping`
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum FlashPartition {
+    /// main SoC gateware
+    SocGateware,
+    /// secondary (staging) SoC gateware
+    SocStaging,
+    /// the loader, along with the fonts that are linked in behind it
+    Loader,
+    /// the kernel and initial processes
+    Kernel,
+    /// the plausibly deniable database
+    Pddb,
+    /// EC firmware image
+    EcFirmware,
+    /// WF200 wifi firmware image
+    Wf200Firmware,
+}
+impl FlashPartition {
+    /// offset of the partition from the base of FLASH, and its length
+    pub fn bounds(&self) -> (u32, u32) {
+        match self {
+            FlashPartition::SocGateware => (xous::SOC_MAIN_GW_LOC, xous::SOC_MAIN_GW_LEN),
+            FlashPartition::SocStaging => (xous::SOC_SEC_GW_LOC, xous::SOC_SEC_GW_LEN),
+            FlashPartition::Loader => (xous::LOADER_LOC, xous::LOADER_LEN),
+            FlashPartition::Kernel => (xous::KERNEL_LOC, xous::KERNEL_LEN),
+            FlashPartition::Pddb => (xous::PDDB_LOC, xous::PDDB_LEN),
+            FlashPartition::EcFirmware => (xous::EC_FW_PKG_LOC, xous::EC_FW_PKG_LEN),
+            FlashPartition::Wf200Firmware => (xous::EC_WF200_PKG_LOC, xous::EC_WF200_PKG_LEN),
+        }
+    }
+}
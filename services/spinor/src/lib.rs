@@ -92,6 +92,7 @@ impl Spinor {
         let mut i = 0;
         if !wr.clean_patch {
             assert!((wr.start & 0xFFF) == 0, "erasing is required, but start address is not erase-sector aligned");
+            EMU_ERASES.fetch_add(1, Ordering::Relaxed);
             for addr in wr.start..wr.start + 4096 {
                 EMU_FLASH.lock().unwrap()[addr as usize] = 0xFF;
             }
@@ -133,22 +134,7 @@ impl Spinor {
             return Err(SpinorError::AlignmentError);
         }
         // acquire a write lock on the unit
-        #[cfg(not(test))]
-        {
-            let response = send_message(self.conn,
-                Message::new_blocking_scalar(Opcode::AcquireExclusive.to_usize().unwrap(),
-                    self.token[0] as usize,
-                    self.token[1] as usize,
-                    self.token[2] as usize,
-                    self.token[3] as usize,
-                )
-            ).expect("couldn't send AcquireExclusive message to Sha2 hardware!");
-            if let xous::Result::Scalar1(result) = response {
-                if result == 0 {
-                    return Err(SpinorError::BusyTryAgain)
-                }
-            }
-        }
+        self.acquire_exclusive()?;
 
         // pre-allocate a buffer that we'll use repeatedly to communicate with the server
         let mut wr = WriteRegion {
@@ -257,12 +243,41 @@ impl Spinor {
         }
 
         // release the write lock before exiting
-        #[cfg(not(test))]
+        self.release_exclusive();
+
+        ret
+    }
+
+    #[cfg(not(test))]
+    fn acquire_exclusive(&mut self) -> Result<(), SpinorError> {
+        let response = send_message(self.conn,
+            Message::new_blocking_scalar(Opcode::AcquireExclusive.to_usize().unwrap(),
+                self.token[0] as usize,
+                self.token[1] as usize,
+                self.token[2] as usize,
+                self.token[3] as usize,
+            )
+        ).expect("couldn't send AcquireExclusive message to Sha2 hardware!");
+        if let xous::Result::Scalar1(result) = response {
+            if result == 0 {
+                return Err(SpinorError::BusyTryAgain)
+            }
+        }
+        Ok(())
+    }
+    #[cfg(test)]
+    fn acquire_exclusive(&mut self) -> Result<(), SpinorError> {
+        Ok(())
+    }
+
+    #[cfg(not(test))]
+    fn release_exclusive(&mut self) {
         let _ = send_message(self.conn,
             Message::new_blocking_scalar(Opcode::ReleaseExclusive.to_usize().unwrap(), 0, 0, 0, 0)
         ).expect("couldn't send ReleaseExclusive message");
-
-        ret
+    }
+    #[cfg(test)]
+    fn release_exclusive(&mut self) {
     }
 
     /// these functions are intended for use by the suspend/resume manager. most functions wouldn't have a need to call this.
@@ -288,7 +303,320 @@ impl Spinor {
     }
 }
 
+/// Number of erase sectors that a `WriteCache` holds
+pub const WRITE_CACHE_SECTORS: usize = 4;
+
+struct CachedSector {
+    /// offset of the sector from the start of the region
+    index: u32,
+    /// contents of the sector, with any patches applied
+    data: [u8; SPINOR_ERASE_SIZE as usize],
+    /// the range of bytes in `data` that have been patched since the sector was loaded
+    dirty: core::ops::Range<usize>,
+    /// when the sector was last touched, for picking a sector to evict
+    used: u32,
+}
+
+/// A write-back cache that sits in front of `Spinor::patch()`.
+///
+/// Patches are applied to a copy of each erase sector they touch, and only go out to FLASH when
+/// the cache is flushed, or when room is needed for another sector. However many patches land on
+/// a sector in between, it costs at most one erase and one program. If nothing that changed had
+/// been programmed since the last erase, the erase is skipped and only the changed span is
+/// programmed.
+///
+/// Until it is flushed, FLASH is behind the cache; use `read()` to see patched data. The cache
+/// holds `WRITE_CACHE_SECTORS` whole sectors, so keep it somewhere long-lived rather than on
+/// the stack.
+///
+/// The cache has no connection or region of its own to write back with, so it can't flush
+/// itself when it goes away. Dropping it with patches still pending panics instead of losing
+/// them quietly: `flush()` it first, or `discard()` the patches if they really aren't wanted.
+pub struct WriteCache {
+    region_base: u32,
+    sectors: [Option<CachedSector>; WRITE_CACHE_SECTORS],
+    clock: u32,
+}
+
+impl WriteCache {
+    /// Create a cache for the region that starts `region_base` bytes from the base of FLASH.
+    /// It has the same alignment requirement as the `region_base` given to `Spinor::patch()`.
+    pub fn new(region_base: u32) -> Result<Self, SpinorError> {
+        if region_base & (SPINOR_ERASE_SIZE - 1) != 0 {
+            return Err(SpinorError::AlignmentError);
+        }
+        Ok(WriteCache {
+            region_base,
+            sectors: Default::default(),
+            clock: 0,
+        })
+    }
+
+    /// Patch `patch_data` into the region at `patch_index`, as `Spinor::patch()` would. There are no
+    /// alignment requirements on either. `region` is the region's memory-mapped contents, which are
+    /// read the first time each sector is touched.
+    pub fn patch(&mut self, spinor: &mut Spinor, region: &[u8], patch_data: &[u8], patch_index: u32) -> Result<(), SpinorError> {
+        let patch_index = patch_index as usize;
+        if patch_index + patch_data.len() > region.len() {
+            return Err(SpinorError::InvalidRequest);
+        }
+        let sector_size = SPINOR_ERASE_SIZE as usize;
+        let mut index = patch_index;
+        let mut remaining = patch_data;
+        // split the patch at sector boundaries
+        while !remaining.is_empty() {
+            let offset = index % sector_size;
+            let len = remaining.len().min(sector_size - offset);
+            let slot = self.slot_for(spinor, region, (index - offset) as u32)?;
+            let sector = self.sectors[slot].as_mut().unwrap();
+            sector.data[offset..offset + len].copy_from_slice(&remaining[..len]);
+            if sector.dirty.start >= sector.dirty.end {
+                sector.dirty = offset..offset + len;
+            } else {
+                sector.dirty = sector.dirty.start.min(offset)..sector.dirty.end.max(offset + len);
+            }
+            index += len;
+            remaining = &remaining[len..];
+        }
+        Ok(())
+    }
+
+    /// Copy `buf.len()` bytes from `index` in the region into `buf`, as they will be once the
+    /// cache is flushed.
+    pub fn read(&self, region: &[u8], index: u32, buf: &mut [u8]) {
+        let index = index as usize;
+        buf.copy_from_slice(&region[index..index + buf.len()]);
+        let sector_size = SPINOR_ERASE_SIZE as usize;
+        for sector in self.sectors.iter().flatten() {
+            let start = (sector.index as usize).max(index);
+            let end = (sector.index as usize + sector_size).min(index + buf.len());
+            if start < end {
+                buf[start - index..end - index].copy_from_slice(&sector.data[start - sector.index as usize..end - sector.index as usize]);
+            }
+        }
+    }
+
+    /// Write every patched sector out to FLASH, in address order, under a single exclusive lock.
+    /// Sectors that fail to write are kept, so that the flush can be retried.
+    pub fn flush(&mut self, spinor: &mut Spinor, region: &[u8]) -> Result<(), SpinorError> {
+        spinor.acquire_exclusive()?;
+        let mut ret = Ok(());
+        loop {
+            let next = self.sectors.iter().enumerate()
+                .filter_map(|(slot, s)| s.as_ref().map(|s| (slot, s.index)))
+                .min_by_key(|&(_, index)| index);
+            let slot = match next {
+                Some((slot, _)) => slot,
+                None => break,
+            };
+            ret = Self::write_back(spinor, region, self.region_base, self.sectors[slot].as_ref().unwrap());
+            if ret.is_err() {
+                break;
+            }
+            self.sectors[slot] = None;
+        }
+        spinor.release_exclusive();
+        ret
+    }
+
+    /// Drop every patch that hasn't been written out yet. FLASH is left as it was at the last
+    /// flush or eviction.
+    pub fn discard(&mut self) {
+        self.sectors = Default::default();
+    }
+
+    /// Number of cached sectors with patches that haven't been written out yet
+    pub fn pending(&self) -> usize {
+        self.sectors.iter().flatten().filter(|s| s.dirty.start < s.dirty.end).count()
+    }
+
+    /// Find the slot holding the sector at `index`, loading it into a free slot, or the least
+    /// recently used one, if it isn't there.
+    fn slot_for(&mut self, spinor: &mut Spinor, region: &[u8], index: u32) -> Result<usize, SpinorError> {
+        self.clock = self.clock.wrapping_add(1);
+        if let Some(slot) = self.sectors.iter().position(|s| s.as_ref().map(|s| s.index) == Some(index)) {
+            self.sectors[slot].as_mut().unwrap().used = self.clock;
+            return Ok(slot);
+        }
+        let slot = match self.sectors.iter().position(|s| s.is_none()) {
+            Some(slot) => slot,
+            None => {
+                let clock = self.clock;
+                let (slot, _) = self.sectors.iter().enumerate()
+                    .max_by_key(|(_, s)| clock.wrapping_sub(s.as_ref().unwrap().used))
+                    .unwrap();
+                spinor.acquire_exclusive()?;
+                let ret = Self::write_back(spinor, region, self.region_base, self.sectors[slot].as_ref().unwrap());
+                spinor.release_exclusive();
+                ret?;
+                slot
+            }
+        };
+        let mut data = [0u8; SPINOR_ERASE_SIZE as usize];
+        data.copy_from_slice(&region[index as usize..(index + SPINOR_ERASE_SIZE) as usize]);
+        self.sectors[slot] = Some(CachedSector {
+            index,
+            data,
+            dirty: 0..0,
+            used: self.clock,
+        });
+        Ok(slot)
+    }
+
+    /// Write one sector out to FLASH. The caller must hold the exclusive lock.
+    fn write_back(spinor: &mut Spinor, region: &[u8], region_base: u32, sector: &CachedSector) -> Result<(), SpinorError> {
+        let flash = &region[sector.index as usize..(sector.index + SPINOR_ERASE_SIZE) as usize];
+        // narrow the dirty range down to the bytes that actually changed
+        let dirty = sector.dirty.clone();
+        let first = match dirty.clone().find(|&i| sector.data[i] != flash[i]) {
+            Some(i) => i,
+            None => return Ok(()),
+        };
+        let last = dirty.rev().find(|&i| sector.data[i] != flash[i]).unwrap();
+        // the DDR interface transfers two bytes at a time
+        let start = first & !1;
+        let end = (last + 2) & !1;
+
+        let mut wr = WriteRegion {
+            id: spinor.token,
+            start: 0,
+            data: [0xFF; 4096],
+            len: 0,
+            result: None,
+            clean_patch: false,
+        };
+        // Only bytes that are still erased can be programmed without an erase: the part keeps ECC
+        // over each programmed chunk, so programming over existing data isn't allowed even if it
+        // would only clear bits.
+        if flash[start..end].iter().all(|&b| b == 0xFF) {
+            wr.clean_patch = true;
+            wr.start = region_base + sector.index + start as u32;
+            wr.len = (end - start) as u32;
+            wr.data[..end - start].copy_from_slice(&sector.data[start..end]);
+        } else {
+            wr.start = region_base + sector.index;
+            wr.len = SPINOR_ERASE_SIZE;
+            wr.data.copy_from_slice(&sector.data);
+        }
+        spinor.send_write_region(&wr)
+    }
+}
+
+impl Drop for WriteCache {
+    fn drop(&mut self) {
+        let pending = self.pending();
+        if pending == 0 {
+            return;
+        }
+        // panicking again while already unwinding would abort and hide the first panic
+        if unwinding() {
+            log::error!("WriteCache dropped during a panic with {} unflushed sectors", pending);
+            return;
+        }
+        panic!("WriteCache dropped with {} unflushed sectors: flush() or discard() it first", pending);
+    }
+}
+
+#[cfg(not(all(target_os = "none", not(test))))]
+fn unwinding() -> bool {
+    std::thread::panicking()
+}
+#[cfg(all(target_os = "none", not(test)))]
+fn unwinding() -> bool {
+    false
+}
+
+/// A read-only mapping of part of FLASH into this process.
+///
+/// FLASH is memory mapped, so once a partition is mapped it can be read directly -- font
+/// lookups, image verification and so on -- without a message per chunk. Each partition can only
+/// be mapped by one process at a time; the kernel refuses a second mapping of the same pages.
+/// The mapping can be handed to `Spinor::patch()` or `WriteCache` as the `region`, with `base()`
+/// as the `region_base`.
+pub struct FlashMapping {
+    range: xous::MemoryRange,
+    base: u32,
+    len: usize,
+}
+
+impl FlashMapping {
+    /// Map one of the named FLASH partitions
+    pub fn new(partition: FlashPartition) -> Result<Self, SpinorError> {
+        let (base, len) = partition.bounds();
+        FlashMapping::new_range(base, len)
+    }
+
+    /// Map `len` bytes of FLASH starting at `base`, given as an offset from the base of FLASH.
+    /// `base` must be page aligned; `len` is rounded up to a whole number of pages.
+    pub fn new_range(base: u32, len: u32) -> Result<Self, SpinorError> {
+        if (base & 0xFFF) != 0 {
+            return Err(SpinorError::AlignmentError);
+        }
+        let map_len = ((len as usize) + 0xFFF) & !0xFFF;
+        // stay within the FLASH device itself, the same bound the server puts on writes
+        if map_len == 0 || (base as usize).checked_add(map_len).map_or(true, |end| end > SPINOR_SIZE_BYTES as usize) {
+            return Err(SpinorError::InvalidRequest);
+        }
+        #[cfg(target_os = "none")]
+        let range = xous::syscall::map_memory(
+            xous::MemoryAddress::new((xous::FLASH_PHYS_BASE + base) as usize),
+            None,
+            map_len,
+            xous::MemoryFlags::R,
+        ).or(Err(SpinorError::AccessDenied))?;
+        // hosted mode has no FLASH to map, so hand back a blank one
+        #[cfg(not(target_os = "none"))]
+        let range = {
+            let range = xous::syscall::map_memory(
+                None,
+                None,
+                map_len,
+                xous::MemoryFlags::R | xous::MemoryFlags::W,
+            ).or(Err(SpinorError::AccessDenied))?;
+            for byte in range.as_slice_mut::<u8>().iter_mut() {
+                *byte = 0xFF;
+            }
+            range
+        };
+        Ok(FlashMapping {
+            range,
+            base,
+            len: len as usize,
+        })
+    }
+
+    /// Offset of the mapping from the base of FLASH
+    pub fn base(&self) -> u32 {
+        self.base
+    }
+
+    /// The mapped contents of FLASH
+    pub fn as_slice(&self) -> &[u8] {
+        &self.range.as_slice::<u8>()[..self.len]
+    }
+
+    /// Copy `buf.len()` bytes starting at `index` within the mapping into `buf`
+    pub fn read(&self, index: u32, buf: &mut [u8]) -> Result<(), SpinorError> {
+        let index = index as usize;
+        match index.checked_add(buf.len()) {
+            Some(end) if end <= self.len => {
+                buf.copy_from_slice(&self.as_slice()[index..end]);
+                Ok(())
+            }
+            _ => Err(SpinorError::InvalidRequest),
+        }
+    }
+}
+
+impl Drop for FlashMapping {
+    fn drop(&mut self) {
+        xous::syscall::unmap_memory(self.range).expect("couldn't unmap FLASH");
+    }
+}
+
 use core::{sync::atomic::{AtomicU32, Ordering}, u8};
+#[cfg(test)]
+static EMU_ERASES: AtomicU32 = AtomicU32::new(0);
 static REFCOUNT: AtomicU32 = AtomicU32::new(0);
 #[cfg(not(test))]
 impl Drop for Spinor {
@@ -384,6 +712,16 @@ mod tests {
         }
     }
 
+    #[test]
+    fn test_mapping_bounds() {
+        // these are all refused before anything is mapped
+        assert!(matches!(FlashMapping::new_range(SPINOR_SIZE_BYTES, 0x1000), Err(SpinorError::InvalidRequest)));
+        assert!(matches!(FlashMapping::new_range(SPINOR_SIZE_BYTES - 0x1000, 0x1001), Err(SpinorError::InvalidRequest)));
+        assert!(matches!(FlashMapping::new_range(0, SPINOR_SIZE_BYTES + 1), Err(SpinorError::InvalidRequest)));
+        assert!(matches!(FlashMapping::new_range(0xFFFF_F000, 0x1000), Err(SpinorError::InvalidRequest)));
+        assert!(matches!(FlashMapping::new_range(0x800, 0x1000), Err(SpinorError::AlignmentError)));
+    }
+
     fn init_emu_flash(sectors: usize) {
         EMU_FLASH.lock().unwrap().clear();
         for _ in 0..sectors * 4096 {
@@ -646,4 +984,135 @@ mod tests {
         print!("{:x?}", &EMU_FLASH.lock().unwrap()[0x207C..0x2084]);
     }
 
-}
\ No newline at end of file
+
+    #[test]
+    fn test_cache_coalesce() {
+        let mut spinor = Spinor::new();
+        init_emu_flash(8);
+        flash_fill_rand();
+        let mut flash_orig = Vec::<u8>::new();
+        flash_orig.extend(EMU_FLASH.lock().unwrap().as_slice().iter().copied());
+
+        let region_base = 0x1000;
+        let region = &flash_orig[region_base as usize .. (region_base + 0x1000 * 4) as usize];
+        let mut cache = WriteCache::new(region_base).unwrap();
+
+        // several small, odd-sized and overlapping patches, two of which straddle a sector boundary
+        EMU_ERASES.store(0, Ordering::Relaxed);
+        let mut expected = flash_orig.clone();
+        let patches: [(u32, usize, u8); 5] = [(0x10, 3, 0x11), (0x12, 8, 0x22), (0xFFE, 5, 0x33), (0x800, 1, 0x44), (0x1FF0, 0x20, 0x55)];
+        for &(index, len, value) in patches.iter() {
+            let data = vec![value; len];
+            cache.patch(&mut spinor, region, &data, index).unwrap();
+            for byte in expected[(region_base + index) as usize..(region_base + index) as usize + len].iter_mut() {
+                *byte = value;
+            }
+        }
+        // nothing reaches FLASH until the flush, but reads see the patches
+        assert!(EMU_ERASES.load(Ordering::Relaxed) == 0, "cache wrote through before the flush");
+        let mut readback = [0u8; 0x40];
+        cache.read(region, 0xFE0, &mut readback);
+        assert!(readback[..] == expected[0x1FE0..0x2020], "read did not see cached data");
+
+        cache.flush(&mut spinor, region).unwrap();
+        assert!(EMU_ERASES.load(Ordering::Relaxed) == 3, "expected one erase per sector touched, got {}", EMU_ERASES.load(Ordering::Relaxed));
+        for (addr, (&patched, &exp)) in EMU_FLASH.lock().unwrap().iter().zip(expected.iter()).enumerate() {
+            assert!(patched == exp, "bad data after flush: {:08x} : e.{:02x} a.{:02x}", addr, exp, patched);
+        }
+    }
+
+    #[test]
+    fn test_cache_skips_erase() {
+        let mut spinor = Spinor::new();
+        init_emu_flash(8);
+        flash_fill_rand();
+        // leave an erased hole in the middle of a sector of data
+        for byte in EMU_FLASH.lock().unwrap()[0x2100..0x2300].iter_mut() {
+            *byte = 0xFF;
+        }
+        let mut flash_orig = Vec::<u8>::new();
+        flash_orig.extend(EMU_FLASH.lock().unwrap().as_slice().iter().copied());
+
+        let region_base = 0x1000;
+        let region = &flash_orig[region_base as usize .. (region_base + 0x1000 * 4) as usize];
+        let mut cache = WriteCache::new(region_base).unwrap();
+
+        EMU_ERASES.store(0, Ordering::Relaxed);
+        cache.patch(&mut spinor, region, &[1, 2, 3], 0x1101).unwrap();
+        cache.patch(&mut spinor, region, &[4, 5], 0x1200).unwrap();
+        cache.flush(&mut spinor, region).unwrap();
+        assert!(EMU_ERASES.load(Ordering::Relaxed) == 0, "patch into erased space should not erase");
+        for (addr, (&patched, &orig)) in EMU_FLASH.lock().unwrap().iter().zip(flash_orig.iter()).enumerate() {
+            match addr {
+                0x2101 => assert!(patched == 1),
+                0x2102 => assert!(patched == 2),
+                0x2103 => assert!(patched == 3),
+                0x2200 => assert!(patched == 4),
+                0x2201 => assert!(patched == 5),
+                _ => assert!(patched == orig, "data disturbed: {:08x} : e.{:02x} a.{:02x}", addr, orig, patched),
+            }
+        }
+    }
+
+    #[test]
+    #[should_panic(expected = "unflushed sectors")]
+    fn test_cache_drop_unflushed() {
+        let mut spinor = Spinor::new();
+        init_emu_flash(2);
+        let flash_orig = EMU_FLASH.lock().unwrap().clone();
+        let mut cache = WriteCache::new(0).unwrap();
+        cache.patch(&mut spinor, &flash_orig, &[1, 2, 3, 4], 0x10).unwrap();
+        assert!(cache.pending() == 1);
+        drop(cache);
+    }
+
+    #[test]
+    fn test_cache_drop_clean() {
+        let mut spinor = Spinor::new();
+        init_emu_flash(2);
+        let flash_orig = EMU_FLASH.lock().unwrap().clone();
+
+        // a flushed cache drops quietly
+        let mut cache = WriteCache::new(0).unwrap();
+        cache.patch(&mut spinor, &flash_orig, &[1, 2, 3, 4], 0x10).unwrap();
+        cache.flush(&mut spinor, &flash_orig).unwrap();
+        assert!(cache.pending() == 0);
+        drop(cache);
+
+        // and so does one whose patches were discarded, which leaves FLASH alone
+        let flashed = EMU_FLASH.lock().unwrap().clone();
+        let mut cache = WriteCache::new(0).unwrap();
+        cache.patch(&mut spinor, &flashed, &[5, 6], 0x1000).unwrap();
+        cache.discard();
+        drop(cache);
+        assert!(*EMU_FLASH.lock().unwrap() == flashed, "discarded patches reached FLASH");
+    }
+
+    #[test]
+    fn test_cache_evict() {
+        let mut spinor = Spinor::new();
+        init_emu_flash(WRITE_CACHE_SECTORS + 2);
+        flash_fill_rand();
+        let mut flash_orig = Vec::<u8>::new();
+        flash_orig.extend(EMU_FLASH.lock().unwrap().as_slice().iter().copied());
+
+        let region = &flash_orig[..];
+        let mut cache = WriteCache::new(0).unwrap();
+        // touch one more sector than the cache holds; the first one is written back to make room
+        EMU_ERASES.store(0, Ordering::Relaxed);
+        for sector in 0..WRITE_CACHE_SECTORS as u32 + 1 {
+            cache.patch(&mut spinor, region, &[sector as u8; 16], sector * SPINOR_ERASE_SIZE + 0x40).unwrap();
+        }
+        assert!(EMU_ERASES.load(Ordering::Relaxed) == 1, "expected the oldest sector to be evicted");
+        cache.flush(&mut spinor, region).unwrap();
+        assert!(EMU_ERASES.load(Ordering::Relaxed) == WRITE_CACHE_SECTORS as u32 + 1);
+        for (addr, (&patched, &orig)) in EMU_FLASH.lock().unwrap().iter().zip(flash_orig.iter()).enumerate() {
+            let offset = addr as u32 % SPINOR_ERASE_SIZE;
+            if (offset >= 0x40) && (offset < 0x50) && (addr as u32) < (WRITE_CACHE_SECTORS as u32 + 1) * SPINOR_ERASE_SIZE {
+                assert!(patched == (addr as u32 / SPINOR_ERASE_SIZE) as u8, "data was not patched: {:08x}", addr);
+            } else {
+                assert!(patched == orig, "data disturbed: {:08x} : e.{:02x} a.{:02x}", addr, orig, patched);
+            }
+        }
+    }
+}
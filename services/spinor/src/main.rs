@@ -483,7 +483,7 @@ fn susres_thread(sid0: usize, sid1: usize, sid2: usize, sid3: usize) {
 
     // register a suspend/resume listener
     let sr_cid = xous::connect(susres_sid).expect("couldn't create suspend callback connection");
-    let mut susres = susres::Susres::new(&xns, api::SusResOps::SuspendResume as u32, sr_cid).expect("couldn't create suspend/resume object");
+    let mut susres = susres::Susres::new(None, &xns, api::SusResOps::SuspendResume as u32, sr_cid).expect("couldn't create suspend/resume object");
 
     let main_cid = xns.request_connection_blocking(api::SERVER_NAME_SPINOR).expect("couldn't connect to our main thread for susres coordination");
 
@@ -506,6 +506,7 @@ fn susres_thread(sid0: usize, sid1: usize, sid2: usize, sid3: usize) {
                 }
                 xous::send_message(main_cid,
                     xous::Message::new_blocking_scalar(Opcode::ResumeInner.to_usize().unwrap(), 0, 0, 0, 0)).expect("couldn't send suspend message");
+                susres.resumed().expect("couldn't report resume");
                 SUSPEND_PENDING.store(false, Ordering::Relaxed);
             }),
             Some(SusResOps::Quit) => {
@@ -40,11 +40,28 @@ pub(crate) enum Opcode {
     Quit,
 }
 
+/// When a server is told about a suspend, relative to the other servers.
+///
+/// Servers in the same group are told at the same time and prepare concurrently;
+/// the next group is told once everyone in the previous group is ready. Resume
+/// runs in the opposite order, so a `Late` server is let go before the `Normal`
+/// and `Early` ones. Put servers that others depend on, or that the user is
+/// looking at, in a later group; put slow drivers that nobody waits on early.
+#[derive(num_derive::FromPrimitive, num_derive::ToPrimitive, Debug, Copy, Clone, PartialEq, Eq, PartialOrd, Ord)]
+pub enum SuspendOrder {
+    Early = 0,
+    Normal = 1,
+    Late = 2,
+    Last = 3,
+}
+pub(crate) const SUSPEND_ORDERS: usize = 4;
+
 #[derive(Debug, rkyv::Archive, rkyv::Serialize, rkyv::Deserialize, Copy, Clone)]
 pub(crate) struct ScalarHook {
     pub sid: (u32, u32, u32, u32),
     pub id: u32,  // ID of the scalar message to send through (e.g. the discriminant of the Enum on the caller's side API)
     pub cid: xous::CID,   // caller-side connection ID for the scalar message to route to. Created by the caller before hooking.
+    pub order: u32, // the `SuspendOrder` of the caller
 }
 
 #[derive(Debug, num_derive::FromPrimitive, num_derive::ToPrimitive)]
@@ -55,7 +72,16 @@ pub(crate) enum SuspendEventCallback {
 
 #[derive(num_derive::FromPrimitive, num_derive::ToPrimitive, Debug)]
 pub(crate) enum ExecGateOpcode {
+    /// blocks the caller until resume; arg1 is the caller's `SuspendOrder`
     SuspendingNow,
+    /// from the main loop: the low-level resume is done, start letting callers through,
+    /// one group at a time
+    Resume,
+    /// from a server that has finished resuming; arg1 is its `SuspendOrder`. The next group
+    /// is let through once everyone in the current one has sent this.
+    Resumed,
+    /// from the gate timer: the group let through as arg1 has had long enough to resume
+    GroupTimeout,
     Drop,
 }
 
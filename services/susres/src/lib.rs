@@ -15,13 +15,19 @@ pub struct Susres {
     conn: CID,
     suspend_cb_sid: Option<xous::SID>,
     execution_gate_conn: CID,
+    order: SuspendOrder,
 }
 impl Susres {
+    /// Subscribe to suspend events. `order` picks when this server hears about a suspend
+    /// relative to the others (see `SuspendOrder`); `None` is the same as `SuspendOrder::Normal`.
     #[cfg(target_os = "none")]
-    pub fn new(xns: &xous_names::XousNames, cb_discriminant: u32, cid: CID) -> Result<Self, xous::Error> {
+    pub fn new(order: Option<SuspendOrder>, xns: &xous_names::XousNames, cb_discriminant: u32, cid: CID) -> Result<Self, xous::Error> {
+        let order = order.unwrap_or(SuspendOrder::Normal);
         REFCOUNT.store(REFCOUNT.load(Ordering::Relaxed) + 1, Ordering::Relaxed);
-        let conn = xns.request_connection_blocking(api::SERVER_NAME_SUSRES).expect("Can't connect to SUSRES");
-        let execution_gate_conn = xns.request_connection_blocking(api::SERVER_NAME_EXEC_GATE).expect("Can't connect to the execution gate");
+        let mut cids: [CID; 2] = [0; 2];
+        xns.request_connections_blocking(&[api::SERVER_NAME_SUSRES, api::SERVER_NAME_EXEC_GATE], &mut cids)
+            .expect("Can't connect to SUSRES and the execution gate");
+        let (conn, execution_gate_conn) = (cids[0], cids[1]);
 
         let sid = xous::create_server().unwrap();
         let sid_tuple = sid.to_u32();
@@ -30,6 +36,7 @@ impl Susres {
             sid: sid_tuple,
             id: cb_discriminant,
             cid,
+            order: order.to_u32().unwrap(),
         };
         let buf = Buffer::into_buf(hookdata).or(Err(xous::Error::InternalError))?;
         buf.lend(conn, Opcode::SuspendEventSubscribe.to_u32().unwrap())?;
@@ -38,6 +45,7 @@ impl Susres {
             conn,
             suspend_cb_sid: Some(sid),
             execution_gate_conn,
+            order,
         })
     }
     // suspend/resume is not implemented in hosted mode, and will break if you try to do it.
@@ -46,12 +54,13 @@ impl Susres {
     // different and have a lot of overhead; it seems like the system goes into a form of deadlock
     // during boot when all the hosted mode servers try to connect. This isn't an issue on real hardware.
     #[cfg(not(target_os = "none"))]
-    pub fn new(xns: &xous_names::XousNames, cb_discriminant: u32, cid: CID) -> Result<Self, xous::Error> {
+    pub fn new(order: Option<SuspendOrder>, xns: &xous_names::XousNames, cb_discriminant: u32, cid: CID) -> Result<Self, xous::Error> {
         REFCOUNT.store(REFCOUNT.load(Ordering::Relaxed) + 1, Ordering::Relaxed);
         Ok(Susres {
             conn: 0,
             suspend_cb_sid: None,
             execution_gate_conn: 0,
+            order: order.unwrap_or(SuspendOrder::Normal),
         })
     }
     pub fn conn(&self) -> CID { self.conn }
@@ -63,6 +72,7 @@ impl Susres {
             conn,
             suspend_cb_sid: None,
             execution_gate_conn: 0,
+            order: SuspendOrder::Normal,
         })
     }
 
@@ -85,7 +95,7 @@ impl Susres {
         log::trace!("blocking until suspend");
         // now block until we've resumed
         send_message(self.execution_gate_conn,
-            Message::new_blocking_scalar(ExecGateOpcode::SuspendingNow.to_usize().unwrap(), 0, 0, 0, 0)
+            Message::new_blocking_scalar(ExecGateOpcode::SuspendingNow.to_usize().unwrap(), self.order.to_usize().unwrap(), 0, 0, 0)
         ).map(|_|())?;
 
         let response = send_message(self.conn,
@@ -102,6 +112,18 @@ impl Susres {
         }
     }
 
+    /// Report that this server has finished restoring its state after `suspend_until_resume()`
+    /// returned. Servers are let out of the execution gate one group at a time, and the next
+    /// group goes once everyone in this one has reported in, or after a short timeout.
+    pub fn resumed(&self) -> Result<(), xous::Error> {
+        if self.execution_gate_conn == 0 { // hosted mode, or created without a hook
+            return Ok(())
+        }
+        send_message(self.execution_gate_conn,
+            Message::new_scalar(ExecGateOpcode::Resumed.to_usize().unwrap(), self.order.to_usize().unwrap(), 0, 0, 0)
+        ).map(|_|())
+    }
+
     pub fn set_suspendable(&mut self, allow_suspend: bool) -> Result<(), xous::Error> {
         if allow_suspend {
             send_message(self.conn,
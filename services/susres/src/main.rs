@@ -6,7 +6,7 @@
 mod murmur3;
 
 mod api;
-use api::{Opcode, ScalarHook, SuspendEventCallback, ExecGateOpcode};
+use api::{Opcode, ScalarHook, SuspendEventCallback, ExecGateOpcode, SuspendOrder, SUSPEND_ORDERS};
 
 use num_traits::{ToPrimitive, FromPrimitive};
 use xous_ipc::Buffer;
@@ -209,6 +209,11 @@ mod implementation {
                 xous::Message::new_scalar(crate::TimeoutOpcode::SetCsr.to_usize().unwrap(), self.csr.base as usize, 0, 0, 0)
             ).map(|_| ())
         }
+        pub fn setup_gate_timer_csr(&mut self, cid: xous::CID) -> Result<(), xous::Error> {
+            xous::send_message(cid,
+                xous::Message::new_scalar(crate::GateTimerOpcode::SetCsr.to_usize().unwrap(), self.csr.base as usize, 0, 0, 0)
+            ).map(|_| ())
+        }
 
         pub fn do_suspend(&mut self, forced: bool) {
             // allocate memory for the cache flush
@@ -419,6 +424,11 @@ mod implementation {
                 xous::Message::new_scalar(crate::TimeoutOpcode::SetCsr.to_usize().unwrap(), 0, 0, 0, 0)
             ).map(|_| ())
         }
+        pub fn setup_gate_timer_csr(&mut self, cid: xous::CID) -> Result<(), xous::Error> {
+            xous::send_message(cid,
+                xous::Message::new_scalar(crate::GateTimerOpcode::SetCsr.to_usize().unwrap(), 0, 0, 0, 0)
+            ).map(|_| ())
+        }
     }
 }
 
@@ -430,6 +440,8 @@ struct ScalarCallback {
     ready_to_suspend: bool,
     token: u32,
     failed_to_suspend: bool,
+    order: SuspendOrder,
+    event_sent: bool,
 }
 
 #[derive(Debug, num_derive::FromPrimitive, num_derive::ToPrimitive)]
@@ -497,6 +509,98 @@ pub fn timeout_thread(sid0: usize, sid1: usize, sid2: usize, sid3: usize) {
     xous::destroy_server(sid).unwrap();
 }
 
+/// How long the execution gate waits for a group to report that it has resumed before it
+/// lets the next group go anyway
+const RESUME_GROUP_TIMEOUT_MS: u32 = 50;
+/// connection from the gate timer thread to the execution gate
+static EXEC_GATE_CONN: AtomicU32 = AtomicU32::new(0);
+/// connection from the execution gate to the gate timer thread
+static GATE_TIMER_CONN: AtomicU32 = AtomicU32::new(0);
+
+#[derive(Debug, num_derive::FromPrimitive, num_derive::ToPrimitive)]
+enum GateTimerOpcode {
+    SetCsr,
+    /// wait for `RESUME_GROUP_TIMEOUT_MS`, then send `GroupTimeout` with arg1 to the gate
+    Run,
+    Drop,
+}
+
+/// Tells the execution gate when a resuming group has had long enough to report back. Like
+/// the timeout thread, this keeps time with the susres timer: the ticktimer is resumed by the
+/// gate, so it can't be used to time the gate.
+pub fn gate_timer_thread(sid0: usize, sid1: usize, sid2: usize, sid3: usize) {
+    let sid = xous::SID::from_u32(sid0 as u32, sid1 as u32, sid2 as u32, sid3 as u32);
+    #[cfg(target_os = "none")]
+    use utralib::generated::*;
+    #[cfg(target_os = "none")]
+    let mut csr: Option<CSR::<u32>> = None;
+    loop {
+        let msg = xous::receive_message(sid).unwrap();
+        match FromPrimitive::from_usize(msg.body.id()) {
+            #[cfg(target_os = "none")]
+            Some(GateTimerOpcode::SetCsr) => msg_scalar_unpack!(msg, base, _, _, _, {
+                csr = Some(CSR::new(base as *mut u32));
+            }),
+            #[cfg(not(target_os = "none"))]
+            Some(GateTimerOpcode::SetCsr) => msg_scalar_unpack!(msg, _base, _, _, _, {
+                // ignore the opcode in hosted mode
+            }),
+            Some(GateTimerOpcode::Run) => msg_scalar_unpack!(msg, epoch, _, _, _, {
+                #[cfg(target_os = "none")]
+                {
+                    fn get_hw_time(hw: CSR::<u32>) -> u64 {
+                        hw.r(utra::susres::TIME0) as u64 | ((hw.r(utra::susres::TIME1) as u64) << 32)
+                    }
+                    if let Some(hw) = csr {
+                        let now = get_hw_time(hw);
+                        while ((get_hw_time(hw) - now) as u32) < RESUME_GROUP_TIMEOUT_MS {
+                            xous::yield_slice();
+                        }
+                    } else {
+                        panic!("hardware CSR not sent to gate_timer_thread before it was instructed to run");
+                    }
+                }
+                match send_message(EXEC_GATE_CONN.load(Ordering::Relaxed),
+                    Message::new_scalar(ExecGateOpcode::GroupTimeout.to_usize().unwrap(), epoch, 0, 0, 0)
+                ) {
+                    Err(xous::Error::ServerNotFound) => break,
+                    Ok(xous::Result::Ok) => {},
+                    _ => panic!("unhandled error in gate timer thread")
+                }
+            }),
+            Some(GateTimerOpcode::Drop) => {
+                break
+            }
+            None => {
+                log::error!("received unknown opcode in gate_timer_thread!");
+            }
+        }
+    }
+    xous::destroy_server(sid).unwrap();
+}
+
+/// Let the next group of gated callers through, in the reverse of the order they were
+/// suspended in, and start timing how long they take to report back. Returns the group
+/// and the number of callers let through, or `None` once the gate is empty.
+fn release_group(gated: &mut [Option<(xous::MessageSender, usize)>; 32], epoch: &mut usize) -> Option<(usize, usize)> {
+    let order = gated.iter().flatten().map(|&(_, order)| order).max()?;
+    let mut released = 0;
+    for slot in gated.iter_mut() {
+        if let Some((sender, slot_order)) = *slot {
+            if slot_order == order {
+                xous::return_scalar(sender, 0).expect("couldn't return dummy message to unblock execution");
+                *slot = None;
+                released += 1;
+            }
+        }
+    }
+    *epoch += 1;
+    send_message(GATE_TIMER_CONN.load(Ordering::Relaxed),
+        Message::new_scalar(GateTimerOpcode::Run.to_usize().unwrap(), *epoch, 0, 0, 0)
+    ).expect("couldn't start the gate timer");
+    Some((order, released))
+}
+
 static SHOULD_RESUME: AtomicBool = AtomicBool::new(false);
 static RESUME_EXEC: AtomicBool = AtomicBool::new(false);
 pub fn execution_gate() {
@@ -504,18 +608,49 @@ pub fn execution_gate() {
     let execgate_sid = xns.register_name(api::SERVER_NAME_EXEC_GATE, None).expect("can't register execution gate");
     log::trace!("execution_gate registered with NS -- {:?}", execgate_sid);
 
+    // callers held at the gate, along with their suspend order
+    let mut gated: [Option<(xous::MessageSender, usize)>; 32] = [None; 32];
+    // the group that was let through last, and how many of it have yet to report back
+    let mut resuming: Option<(usize, usize)> = None;
+    // counts groups let through, so a timer for a group that has already reported back is ignored
+    let mut epoch: usize = 0;
     loop {
         let msg = xous::receive_message(execgate_sid).unwrap();
         match FromPrimitive::from_usize(msg.body.id()) {
             // the entire purpose of SupendingNow is to block the thread that sent the message, until we're ready to resume.
-            Some(ExecGateOpcode::SuspendingNow) => msg_blocking_scalar_unpack!(msg, _, _, _, _, {
+            Some(ExecGateOpcode::SuspendingNow) => msg_blocking_scalar_unpack!(msg, order, _, _, _, {
                 println!("checking exec gate:");
-                while !RESUME_EXEC.load(Ordering::Relaxed) {
+                if RESUME_EXEC.load(Ordering::Relaxed) {
+                    // the resume already happened before this caller made it to the gate
+                    xous::return_scalar(msg.sender, 0).expect("couldn't return dummy message to unblock execution");
+                } else if let Some(slot) = gated.iter_mut().find(|slot| slot.is_none()) {
                     println!("execution gate active");
-                    xous::yield_slice();
+                    *slot = Some((msg.sender, order.min(SUSPEND_ORDERS - 1)));
+                } else {
+                    log::error!("ran out of space at the execution gate, letting the caller through");
+                    xous::return_scalar(msg.sender, 0).expect("couldn't return dummy message to unblock execution");
                 }
+            }),
+            Some(ExecGateOpcode::Resume) => {
                 println!("execution is ungated!");
-                xous::return_scalar(msg.sender, 0).expect("couldn't return dummy message to unblock execution");
+                resuming = release_group(&mut gated, &mut epoch);
+            }
+            Some(ExecGateOpcode::Resumed) => msg_scalar_unpack!(msg, order, _, _, _, {
+                match resuming {
+                    Some((group, waiting)) if group == order && waiting > 1 => resuming = Some((group, waiting - 1)),
+                    // the whole group is back up, so the next one can go
+                    Some((group, _)) if group == order => resuming = release_group(&mut gated, &mut epoch),
+                    // someone that was let straight through, or was already given up on
+                    _ => {}
+                }
+            }),
+            Some(ExecGateOpcode::GroupTimeout) => msg_scalar_unpack!(msg, timer_epoch, _, _, _, {
+                if let Some((group, waiting)) = resuming {
+                    if timer_epoch == epoch {
+                        log::warn!("{} servers in suspend group {} didn't report back from resume in time, moving on", waiting, group);
+                        resuming = release_group(&mut gated, &mut epoch);
+                    }
+                }
             }),
             Some(ExecGateOpcode::Drop) => {
                 break;
@@ -525,6 +660,9 @@ pub fn execution_gate() {
             }
         }
     }
+    send_message(GATE_TIMER_CONN.load(Ordering::Relaxed),
+        Message::new_scalar(GateTimerOpcode::Drop.to_usize().unwrap(), 0, 0, 0, 0)
+    ).ok();
     xous::destroy_server(execgate_sid).unwrap();
 }
 
@@ -550,6 +688,7 @@ fn xmain() -> ! {
     // unlimited connections allowed
     let susres_sid = xns.register_name(api::SERVER_NAME_SUSRES, None).expect("can't register server");
     log::trace!("main loop registered with NS -- {:?}", susres_sid);
+    let execgate_conn = xns.request_connection_blocking(api::SERVER_NAME_EXEC_GATE).expect("can't connect to the execution gate");
 
     // make a connection for the timeout thread to wake us up
     let timeout_incoming_conn = xous::connect(susres_sid).unwrap();
@@ -561,6 +700,15 @@ fn xmain() -> ! {
     let timeout_outgoing_conn = xous::connect(timeout_sid).expect("couldn't connect to our timeout thread");
     susres_hw.setup_timeout_csr(timeout_outgoing_conn).expect("couldn't set hardware CSR for timeout thread");
 
+    // and one more for the execution gate to time each group as it resumes
+    EXEC_GATE_CONN.store(execgate_conn, Ordering::Relaxed);
+    let gate_timer_sid = xous::create_server().unwrap();
+    let (sid0, sid1, sid2, sid3) = gate_timer_sid.to_u32();
+    xous::create_thread_4(gate_timer_thread, sid0 as usize, sid1 as usize, sid2 as usize, sid3 as usize).expect("couldn't create gate timer thread");
+    let gate_timer_conn = xous::connect(gate_timer_sid).expect("couldn't connect to the gate timer thread");
+    susres_hw.setup_gate_timer_csr(gate_timer_conn).expect("couldn't set hardware CSR for gate timer thread");
+    GATE_TIMER_CONN.store(gate_timer_conn, Ordering::Relaxed);
+
     let mut suspend_requested = false;
     let mut timeout_pending = false;
     let mut reboot_requested: bool = false;
@@ -614,16 +762,10 @@ fn xmain() -> ! {
                         scb.ready_to_suspend = true;
                         suspend_subscribers[token] = Some(scb);
 
-                        let mut all_ready = true;
-                        for maybe_sub in suspend_subscribers.iter() {
-                            if let Some(sub) = maybe_sub {
-                                if sub.ready_to_suspend == false {
-                                    all_ready = false;
-                                    break;
-                                }
-                            };
-                        }
-                        if all_ready {
+                        // once everyone who has been told is ready, move on to the next group
+                        let group_ready = suspend_subscribers.iter().flatten()
+                            .all(|sub| sub.ready_to_suspend || !sub.event_sent);
+                        if group_ready && !send_event(&mut suspend_subscribers) {
                             log::trace!("all callbacks reporting in, doing suspend");
                             timeout_pending = false;
                             susres_hw.do_suspend(false);
@@ -635,7 +777,7 @@ fn xmain() -> ! {
                             }
                             // this now allows all other threads to commence
                             log::trace!("low-level resume done, restoring execution");
-                            RESUME_EXEC.store(true, Ordering::Relaxed);
+                            release_execution_gate(execgate_conn);
                         } else {
                             log::trace!("still waiting on callbacks, returning to main loop");
                         }
@@ -654,6 +796,7 @@ fn xmain() -> ! {
                             if let Some(sub) = maybe_sub {
                                 sub.ready_to_suspend = false;
                                 sub.failed_to_suspend = false;
+                                sub.event_sent = false;
                             };
                         }
                         // do we want to start the timeout before or after sending the notifications? hmm. 🤔
@@ -662,7 +805,7 @@ fn xmain() -> ! {
                             Message::new_scalar(TimeoutOpcode::Run.to_usize().unwrap(), 0, 0, 0, 0)
                         ).expect("couldn't initiate timeout before suspend!");
 
-                        send_event(&suspend_subscribers);
+                        send_event(&mut suspend_subscribers);
                     }
                     // denied requests just silently fail.
                 },
@@ -686,7 +829,7 @@ fn xmain() -> ! {
                         } else {
                             log::error!("We forced a suspend, but the bootloader is claiming we did a clean suspend. Internal state may be inconsistent.");
                         }
-                        RESUME_EXEC.store(true, Ordering::Relaxed);
+                        release_execution_gate(execgate_conn);
                     } else {
                         log::trace!("clean suspend timeout received, ignoring");
                         // this means we did a clean suspend, we've resumed, and the timeout came back after the resume
@@ -743,6 +886,8 @@ fn do_hook(hookdata: ScalarHook, cb_conns: &mut [Option<ScalarCallback>; 32]) {
         ready_to_suspend: false,
         token: 0,
         failed_to_suspend: false,
+        order: FromPrimitive::from_u32(hookdata.order).unwrap_or(SuspendOrder::Normal),
+        event_sent: false,
     };
     for i in 0..cb_conns.len() {
         if cb_conns[i].is_none() {
@@ -764,13 +909,31 @@ fn unhook(cb_conns: &mut [Option<ScalarCallback>; 32]) {
         *entry = None;
     }
 }
-fn send_event(cb_conns: &[Option<ScalarCallback>; 32]) {
-    for entry in cb_conns.iter() {
+/// Send the suspend event to the earliest group of subscribers that hasn't heard about it yet.
+/// Returns `false` once every subscriber has been told.
+fn send_event(cb_conns: &mut [Option<ScalarCallback>; 32]) -> bool {
+    let order = match cb_conns.iter().flatten().filter(|scb| !scb.event_sent).map(|scb| scb.order).min() {
+        Some(order) => order,
+        None => return false,
+    };
+    log::trace!("sending suspend event to {:?} subscribers", order);
+    for entry in cb_conns.iter_mut() {
         if let Some(scb) = entry {
+            if scb.event_sent || scb.order != order {
+                continue;
+            }
             xous::send_message(scb.server_to_cb_cid,
                 xous::Message::new_scalar(SuspendEventCallback::Event.to_usize().unwrap(),
                    scb.cb_to_client_cid as usize, scb.cb_to_client_id as usize, scb.token as usize, 0)
             ).unwrap();
+            scb.event_sent = true;
         };
     }
+    true
+}
+fn release_execution_gate(execgate_conn: CID) {
+    RESUME_EXEC.store(true, Ordering::Relaxed);
+    send_message(execgate_conn,
+        Message::new_scalar(ExecGateOpcode::Resume.to_usize().unwrap(), 0, 0, 0, 0)
+    ).expect("couldn't release the execution gate");
 }
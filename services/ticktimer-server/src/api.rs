@@ -3,7 +3,7 @@ pub(crate) enum Opcode {
     /// Get the elapsed time in milliseconds
     ElapsedMs = 0,
 
-    /// Sleep for the specified numer of milliseconds
+    /// Sleep for the specified numer of milliseconds, give or take an optional slack
     SleepMs = 1,
 
     /// Recalculate the sleep time
@@ -14,4 +14,20 @@ pub(crate) enum Opcode {
 
     /// force a WDT update
     PingWdt = 4,
+
+    /// Allocate a timer owned by the calling process
+    TimerCreate = 5,
+
+    /// (Re)arm a timer with a delay, an optional period and a slack. Returns 0, or the
+    /// `xous::Error` that kept the timer from starting
+    TimerStart = 6,
+
+    /// Block until a timer expires
+    TimerWait = 7,
+
+    /// Stop a timer without freeing it
+    TimerCancel = 8,
+
+    /// Stop and free a timer
+    TimerFree = 9,
 }
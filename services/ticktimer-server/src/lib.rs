@@ -19,6 +19,15 @@ impl Ticktimer {
     }
 
     /// note special case for elapsed_ms() is "infalliable". it really should never fail so get rid of the Error
+    ///
+    /// On hardware the count is read straight from the ticktimer, which the kernel maps into
+    /// every process, so this doesn't send a message at all.
+    #[cfg(any(target_os = "none", target_os = "xous"))]
+    pub fn elapsed_ms(&self) -> u64 {
+        xous::arch::elapsed_ms()
+    }
+
+    #[cfg(not(any(target_os = "none", target_os = "xous")))]
     pub fn elapsed_ms(&self) -> u64 {
         let response = send_message(self.conn,
             xous::Message::new_blocking_scalar(api::Opcode::ElapsedMs.to_usize().unwrap(),
@@ -31,12 +40,39 @@ impl Ticktimer {
         }
     }
 
+    /// Sleep for `ms` milliseconds. Use `sleep_ms_slack()` instead if the wakeup can be late,
+    /// so that it can share an interrupt with other wakeups.
     pub fn sleep_ms(&self, ms: usize) -> Result<(), Error> {
-        send_message(self.conn,
+        self.sleep_ms_slack(ms, 0)
+    }
+
+    /// Sleep for at least `ms` milliseconds, and at most about `ms + slack_ms`. The wakeup is
+    /// rounded up to a multiple of the largest power of two no bigger than `slack_ms`, so that
+    /// it can share an interrupt with other wakeups. A `slack_ms` of 0 wakes up as close to
+    /// `ms` as possible.
+    pub fn sleep_ms_slack(&self, ms: usize, slack_ms: usize) -> Result<(), Error> {
+        let response = send_message(self.conn,
             xous::Message::new_blocking_scalar(api::Opcode::SleepMs.to_usize().unwrap(),
                  ms,
-                 0, 0, 0)
-        ).map(|_| ())
+                 slack_ms, 0, 0)
+        )?;
+        match response {
+            // the server had no room to queue the sleep
+            xous::Result::Scalar1(result) if result != 0 => Err(Error::OutOfMemory),
+            _ => Ok(()),
+        }
+    }
+
+    /// Create a timer that can be started, restarted, cancelled and waited on
+    pub fn timer(&self) -> Result<Timer, Error> {
+        let response = send_message(self.conn,
+            xous::Message::new_blocking_scalar(api::Opcode::TimerCreate.to_usize().unwrap(), 0, 0, 0, 0)
+        )?;
+        match response {
+            xous::Result::Scalar1(handle) if handle != 0 => Ok(Timer { conn: self.conn, handle }),
+            xous::Result::Scalar1(_) => Err(Error::OutOfMemory),
+            _ => Err(Error::InternalError),
+        }
     }
 
     pub fn ping_wdt(&self) {
@@ -45,6 +81,63 @@ impl Ticktimer {
         ).expect("Couldn't send WDT ping");
     }
 }
+/// A timer kept by the ticktimer server on behalf of this process. Dropping it frees the timer.
+#[derive(Debug)]
+pub struct Timer {
+    conn: CID,
+    handle: usize,
+}
+impl Timer {
+    /// Start the timer so that it expires after `ms` milliseconds, and then every `period_ms`
+    /// after that if `period_ms` is not 0. `slack_ms` works as it does for `sleep_ms_slack()`.
+    /// Starting a timer that is already running restarts it.
+    ///
+    /// # Errors
+    ///
+    /// * **BadAddress**: The server doesn't know this timer
+    /// * **OutOfMemory**: The server had no room to queue the timer
+    pub fn start(&self, ms: usize, period_ms: usize, slack_ms: usize) -> Result<(), Error> {
+        let response = send_message(self.conn,
+            xous::Message::new_blocking_scalar(api::Opcode::TimerStart.to_usize().unwrap(),
+                self.handle, ms, period_ms, slack_ms)
+        )?;
+        match response {
+            xous::Result::Scalar1(0) => Ok(()),
+            xous::Result::Scalar1(error) => Err(Error::from_usize(error)),
+            _ => Err(Error::InternalError),
+        }
+    }
+
+    /// Block until the timer expires. Returns the number of times it has expired since the
+    /// last call, which is more than 1 if a periodic timer wasn't waited on in time, or 0 if
+    /// the timer was cancelled or isn't running.
+    pub fn wait(&self) -> Result<usize, Error> {
+        let response = send_message(self.conn,
+            xous::Message::new_blocking_scalar(api::Opcode::TimerWait.to_usize().unwrap(),
+                self.handle, 0, 0, 0)
+        )?;
+        match response {
+            xous::Result::Scalar1(expirations) => Ok(expirations),
+            _ => Err(Error::InternalError),
+        }
+    }
+
+    /// Stop the timer. A thread blocked in `wait()` returns 0.
+    pub fn cancel(&self) -> Result<(), Error> {
+        send_message(self.conn,
+            xous::Message::new_blocking_scalar(api::Opcode::TimerCancel.to_usize().unwrap(),
+                self.handle, 0, 0, 0)
+        ).map(|_| ())
+    }
+}
+impl Drop for Timer {
+    fn drop(&mut self) {
+        send_message(self.conn,
+            xous::Message::new_scalar(api::Opcode::TimerFree.to_usize().unwrap(), self.handle, 0, 0, 0)
+        ).ok();
+    }
+}
+
 use core::sync::atomic::{AtomicU32, Ordering};
 static REFCOUNT: AtomicU32 = AtomicU32::new(0);
 impl Drop for Ticktimer {
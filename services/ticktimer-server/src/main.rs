@@ -5,62 +5,19 @@
 
 mod api;
 
-use heapless::binary_heap::{BinaryHeap, Min};
+mod wheel;
+use wheel::{apply_slack, TimerWheel};
 
 use log::{error, info};
 
-#[derive(Eq)]
-pub struct SleepRequest {
-    msec: i64,
-    sender: xous::MessageSender,
-}
-
-impl core::fmt::Display for SleepRequest {
-    fn fmt(&self, f: &mut core::fmt::Formatter<'_>) -> core::fmt::Result {
-        write!(f, "SleepRequest {{ msec: {}, {} }}", self.msec, self.sender)
-    }
-}
-
-impl core::fmt::Debug for SleepRequest {
-    fn fmt(&self, f: &mut core::fmt::Formatter<'_>) -> core::fmt::Result {
-        write!(f, "SleepRequest {{ msec: {}, {} }}", self.msec, self.sender)
-    }
-}
-
-impl core::cmp::Ord for SleepRequest {
-    fn cmp(&self, other: &Self) -> core::cmp::Ordering {
-        if self.msec < other.msec {
-            core::cmp::Ordering::Less
-        } else if self.msec > other.msec {
-            core::cmp::Ordering::Greater
-        } else {
-            self.sender.cmp(&other.sender)
-        }
-    }
-}
-
-impl core::cmp::PartialOrd for SleepRequest {
-    fn partial_cmp(&self, other: &Self) -> Option<core::cmp::Ordering> {
-        Some(self.cmp(other))
-    }
-}
-
-impl core::cmp::PartialEq for SleepRequest {
-    fn eq(&self, other: &Self) -> bool {
-        self.msec == other.msec && self.sender == other.sender
-    }
-}
-
 #[cfg(target_os = "none")]
 mod implementation {
     const TICKS_PER_MS: u64 = 1;
-    use super::SleepRequest;
     use utralib::generated::*;
     use susres::{RegManager, RegOrField, SuspendResume};
 
     pub struct XousTickTimer {
         csr: utralib::CSR<u32>,
-        current_response: Option<SleepRequest>,
         connection: xous::CID,
         ticktimer_sr_manager: RegManager::<{utra::ticktimer::TICKTIMER_NUMREGS}>,
         wdt_sr_manager: RegManager::<{utra::wdt::WDT_NUMREGS}>,
@@ -95,12 +52,6 @@ mod implementation {
         let xtt = unsafe { &mut *(arg as *mut XousTickTimer) };
         // println!("In IRQ, connection: {}", xtt.connection);
 
-        // Safe because we're in an interrupt, and this interrupt is only
-        // enabled when this value is not None.
-        let response = xtt.current_response.take().unwrap();
-
-        xous::return_scalar(response.sender, 0).expect("couldn't send response");
-
         // Disable the timer
         xtt.csr.wfo(utra::ticktimer::EV_ENABLE_ALARM, 0);
         xtt.csr.wfo(utra::ticktimer::EV_PENDING_ALARM, 1);
@@ -139,7 +90,6 @@ mod implementation {
 
             let mut xtt = XousTickTimer {
                 csr: CSR::new(csr.as_mut_ptr() as *mut u32),
-                current_response: None,
                 connection,
                 ticktimer_sr_manager,
                 wdt_sr_manager,
@@ -202,43 +152,21 @@ mod implementation {
             self.raw_ticktime() / TICKS_PER_MS
         }
 
-        pub fn stop_interrupt(&mut self) -> Option<SleepRequest> {
+        pub fn stop_interrupt(&mut self) {
             // Disable the timer
             self.csr.wfo(utra::ticktimer::EV_ENABLE_ALARM, 0);
-
-            // Now that the interrupt is disabled, we can see if the interrupt handler has a current response.
-            // If it exists, then that means that an interrupt did NOT fire, and an existing interrupt
-            // is in place.
-            if let Some(sr) = self.current_response.take() {
-                #[cfg(feature = "debug-print")]
-                {
-                    log::info!(
-                        "Stopping currently-running timer sr.msec: {}  elapsed_ms: {}",
-                        sr.msec,
-                        self.elapsed_ms()
-                    );
-                }
-                Some(sr)
-            } else {
-                None
-            }
         }
 
-        pub fn schedule_response(&mut self, request: SleepRequest) {
-            let irq_target = request.msec;
+        pub fn schedule_interrupt(&mut self, irq_target: i64) {
             log::trace!(
-                "setting a response at {} ms (current time: {} ms)",
+                "setting an interrupt at {} ms (current time: {} ms)",
                 irq_target,
                 self.elapsed_ms()
             );
 
-            // Disable the timer interrupt
-            assert!(self.csr.rf(utra::ticktimer::EV_ENABLE_ALARM) == 0);
+            // Disable the timer interrupt while the target is changed
             self.csr.wfo(utra::ticktimer::EV_ENABLE_ALARM, 0);
 
-            // Save a copy of the current sleep request
-            self.current_response = Some(request);
-
             // Set the new target time
             self.csr
                 .wo(utra::ticktimer::MSLEEP_TARGET1, (irq_target >> 32) as _);
@@ -304,32 +232,27 @@ mod implementation {
 
 #[cfg(not(target_os = "none"))]
 mod implementation {
-    use super::SleepRequest;
     use std::convert::TryInto;
     use num_traits::ToPrimitive;
 
     #[derive(Debug)]
     enum SleepComms {
-        InterruptSleep,
-        StartSleep(
-            xous::MessageSender,
-            i64, /* ms */
+        StopInterrupt,
+        ScheduleInterrupt(
+            i64, /* irq_target */
             u64, /* elapsed */
         ),
     }
     pub struct XousTickTimer {
         start: std::time::Instant,
         sleep_comms: std::sync::mpsc::Sender<SleepComms>,
-        time_remaining_receiver: std::sync::mpsc::Receiver<Option<SleepRequest>>,
     }
 
     impl XousTickTimer {
         pub fn new(cid: xous::CID) -> XousTickTimer {
             let (sleep_sender, sleep_receiver) = std::sync::mpsc::channel();
-            let (time_remaining_sender, time_remaining_receiver) = std::sync::mpsc::channel();
             xous::create_thread(move || {
                 let mut timeout = None;
-                let mut current_response: Option<SleepRequest> = None;
                 loop {
                     let result = match timeout {
                         None => sleep_receiver
@@ -339,13 +262,8 @@ mod implementation {
                     };
                     match result {
                         Err(std::sync::mpsc::RecvTimeoutError::Timeout) => {
-                            let sender = current_response.take().unwrap().sender;
-                            #[cfg(feature = "debug-print")]
-                            log::info!("Returning scalar to {}", sender);
-                            xous::return_scalar(sender, 0).expect("couldn't send response");
-
-                            // This is dangerous and may panic if the queue is full.
-                            xous::try_send_message(
+                            // The "interrupt" fired, so get the server to look at its timers.
+                            xous::send_message(
                                 cid,
                                 xous::Message::Scalar(xous::ScalarMessage {
                                     id: crate::api::Opcode::RecalculateSleep.to_usize().unwrap(),
@@ -358,35 +276,16 @@ mod implementation {
                         Err(std::sync::mpsc::RecvTimeoutError::Disconnected) => {
                             return;
                         }
-                        Ok(SleepComms::InterruptSleep) => {
+                        Ok(SleepComms::StopInterrupt) => {
                             timeout = None;
-                            time_remaining_sender.send(current_response.take()).unwrap()
                         }
-                        Ok(SleepComms::StartSleep(new_sender, expiry, elapsed)) => {
-                            let mut duration = expiry - (elapsed as i64);
-                            if duration > 0 {
-                                #[cfg(feature = "debug-print")]
-                                log::info!(
-                                    "Starting sleep for {} ms, returning to {}",
-                                    duration,
-                                    new_sender
-                                );
-                            } else {
-                                #[cfg(feature = "debug-print")]
-                                log::info!(
-                                    "Clamping duration to 0 (was: {})m returning to {}",
-                                    duration,
-                                    new_sender
-                                );
-                                duration = 0;
-                            }
+                        Ok(SleepComms::ScheduleInterrupt(irq_target, elapsed)) => {
+                            let duration = (irq_target - (elapsed as i64)).max(0);
+                            #[cfg(feature = "debug-print")]
+                            log::info!("Starting sleep for {} ms", duration);
                             timeout = Some(std::time::Duration::from_millis(
                                 duration.try_into().unwrap(),
                             ));
-                            current_response = Some(SleepRequest {
-                                sender: new_sender,
-                                msec: expiry,
-                            });
                         }
                     }
                 }
@@ -395,7 +294,6 @@ mod implementation {
 
             XousTickTimer {
                 start: std::time::Instant::now(),
-                time_remaining_receiver,
                 sleep_comms: sleep_sender,
             }
         }
@@ -408,25 +306,19 @@ mod implementation {
             self.start.elapsed().as_millis().try_into().unwrap()
         }
 
-        pub fn stop_interrupt(&mut self) -> Option<SleepRequest> {
-            self.sleep_comms.send(SleepComms::InterruptSleep).unwrap();
-            self.time_remaining_receiver.recv().unwrap()
+        pub fn stop_interrupt(&mut self) {
+            self.sleep_comms.send(SleepComms::StopInterrupt).unwrap();
         }
 
-        pub fn schedule_response(&mut self, request: SleepRequest) {
+        pub fn schedule_interrupt(&mut self, irq_target: i64) {
             #[cfg(feature = "debug-print")]
             log::info!(
-                "request.msec: {}  self.elapsed_ms: {}  returning to: {}",
-                request.msec,
+                "irq_target: {}  self.elapsed_ms: {}",
+                irq_target,
                 self.elapsed_ms(),
-                request.sender
             );
             self.sleep_comms
-                .send(SleepComms::StartSleep(
-                    request.sender,
-                    request.msec as i64,
-                    self.elapsed_ms(),
-                ))
+                .send(SleepComms::ScheduleInterrupt(irq_target, self.elapsed_ms()))
                 .unwrap();
         }
 
@@ -447,53 +339,197 @@ mod implementation {
 
 use implementation::*;
 
-fn recalculate_sleep(
-    ticktimer: &mut XousTickTimer,
-    sleep_heap: &mut BinaryHeap<SleepRequest, Min, 64>,
-    new: Option<SleepRequest>,
-) {
-    // If there's a sleep request ongoing now, grab it.
-    if let Some(current) = ticktimer.stop_interrupt() {
-        #[cfg(feature = "debug-print")]
-        info!("Existing request was {:?}", current);
-        sleep_heap.push(current).expect("couldn't push to heap")
-    } else {
-        #[cfg(feature = "debug-print")]
-        info!("There was no existing request");
+/// Maximum number of timers that can be allocated with `TimerCreate`
+const MAX_TIMERS: usize = 32;
+
+/// What to do when an entry in the timer wheel expires
+#[derive(Clone, Copy, Debug)]
+enum Wakeup {
+    /// Return from a `SleepMs` call
+    Sleep(xous::MessageSender),
+    /// Fire the timer with this index
+    Timer(usize),
+}
+
+#[derive(Clone, Copy)]
+struct Timer {
+    owner: Option<xous::PID>,
+    /// The timer's entry in the wheel, if it's running
+    key: Option<u16>,
+    /// When the timer is next due, before slack is applied
+    deadline: i64,
+    /// Time between expirations, or 0 for a one-shot timer
+    period: i64,
+    slack: i64,
+    /// Expirations that haven't been collected with `TimerWait` yet
+    expirations: usize,
+    /// A thread blocked in `TimerWait`
+    waiter: Option<xous::MessageSender>,
+}
+
+/// Timers are freed when their owner drops them. Nothing tells this server when a process
+/// exits, so a timer that is still allocated at that point stays allocated. This is
+/// intended: services don't exit while the system is running, and a process that later
+/// gets the same PID can't reach the timer without its handle, so at worst `MAX_TIMERS`
+/// slots are lost.
+struct TimerServer {
+    wheel: TimerWheel<Wakeup>,
+    timers: [Option<Timer>; MAX_TIMERS],
+    /// Bumped whenever a timer slot is freed, so that stale handles can be told apart
+    generation: [usize; MAX_TIMERS],
+    /// The time the hardware alarm is currently set for
+    armed: Option<i64>,
+}
+
+impl TimerServer {
+    fn new(now: i64) -> Self {
+        TimerServer {
+            wheel: TimerWheel::new(now),
+            timers: [None; MAX_TIMERS],
+            generation: [0; MAX_TIMERS],
+            armed: None,
+        }
+    }
+
+    fn handle(&self, index: usize) -> usize {
+        (self.generation[index] << 8) | (index + 1)
     }
 
-    // If we have a new sleep request, add it to the heap.
-    if let Some(mut request) = new {
-        #[cfg(feature = "debug-print")]
-        info!("New sleep request was: {:?}", request);
-
-        request.msec += ticktimer.elapsed_ms() as i64;
-
-        #[cfg(feature = "debug-print")]
-        info!("Modified, the request was: {:?}", request);
-        sleep_heap
-            .push(request)
-            .expect("couldn't push new sleep to heap");
-    } else {
-        #[cfg(feature = "debug-print")]
-        info!("No new sleep request");
+    /// Look up the timer that `handle` refers to, if it belongs to `sender`
+    fn lookup(&self, handle: usize, sender: xous::MessageSender) -> Option<usize> {
+        let index = (handle & 0xFF).checked_sub(1)?;
+        if index >= MAX_TIMERS || self.handle(index) != handle {
+            return None;
+        }
+        match self.timers[index] {
+            Some(timer) if timer.owner == sender.pid() => Some(index),
+            _ => None,
+        }
     }
 
-    // If there are items in the sleep heap, take the next item that will expire.
-    if let Some(next_response) = sleep_heap.pop() {
-        #[cfg(feature = "debug-print")]
-        info!(
-            "scheduling a response at {} to {} (heap: {:?})",
-            next_response.msec, next_response.sender, sleep_heap
-        );
-        ticktimer.schedule_response(next_response);
+    /// Queue a wakeup for `sender` after `ms`, returning `false` if there's no room for it
+    fn sleep(&mut self, now: i64, ms: i64, slack: i64, sender: xous::MessageSender) -> bool {
+        let deadline = apply_slack(now + ms, slack);
+        if deadline <= now {
+            xous::return_scalar(sender, 0).expect("couldn't return sleep");
+            return true;
+        }
+        self.wheel.insert(deadline, Wakeup::Sleep(sender)).is_some()
+    }
+
+    fn create(&mut self, sender: xous::MessageSender) -> usize {
+        match self.timers.iter().position(|t| t.is_none()) {
+            Some(index) => {
+                self.timers[index] = Some(Timer {
+                    owner: sender.pid(),
+                    key: None,
+                    deadline: 0,
+                    period: 0,
+                    slack: 0,
+                    expirations: 0,
+                    waiter: None,
+                });
+                self.handle(index)
+            }
+            None => 0,
+        }
+    }
+
+    /// Stop a timer, releasing anyone waiting on it
+    fn cancel(&mut self, index: usize) {
+        let timer = self.timers[index].as_mut().unwrap();
+        if let Some(key) = timer.key.take() {
+            self.wheel.cancel(key);
+        }
+        timer.expirations = 0;
+        if let Some(waiter) = timer.waiter.take() {
+            xous::return_scalar(waiter, 0).expect("couldn't release timer waiter");
+        }
+    }
+
+    fn start(&mut self, index: usize, now: i64, delay: i64, period: i64, slack: i64) -> bool {
+        self.cancel(index);
+        let timer = self.timers[index].as_mut().unwrap();
+        timer.deadline = now + delay;
+        timer.period = period;
+        timer.slack = slack;
+        timer.key = self.wheel.insert(apply_slack(timer.deadline, slack), Wakeup::Timer(index));
+        timer.key.is_some()
+    }
+
+    fn wait(&mut self, index: usize, sender: xous::MessageSender) {
+        let timer = self.timers[index].as_mut().unwrap();
+        if timer.expirations != 0 {
+            xous::return_scalar(sender, timer.expirations).expect("couldn't return timer expirations");
+            timer.expirations = 0;
+        } else if timer.key.is_none() || timer.waiter.is_some() {
+            // nothing is going to wake this caller up
+            xous::return_scalar(sender, 0).expect("couldn't return timer wait");
+        } else {
+            timer.waiter = Some(sender);
+        }
+    }
+
+    fn free(&mut self, index: usize) {
+        self.cancel(index);
+        self.timers[index] = None;
+        self.generation[index] = (self.generation[index] + 1) & 0xFF_FFFF;
+    }
+
+    fn fire(&mut self, now: i64, wakeup: Wakeup) {
+        match wakeup {
+            Wakeup::Sleep(sender) => {
+                xous::return_scalar(sender, 0).expect("couldn't send response");
+            }
+            Wakeup::Timer(index) => {
+                let timer = self.timers[index].as_mut().unwrap();
+                timer.key = None;
+                timer.expirations += 1;
+                if timer.period != 0 {
+                    // count any periods that were missed, rather than firing them back-to-back
+                    let mut next = timer.deadline + timer.period;
+                    if next <= now {
+                        let missed = (now - next) / timer.period + 1;
+                        timer.expirations += missed as usize;
+                        next += missed * timer.period;
+                    }
+                    timer.deadline = next;
+                    timer.key = self.wheel.insert(apply_slack(next, timer.slack), Wakeup::Timer(index));
+                    if timer.key.is_none() {
+                        error!("no room to re-arm periodic timer {}", index);
+                    }
+                }
+                if let Some(waiter) = timer.waiter.take() {
+                    xous::return_scalar(waiter, timer.expirations).expect("couldn't return timer expirations");
+                    timer.expirations = 0;
+                }
+            }
+        }
+    }
+
+    /// Fire everything that is due, and point the hardware alarm at whatever is due next. The
+    /// alarm is only touched if that time changed, so most requests don't disturb it.
+    fn service(&mut self, ticktimer: &mut XousTickTimer) {
+        let now = ticktimer.elapsed_ms() as i64;
+        self.wheel.expire(now);
+        while let Some(wakeup) = self.wheel.pop_due() {
+            #[cfg(feature = "debug-print")]
+            info!("firing {:?} at {}", wakeup, now);
+            self.fire(now, wakeup);
+        }
+        let next = self.wheel.next_event();
+        if next != self.armed {
+            match next {
+                Some(irq_target) => ticktimer.schedule_interrupt(irq_target),
+                None => ticktimer.stop_interrupt(),
+            }
+            self.armed = next;
+        }
     }
 }
 
 #[xous::xous_main]
 fn xmain() -> ! {
-    let mut sleep_heap: BinaryHeap<SleepRequest, Min, 64> = BinaryHeap::new();
-
     log_server::init_wait().unwrap();
     log::set_max_level(log::LevelFilter::Info);
     info!("my PID is {}", xous::process::id());
@@ -509,11 +545,12 @@ fn xmain() -> ! {
     // Create a new ticktimer object
     let mut ticktimer = XousTickTimer::new(ticktimer_client);
     ticktimer.reset(); // make sure the time starts from zero
+    let mut timers = TimerServer::new(ticktimer.elapsed_ms() as i64);
 
     // register a suspend/resume listener
     let xns = xous_names::XousNames::new().unwrap();
     let sr_cid = xous::connect(ticktimer_server).expect("couldn't create suspend callback connection");
-    let mut susres = susres::Susres::new(&xns, api::Opcode::SuspendResume as u32, sr_cid).expect("couldn't create suspend/resume object");
+    let mut susres = susres::Susres::new(Some(susres::SuspendOrder::Last), &xns, api::Opcode::SuspendResume as u32, sr_cid).expect("couldn't create suspend/resume object");
 
     loop {
         #[cfg(feature = "watchdog")]
@@ -533,23 +570,57 @@ fn xmain() -> ! {
                 )
                 .expect("couldn't return time request");
             }
-            Some(api::Opcode::SleepMs) => xous::msg_blocking_scalar_unpack!(msg, ms, _, _, _, {
-                    recalculate_sleep(
-                        &mut ticktimer,
-                        &mut sleep_heap,
-                        Some(SleepRequest {
-                            msec: ms as i64,
-                            sender: msg.sender,
-                        }),
-                    )
+            Some(api::Opcode::SleepMs) => xous::msg_blocking_scalar_unpack!(msg, ms, slack, _, _, {
+                let now = ticktimer.elapsed_ms() as i64;
+                if !timers.sleep(now, ms as i64, slack as i64, msg.sender) {
+                    error!("too many sleepers, refusing a sleep of {} ms", ms);
+                    xous::return_scalar(msg.sender, 1).expect("couldn't refuse sleep");
+                }
             }),
             Some(api::Opcode::RecalculateSleep) => {
-                recalculate_sleep(&mut ticktimer, &mut sleep_heap, None);
+                // the alarm fired; the timers are serviced below
+                timers.armed = None;
             },
+            Some(api::Opcode::TimerCreate) => xous::msg_blocking_scalar_unpack!(msg, _, _, _, _, {
+                let handle = timers.create(msg.sender);
+                xous::return_scalar(msg.sender, handle).expect("couldn't return timer handle");
+            }),
+            Some(api::Opcode::TimerStart) => xous::msg_blocking_scalar_unpack!(msg, handle, delay, period, slack, {
+                let result = match timers.lookup(handle, msg.sender) {
+                    Some(index) => {
+                        if timers.start(index, ticktimer.elapsed_ms() as i64, delay as i64, period as i64, slack as i64) {
+                            xous::Error::NoError
+                        } else {
+                            xous::Error::OutOfMemory
+                        }
+                    }
+                    None => xous::Error::BadAddress,
+                };
+                xous::return_scalar(msg.sender, result.to_usize()).expect("couldn't return timer start");
+            }),
+            Some(api::Opcode::TimerWait) => xous::msg_blocking_scalar_unpack!(msg, handle, _, _, _, {
+                match timers.lookup(handle, msg.sender) {
+                    Some(index) => timers.wait(index, msg.sender),
+                    None => xous::return_scalar(msg.sender, 0).expect("couldn't return timer wait"),
+                }
+            }),
+            Some(api::Opcode::TimerCancel) => xous::msg_blocking_scalar_unpack!(msg, handle, _, _, _, {
+                let found = timers.lookup(handle, msg.sender);
+                if let Some(index) = found {
+                    timers.cancel(index);
+                }
+                xous::return_scalar(msg.sender, found.is_some() as usize).expect("couldn't return timer cancel");
+            }),
+            Some(api::Opcode::TimerFree) => xous::msg_scalar_unpack!(msg, handle, _, _, _, {
+                if let Some(index) = timers.lookup(handle, msg.sender) {
+                    timers.free(index);
+                }
+            }),
             Some(api::Opcode::SuspendResume) => xous::msg_scalar_unpack!(msg, token, _, _, _, {
                 ticktimer.suspend();
                 susres.suspend_until_resume(token).expect("couldn't execute suspend/resume");
                 ticktimer.resume();
+                susres.resumed().expect("couldn't report resume");
             }),
             Some(api::Opcode::PingWdt) => {
                 ticktimer.reset_wdt();
@@ -559,6 +630,7 @@ fn xmain() -> ! {
                 break
             }
         }
+        timers.service(&mut ticktimer);
     }
     // clean up our program
     log::trace!("main loop exit, destroying servers");
@@ -0,0 +1,352 @@
+//! A hierarchical timer wheel.
+//!
+//! Each level has `WHEEL_SLOTS` slots, and each slot on a level covers
+//! `WHEEL_SLOTS` times as much time as a slot on the level below it. A timer
+//! is placed on the lowest level whose span reaches its deadline, and moves
+//! down a level ("cascades") when the wheel gets close enough to it. Level 0
+//! slots are one millisecond wide, so by the time a timer reaches level 0 it
+//! is sorted exactly.
+//!
+//! Inserting and cancelling are O(1). Timers live in a fixed pool and are
+//! linked into their slots by index, so no allocator is needed. Each level
+//! keeps a bitmap of which slots are occupied, which lets the wheel jump
+//! straight to the next slot that needs attention instead of stepping through
+//! every millisecond in between.
+
+const WHEEL_BITS: u32 = 6;
+const WHEEL_SLOTS: usize = 1 << WHEEL_BITS;
+const WHEEL_LEVELS: usize = 4;
+
+/// Deadlines further out than this are parked in the top level and
+/// re-sorted when they cascade, about every 4.6 hours.
+const WHEEL_HORIZON: i64 = 1 << (WHEEL_BITS * WHEEL_LEVELS as u32);
+
+/// Maximum number of timers that can be pending at once
+pub const TIMER_POOL_LEN: usize = 256;
+
+/// Marks the end of a list
+const NIL: u16 = u16::MAX;
+
+/// The list of timers that have expired but haven't been collected with `pop_due()`
+const DUE_LIST: usize = WHEEL_LEVELS * WHEEL_SLOTS;
+
+#[derive(Clone, Copy)]
+struct Entry<T: Copy> {
+    deadline: i64,
+    next: u16,
+    prev: u16,
+    /// Which list this entry is on, or `NIL` if it's free
+    list: u16,
+    payload: Option<T>,
+}
+
+pub struct TimerWheel<T: Copy> {
+    entries: [Entry<T>; TIMER_POOL_LEN],
+    free: u16,
+    /// Head of each slot's list, followed by the head of the due list
+    heads: [u16; WHEEL_LEVELS * WHEEL_SLOTS + 1],
+    occupied: [u64; WHEEL_LEVELS],
+    /// The next millisecond that has yet to be processed
+    current: i64,
+}
+
+/// Push `deadline` out so that it lands on a multiple of the largest power of
+/// two that is no bigger than `slack`. Timers with similar slack that expire
+/// close together end up with the same deadline, and share an interrupt.
+pub fn apply_slack(deadline: i64, slack: i64) -> i64 {
+    if slack <= 0 {
+        return deadline;
+    }
+    let granule = 1i64 << (63 - slack.leading_zeros());
+    (deadline + granule - 1) & !(granule - 1)
+}
+
+impl<T: Copy> TimerWheel<T> {
+    pub fn new(now: i64) -> Self {
+        let mut entries = [Entry {
+            deadline: 0,
+            next: NIL,
+            prev: NIL,
+            list: NIL,
+            payload: None,
+        }; TIMER_POOL_LEN];
+        for (index, entry) in entries.iter_mut().enumerate() {
+            entry.next = if index + 1 < TIMER_POOL_LEN { (index + 1) as u16 } else { NIL };
+        }
+        TimerWheel {
+            entries,
+            free: 0,
+            heads: [NIL; WHEEL_LEVELS * WHEEL_SLOTS + 1],
+            occupied: [0; WHEEL_LEVELS],
+            current: now,
+        }
+    }
+
+    /// Add a timer that expires at `deadline`. Returns a key that can be used to
+    /// cancel it, or `None` if the pool is exhausted.
+    pub fn insert(&mut self, deadline: i64, payload: T) -> Option<u16> {
+        let key = self.free;
+        if key == NIL {
+            return None;
+        }
+        self.free = self.entries[key as usize].next;
+        self.entries[key as usize].deadline = deadline;
+        self.entries[key as usize].payload = Some(payload);
+        self.link(key);
+        Some(key)
+    }
+
+    /// Remove a pending timer, returning its payload.
+    pub fn cancel(&mut self, key: u16) -> Option<T> {
+        if key as usize >= TIMER_POOL_LEN || self.entries[key as usize].list == NIL {
+            return None;
+        }
+        self.unlink(key);
+        self.release(key)
+    }
+
+    /// The earliest deadline of any pending timer, which is what the hardware
+    /// alarm should be set for. Timers that still have to move down a level
+    /// are moved by `expire()` on its way to that deadline, so nothing needs
+    /// to wake up just to move them.
+    pub fn next_event(&self) -> Option<i64> {
+        if self.heads[DUE_LIST] != NIL {
+            return Some(self.current);
+        }
+        // Slots on a level cover successive stretches of time, so the earliest
+        // deadline is in the first occupied slot of one of the levels.
+        let mut next: Option<i64> = None;
+        for level in 0..WHEEL_LEVELS {
+            if let Some((list, _)) = self.first_slot(level) {
+                let mut key = self.heads[list];
+                while key != NIL {
+                    let deadline = self.entries[key as usize].deadline;
+                    next = Some(next.map_or(deadline, |n| n.min(deadline)));
+                    key = self.entries[key as usize].next;
+                }
+            }
+        }
+        // a deadline that has already passed is handled on the next pass
+        next.map(|n| n.max(self.current))
+    }
+
+    /// The next occupied slot on `level`, and the time at which it needs to be
+    /// processed.
+    fn first_slot(&self, level: usize) -> Option<(usize, i64)> {
+        if self.occupied[level] == 0 {
+            return None;
+        }
+        let shift = WHEEL_BITS * level as u32;
+        // the first slot boundary at or after `current`
+        let base = (self.current + (1 << shift) - 1) >> shift;
+        let skip = self.occupied[level].rotate_right((base as usize & (WHEEL_SLOTS - 1)) as u32).trailing_zeros() as i64;
+        let when = (base + skip) << shift;
+        Some((level * WHEEL_SLOTS + ((base + skip) as usize & (WHEEL_SLOTS - 1)), when))
+    }
+
+    /// The next time at which a slot in the wheel needs to be processed.
+    fn next_slot(&self) -> Option<i64> {
+        (0..WHEEL_LEVELS)
+            .filter_map(|level| self.first_slot(level).map(|(_, when)| when))
+            .min()
+    }
+
+    /// Advance the wheel up to and including `now`, moving every timer whose
+    /// deadline has passed onto the due list.
+    pub fn expire(&mut self, now: i64) {
+        while let Some(when) = self.next_slot() {
+            if when > now {
+                break;
+            }
+            self.current = when;
+            for level in (1..WHEEL_LEVELS).rev() {
+                let shift = WHEEL_BITS * level as u32;
+                if when & ((1 << shift) - 1) == 0 {
+                    self.cascade(level * WHEEL_SLOTS + ((when >> shift) as usize & (WHEEL_SLOTS - 1)));
+                }
+            }
+            let slot = when as usize & (WHEEL_SLOTS - 1);
+            while self.heads[slot] != NIL {
+                let key = self.heads[slot];
+                self.unlink(key);
+                self.push(DUE_LIST, key);
+            }
+            self.current = when + 1;
+        }
+        if now >= self.current {
+            self.current = now + 1;
+        }
+    }
+
+    /// Take the next timer off the due list.
+    pub fn pop_due(&mut self) -> Option<T> {
+        let key = self.heads[DUE_LIST];
+        if key == NIL {
+            return None;
+        }
+        self.unlink(key);
+        self.release(key)
+    }
+
+    /// Re-sort every timer in `list` against the current time.
+    fn cascade(&mut self, list: usize) {
+        let mut key = self.heads[list];
+        self.heads[list] = NIL;
+        self.occupied[list / WHEEL_SLOTS] &= !(1 << (list % WHEEL_SLOTS));
+        while key != NIL {
+            let next = self.entries[key as usize].next;
+            self.link(key);
+            key = next;
+        }
+    }
+
+    /// Put a timer in the slot that matches its deadline.
+    fn link(&mut self, key: u16) {
+        let deadline = self.entries[key as usize].deadline;
+        let delta = deadline - self.current;
+        let (level, when) = if delta < WHEEL_SLOTS as i64 {
+            // anything that's already late goes in the slot that is processed next
+            (0, deadline.max(self.current))
+        } else if delta >= WHEEL_HORIZON {
+            (WHEEL_LEVELS - 1, self.current + WHEEL_HORIZON - 1)
+        } else {
+            let mut level = 1;
+            while delta >= 1 << (WHEEL_BITS * (level as u32 + 1)) {
+                level += 1;
+            }
+            (level, deadline)
+        };
+        let slot = (when >> (WHEEL_BITS * level as u32)) as usize & (WHEEL_SLOTS - 1);
+        self.occupied[level] |= 1 << slot;
+        self.push(level * WHEEL_SLOTS + slot, key);
+    }
+
+    fn push(&mut self, list: usize, key: u16) {
+        let head = self.heads[list];
+        let entry = &mut self.entries[key as usize];
+        entry.list = list as u16;
+        entry.prev = NIL;
+        entry.next = head;
+        if head != NIL {
+            self.entries[head as usize].prev = key;
+        }
+        self.heads[list] = key;
+    }
+
+    fn unlink(&mut self, key: u16) {
+        let Entry { next, prev, list, .. } = self.entries[key as usize];
+        let list = list as usize;
+        if prev == NIL {
+            self.heads[list] = next;
+            if next == NIL && list < DUE_LIST {
+                self.occupied[list / WHEEL_SLOTS] &= !(1 << (list % WHEEL_SLOTS));
+            }
+        } else {
+            self.entries[prev as usize].next = next;
+        }
+        if next != NIL {
+            self.entries[next as usize].prev = prev;
+        }
+        self.entries[key as usize].list = NIL;
+    }
+
+    fn release(&mut self, key: u16) -> Option<T> {
+        let entry = &mut self.entries[key as usize];
+        entry.next = self.free;
+        self.free = key;
+        entry.payload.take()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn collect(wheel: &mut TimerWheel<u32>, now: i64) -> Vec<u32> {
+        wheel.expire(now);
+        let mut due = vec![];
+        while let Some(id) = wheel.pop_due() {
+            due.push(id);
+        }
+        due.sort();
+        due
+    }
+
+    #[test]
+    fn test_expiry_order() {
+        let mut wheel = TimerWheel::new(0);
+        // spread the deadlines over every level, and past the horizon
+        let deadlines: [i64; 8] = [1, 63, 64, 65, 4095, 4097, 300_000, WHEEL_HORIZON * 2 + 7];
+        for (id, &deadline) in deadlines.iter().enumerate() {
+            wheel.insert(deadline, id as u32).unwrap();
+        }
+        // stepping to each event in turn sees every timer exactly on its deadline,
+        // and never wakes up for nothing
+        let mut fired = vec![];
+        while let Some(when) = wheel.next_event() {
+            let due = collect(&mut wheel, when);
+            assert!(!due.is_empty(), "woke up at {} with nothing due", when);
+            for id in due {
+                assert!(deadlines[id as usize] == when, "timer {} fired at {}", id, when);
+                fired.push(id);
+            }
+        }
+        assert!(fired == (0..deadlines.len() as u32).collect::<Vec<u32>>());
+    }
+
+    #[test]
+    fn test_one_wakeup_per_deadline() {
+        // a long sleep sits on a high level, and has to cascade on its way down,
+        // but the alarm only needs to go off once, at the deadline
+        for &deadline in &[1000i64, 5_000, 250_000, 2_000_000] {
+            let mut wheel = TimerWheel::new(0);
+            wheel.insert(deadline, 1).unwrap();
+            assert!(wheel.next_event() == Some(deadline), "alarm set early for {}", deadline);
+            assert!(collect(&mut wheel, deadline) == vec![1]);
+            assert!(wheel.next_event() == None);
+        }
+        // the same goes when the wheel has moved on since the timer went in
+        let mut wheel = TimerWheel::new(0);
+        wheel.insert(70_000, 1).unwrap();
+        wheel.insert(3_000, 2).unwrap();
+        assert!(collect(&mut wheel, 3_000) == vec![2]);
+        assert!(wheel.next_event() == Some(70_000));
+        assert!(collect(&mut wheel, 70_000) == vec![1]);
+    }
+
+    #[test]
+    fn test_late_expire_and_cancel() {
+        let mut wheel = TimerWheel::new(1000);
+        let keep = wheel.insert(1500, 1).unwrap();
+        let cancel = wheel.insert(1400, 2).unwrap();
+        wheel.insert(90_000, 3).unwrap();
+        assert!(wheel.cancel(cancel) == Some(2));
+        assert!(wheel.cancel(cancel) == None);
+        // a wheel that is serviced late catches up in one go
+        assert!(collect(&mut wheel, 100_000) == vec![1, 3]);
+        assert!(wheel.cancel(keep) == None);
+        assert!(wheel.next_event() == None);
+        // a deadline that has already passed is due on the next pass
+        wheel.insert(5, 4).unwrap();
+        assert!(collect(&mut wheel, 100_001) == vec![4]);
+    }
+
+    #[test]
+    fn test_pool_exhaustion() {
+        let mut wheel = TimerWheel::new(0);
+        for id in 0..TIMER_POOL_LEN as u32 {
+            wheel.insert(10 + id as i64, id).unwrap();
+        }
+        assert!(wheel.insert(10, 0).is_none());
+        assert!(collect(&mut wheel, 10).len() == 1);
+        assert!(wheel.insert(10, 0).is_some());
+    }
+
+    #[test]
+    fn test_slack() {
+        assert!(apply_slack(1001, 0) == 1001);
+        assert!(apply_slack(1001, 10) == 1008);
+        assert!(apply_slack(1008, 10) == 1008);
+        assert!(apply_slack(1003, 7) == 1004);
+    }
+}
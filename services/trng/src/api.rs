@@ -35,6 +35,8 @@ pub struct TrngErrors {
     pub nist_errs: u32,
     pub server_underruns: u16,
     pub kernel_underruns: u16,
+    /// requests that found the server's pool of entropy empty, and had to wait for the generator
+    pub pool_underruns: u16,
     pub pending_mask: u32,
 }
 
@@ -67,6 +69,9 @@ pub(crate) enum Opcode {
     /// Get Error stats
     ErrorStats,
 
+    /// Top up the entropy pool (internal API only)
+    RefillPool,
+
     Quit,
 }
 
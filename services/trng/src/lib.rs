@@ -26,6 +26,9 @@ impl Trng {
             ).expect("TRNG|LIB: can't get_u32");
         if let xous::Result::Scalar2(trng, _) = response {
             Ok(trng as u32)
+        } else if let xous::Result::Scalar1(_) = response {
+            // the generator is stuck
+            Err(xous::Error::InternalError)
         } else {
             panic!("unexpected return value: {:#?}", response);
         }
@@ -37,6 +40,9 @@ impl Trng {
         ).expect("TRNG|LIB: can't get_u32");
     if let xous::Result::Scalar2(lo, hi) = response {
             Ok( lo as u64 | ((hi as u64) << 32) )
+        } else if let xous::Result::Scalar1(_) = response {
+            // the generator is stuck
+            Err(xous::Error::InternalError)
         } else {
             panic!("unexpected return value: {:#?}", response);
         }
@@ -120,7 +126,7 @@ fn error_cb_server(sid0: usize, sid1: usize, sid2: usize, sid3: usize) {
     xous::destroy_server(sid).unwrap();
 }
 
-use rand_core::{impls, CryptoRng, RngCore};
+use rand_core::{impls, CryptoRng, RngCore, SeedableRng};
 impl CryptoRng for Trng {}
 impl RngCore for Trng {
     fn next_u32(&mut self) -> u32 {
@@ -190,3 +196,78 @@ impl RngCore for Trng {
         Ok(self.fill_bytes(dest))
     }
 }
+
+/// How many bytes a `Csprng` hands out before it takes a fresh seed from the TRNG server
+pub const CSPRNG_RESEED_INTERVAL: usize = 64 * 1024;
+
+/// A ChaCha20 generator that runs in the caller's process, seeded from the TRNG server's entropy pool.
+/// Use this when you need a lot of random data, e.g. for key generation or IVs: it costs one message to
+/// the server every `CSPRNG_RESEED_INTERVAL` bytes, where `Trng::get_u64()` costs one every 8 bytes.
+pub struct Csprng {
+    trng: Trng,
+    rng: rand_chacha::ChaCha20Rng,
+    /// bytes left to hand out before the next reseed
+    remaining: usize,
+}
+impl Csprng {
+    pub fn new(xns: &xous_names::XousNames) -> Result<Self, xous::Error> {
+        let trng = Trng::new(xns)?;
+        let rng = rand_chacha::ChaCha20Rng::from_seed(Csprng::seed(&trng)?);
+        Ok(Csprng {
+            trng,
+            rng,
+            remaining: CSPRNG_RESEED_INTERVAL,
+        })
+    }
+    /// Take a fresh seed from the TRNG server now, instead of waiting for the reseed interval to run out.
+    pub fn reseed(&mut self) -> Result<(), xous::Error> {
+        self.rng = rand_chacha::ChaCha20Rng::from_seed(Csprng::seed(&self.trng)?);
+        self.remaining = CSPRNG_RESEED_INTERVAL;
+        Ok(())
+    }
+    fn seed(trng: &Trng) -> Result<[u8; 32], xous::Error> {
+        let mut words: [u32; 8] = [0; 8];
+        trng.fill_buf(&mut words)?;
+        let mut seed: [u8; 32] = [0; 32];
+        for (&src, dst) in words.iter().zip(seed.chunks_exact_mut(4)) {
+            dst.copy_from_slice(&src.to_le_bytes());
+        }
+        Ok(seed)
+    }
+    /// account for `len` bytes of output, reseeding first if they would run past the interval.
+    /// If the reseed fails, nothing is consumed and no output should be generated.
+    fn consume(&mut self, len: usize) -> Result<(), xous::Error> {
+        if len > self.remaining {
+            self.reseed()?;
+        }
+        self.remaining -= len;
+        Ok(())
+    }
+}
+/// `rand_core::Error` can't carry a `xous::Error` without `std`, so pass it on as a custom error code
+fn rng_error(e: xous::Error) -> rand_core::Error {
+    rand_core::Error::from(core::num::NonZeroU32::new(rand_core::Error::CUSTOM_START + e.to_usize() as u32).unwrap())
+}
+impl CryptoRng for Csprng {}
+impl RngCore for Csprng {
+    // `RngCore` gives these no way to report an error, so a TRNG that can't supply a fresh seed
+    // is fatal here. Use `try_fill_bytes()` to handle it instead.
+    fn next_u32(&mut self) -> u32 {
+        self.consume(4).expect("couldn't reseed CSPRNG from TRNG server");
+        self.rng.next_u32()
+    }
+    fn next_u64(&mut self) -> u64 {
+        self.consume(8).expect("couldn't reseed CSPRNG from TRNG server");
+        self.rng.next_u64()
+    }
+    fn fill_bytes(&mut self, dest: &mut[u8]) {
+        self.try_fill_bytes(dest).expect("couldn't reseed CSPRNG from TRNG server")
+    }
+    fn try_fill_bytes(&mut self, dest: &mut[u8]) -> Result<(), rand_core::Error> {
+        for chunk in dest.chunks_mut(CSPRNG_RESEED_INTERVAL) {
+            self.consume(chunk.len()).map_err(rng_error)?;
+            self.rng.fill_bytes(chunk);
+        }
+        Ok(())
+    }
+}
@@ -17,10 +17,129 @@ struct ScalarCallback {
     cb_to_client_id: u32,
 }
 
+/// Words of entropy the server keeps ready to hand out
+const POOL_LEN: usize = 2048;
+/// Once the pool is down to this many words, a refill is queued up
+const POOL_LOW_WATER: usize = 1024;
+/// Words added to the pool by each `RefillPool` message. A refill waits behind any requests that are
+/// already queued, and keeping each one short means requests that arrive during a refill don't wait long either.
+const POOL_REFILL_CHUNK: usize = 256;
+/// Chunks in a row that may fail the repetition test before the generator is taken to be stuck, and
+/// whoever is waiting on it gets an error rather than waiting forever.
+const POOL_REFILL_RETRIES: usize = 8;
+
+/// Entropy drawn from the generator ahead of time, so that requests don't have to wait on it.
+struct Pool {
+    words: [u32; POOL_LEN],
+    len: usize,
+    /// a `RefillPool` message is in our queue
+    refill_pending: bool,
+    /// the last word drawn from the generator, for the repetition test
+    last: u32,
+    /// requests that found the pool empty, and had to wait for the generator
+    underruns: u16,
+}
+
+impl Pool {
+    fn new() -> Pool {
+        Pool {
+            words: [0; POOL_LEN],
+            len: 0,
+            refill_pending: false,
+            last: 0,
+            underruns: 0,
+        }
+    }
+
+    /// Add up to one chunk of words from the generator. Each chunk goes through a repetition count
+    /// test first: a word that is the same as the one before it means the generator has stuck, e.g.
+    /// on the zeroes it produces before its pipeline fills, and the whole chunk is thrown away.
+    /// This is on top of the health tests the hardware runs on the raw entropy.
+    fn refill(&mut self, trng: &mut implementation::Trng) -> bool {
+        let count = POOL_REFILL_CHUNK.min(POOL_LEN - self.len);
+        let chunk = &mut self.words[self.len..self.len + count];
+        trng.fill(chunk);
+        let mut last = self.last;
+        let mut healthy = true;
+        for &word in chunk.iter() {
+            healthy &= word != last;
+            last = word;
+        }
+        self.last = last;
+        if healthy {
+            self.len += count;
+        } else {
+            log::error!("TRNG output failed the repetition test, discarding {} words", count);
+        }
+        healthy
+    }
+
+    /// Refill from the generator until the pool holds at least `want` words. Returns `false` if the
+    /// generator fails the repetition test `POOL_REFILL_RETRIES` times in a row first.
+    fn refill_until(&mut self, trng: &mut implementation::Trng, want: usize) -> bool {
+        let mut failures = 0;
+        while self.len < want {
+            if self.refill(trng) {
+                failures = 0;
+            } else {
+                failures += 1;
+                if failures == POOL_REFILL_RETRIES {
+                    return false;
+                }
+            }
+        }
+        true
+    }
+
+    /// Fill `dest` from the pool, topping it up from the generator if it runs dry. Returns `false`,
+    /// with `dest` zeroed, if the generator seems to be stuck.
+    fn take(&mut self, trng: &mut implementation::Trng, dest: &mut [u32]) -> bool {
+        if self.len < dest.len() {
+            self.underruns = self.underruns.saturating_add(1);
+        }
+        let mut filled = 0;
+        while filled < dest.len() {
+            if self.len == 0 && !self.refill_until(trng, 1) {
+                log::error!("TRNG seems to be stuck, failing a request for {} words", dest.len());
+                for word in dest.iter_mut() {
+                    *word = 0;
+                }
+                return false;
+            }
+            let count = (dest.len() - filled).min(self.len);
+            dest[filled..filled + count].copy_from_slice(&self.words[self.len - count..self.len]);
+            // words are only ever handed out once
+            for word in self.words[self.len - count..self.len].iter_mut() {
+                *word = 0;
+            }
+            self.len -= count;
+            filled += count;
+        }
+        true
+    }
+
+    /// Throw out everything in the pool, e.g. because the generator reported a health test failure.
+    fn discard(&mut self) {
+        for word in self.words.iter_mut() {
+            *word = 0;
+        }
+        self.len = 0;
+    }
+
+    /// Queue up a `RefillPool` message if the pool is low and there isn't one on the way already.
+    fn schedule_refill(&mut self, self_cid: CID) {
+        if self.len < POOL_LOW_WATER && !self.refill_pending {
+            // this is our own queue, so it can't wait for space; if it's full, the next request tries again
+            self.refill_pending = xous::try_send_message(self_cid,
+                xous::Message::new_scalar(api::Opcode::RefillPool.to_usize().unwrap(), 0, 0, 0, 0)).is_ok();
+        }
+    }
+}
+
 #[cfg(target_os = "none")]
 mod implementation {
     use utralib::generated::*;
-    use crate::api::{ExcursionTest, MiniRunsTest, NistTests, HealthTests, TrngErrors, TrngBuf};
+    use crate::api::{ExcursionTest, MiniRunsTest, NistTests, HealthTests, TrngErrors};
     use susres::{RegManager, RegOrField, SuspendResume};
     use num_traits::*;
 
@@ -109,6 +228,7 @@ mod implementation {
                     ro_adaptive_errs: None,
                     kernel_underruns: 0,
                     server_underruns: 0,
+                    pool_underruns: 0,
                     nist_errs: 0,
                     pending_mask: 0,
                 },
@@ -370,12 +490,10 @@ mod implementation {
             }
         }
 
-        pub fn get_buf(&mut self, len: u16) -> TrngBuf {
-            let mut tb = TrngBuf {data: [0; 1024], len};
-            for i in 0..len as usize {
-                tb.data[i] = self.get_data_eager();
+        pub fn fill(&mut self, data: &mut [u32]) {
+            for word in data.iter_mut() {
+                *word = self.get_data_eager();
             }
-            tb
         }
 
         pub fn get_trng(&mut self, count: usize) -> [u32; 2] {
@@ -406,7 +524,7 @@ mod implementation {
 // a stub to try to avoid breaking hosted mode for as long as possible.
 #[cfg(not(target_os = "none"))]
 mod implementation {
-    use crate::api::{TrngBuf, HealthTests, TrngErrors};
+    use crate::api::{HealthTests, TrngErrors};
 
     pub struct Trng {
         seed: u32,
@@ -431,17 +549,15 @@ mod implementation {
         #[allow(dead_code)]
         pub fn wait_full(&self) { }
 
-        pub fn get_buf(&mut self, len: u16) -> TrngBuf {
+        pub fn fill(&mut self, data: &mut [u32]) {
             if self.msgcount < 3 {
                 log::info!("hosted mode TRNG is *not* random, it is a deterministic LFSR");
             }
             self.msgcount += 1;
-            let mut tb = TrngBuf {data: [0; 1024], len};
-            for i in 0..len as usize {
+            for word in data.iter_mut() {
                 self.seed = self.move_lfsr(self.seed);
-                tb.data[i] = self.seed;
+                *word = self.seed;
             }
-            tb
         }
 
         pub fn get_trng(&mut self, _count: usize) -> [u32; 2] {
@@ -473,6 +589,7 @@ mod implementation {
                 ro_adaptive_errs: None,
                 kernel_underruns: 0,
                 server_underruns: 0,
+                pool_underruns: 0,
                 nist_errs: 0,
                 pending_mask: 0,
             }
@@ -688,25 +805,50 @@ fn xmain() -> ! {
 
     // pump the TRNG hardware to clear the first number out, sometimes it is 0 due to clock-sync issues on the fifo
     trng.get_trng(2);
+    let mut pool = Pool::new();
+    if !pool.refill_until(&mut trng, POOL_LEN) {
+        // carry on, so that clients get errors back instead of hanging on a server that never started
+        log::error!("TRNG seems to be stuck, starting with {} of {} words in the pool", pool.len, POOL_LEN);
+    }
+    let self_cid = xous::connect(trng_sid).expect("couldn't create refill connection");
     log::trace!("ready to accept requests");
 
     // register a suspend/resume listener
     let sr_cid = xous::connect(trng_sid).expect("couldn't create suspend callback connection");
-    let mut susres = susres::Susres::new(&xns, api::Opcode::SuspendResume as u32, sr_cid).expect("couldn't create suspend/resume object");
+    let mut susres = susres::Susres::new(None, &xns, api::Opcode::SuspendResume as u32, sr_cid).expect("couldn't create suspend/resume object");
 
     let mut error_cb_conns: [Option<ScalarCallback>; 32] = [None; 32];
     loop {
         let mut msg = xous::receive_message(trng_sid).unwrap();
         match FromPrimitive::from_usize(msg.body.id()) {
             Some(api::Opcode::GetTrng) => xous::msg_blocking_scalar_unpack!(msg, count, _, _, _, {
-                let val: [u32; 2] = trng.get_trng(count);
-                xous::return_scalar2(msg.sender, val[0] as _, val[1] as _)
-                    .expect("couldn't return GetTrng request");
+                let mut val: [u32; 2] = [0; 2];
+                // we don't just draw down TRNGs if not requested, because they are a finite resource
+                if pool.take(&mut trng, &mut val[..count.max(1).min(2)]) {
+                    xous::return_scalar2(msg.sender, val[0] as _, val[1] as _)
+                        .expect("couldn't return GetTrng request");
+                } else {
+                    // a single scalar tells the client that there's no entropy to be had
+                    xous::return_scalar(msg.sender, 0).expect("couldn't return GetTrng request");
+                }
+                pool.schedule_refill(self_cid);
             }),
+            Some(api::Opcode::RefillPool) => {
+                pool.refill_pending = false;
+                // keep going until the pool is full, one chunk per message so requests can get in between
+                if pool.refill(&mut trng) && pool.len < POOL_LEN {
+                    pool.refill_pending = xous::try_send_message(self_cid,
+                        xous::Message::new_scalar(api::Opcode::RefillPool.to_usize().unwrap(), 0, 0, 0, 0)).is_ok();
+                }
+            },
             Some(api::Opcode::SuspendResume) => xous::msg_scalar_unpack!(msg, token, _, _, _, {
                 trng.suspend();
                 susres.suspend_until_resume(token).expect("couldn't execute suspend/resume");
                 trng.resume();
+                susres.resumed().expect("couldn't report resume");
+                // what's in the pool was made before the suspend, so start over with fresh entropy
+                pool.discard();
+                pool.schedule_refill(self_cid);
             }),
             Some(api::Opcode::ErrorSubscribe) => {
                 let buffer = unsafe { Buffer::from_memory_message(msg.body.memory_message().unwrap()) };
@@ -716,6 +858,9 @@ fn xmain() -> ! {
             Some(api::Opcode::ErrorNotification) => {
                 log::error!("Got a notification interrupt from the TRNG. Syndrome: {:?}", trng.get_errors());
                 log::error!("Stats: {:?}", trng.get_err_stats());
+                // the pool may have been filled after the failure started, so don't hand any of it out
+                pool.discard();
+                pool.schedule_refill(self_cid);
                 send_event(&error_cb_conns);
             },
             Some(api::Opcode::HealthStats) => {
@@ -724,12 +869,20 @@ fn xmain() -> ! {
             },
             Some(api::Opcode::ErrorStats) => {
                 let mut buffer = unsafe { Buffer::from_memory_message_mut(msg.body.memory_message_mut().unwrap()) };
-                buffer.replace(trng.get_errors()).unwrap();
+                let mut errors = trng.get_errors();
+                errors.pool_underruns = pool.underruns;
+                buffer.replace(errors).unwrap();
             },
             Some(api::Opcode::FillTrng) => {
                 let mut buffer = unsafe { Buffer::from_memory_message_mut(msg.body.memory_message_mut().unwrap()) };
                 let len = buffer.as_flat::<TrngBuf, _>().unwrap().len;
-                buffer.replace(trng.get_buf(len)).unwrap();
+                let mut tb = TrngBuf {data: [0; 1024], len: len.min(1024)};
+                if !pool.take(&mut trng, &mut tb.data[..tb.len as usize]) {
+                    // the client treats a short buffer as an error
+                    tb.len = 0;
+                }
+                buffer.replace(tb).unwrap();
+                pool.schedule_refill(self_cid);
             },
             Some(api::Opcode::Quit) => {
                 break
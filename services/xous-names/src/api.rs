@@ -17,6 +17,8 @@ pub(crate) enum Opcode {
     Disconnect,
     /// indicates if all inherentely trusted slots have been occupied. Should not run untrusted code until this is the case.
     TrustedInitDone,
+    /// Create connections to several target servers in one request.
+    LookupBatch,
 }
 
 #[derive(Debug, rkyv::Archive, rkyv::Serialize, rkyv::Deserialize)]
@@ -39,6 +41,21 @@ pub(crate) struct Registration {
     pub conn_limit: Option<u32>,
 }
 
+/// The most names that can be resolved by a single `LookupBatch` request
+pub const LOOKUP_BATCH_SIZE: usize = 8;
+
+#[derive(Debug, rkyv::Archive, rkyv::Serialize, rkyv::Deserialize)]
+pub(crate) struct LookupBatch {
+    /// Names of the servers to connect to. Only the first `count` are used.
+    pub names: [xous_ipc::String::<64>; LOOKUP_BATCH_SIZE],
+    pub count: u32,
+    /// Filled in by the name server in place: the connection to each server, or 0 if it couldn't be made yet
+    pub cids: [xous::CID; LOOKUP_BATCH_SIZE],
+    /// Set by the name server for single-connection servers. These are skipped, since their
+    /// disconnect token can't be returned in a batch, and have to be looked up with `Lookup`.
+    pub single: [bool; LOOKUP_BATCH_SIZE],
+}
+
 #[derive(Debug, rkyv::Archive, rkyv::Serialize, rkyv::Deserialize)]
 pub(crate) struct Disconnect {
     pub name: xous_ipc::String::<64>,
@@ -137,6 +137,66 @@ impl XousNames {
         }
     }
 
+    /// Connect to every server in `names`, waiting for any that haven't registered yet, and store
+    /// each connection in the matching entry of `cids`. Up to `api::LOOKUP_BATCH_SIZE` names are
+    /// resolved per request, which saves a round trip per server for processes that need several
+    /// connections at startup. Single-connection servers are looked up one at a time, like
+    /// `request_connection_blocking()`; use `request_connection_with_token()` if you need the
+    /// token to disconnect from one later.
+    pub fn request_connections_blocking(&self, names: &[&str], cids: &mut [xous::CID]) -> Result<(), xous::Error> {
+        assert_eq!(names.len(), cids.len(), "each name needs a slot for its connection");
+        // CID 0 is never a valid connection, so use it to mark names that are still outstanding
+        for cid in cids.iter_mut() {
+            *cid = 0;
+        }
+        loop {
+            let mut batch = api::LookupBatch {
+                names: [String::<64>::new(); api::LOOKUP_BATCH_SIZE],
+                count: 0,
+                cids: [0; api::LOOKUP_BATCH_SIZE],
+                single: [false; api::LOOKUP_BATCH_SIZE],
+            };
+            let mut requested = [0usize; api::LOOKUP_BATCH_SIZE];
+            for (index, name) in names.iter().enumerate() {
+                if cids[index] != 0 {
+                    continue;
+                }
+                if batch.count as usize == api::LOOKUP_BATCH_SIZE {
+                    break;
+                }
+                write!(batch.names[batch.count as usize], "{}", name).expect("name probably too long");
+                requested[batch.count as usize] = index;
+                batch.count += 1;
+            }
+            if batch.count == 0 {
+                return Ok(());
+            }
+
+            let mut buf = Buffer::into_buf(batch).or(Err(xous::Error::InternalError))?;
+            buf.lend_mut(
+                self.conn,
+                api::Opcode::LookupBatch.to_u32().unwrap()
+            )
+            .or(Err(xous::Error::InternalError))?;
+
+            let reply = buf.as_flat::<api::LookupBatch, _>().or(Err(xous::Error::InternalError))?;
+            let mut progress = false;
+            for i in 0..(reply.count as usize).min(api::LOOKUP_BATCH_SIZE) {
+                if reply.single[i] {
+                    cids[requested[i]] = self.request_connection_blocking(names[requested[i]])?;
+                    progress = true;
+                } else if reply.cids[i] != 0 {
+                    cids[requested[i]] = reply.cids[i];
+                    progress = true;
+                }
+            }
+            if !progress {
+                log::info!("connections to {:?} could not all be established, retrying", names);
+                xous::yield_slice();
+            }
+        }
+    }
+
     pub fn trusted_init_done(&self) -> Result<bool, xous::Error> {
         let response = xous::send_message(self.conn,
             xous::Message::new_blocking_scalar(api::Opcode::TrustedInitDone.to_usize().unwrap(), 0, 0, 0, 0)
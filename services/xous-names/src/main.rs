@@ -65,10 +65,11 @@ mod implementation {
 }
 
 /*
-SlowMap is a stand-in implementation for a HashMap from the Heapless crate that has proven to be unsafe,
-and leaking data between entries. It's called "SlowMap" because it's slow: accesses are O(N). That
-being said, it's 100% safe, and xous-names accesses are once-in-a-blue-moon type of things, so
-I'll take safety over speed in this case.
+NameTable is a fixed-capacity hash table of registered servers. It was originally a stand-in for a
+HashMap from the Heapless crate that proved to be unsafe and leaked data between entries, so rather
+than going back to Heapless it keeps its own index: entries live in a plain array, and a separate
+array of slot numbers is probed linearly using an FNV hash of the server name. Lookups only compare
+names that land in the same probe sequence, rather than every registered name.
 
 Eventually, we shall endeavor to remove Heapless entirely, once we have a `libstd` in place
 and we can use heap-allocated Rust primitives...
@@ -83,43 +84,81 @@ struct Connection {
     pub auth_conns: u32,  // number of authenticated connections
     pub token: Option<[u32; 4]>,  // a random number that must be presented to allow for disconnection for single-connection servers
 }
-struct SlowMap {
-    pub map: [Option<Connection>; 128],
+const NAME_TABLE_SIZE: usize = 128;
+// twice the number of entries, to keep probe sequences short
+const NAME_INDEX_SIZE: usize = 256;
+struct NameTable {
+    pub map: [Option<Connection>; NAME_TABLE_SIZE],
+    // slot number plus one of the entry for each hash bucket, or 0 if the bucket is empty
+    index: [u8; NAME_INDEX_SIZE],
 }
-impl SlowMap {
+impl NameTable {
     pub fn new() -> Self {
-        SlowMap {
-            map: [None; 128],
+        NameTable {
+            map: [None; NAME_TABLE_SIZE],
+            index: [0; NAME_INDEX_SIZE],
+        }
+    }
+    fn bucket(name: &XousServerName) -> usize {
+        use hash32::{Hash, Hasher};
+        let mut hasher = hash32::FnvHasher::default();
+        name.hash(&mut hasher);
+        hasher.finish() as usize % NAME_INDEX_SIZE
+    }
+    /// returns the slot in `map` holding `name`, if it's registered
+    fn find(&self, name: &XousServerName) -> Option<usize> {
+        let mut bucket = Self::bucket(name);
+        for _ in 0..NAME_INDEX_SIZE {
+            let slot = self.index[bucket] as usize;
+            if slot == 0 {
+                return None;
+            }
+            if let Some(entry) = &self.map[slot - 1] {
+                if entry.name == *name {
+                    return Some(slot - 1);
+                }
+            }
+            bucket = (bucket + 1) % NAME_INDEX_SIZE;
+        }
+        None
+    }
+    fn index_slot(&mut self, slot: usize) {
+        let mut bucket = Self::bucket(&self.map[slot].as_ref().unwrap().name);
+        // there are more buckets than slots, so this always finds room
+        while self.index[bucket] != 0 {
+            bucket = (bucket + 1) % NAME_INDEX_SIZE;
+        }
+        self.index[bucket] = (slot + 1) as u8;
+    }
+    /// linear probing doesn't allow buckets to simply be cleared, so start over after a removal.
+    /// Servers unregister rarely enough that this isn't worth optimizing.
+    fn rebuild_index(&mut self) {
+        self.index = [0; NAME_INDEX_SIZE];
+        for slot in 0..self.map.len() {
+            if self.map[slot].is_some() {
+                self.index_slot(slot);
+            }
         }
     }
     pub fn insert(&mut self, name: XousServerName, sid: xous::SID, max_conns: Option<u32>) -> Result<(), xous::Error> {
-        let mut ok = false;
         let token = if max_conns == Some(1) {
             // for the special case of 1-connection servers, provision a one-time use token for disconnects
             Some(xous::create_server_id().expect("couldn't create token").to_array())
         } else {
             None
         };
-        for entry in self.map.iter_mut() {
-            if entry.is_none() {
-                *entry = Some(Connection {
-                    name,
-                    sid,
-                    current_conns: 0,
-                    max_conns,
-                    allow_authenticate: false, // for now, we don't support authenticated connections
-                    auth_conns: 0,
-                    token,
-                });
-                ok = true;
-                break;
-            }
-        }
-        if !ok {
-            Err(xous::Error::OutOfMemory)
-        } else {
-            Ok(())
-        }
+        let slot = self.map.iter().position(|entry| entry.is_none()).ok_or(xous::Error::OutOfMemory)?;
+        self.map[slot] = Some(Connection {
+            name,
+            sid,
+            current_conns: 0,
+            max_conns,
+            allow_authenticate: false, // for now, we don't support authenticated connections
+            auth_conns: 0,
+            token,
+        });
+        self.index_slot(slot);
+        Ok(())
     }
     pub fn remove(&mut self, sid: xous::SID) -> Option<XousServerName> {
         let mut name: Option<XousServerName> = None;
@@ -128,51 +167,50 @@ impl SlowMap {
                 if mapping.sid == sid {
                     name = Some(mapping.name);
                     *entry = None;
+                    break;
                 }
-                break;
             }
         }
+        if name.is_some() {
+            self.rebuild_index();
+        }
         name
     }
     pub fn contains_key(&self, name: &XousServerName) -> bool {
-        for maybe_entry in self.map.iter() {
-            if let Some(entry) = maybe_entry {
-                if entry.name == *name {
-                    return true
-                }
-            }
+        self.find(name).is_some()
+    }
+    pub fn is_single_connection(&self, name: &XousServerName) -> bool {
+        match self.find(name) {
+            Some(slot) => self.map[slot].as_ref().unwrap().max_conns == Some(1),
+            None => false,
         }
-        return false
     }
     pub fn connect(&mut self, name: &XousServerName) -> (Option<&xous::SID>, Option<[u32; 4]>) {
-        for maybe_entry in self.map.iter_mut() {
-            if let Some(entry) = maybe_entry {
-                if *name == entry.name {
-                    if Some(1) == entry.max_conns {
-                        // single-connection case
-                        if entry.current_conns < 1 {
-                            (*entry).current_conns = 1;
-                            return (Some(&entry.sid), entry.token)
-                        } else {
-                            return (None, None)
-                        }
-                    }
-                    if let Some(max) = entry.max_conns {
-                        if entry.current_conns < max {
-                            (*entry).current_conns += 1;
-                            return (Some(&entry.sid), None);
-                        } else {
-                            return (None, None);
-                        }
-                    } else {
-                        // unlimited connections allowed
-                        (*entry).current_conns += 1;
-                        return (Some(&entry.sid), None);
-                    }
-                }
+        let entry = match self.find(name) {
+            Some(slot) => self.map[slot].as_mut().unwrap(),
+            None => return (None, None),
+        };
+        if Some(1) == entry.max_conns {
+            // single-connection case
+            if entry.current_conns < 1 {
+                (*entry).current_conns = 1;
+                return (Some(&entry.sid), entry.token)
+            } else {
+                return (None, None)
+            }
+        }
+        if let Some(max) = entry.max_conns {
+            if entry.current_conns < max {
+                (*entry).current_conns += 1;
+                (Some(&entry.sid), None)
+            } else {
+                (None, None)
             }
+        } else {
+            // unlimited connections allowed
+            (*entry).current_conns += 1;
+            (Some(&entry.sid), None)
         }
-        (None, None)
     }
     pub fn trusted_init_done(&self) -> bool {
         let mut trusted_done = true;
@@ -209,15 +247,14 @@ impl SlowMap {
     // this is a safer version of disconnect. we track servers that allow exactly one connection at a time
     // and give them a one-time-use token that a connector can use to disconnect.
     pub fn disconnect_with_token(&mut self, name: &XousServerName, token: [u32; 4]) -> bool {
-        for maybe_entry in self.map.iter_mut() {
-            if let Some(entry) = maybe_entry {
-                if let Some(old_token) = entry.token {
-                    if (*name == entry.name) && (token == old_token) && (entry.current_conns == 1) {
-                        (*entry).current_conns = 0;
-                        // generate the token -- we should never re-use these!
-                        (*entry).token = Some(xous::create_server_id().expect("couldn't create token").to_array());
-                        return true
-                    }
+        if let Some(slot) = self.find(name) {
+            let entry = self.map[slot].as_mut().unwrap();
+            if let Some(old_token) = entry.token {
+                if (token == old_token) && (entry.current_conns == 1) {
+                    (*entry).current_conns = 0;
+                    // generate the token -- we should never re-use these!
+                    (*entry).token = Some(xous::create_server_id().expect("couldn't create token").to_array());
+                    return true
                 }
             }
         }
@@ -238,8 +275,7 @@ fn xmain() -> ! {
     let d11ctimeout = D11cTimeout::new();
 
     // this limits the number of available servers to be requested to 128...!
-    //let mut name_table = FnvIndexMap::<XousServerName, xous::SID, 128>::new();
-    let mut name_table = SlowMap::new();
+    let mut name_table = NameTable::new();
 
     info!("started");
     loop {
@@ -336,6 +372,41 @@ fn xmain() -> ! {
                 }
                 buffer.replace(response).expect("Lookup can't serialize return value");
             }
+            Some(api::Opcode::LookupBatch) => {
+                let mem = msg.body.memory_message_mut().unwrap();
+                let mut buffer = unsafe { Buffer::from_memory_message_mut(mem) };
+                // Only the connection IDs change, so fill them in where they are rather than
+                // copying all of the names out and serializing them back again.
+                let batch = buffer.as_flat_mut::<LookupBatch, _>().unwrap().get_mut();
+                let sender_pid = msg
+                    .sender
+                    .pid()
+                    .expect("can't extract sender PID on LookupBatch");
+                let mut missing = false;
+                for i in 0..(batch.count as usize).min(LOOKUP_BATCH_SIZE) {
+                    let name = XousServerName::from_str(batch.names[i].as_str());
+                    log::trace!("batched lookup request for '{}'", name);
+                    batch.cids[i] = 0;
+                    // connecting here would use up the server's only connection and lose its token
+                    batch.single[i] = name_table.is_single_connection(&name);
+                    if batch.single[i] {
+                        continue;
+                    }
+                    if let (Some(server_sid), _) = name_table.connect(&name) {
+                        if let xous::Result::ConnectionID(connection_id) =
+                            xous::connect_for_process(sender_pid, *server_sid).expect("can't broker connection")
+                        {
+                            batch.cids[i] = connection_id;
+                        }
+                    }
+                    if batch.cids[i] == 0 {
+                        missing = true;
+                    }
+                }
+                if missing {
+                    d11ctimeout.hosted_delay();
+                }
+            }
             Some(api::Opcode::AuthenticatedLookup) => {
                 let mem = msg.body.memory_message_mut().unwrap();
                 let buffer = unsafe { Buffer::from_memory_message_mut(mem) };
@@ -123,6 +123,13 @@ fn main() {
                 .takes_value(false)
                 .help("Reduce kernel-userspace security and enable debugging programs"),
         )
+        .arg(
+            Arg::with_name("compress")
+                .short("z")
+                .long("compress")
+                .takes_value(false)
+                .help("Compress initial programs, to be unpacked by the loader"),
+        )
         .arg(
             Arg::with_name("output")
                 .value_name("OUTPUT")
@@ -242,7 +249,11 @@ fn main() {
             );
             pid += 1;
             let init = read_minielf(init_path).expect("couldn't parse init file");
-            args.add(IniE::new(init.entry_point, init.sections, init.program));
+            let mut inie = IniE::new(init.entry_point, init.sections, init.program);
+            if matches.is_present("compress") {
+                inie.compress();
+            }
+            args.add(inie);
         }
     }
 
@@ -17,6 +17,7 @@ bitflags! {
         const WRITE = 1;
         const NOCOPY = 2;
         const EXECUTE = 4;
+        const COMPRESSED = 8;
     }
 }
 
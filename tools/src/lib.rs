@@ -3,5 +3,6 @@ extern crate log;
 #[macro_use]
 pub mod xous_arguments;
 pub mod elf;
+pub mod lz4;
 pub mod tags;
 pub mod utils;
@@ -0,0 +1,191 @@
+//! An LZ4 block compressor.
+//!
+//! This produces plain LZ4 blocks (no frame header), which the loader expands
+//! directly into the pages of a process. The output follows the end-of-block
+//! rules from the LZ4 spec, so it can also be checked with any LZ4 decoder.
+//!
+//! This is a simple greedy compressor rather than a fast one. It only runs when
+//! an image is created, and the loader's decompressor doesn't care how the
+//! matches were found.
+
+const MIN_MATCH: usize = 4;
+const MAX_OFFSET: usize = 65535;
+const HASH_BITS: u32 = 12;
+
+/// The last few bytes of a block are always literals
+const LAST_LITERALS: usize = 5;
+
+/// No match may start within this many bytes of the end of a block
+const MF_LIMIT: usize = 12;
+
+/// The loader's decompressor, so that the tests check each end against the other
+#[cfg(test)]
+#[path = "../../loader/src/lz4.rs"]
+mod loader_lz4;
+
+fn read_u32(input: &[u8], offset: usize) -> u32 {
+    u32::from_le_bytes([
+        input[offset],
+        input[offset + 1],
+        input[offset + 2],
+        input[offset + 3],
+    ])
+}
+
+fn hash(sequence: u32) -> usize {
+    (sequence.wrapping_mul(2_654_435_761) >> (32 - HASH_BITS)) as usize
+}
+
+/// Write the remainder of a length that didn't fit in the token.
+fn write_length(output: &mut Vec<u8>, mut length: usize) {
+    while length >= 255 {
+        output.push(255);
+        length -= 255;
+    }
+    output.push(length as u8);
+}
+
+fn write_sequence(output: &mut Vec<u8>, literals: &[u8], matched: Option<(usize, usize)>) {
+    let match_code = matched.map_or(0, |(_, length)| length - MIN_MATCH);
+    output.push(((literals.len().min(15) as u8) << 4) | match_code.min(15) as u8);
+    if literals.len() >= 15 {
+        write_length(output, literals.len() - 15);
+    }
+    output.extend_from_slice(literals);
+    if let Some((offset, _)) = matched {
+        output.extend_from_slice(&(offset as u16).to_le_bytes());
+        if match_code >= 15 {
+            write_length(output, match_code - 15);
+        }
+    }
+}
+
+/// Compress `input` into a single LZ4 block.
+pub fn compress(input: &[u8]) -> Vec<u8> {
+    let mut output = Vec::with_capacity(input.len());
+    let mut table = vec![usize::MAX; 1 << HASH_BITS];
+    let mut anchor = 0;
+    let mut position = 0;
+
+    if input.len() > MF_LIMIT {
+        let match_limit = input.len() - MF_LIMIT;
+        let match_end = input.len() - LAST_LITERALS;
+        while position < match_limit {
+            let sequence = read_u32(input, position);
+            let slot = hash(sequence);
+            let candidate = table[slot];
+            table[slot] = position;
+
+            if candidate == usize::MAX
+                || position - candidate > MAX_OFFSET
+                || read_u32(input, candidate) != sequence
+            {
+                position += 1;
+                continue;
+            }
+
+            let mut length = MIN_MATCH;
+            while position + length < match_end
+                && input[candidate + length] == input[position + length]
+            {
+                length += 1;
+            }
+            write_sequence(
+                &mut output,
+                &input[anchor..position],
+                Some((position - candidate, length)),
+            );
+            position += length;
+            anchor = position;
+        }
+    }
+
+    write_sequence(&mut output, &input[anchor..], None);
+    output
+}
+
+#[cfg(test)]
+mod tests {
+    use super::loader_lz4::decompress;
+    use super::compress;
+
+    /// Compress `input`, expand it again with the loader's decompressor, and
+    /// return the compressed block.
+    fn round_trip(input: &[u8]) -> Vec<u8> {
+        let compressed = compress(input);
+        let mut output = vec![0xa5u8; input.len()];
+        let end = unsafe { decompress(output.as_mut_ptr(), output.len(), compressed.as_ptr()) };
+        assert_eq!(
+            end as usize - compressed.as_ptr() as usize,
+            compressed.len(),
+            "the decompressor didn't use up the whole block"
+        );
+        assert_eq!(output, input);
+        compressed
+    }
+
+    fn noise(len: usize) -> Vec<u8> {
+        let mut state: u32 = 0x1234_5678;
+        (0..len)
+            .map(|_| {
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                state as u8
+            })
+            .collect()
+    }
+
+    #[test]
+    fn empty() {
+        assert_eq!(round_trip(&[]), [0]);
+    }
+
+    #[test]
+    fn short() {
+        // too short for a match, so these are all literals
+        for len in 1..=16 {
+            round_trip(&vec![7u8; len]);
+        }
+    }
+
+    #[test]
+    fn incompressible() {
+        let input = noise(4096);
+        let compressed = round_trip(&input);
+        // literals cost one extra byte for every 255 of them, plus the token
+        assert!(compressed.len() <= input.len() + input.len() / 255 + 16);
+    }
+
+    #[test]
+    fn long_matches() {
+        // a run that is copied from the byte just before it, with a length
+        // that needs several extra length bytes
+        let compressed = round_trip(&[0u8; 4096]);
+        assert!(compressed.len() < 32);
+
+        // matches that repeat a short pattern, and one that reaches back a long way
+        let mut input = Vec::new();
+        for _ in 0..700 {
+            input.extend_from_slice(b"abc");
+        }
+        let block = noise(1000);
+        input.extend_from_slice(&block);
+        input.extend_from_slice(&block);
+        let compressed = round_trip(&input);
+        assert!(compressed.len() < 1100);
+    }
+
+    #[test]
+    fn mixed() {
+        // long runs of literals between matches, and a match right up to the
+        // point where the end-of-block rules stop them
+        let mut input = Vec::new();
+        for i in 0..64 {
+            input.extend_from_slice(&noise(17 + i));
+            input.extend_from_slice(b"xous-core text section ");
+        }
+        input.extend_from_slice(&[0xff; 40]);
+        round_trip(&input);
+    }
+}
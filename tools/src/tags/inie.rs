@@ -1,8 +1,10 @@
-use crate::elf::MiniElfSection;
+use crate::elf::{MiniElfFlags, MiniElfSection};
 use crate::xous_arguments::{XousArgument, XousArgumentCode, XousSize};
 use std::fmt;
 use std::io;
 
+const PAGE_SIZE: usize = 4096;
+
 #[derive(Debug)]
 pub struct IniE {
     /// Address of Init in RAM (i.e. SPI flash)
@@ -14,6 +16,9 @@ pub struct IniE {
     /// Array of minielf sections
     sections: Vec<MiniElfSection>,
 
+    /// Number of bytes each section takes up in `data`
+    stored_sizes: Vec<u32>,
+
     /// Actual program data
     data: Vec<u8>,
 }
@@ -26,9 +31,9 @@ impl fmt::Display for IniE {
             self.entrypoint, self.load_offset
         )?;
         let mut load_offset = self.load_offset;
-        for section in &self.sections {
+        for (section, stored_size) in self.sections.iter().zip(&self.stored_sizes) {
             writeln!(f, "        Loaded from {:08x} - {}", load_offset, section)?;
-            load_offset += section.size as u32;
+            load_offset += stored_size;
         }
         Ok(())
     }
@@ -40,13 +45,61 @@ impl IniE {
         while data.len() & 3 != 0 {
             data.push(0);
         }
+        let stored_sizes = sections
+            .iter()
+            .map(|section| {
+                if section.flags.contains(MiniElfFlags::NOCOPY) {
+                    0
+                } else {
+                    section.size
+                }
+            })
+            .collect();
         IniE {
             load_offset: 0,
             entrypoint,
             sections,
+            stored_sizes,
             data,
         }
     }
+
+    /// Compress each section that gets smaller for it. The loader unpacks
+    /// programs one page at a time, so the section is split on page boundaries
+    /// and every piece is compressed as its own LZ4 block.
+    pub fn compress(&mut self) {
+        let mut data = vec![];
+        let mut offset = 0;
+        for (section, stored_size) in self.sections.iter_mut().zip(self.stored_sizes.iter_mut()) {
+            if section.flags.contains(MiniElfFlags::NOCOPY) {
+                continue;
+            }
+            let raw = &self.data[offset..offset + section.size as usize];
+            offset += section.size as usize;
+
+            let mut packed = vec![];
+            let mut virt = section.virt as usize;
+            let mut remaining = raw;
+            while !remaining.is_empty() {
+                let chunk_size = (PAGE_SIZE - (virt & (PAGE_SIZE - 1))).min(remaining.len());
+                packed.extend(crate::lz4::compress(&remaining[..chunk_size]));
+                remaining = &remaining[chunk_size..];
+                virt += chunk_size;
+            }
+
+            if packed.len() < raw.len() {
+                section.flags |= MiniElfFlags::COMPRESSED;
+                *stored_size = packed.len() as u32;
+                data.extend(packed);
+            } else {
+                data.extend_from_slice(raw);
+            }
+        }
+        while data.len() & 3 != 0 {
+            data.push(0);
+        }
+        self.data = data;
+    }
 }
 
 impl XousArgument for IniE {
@@ -1,7 +1,9 @@
+use core::pin::Pin;
+use core::sync::atomic::{AtomicUsize, Ordering};
 use rkyv::{ser::Serializer, Fallible};
 use xous::{
     map_memory, send_message, unmap_memory, Error, MemoryAddress, MemoryFlags, MemoryMessage,
-    MemoryRange, MemorySize, Message, Result, CID,
+    MemoryRange, MemorySize, Message, MessageEnvelope, Result, CID,
 };
 
 #[derive(Debug)]
@@ -14,6 +16,67 @@ pub struct Buffer<'a> {
     memory_message: Option<&'a mut MemoryMessage>,
 }
 
+/// Number of freed buffers each process holds on to for reuse.
+const POOL_SLOTS: usize = 4;
+
+/// Only buffers up to this many pages are kept in the pool, which bounds the
+/// memory an idle process keeps mapped.
+const POOL_MAX_PAGES: usize = 2;
+
+/// Buffers that have been dropped but are still mapped. Each slot holds the
+/// page-aligned address of a buffer with its length in pages stored in the low
+/// bits, or 0 if it's empty.
+static POOL: [AtomicUsize; POOL_SLOTS] = [
+    AtomicUsize::new(0),
+    AtomicUsize::new(0),
+    AtomicUsize::new(0),
+    AtomicUsize::new(0),
+];
+
+/// Take a buffer of `len` bytes out of the pool, if there is one.
+fn pool_take(len: usize) -> Option<MemoryRange> {
+    let pages = len / 0x1000;
+    if pages > POOL_MAX_PAGES {
+        return None;
+    }
+    for slot in POOL.iter() {
+        let entry = slot.load(Ordering::Relaxed);
+        if entry == 0 || (entry & 0xFFF) != pages {
+            continue;
+        }
+        if slot
+            .compare_exchange(entry, 0, Ordering::Acquire, Ordering::Relaxed)
+            .is_ok()
+        {
+            let range = unsafe { MemoryRange::new(entry & !0xFFF, len).ok()? };
+            // Freshly-mapped memory is always zeroed, and the previous contents
+            // may have been lent to a different server.
+            unsafe { core::ptr::write_bytes(range.as_mut_ptr(), 0, len) };
+            return Some(range);
+        }
+    }
+    None
+}
+
+/// Put the memory of a dropped buffer into the pool. Returns `false` if it
+/// doesn't fit, in which case it should be unmapped.
+fn pool_give(range: MemoryRange) -> bool {
+    let pages = range.len() / 0x1000;
+    if pages > POOL_MAX_PAGES || (range.len() & 0xFFF) != 0 || (range.as_ptr() as usize & 0xFFF) != 0 {
+        return false;
+    }
+    let entry = range.as_ptr() as usize | pages;
+    for slot in POOL.iter() {
+        if slot
+            .compare_exchange(0, entry, Ordering::Release, Ordering::Relaxed)
+            .is_ok()
+        {
+            return true;
+        }
+    }
+    false
+}
+
 pub struct XousDeserializer;
 
 // Unreachable enum pattern, swap out for the never type (!) whenever that gets stabilized
@@ -35,15 +98,19 @@ impl<'a> Buffer<'a> {
 
         let flags = MemoryFlags::R | MemoryFlags::W;
 
-        // Allocate enough memory to hold the requested data
-        let new_mem = map_memory(
-            None,
-            None,
-            // Ensure our byte size is a multiple of 4096
-            len + remainder,
-            flags,
-        )
-        .expect("Buffer: error in new()/map_memory");
+        // Allocate enough memory to hold the requested data, reusing a buffer
+        // that was dropped earlier if there's one of the right size.
+        let new_mem = match pool_take(len + remainder) {
+            Some(mem) => mem,
+            None => map_memory(
+                None,
+                None,
+                // Ensure our byte size is a multiple of 4096
+                len + remainder,
+                flags,
+            )
+            .expect("Buffer: error in new()/map_memory"),
+        };
 
         let valid =
             unsafe { MemoryRange::new(new_mem.as_mut_ptr() as usize, len + remainder).unwrap() };
@@ -83,6 +150,47 @@ impl<'a> Buffer<'a> {
         }
     }
 
+    /// Take ownership of memory that was moved to this process, so that it can
+    /// be passed on to another server with `send()` instead of being copied
+    /// into a new `Buffer`. If it's dropped instead, the memory is freed just
+    /// like that of a `Buffer` made with `new()`, which lets this process reuse
+    /// it. Returns the envelope unchanged if it doesn't hold a `Move`.
+    #[allow(dead_code)]
+    pub fn from_move(
+        envelope: MessageEnvelope,
+    ) -> core::result::Result<Buffer<'static>, MessageEnvelope> {
+        let (buf, offset) = match &envelope.body {
+            Message::Move(mem) => (mem.buf, mem.offset),
+            _ => return Err(envelope),
+        };
+
+        // The buffer owns the memory now, so the envelope mustn't free it.
+        #[cfg(target_os = "none")]
+        {
+            core::mem::forget(envelope);
+            Ok(Buffer {
+                range: buf,
+                slice: unsafe { core::slice::from_raw_parts_mut(buf.as_mut_ptr(), buf.len()) },
+                valid: buf,
+                offset,
+                should_drop: true,
+                memory_message: None,
+            })
+        }
+
+        // Hosted processes receive moved memory as an ordinary heap allocation,
+        // which can't be freed the way a `Buffer` is. Copy it into one instead,
+        // and let the envelope free the original.
+        #[cfg(not(target_os = "none"))]
+        {
+            let mut moved = Buffer::new(buf.len());
+            moved.slice[..buf.len()].copy_from_slice(buf.as_slice::<u8>());
+            moved.offset = offset;
+            drop(envelope);
+            Ok(moved)
+        }
+    }
+
     /// Perform a mutable lend of this Buffer to the server.
     #[allow(dead_code)]
     pub fn lend_mut(&mut self, connection: CID, id: u32) -> core::result::Result<Result, Error> {
@@ -188,17 +296,46 @@ impl<'a> Buffer<'a> {
         Ok(())
     }
 
+    /// Find the archived root object of type `U`, making sure it lies entirely within the
+    /// buffer and is properly aligned. This only checks the root object itself: any relative
+    /// pointers within it, such as those of an `ArchivedString`, are still trusted.
+    fn archived_pos<U>(&self) -> core::result::Result<usize, ()> {
+        let pos = self.offset.map(|o| o.get()).unwrap_or_default();
+        let end = pos.checked_add(core::mem::size_of::<U>()).ok_or(())?;
+        if end > self.slice.len()
+            || (self.slice.as_ptr() as usize + pos) % core::mem::align_of::<U>() != 0
+        {
+            return Err(());
+        }
+        Ok(pos)
+    }
+
     /// Zero-copy representation of the data on the receiving side, wrapped in an "Archived" trait and left in the heap. Cheap so uses "as_" prefix.
     #[allow(dead_code)]
     pub fn as_flat<T, U>(&self) -> core::result::Result<&U, ()>
     where
         T: rkyv::Archive<Archived = U>,
     {
-        let pos = self.offset.map(|o| o.get()).unwrap_or_default();
+        let pos = self.archived_pos::<U>()?;
         let r = unsafe { rkyv::archived_value::<T>(self.slice, pos) };
         Ok(r)
     }
 
+    /// Mutable zero-copy representation of the data. Fields can be updated in place, so
+    /// a server that only changes part of a message doesn't need to deserialize it and
+    /// `replace()` the whole thing. Changes show up on the sending side as soon as the
+    /// message is returned.
+    #[allow(dead_code)]
+    pub fn as_flat_mut<T, U>(&mut self) -> core::result::Result<Pin<&mut U>, ()>
+    where
+        T: rkyv::Archive<Archived = U>,
+    {
+        let pos = self.archived_pos::<U>()?;
+        // Archived objects may contain relative pointers, so they must not be moved.
+        let r = unsafe { Pin::new_unchecked(&mut *(self.slice.as_mut_ptr().add(pos) as *mut U)) };
+        Ok(r)
+    }
+
     /// A representation identical to the original, but reequires copying to the stack. More expensive so uses "to_" prefix.
     #[allow(dead_code)]
     pub fn to_original<T, U>(&self) -> core::result::Result<T, ()>
@@ -206,7 +343,7 @@ impl<'a> Buffer<'a> {
         T: rkyv::Archive<Archived = U>,
         U: rkyv::Deserialize<T, dyn Fallible<Error = XousUnreachable>>,
     {
-        let pos = self.offset.map(|o| o.get()).unwrap_or_default();
+        let pos = self.archived_pos::<U>()?;
         let r = unsafe { rkyv::archived_value::<T>(self.slice, pos) };
         Ok(r.deserialize(&mut XousDeserializer {}).unwrap())
     }
@@ -240,7 +377,7 @@ impl<'a> core::ops::DerefMut for Buffer<'a> {
 
 impl<'a> Drop for Buffer<'a> {
     fn drop(&mut self) {
-        if self.should_drop {
+        if self.should_drop && !pool_give(self.range) {
             unmap_memory(self.range).expect("Buffer: failed to drop memory");
         }
     }
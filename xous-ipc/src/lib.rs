@@ -6,3 +6,6 @@ pub use buffer::XousDeserializer;
 
 mod string;
 pub use string::*;
+
+mod ring;
+pub use ring::*;
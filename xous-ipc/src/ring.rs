@@ -0,0 +1,361 @@
+//! A single-producer, single-consumer byte ring living in memory that is shared
+//! between a client and a server.
+//!
+//! Lending a `Buffer` for every chunk of a stream means remapping pages into the
+//! server and back again on each call. A ring is instead mapped into both
+//! processes once, using `xous::share_memory()`, and stays there until the
+//! client drops its end. The client writes into the ring and the server reads
+//! from it directly.
+//!
+//! The server is only notified when it needs to be: once it has drained the
+//! ring it marks itself as idle, and the next write sends it a "doorbell"
+//! scalar message. Writes that land while the server is still busy reading
+//! don't cost a syscall at all.
+//!
+//! A server that accepts rings does something like this:
+//!
+//! ```ignore
+//! Some(Opcode::OpenRing) => {
+//!     ring = xous_ipc::RingReceiver::new(msg).ok();
+//!     // The client won't ring the doorbell until the ring has been drained
+//!     // once, so do that straight away.
+//!     if let Some(r) = ring.as_mut() {
+//!         r.drain(|data| process(data));
+//!     }
+//! }
+//! Some(Opcode::RingDoorbell) => {
+//!     if let Some(r) = ring.as_mut() {
+//!         r.drain(|data| process(data));
+//!         if r.is_closed() {
+//!             ring = None;
+//!         }
+//!     }
+//! }
+//! ```
+
+use core::sync::atomic::{AtomicUsize, Ordering};
+use xous::{Error, MemoryRange, Message, MessageEnvelope, ScalarMessage, CID};
+
+/// Number of bytes at the start of the shared region that hold the control
+/// words. The remainder of the region holds data.
+const RING_HEADER_SIZE: usize = 64;
+
+#[repr(C)]
+struct RingHeader {
+    /// Offset of the next byte the producer will write
+    head: AtomicUsize,
+
+    /// Offset of the next byte the consumer will read
+    tail: AtomicUsize,
+
+    /// Nonzero if the consumer has run out of data and is waiting for
+    /// the doorbell
+    idle: AtomicUsize,
+
+    /// Nonzero once the producer has hung up
+    closed: AtomicUsize,
+
+    /// Set by the producer's sharing thread if the ring stopped being shared
+    /// with the consumer, to the `Error` that caused it
+    error: AtomicUsize,
+}
+
+/// The view of the ring that is common to both ends.
+struct Ring {
+    header: *const RingHeader,
+    data: *mut u8,
+    capacity: usize,
+}
+
+impl Ring {
+    fn new(range: &MemoryRange) -> Option<Ring> {
+        if range.len() <= RING_HEADER_SIZE + 1 {
+            return None;
+        }
+        Some(Ring {
+            header: range.as_ptr() as *const RingHeader,
+            data: unsafe { range.as_mut_ptr().add(RING_HEADER_SIZE) },
+            capacity: range.len() - RING_HEADER_SIZE,
+        })
+    }
+
+    fn header(&self) -> &RingHeader {
+        unsafe { &*self.header }
+    }
+
+    /// Number of bytes waiting to be read.
+    fn used(&self) -> usize {
+        let head = self.header().head.load(Ordering::SeqCst);
+        let tail = self.header().tail.load(Ordering::SeqCst);
+        (head + self.capacity - tail) % self.capacity
+    }
+
+    /// Copy as much of `src` as will fit into the ring and publish it.
+    fn produce(&self, src: &[u8]) -> usize {
+        let head = self.header().head.load(Ordering::Relaxed);
+        let tail = self.header().tail.load(Ordering::Acquire);
+        // One byte is always left empty, so that a full ring can be told
+        // apart from an empty one.
+        let free = (tail + self.capacity - head - 1) % self.capacity;
+        let count = free.min(src.len());
+        let first = count.min(self.capacity - head);
+        unsafe {
+            core::ptr::copy_nonoverlapping(src.as_ptr(), self.data.add(head), first);
+            core::ptr::copy_nonoverlapping(src[first..].as_ptr(), self.data, count - first);
+        }
+        self.header()
+            .head
+            .store((head + count) % self.capacity, Ordering::SeqCst);
+        count
+    }
+
+    /// Return the longest contiguous run of bytes that can be read.
+    fn readable(&self) -> &[u8] {
+        let head = self.header().head.load(Ordering::Acquire);
+        let tail = self.header().tail.load(Ordering::Relaxed);
+        let end = if head >= tail { head } else { self.capacity };
+        unsafe { core::slice::from_raw_parts(self.data.add(tail), end - tail) }
+    }
+
+    /// Hand `count` bytes at the start of `readable()` back to the producer.
+    fn consume(&self, count: usize) {
+        let tail = self.header().tail.load(Ordering::Relaxed);
+        self.header()
+            .tail
+            .store((tail + count) % self.capacity, Ordering::Release);
+    }
+
+    /// Mark the consumer as idle if there's nothing left to read. Returns
+    /// `false` if more data arrived in the meantime, in which case the
+    /// consumer should keep reading.
+    fn idle_if_empty(&self) -> bool {
+        self.header().idle.store(1, Ordering::SeqCst);
+        if self.used() == 0 {
+            return true;
+        }
+        self.header().idle.store(0, Ordering::SeqCst);
+        false
+    }
+}
+
+/// The client end of a ring, which writes data for the server to consume.
+pub struct RingSender {
+    ring: Ring,
+    range: MemoryRange,
+    connection: CID,
+    doorbell: usize,
+    sharer: Option<xous::arch::WaitHandle<usize>>,
+}
+
+/// Keep the ring shared with the server. This runs in its own thread, since
+/// `share_memory()` doesn't return until the server gives the memory back.
+/// If that happens before the client has hung up, nobody is reading the ring
+/// any more, so the reason is left in the header for `write()` to report.
+fn ring_sharer(connection: usize, id: usize, addr: usize, len: usize) -> usize {
+    let buf = unsafe { MemoryRange::new(addr, len) }.unwrap();
+    let message = xous::MemoryMessage {
+        id,
+        buf,
+        offset: None,
+        valid: None,
+    };
+    let result = match xous::share_memory(connection as CID, message) {
+        Ok(_) => Error::ServerNotFound,
+        Err(e) => e,
+    };
+    let header = unsafe { &*(buf.as_ptr() as *const RingHeader) };
+    if header.closed.load(Ordering::SeqCst) == 0 {
+        header.error.store(result.to_usize(), Ordering::SeqCst);
+    }
+    result.to_usize()
+}
+
+impl RingSender {
+    /// Create a ring of at least `len` bytes and share it with the server on
+    /// `connection`. The server receives a `MutableBorrow` with the ID
+    /// `open_id`, which it should pass to `RingReceiver::new()`, and is sent a
+    /// scalar with the ID `doorbell_id` whenever new data arrives while it's
+    /// idle.
+    pub fn new(
+        connection: CID,
+        open_id: usize,
+        doorbell_id: usize,
+        len: usize,
+    ) -> core::result::Result<Self, Error> {
+        // Hosted processes live in separate address spaces, so there's
+        // no memory to share.
+        if cfg!(not(any(target_os = "none", target_os = "xous"))) {
+            return Err(Error::UnhandledSyscall);
+        }
+
+        let len = (len + RING_HEADER_SIZE + 0xfff) & !0xfff;
+        let range = xous::map_memory(
+            None,
+            None,
+            len,
+            xous::MemoryFlags::R | xous::MemoryFlags::W,
+        )?;
+        let ring = Ring::new(&range).ok_or(Error::BadAddress)?;
+
+        // The ring starts out marked busy, since a doorbell sent before the
+        // server has accepted the ring would be lost. The server drains it
+        // once it has, and that marks it idle.
+        ring.header().idle.store(0, Ordering::SeqCst);
+        ring.header().error.store(0, Ordering::SeqCst);
+
+        let sharer = xous::create_thread_4(
+            ring_sharer,
+            connection as usize,
+            open_id,
+            range.as_ptr() as usize,
+            range.len(),
+        )
+        .or_else(|e| {
+            xous::unmap_memory(range).ok();
+            Err(e)
+        })?;
+
+        Ok(RingSender {
+            ring,
+            range,
+            connection,
+            doorbell: doorbell_id,
+            sharer: Some(sharer),
+        })
+    }
+
+    /// The number of bytes that can be written without blocking.
+    pub fn available(&self) -> usize {
+        self.ring.capacity - 1 - self.ring.used()
+    }
+
+    /// Copy as much of `data` as fits into the ring, and return the number of
+    /// bytes that were written. If the server was waiting for data, this rings
+    /// its doorbell. Fails if the server refused the ring or has given it back.
+    pub fn write(&mut self, data: &[u8]) -> core::result::Result<usize, Error> {
+        let error = self.ring.header().error.load(Ordering::SeqCst);
+        if error != 0 {
+            return Err(Error::from_usize(error));
+        }
+        let written = self.ring.produce(data);
+        if written > 0 && self.ring.header().idle.swap(0, Ordering::SeqCst) != 0 {
+            self.ring_doorbell()?;
+        }
+        Ok(written)
+    }
+
+    /// Write all of `data`, yielding to the server while the ring is full.
+    pub fn write_all(&mut self, mut data: &[u8]) -> core::result::Result<(), Error> {
+        while !data.is_empty() {
+            let written = self.write(data)?;
+            data = &data[written..];
+            if !data.is_empty() {
+                xous::yield_slice();
+            }
+        }
+        Ok(())
+    }
+
+    fn ring_doorbell(&self) -> core::result::Result<(), Error> {
+        xous::send_message(
+            self.connection,
+            Message::Scalar(ScalarMessage {
+                id: self.doorbell,
+                arg1: 0,
+                arg2: 0,
+                arg3: 0,
+                arg4: 0,
+            }),
+        )
+        .map(|_| ())
+    }
+}
+
+impl Drop for RingSender {
+    fn drop(&mut self) {
+        // Tell the server we've hung up. It will return the memory once it
+        // has drained the ring, which allows the sharing thread to exit.
+        self.ring.header().closed.store(1, Ordering::SeqCst);
+        self.ring.header().idle.store(0, Ordering::SeqCst);
+        self.ring_doorbell().ok();
+        if let Some(sharer) = self.sharer.take() {
+            xous::wait_thread(sharer).ok();
+        }
+        xous::unmap_memory(self.range).expect("RingSender: failed to drop memory");
+    }
+}
+
+/// The server end of a ring, which reads data written by the client.
+pub struct RingReceiver {
+    ring: Ring,
+    // Holding on to the envelope keeps the memory shared. Dropping it returns
+    // the memory to the client.
+    _envelope: MessageEnvelope,
+}
+
+impl RingReceiver {
+    /// Accept a ring that was opened with `RingSender::new()`. The client
+    /// doesn't ring the doorbell until this end has run out of data once, so
+    /// call `drain()` or `read()` right after this to pick up anything that
+    /// was written before the ring was accepted.
+    pub fn new(envelope: MessageEnvelope) -> core::result::Result<Self, Error> {
+        let ring = match &envelope.body {
+            Message::MutableBorrow(mem) => Ring::new(&mem.buf).ok_or(Error::BadAddress)?,
+            _ => return Err(Error::BadAddress),
+        };
+        Ok(RingReceiver {
+            ring,
+            _envelope: envelope,
+        })
+    }
+
+    /// Pass each contiguous run of waiting bytes to `f` until the ring is
+    /// empty, then wait for the doorbell. Returns the number of bytes that
+    /// were consumed.
+    pub fn drain<F>(&mut self, mut f: F) -> usize
+    where
+        F: FnMut(&[u8]),
+    {
+        let mut total = 0;
+        loop {
+            let chunk = self.ring.readable();
+            if chunk.is_empty() {
+                if self.ring.idle_if_empty() {
+                    return total;
+                }
+                continue;
+            }
+            let len = chunk.len();
+            f(chunk);
+            self.ring.consume(len);
+            total += len;
+        }
+    }
+
+    /// Copy waiting bytes into `buf`, returning the number of bytes copied.
+    /// If this empties the ring, the client will ring the doorbell the next
+    /// time it writes.
+    pub fn read(&mut self, buf: &mut [u8]) -> usize {
+        let mut copied = 0;
+        while copied < buf.len() {
+            let chunk = self.ring.readable();
+            if chunk.is_empty() {
+                if self.ring.idle_if_empty() {
+                    break;
+                }
+                continue;
+            }
+            let len = chunk.len().min(buf.len() - copied);
+            buf[copied..copied + len].copy_from_slice(&chunk[..len]);
+            self.ring.consume(len);
+            copied += len;
+        }
+        copied
+    }
+
+    /// Returns `true` once the client has hung up. Any data still in the
+    /// ring may be read before dropping this end.
+    pub fn is_closed(&self) -> bool {
+        self.ring.header().closed.load(Ordering::SeqCst) != 0
+    }
+}
@@ -4,7 +4,8 @@ use std::convert::TryInto;
 use std::io::{Read, Write};
 use std::mem::size_of;
 use std::net::{IpAddr, Ipv4Addr, SocketAddr, TcpStream, ToSocketAddrs};
-use std::sync::{Arc, Mutex};
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::sync::{Arc, Condvar, Mutex, MutexGuard};
 use std::thread_local;
 
 use crate::{Result, PID, TID};
@@ -196,7 +197,45 @@ pub struct WaitHandle<T>(std::thread::JoinHandle<T>);
 struct ServerConnection {
     send: Arc<Mutex<TcpStream>>,
     recv: Arc<Mutex<TcpStream>>,
-    mailbox: Arc<Mutex<HashMap<TID, Result>>>,
+    mailbox: Arc<Mailbox>,
+}
+
+/// Responses that were read off the socket by one thread on behalf of another.
+///
+/// Only one thread at a time can read from the socket. The others wait on
+/// `changed`, which is signalled whenever a response is posted or the socket
+/// is given up, so they either find their response or take over reading.
+struct Mailbox {
+    results: Mutex<HashMap<TID, Result>>,
+    changed: Condvar,
+}
+
+impl Mailbox {
+    fn new() -> Mailbox {
+        Mailbox {
+            results: Mutex::new(HashMap::new()),
+            changed: Condvar::new(),
+        }
+    }
+
+    /// Take the response for `thread_id` out of the mailbox, if it has arrived.
+    fn take(results: &mut HashMap<TID, Result>, thread_id: TID) -> Option<Result> {
+        match results.get(&thread_id) {
+            Some(Result::BlockedProcess) | None => None,
+            Some(_) => results.remove(&thread_id),
+        }
+    }
+
+    /// Post a response for another thread, or just wake the other waiters up
+    /// if `response` is `None`. This must be called after giving up the
+    /// receive stream, so that another thread can take it over.
+    fn post(&self, response: Option<(TID, Result)>) {
+        let mut results = self.results.lock().unwrap();
+        if let Some((thread_id, response)) = response {
+            results.insert(thread_id, response);
+        }
+        self.changed.notify_all();
+    }
 }
 
 pub fn thread_to_args(call: usize, _init: &ThreadInit) -> [usize; 8] {
@@ -473,6 +512,65 @@ pub fn wait_thread<T>(joiner: WaitHandle<T>) -> crate::SysCallResult {
         .map_err(|_| crate::Error::InternalError)
 }
 
+/// Threads that are parked on one futex
+#[derive(Default)]
+struct FutexWaiters {
+    parked: usize,
+    /// Wakeups that have been handed out but not yet collected
+    woken: usize,
+}
+
+lazy_static::lazy_static! {
+    static ref FUTEXES: (Mutex<HashMap<usize, FutexWaiters>>, Condvar) =
+        (Mutex::new(HashMap::new()), Condvar::new());
+}
+
+/// A hosted kernel can't look into the memory of its processes, so it has no
+/// way to check what a futex holds. Hosted processes are ordinary programs,
+/// though, so park the thread on a condition variable here instead.
+pub fn futex_wait(futex: &AtomicUsize, expected: usize) -> core::result::Result<(), crate::Error> {
+    let key = futex as *const AtomicUsize as usize;
+    let (table, wakeup) = &*FUTEXES;
+    let mut table = table.lock().unwrap();
+
+    // `futex_wake()` holds the same lock, so it can't slip in between this
+    // check and parking.
+    if futex.load(Ordering::SeqCst) != expected {
+        return Ok(());
+    }
+    table.entry(key).or_default().parked += 1;
+    loop {
+        table = wakeup.wait(table).unwrap();
+        let waiters = table.get_mut(&key).expect("futex waiters went missing");
+        if waiters.woken > 0 {
+            waiters.woken -= 1;
+            waiters.parked -= 1;
+            if waiters.parked == 0 {
+                table.remove(&key);
+            }
+            return Ok(());
+        }
+    }
+}
+
+pub fn futex_wake(futex: &AtomicUsize, count: usize) -> core::result::Result<usize, crate::Error> {
+    let key = futex as *const AtomicUsize as usize;
+    let (table, wakeup) = &*FUTEXES;
+    let mut table = table.lock().unwrap();
+    let woken = match table.get_mut(&key) {
+        Some(waiters) => {
+            let woken = count.min(waiters.parked - waiters.woken);
+            waiters.woken += woken;
+            woken
+        }
+        None => 0,
+    };
+    if woken > 0 {
+        wakeup.notify_all();
+    }
+    Ok(woken)
+}
+
 pub fn ensure_connection() -> core::result::Result<(), crate::Error> {
     XOUS_SERVER_CONNECTION.with(|xsc| {
         let mut xsc = xsc.borrow_mut();
@@ -513,7 +611,7 @@ fn xous_connect_impl(
             Ok(ServerConnection {
                 send: Arc::new(Mutex::new(conn.try_clone().unwrap())),
                 recv: Arc::new(Mutex::new(conn)),
-                mailbox: Arc::new(Mutex::new(HashMap::new())),
+                mailbox: Arc::new(Mailbox::new()),
             })
         }
         Err(_e) => {
@@ -555,6 +653,9 @@ pub fn _xous_syscall(
 
             let mut xsc_borrowed = xsc.borrow_mut();
             let xsc_asmut = xsc_borrowed.as_mut().expect("not connected to server (did you forget to create a thread with xous::create_thread()?)");
+            // Back off gradually when the server is busy, so that a call that
+            // only needs to wait briefly doesn't stall for the full interval.
+            let mut backoff = std::time::Duration::from_millis(1);
             loop {
                 _xous_syscall_to(
                     nr,
@@ -572,187 +673,160 @@ pub fn _xous_syscall(
                 if *ret != Result::WouldBlock {
                     return;
                 }
-                std::thread::sleep(std::time::Duration::from_millis(50));
+                std::thread::sleep(backoff);
+                backoff = (backoff * 2).min(std::time::Duration::from_millis(50));
             }
         })
     });
 }
 
 fn _xous_syscall_result(ret: &mut Result, thread_id: TID, server_connection: &ServerConnection) {
-    // Check to see if this thread id has an entry in the mailbox already.
-    // This will block until the hashmap is free.
-    {
-        let mut mailbox = server_connection.mailbox.lock().unwrap();
-        if let Some(entry) = mailbox.get(&thread_id) {
-            if &Result::BlockedProcess != entry {
-                *ret = mailbox.remove(&thread_id).unwrap();
-                return;
-            }
-        }
-    }
-
-    // Receive the packet back
+    let mailbox = &server_connection.mailbox;
     loop {
-        // Now that we have the Stream mutex, temporarily take the Mailbox mutex to see if
-        // this thread ID is there. If it is, there's no need to read via the network.
-        // Note that the mailbox mutex is released if it isn't found.
-        {
-            let mut mailbox = server_connection.mailbox.lock().unwrap();
-            if let Some(entry) = mailbox.get(&thread_id) {
-                if &Result::BlockedProcess != entry {
-                    *ret = mailbox.remove(&thread_id).unwrap();
+        // Wait until either another thread has left our response in the mailbox,
+        // or nobody else is reading and we can take the receive stream ourselves.
+        // The mailbox lock is held across the check and the `try_lock()`, and a
+        // thread always posts to the mailbox after giving up the stream, so
+        // there's no window in which a wakeup can be missed.
+        let mut stream = {
+            let mut results = mailbox.results.lock().unwrap();
+            loop {
+                if let Some(response) = Mailbox::take(&mut results, thread_id) {
+                    *ret = response;
                     return;
                 }
-            }
-        }
-
-        let mut stream = match server_connection.recv.try_lock() {
-            Ok(lk) => lk,
-            Err(std::sync::TryLockError::WouldBlock) => {
-                std::thread::sleep(std::time::Duration::from_millis(10));
-                continue;
-            }
-            Err(e) => panic!("Receive error: {}", e),
-        };
-
-        // One more check, in case something came in while we waited for the receiver above.
-        {
-            let mut mailbox = server_connection.mailbox.lock().unwrap();
-            if let Some(entry) = mailbox.get(&thread_id) {
-                if &Result::BlockedProcess != entry {
-                    *ret = mailbox.remove(&thread_id).unwrap();
-                    return;
+                match server_connection.recv.try_lock() {
+                    Ok(stream) => break stream,
+                    Err(std::sync::TryLockError::WouldBlock) => {
+                        results = mailbox.changed.wait(results).unwrap();
+                    }
+                    Err(e) => panic!("Receive error: {}", e),
                 }
             }
-        }
-
-        // This thread_id doesn't exist in the mailbox, so read additional data.
-        let mut pkt = [0usize; 8];
-        let mut raw_bytes = [0u8; size_of::<usize>() * 9];
-        if let Err(e) = stream.read_exact(&mut raw_bytes) {
-            eprintln!("Server shut down: {}", e);
-            std::process::exit(0);
-        }
-
-        let mut raw_bytes_chunks = raw_bytes.chunks(size_of::<usize>());
-
-        // Read the Thread ID, which comes across first, followed by the 8 words of
-        // the message data.
-        let msg_thread_id =
-            usize::from_le_bytes(raw_bytes_chunks.next().unwrap().try_into().unwrap());
-        for (pkt_word, word) in pkt.iter_mut().zip(raw_bytes_chunks) {
-            *pkt_word = usize::from_le_bytes(word.try_into().unwrap());
-        }
+        };
 
-        let mut response = Result::from_args(pkt);
+        let incoming = _xous_syscall_read_response(&mut stream);
+        drop(stream);
 
-        // If we got a `WouldBlock`, then we need to retry the whole call
-        // again. Return and retry.
-        if response == Result::WouldBlock {
-            // If the incoming message was for this thread, return it directly.
-            if msg_thread_id == thread_id {
+        match incoming {
+            // If the incoming message was for this thread, return it directly,
+            // letting the next waiter take over the stream.
+            Some((msg_thread_id, response)) if msg_thread_id == thread_id => {
+                mailbox.post(None);
                 *ret = response;
                 return;
             }
-
-            // Otherwise, add it to the mailbox and try again.
-            let mut mailbox = server_connection.mailbox.lock().unwrap();
-            mailbox.insert(msg_thread_id, response);
-            continue;
+            // Otherwise, hand it to its thread and try again.
+            other => mailbox.post(other),
         }
+    }
+}
 
-        if response == Result::BlockedProcess {
-            // println!("   Waiting again");
-            continue;
-        }
+/// Read one response from the server, along with any memory that came with it.
+/// Returns the thread the response is for, or `None` if the server merely
+/// reported that the process is blocked.
+fn _xous_syscall_read_response(stream: &mut MutexGuard<TcpStream>) -> Option<(TID, Result)> {
+    let mut pkt = [0usize; 8];
+    let mut raw_bytes = [0u8; size_of::<usize>() * 9];
+    if let Err(e) = stream.read_exact(&mut raw_bytes) {
+        eprintln!("Server shut down: {}", e);
+        std::process::exit(0);
+    }
 
-        // Determine if this thread will have a memory packet following it.
-        let call = CALL_FOR_THREAD.with(|cft| {
-            let cft_borrowed = cft.borrow();
-            let mut cft_mtx = cft_borrowed.lock().unwrap();
-            cft_mtx
-                .remove(&msg_thread_id)
-                .expect("thread didn't declare whether it has data")
-        });
-
-        // If the client is passing us memory, remap the array to our own space.
-        if let Result::Message(msg) = &mut response {
-            match &mut msg.body {
-                crate::Message::Move(ref mut memory_message)
-                | crate::Message::Borrow(ref mut memory_message)
-                | crate::Message::MutableBorrow(ref mut memory_message) => {
-                    let data = vec![0u8; memory_message.buf.len()];
-                    let mut data = std::mem::ManuallyDrop::new(data);
-                    if let Err(e) = stream.read_exact(&mut data) {
-                        eprintln!("Server shut down: {}", e);
-                        std::process::exit(0);
-                    }
-                    data.shrink_to_fit();
-                    assert_eq!(data.len(), data.capacity());
-                    let len = data.len();
-                    let addr = data.as_mut_ptr();
-                    memory_message.buf = unsafe { crate::MemoryRange::new(addr as _, len).unwrap() };
-                }
-                _ => (),
-            }
-        }
+    let mut raw_bytes_chunks = raw_bytes.chunks(size_of::<usize>());
+
+    // Read the Thread ID, which comes across first, followed by the 8 words of
+    // the message data.
+    let msg_thread_id = usize::from_le_bytes(raw_bytes_chunks.next().unwrap().try_into().unwrap());
+    for (pkt_word, word) in pkt.iter_mut().zip(raw_bytes_chunks) {
+        *pkt_word = usize::from_le_bytes(word.try_into().unwrap());
+    }
+
+    let mut response = Result::from_args(pkt);
+
+    // If we got a `WouldBlock`, then the whole call needs to be retried. Nothing
+    // else follows it.
+    if response == Result::WouldBlock {
+        return Some((msg_thread_id, response));
+    }
 
-        // If the original call contained memory, then ensure the memory we get back is correct.
-        if let Some(mem) = call.memory() {
-            if call.is_borrow() || call.is_mutableborrow() {
-                // Read the buffer back from the remote host.
-                use core::slice;
-                let mut data = unsafe { slice::from_raw_parts_mut(mem.as_mut_ptr(), mem.len()) };
+    if response == Result::BlockedProcess {
+        // println!("   Waiting again");
+        return None;
+    }
 
-                // If it's a Borrow, verify the contents haven't changed.
-                let previous_data = if call.is_borrow() {
-                    Some(data.to_vec())
-                } else {
-                    None
-                };
+    // Determine if this thread will have a memory packet following it.
+    let call = CALL_FOR_THREAD.with(|cft| {
+        let cft_borrowed = cft.borrow();
+        let mut cft_mtx = cft_borrowed.lock().unwrap();
+        cft_mtx
+            .remove(&msg_thread_id)
+            .expect("thread didn't declare whether it has data")
+    });
 
+    // If the client is passing us memory, remap the array to our own space.
+    if let Result::Message(msg) = &mut response {
+        match &mut msg.body {
+            crate::Message::Move(ref mut memory_message)
+            | crate::Message::Borrow(ref mut memory_message)
+            | crate::Message::MutableBorrow(ref mut memory_message) => {
+                let data = vec![0u8; memory_message.buf.len()];
+                let mut data = std::mem::ManuallyDrop::new(data);
                 if let Err(e) = stream.read_exact(&mut data) {
                     eprintln!("Server shut down: {}", e);
                     std::process::exit(0);
                 }
-
-                // If it is an immutable borrow, verify the contents haven't changed somehow
-                if let Some(previous_data) = previous_data {
-                    assert_eq!(data, previous_data.as_slice());
-                }
+                data.shrink_to_fit();
+                assert_eq!(data.len(), data.capacity());
+                let len = data.len();
+                let addr = data.as_mut_ptr();
+                memory_message.buf = unsafe { crate::MemoryRange::new(addr as _, len).unwrap() };
             }
+            _ => (),
+        }
+    }
+
+    // If the original call contained memory, then ensure the memory we get back is correct.
+    if let Some(mem) = call.memory() {
+        if call.is_borrow() || call.is_mutableborrow() {
+            // Read the buffer back from the remote host.
+            use core::slice;
+            let mut data = unsafe { slice::from_raw_parts_mut(mem.as_mut_ptr(), mem.len()) };
+
+            // If it's a Borrow, verify the contents haven't changed.
+            let previous_data = if call.is_borrow() {
+                Some(data.to_vec())
+            } else {
+                None
+            };
 
-            if call.is_move() {
-                // In a hosted environment, the message contents are leaked when
-                // it gets converted into a MemoryMessage. Now that the call is
-                // complete, free the memory.
-                mem::unmap_memory_post(mem).unwrap();
+            if let Err(e) = stream.read_exact(&mut data) {
+                eprintln!("Server shut down: {}", e);
+                std::process::exit(0);
             }
 
-            // If we're returning memory to the Server, then reconstitute the buffer we just passed,
-            // and Drop it so it can be freed.
-            if call.is_return_memory() {
-                let rebuilt =
-                    unsafe { Vec::from_raw_parts(mem.as_mut_ptr(), mem.len(), mem.len()) };
-                drop(rebuilt);
+            // If it is an immutable borrow, verify the contents haven't changed somehow
+            if let Some(previous_data) = previous_data {
+                assert_eq!(data, previous_data.as_slice());
             }
         }
 
-        // Now that we have the Stream mutex, temporarily take the Mailbox mutex to see if
-        // this thread ID is there. If it is, there's no need to read via the network.
-        // Note that the mailbox mutex is released if it isn't found.
-        {
-            // If the incoming message was for this thread, return it directly.
-            if msg_thread_id == thread_id {
-                *ret = response;
-                return;
-            }
+        if call.is_move() {
+            // In a hosted environment, the message contents are leaked when
+            // it gets converted into a MemoryMessage. Now that the call is
+            // complete, free the memory.
+            mem::unmap_memory_post(mem).unwrap();
+        }
 
-            // Otherwise, add it to the mailbox and try again.
-            let mut mailbox = server_connection.mailbox.lock().unwrap();
-            mailbox.insert(msg_thread_id, response);
+        // If we're returning memory to the Server, then reconstitute the buffer we just passed,
+        // and Drop it so it can be freed.
+        if call.is_return_memory() {
+            let rebuilt = unsafe { Vec::from_raw_parts(mem.as_mut_ptr(), mem.len(), mem.len()) };
+            drop(rebuilt);
         }
     }
+
+    Some((msg_thread_id, response))
 }
 
 #[allow(clippy::too_many_arguments)]
@@ -1,5 +1,6 @@
 use crate::{MemoryRange, PID, TID};
 use core::convert::TryInto;
+use core::sync::atomic::AtomicUsize;
 
 mod mem;
 pub use mem::*;
@@ -138,6 +139,22 @@ pub fn wait_thread<T>(joiner: WaitHandle<T>) -> crate::SysCallResult {
     crate::syscall::rsyscall(call)
 }
 
+pub fn futex_wait(futex: &AtomicUsize, expected: usize) -> core::result::Result<(), crate::Error> {
+    let call = crate::SysCall::FutexWait(futex as *const AtomicUsize as usize, expected);
+    crate::syscall::rsyscall(call).map(|_| ())
+}
+
+pub fn futex_wake(futex: &AtomicUsize, count: usize) -> core::result::Result<usize, crate::Error> {
+    let call = crate::SysCall::FutexWake(futex as *const AtomicUsize as usize, count);
+    crate::syscall::rsyscall(call).and_then(|result| {
+        if let crate::Result::Scalar1(woken) = result {
+            Ok(woken)
+        } else {
+            Err(crate::Error::InternalError)
+        }
+    })
+}
+
 pub fn process_to_args(call: usize, init: &ProcessInit) -> [usize; 8] {
     [
         call,
@@ -387,3 +404,32 @@ extern "C" {
 pub fn cache_flush() {
     unsafe { riscv_cache_flush() };
 }
+
+/// The kernel maps the ticktimer's registers read-only at this address in
+/// every process.
+pub const TICKTIMER_PAGE: usize = 0xffcc_0000;
+
+/// Number of ticktimer ticks per millisecond.
+pub const TICKS_PER_MS: u64 = 1;
+
+/// Read the ticktimer's count directly, without sending a message to the
+/// ticktimer server. The count starts when the ticktimer server starts up.
+pub fn elapsed_ticks() -> u64 {
+    // TIME1 holds the upper word of the count, and TIME0 the lower word.
+    let time1 = (TICKTIMER_PAGE + 4) as *const u32;
+    let time0 = (TICKTIMER_PAGE + 8) as *const u32;
+    loop {
+        let upper = unsafe { time1.read_volatile() };
+        let lower = unsafe { time0.read_volatile() };
+        // If the lower word rolled over between the two reads, try again.
+        if unsafe { time1.read_volatile() } == upper {
+            return ((upper as u64) << 32) | lower as u64;
+        }
+    }
+}
+
+/// Milliseconds since the ticktimer server started, read without sending
+/// it a message.
+pub fn elapsed_ms() -> u64 {
+    elapsed_ticks() / TICKS_PER_MS
+}
@@ -11,6 +11,14 @@ pub type Connection = usize;
 
 pub const MAX_CID: usize = 34;
 
+/// Scheduling priority given to threads that haven't asked for anything else.
+/// Threads with a higher priority are always run in preference to threads with
+/// a lower one, so a high-priority thread should block rather than spin.
+pub const THREAD_PRIORITY_DEFAULT: usize = 2;
+
+/// The highest scheduling priority a thread may have.
+pub const THREAD_PRIORITY_MAX: usize = 7;
+
 pub const FLASH_PHYS_BASE:    u32 = 0x2000_0000;
 pub const SOC_REGION_LOC:     u32 = 0x0000_0000;
 pub const SOC_MAIN_GW_LOC:    u32 = 0x0000_0000;
@@ -729,6 +737,129 @@ impl core::fmt::Display for MemoryType {
     }
 }
 
+/// The kinds of event the kernel can record in its trace ring. Recording of
+/// each kind is turned on by setting bit `1 << kind` in the mask passed to
+/// `set_trace_mask()`.
+#[derive(Debug, Copy, Clone, PartialEq)]
+pub enum TraceEventKind {
+    /// A thread made a syscall. `args` are the syscall number and its first
+    /// argument.
+    SyscallEnter = 0,
+
+    /// The kernel finished handling a syscall. `args` are the syscall number
+    /// and the `Result` tag it returned.
+    SyscallExit = 1,
+
+    /// The kernel returned to a different thread than the one it last ran.
+    /// `pid` and `tid` are the new thread, and `args` are the old one.
+    ContextSwitch = 2,
+
+    /// An interrupt was handed to its handler. `pid` is the process that
+    /// claimed it, and `args[0]` is the IRQ number.
+    Irq = 3,
+
+    /// A message was added to a server's queue. `pid` and `tid` are the
+    /// sender, and `args` are the server index and the message ID.
+    MessageQueued = 4,
+
+    /// A server thread took a message off its queue. `pid` and `tid` are the
+    /// server thread, and `args` are the server index and the message ID.
+    MessageDequeued = 5,
+
+    /// A message went straight to a server thread that was waiting for one,
+    /// without being queued. `pid` and `tid` are the sender, and `args` are
+    /// the server index and the message ID.
+    MessageDelivered = 6,
+
+    /// A page of RAM was allocated. `pid` is the new owner, and `args[0]` is
+    /// the physical address.
+    PageAlloc = 7,
+
+    /// A page of RAM was freed. `pid` is the old owner, and `args[0]` is the
+    /// physical address.
+    PageFree = 8,
+
+    /// The trace reader fell behind and the ring overwrote events that hadn't
+    /// been read. `args[0]` is the number of events that were lost. This is
+    /// always reported, regardless of the mask.
+    Lost = 9,
+}
+
+impl TraceEventKind {
+    pub fn from_usize(kind: usize) -> Option<Self> {
+        use TraceEventKind::*;
+        Some(match kind {
+            0 => SyscallEnter,
+            1 => SyscallExit,
+            2 => ContextSwitch,
+            3 => Irq,
+            4 => MessageQueued,
+            5 => MessageDequeued,
+            6 => MessageDelivered,
+            7 => PageAlloc,
+            8 => PageFree,
+            9 => Lost,
+            _ => return None,
+        })
+    }
+
+    /// The bit that enables this kind of event in a trace mask
+    pub fn mask(self) -> usize {
+        1 << self as usize
+    }
+}
+
+/// One event read out of the kernel trace ring with `read_trace()`.
+#[derive(Debug, Copy, Clone, PartialEq)]
+pub struct TraceEvent {
+    /// When the event happened. On hardware this is the CPU cycle count, and
+    /// when running hosted it is the number of nanoseconds since the kernel
+    /// started.
+    pub timestamp: u64,
+    pub kind: TraceEventKind,
+    pub pid: Option<PID>,
+    pub tid: TID,
+    /// The meaning of these depends on `kind`
+    pub args: [usize; 2],
+}
+
+impl TraceEvent {
+    pub fn from_args(
+        ts_lo: usize,
+        ts_hi: usize,
+        kind: usize,
+        pid: usize,
+        tid: usize,
+        arg0: usize,
+        arg1: usize,
+    ) -> Option<Self> {
+        Some(TraceEvent {
+            timestamp: (ts_lo as u32 as u64) | ((ts_hi as u64) << 32),
+            kind: TraceEventKind::from_usize(kind)?,
+            pid: PID::new(pid as u8),
+            tid: tid as TID,
+            args: [arg0, arg1],
+        })
+    }
+}
+
+/// Counters the kernel keeps for each process, returned by `process_stats()`.
+#[derive(Debug, Copy, Clone, PartialEq, Default)]
+pub struct ProcessStats {
+    /// Time spent running the process' threads, in the same units as
+    /// `TraceEvent::timestamp`. This includes interrupt handlers the process
+    /// claimed, but not time spent in the kernel on its behalf. It is always
+    /// 0 when running hosted.
+    pub cpu_time: u64,
+
+    /// The number of messages the process has sent, whether or not they had
+    /// to be queued
+    pub messages_sent: usize,
+
+    /// The number of pages of RAM the process owns right now
+    pub pages_owned: usize,
+}
+
 #[repr(C)]
 #[derive(Debug, PartialEq)]
 pub enum Result {
@@ -780,6 +911,26 @@ pub enum Result {
         Option<MemorySize>, /* valid */
     ),
 
+    /// An event from the kernel trace ring. Use `TraceEvent::from_args()`
+    /// to decode it.
+    TraceEvent(
+        usize, /* timestamp, low word */
+        usize, /* timestamp, high word */
+        usize, /* kind */
+        usize, /* pid */
+        usize, /* tid */
+        usize, /* arg0 */
+        usize, /* arg1 */
+    ),
+
+    /// The counters the kernel keeps for a process
+    ProcessStats(
+        usize, /* cpu time, low word */
+        usize, /* cpu time, high word */
+        usize, /* messages sent */
+        usize, /* pages owned */
+    ),
+
     UnknownResult(usize, usize, usize, usize, usize, usize, usize),
 }
 
@@ -836,6 +987,12 @@ impl Result {
                 0,
                 0,
             ],
+            Result::TraceEvent(ts_lo, ts_hi, kind, pid, tid, arg0, arg1) => {
+                [19, *ts_lo, *ts_hi, *kind, *pid, *tid, *arg0, *arg1]
+            }
+            Result::ProcessStats(cpu_lo, cpu_hi, messages, pages) => {
+                [20, *cpu_lo, *cpu_hi, *messages, *pages, 0, 0, 0]
+            }
             Result::UnknownResult(arg1, arg2, arg3, arg4, arg5, arg6, arg7) => {
                 [usize::MAX, *arg1, *arg2, *arg3, *arg4, *arg5, *arg6, *arg7]
             }
@@ -912,6 +1069,8 @@ impl Result {
             16 => Result::WouldBlock,
             17 => Result::None,
             18 => Result::MemoryReturned(MemorySize::new(src[1]), MemorySize::new(src[2])),
+            19 => Result::TraceEvent(src[1], src[2], src[3], src[4], src[5], src[6], src[7]),
+            20 => Result::ProcessStats(src[1], src[2], src[3], src[4]),
             _ => Result::UnknownResult(src[0], src[1], src[2], src[3], src[4], src[5], src[6]),
         }
     }
@@ -18,6 +18,7 @@ mod messages;
 pub mod process;
 pub mod string;
 pub mod stringbuffer;
+pub mod sync;
 pub mod syscall;
 
 pub use arch::{ProcessArgs, ProcessInit, ProcessKey, ThreadInit};
@@ -0,0 +1,354 @@
+//! Locks for sharing state between the threads of a process.
+//!
+//! These are built on `futex_wait()` and `futex_wake()`. A lock that nobody
+//! else is holding is taken and released with a single atomic operation, so
+//! the kernel only gets involved when a thread actually has to sleep or wake
+//! someone up.
+
+use crate::{futex_wait, futex_wake};
+use core::cell::UnsafeCell;
+use core::ops::{Deref, DerefMut};
+use core::sync::atomic::{AtomicUsize, Ordering};
+
+const UNLOCKED: usize = 0;
+const LOCKED: usize = 1;
+/// Locked, and there may be threads sleeping on the lock
+const CONTENDED: usize = 2;
+
+/// A mutual exclusion lock protecting a `T`.
+pub struct Mutex<T: ?Sized> {
+    state: AtomicUsize,
+    data: UnsafeCell<T>,
+}
+
+unsafe impl<T: ?Sized + Send> Send for Mutex<T> {}
+unsafe impl<T: ?Sized + Send> Sync for Mutex<T> {}
+
+/// Access to the contents of a `Mutex`. The lock is released when this is
+/// dropped.
+pub struct MutexGuard<'a, T: ?Sized> {
+    mutex: &'a Mutex<T>,
+}
+
+unsafe impl<T: ?Sized + Sync> Sync for MutexGuard<'_, T> {}
+
+impl<T> Mutex<T> {
+    pub const fn new(data: T) -> Mutex<T> {
+        Mutex {
+            state: AtomicUsize::new(UNLOCKED),
+            data: UnsafeCell::new(data),
+        }
+    }
+
+    pub fn into_inner(self) -> T {
+        self.data.into_inner()
+    }
+}
+
+impl<T: ?Sized> Mutex<T> {
+    /// Take the lock, sleeping until it's free if another thread holds it.
+    pub fn lock(&self) -> MutexGuard<'_, T> {
+        if self
+            .state
+            .compare_exchange(UNLOCKED, LOCKED, Ordering::Acquire, Ordering::Relaxed)
+            .is_err()
+        {
+            self.lock_contended();
+        }
+        MutexGuard { mutex: self }
+    }
+
+    /// Take the lock if no other thread holds it.
+    pub fn try_lock(&self) -> Option<MutexGuard<'_, T>> {
+        self.state
+            .compare_exchange(UNLOCKED, LOCKED, Ordering::Acquire, Ordering::Relaxed)
+            .ok()
+            .map(|_| MutexGuard { mutex: self })
+    }
+
+    pub fn get_mut(&mut self) -> &mut T {
+        self.data.get_mut()
+    }
+
+    /// Marking the lock as contended before sleeping makes sure whoever holds
+    /// it now will wake us when they let go. Since we can't tell whether
+    /// anyone else is asleep on it, it stays marked as contended once we get it.
+    fn lock_contended(&self) {
+        while self.state.swap(CONTENDED, Ordering::Acquire) != UNLOCKED {
+            // If this fails, the worst that happens is that we spin.
+            futex_wait(&self.state, CONTENDED).ok();
+        }
+    }
+
+    fn unlock(&self) {
+        if self.state.swap(UNLOCKED, Ordering::Release) == CONTENDED {
+            futex_wake(&self.state, 1).ok();
+        }
+    }
+}
+
+impl<T: Default> Default for Mutex<T> {
+    fn default() -> Mutex<T> {
+        Mutex::new(T::default())
+    }
+}
+
+impl<T: ?Sized> Deref for MutexGuard<'_, T> {
+    type Target = T;
+    fn deref(&self) -> &T {
+        unsafe { &*self.mutex.data.get() }
+    }
+}
+
+impl<T: ?Sized> DerefMut for MutexGuard<'_, T> {
+    fn deref_mut(&mut self) -> &mut T {
+        unsafe { &mut *self.mutex.data.get() }
+    }
+}
+
+impl<T: ?Sized> Drop for MutexGuard<'_, T> {
+    fn drop(&mut self) {
+        self.mutex.unlock();
+    }
+}
+
+/// Lets threads sleep until some state protected by a `Mutex` changes.
+pub struct Condvar {
+    /// Bumped on every notification, so a waiter can tell whether it missed one
+    sequence: AtomicUsize,
+    waiters: AtomicUsize,
+}
+
+impl Condvar {
+    pub const fn new() -> Condvar {
+        Condvar {
+            sequence: AtomicUsize::new(0),
+            waiters: AtomicUsize::new(0),
+        }
+    }
+
+    /// Release the lock and sleep until this is notified, then take the lock
+    /// again. This may return without a notification, so check the condition
+    /// you're waiting for in a loop.
+    pub fn wait<'a, T: ?Sized>(&self, guard: MutexGuard<'a, T>) -> MutexGuard<'a, T> {
+        let mutex = guard.mutex;
+        self.waiters.fetch_add(1, Ordering::SeqCst);
+        let sequence = self.sequence.load(Ordering::SeqCst);
+        drop(guard);
+
+        futex_wait(&self.sequence, sequence).ok();
+
+        self.waiters.fetch_sub(1, Ordering::SeqCst);
+        // Other threads may have been woken along with this one, so the lock
+        // has to be marked as contended.
+        mutex.lock_contended();
+        MutexGuard { mutex }
+    }
+
+    /// Wake one thread that is waiting on this.
+    pub fn notify_one(&self) {
+        self.notify(1);
+    }
+
+    /// Wake every thread that is waiting on this.
+    pub fn notify_all(&self) {
+        self.notify(usize::MAX);
+    }
+
+    fn notify(&self, count: usize) {
+        self.sequence.fetch_add(1, Ordering::SeqCst);
+        if self.waiters.load(Ordering::SeqCst) != 0 {
+            futex_wake(&self.sequence, count).ok();
+        }
+    }
+}
+
+impl Default for Condvar {
+    fn default() -> Condvar {
+        Condvar::new()
+    }
+}
+
+const INCOMPLETE: usize = 0;
+const RUNNING: usize = 1;
+/// Running, and there may be threads sleeping until it's done
+const RUNNING_CONTENDED: usize = 2;
+const COMPLETE: usize = 3;
+
+/// Runs a piece of initialisation exactly once, no matter how many threads
+/// ask for it.
+pub struct Once {
+    state: AtomicUsize,
+}
+
+impl Once {
+    pub const fn new() -> Once {
+        Once {
+            state: AtomicUsize::new(INCOMPLETE),
+        }
+    }
+
+    pub fn is_completed(&self) -> bool {
+        self.state.load(Ordering::Acquire) == COMPLETE
+    }
+
+    /// Run `f` if nothing has run through this `Once` yet. If another thread
+    /// is running its function right now, wait for it to finish first.
+    pub fn call_once<F: FnOnce()>(&self, f: F) {
+        if self.is_completed() {
+            return;
+        }
+        let mut state = match self.state.compare_exchange(
+            INCOMPLETE,
+            RUNNING,
+            Ordering::Acquire,
+            Ordering::Acquire,
+        ) {
+            Ok(_) => {
+                f();
+                if self.state.swap(COMPLETE, Ordering::Release) == RUNNING_CONTENDED {
+                    futex_wake(&self.state, usize::MAX).ok();
+                }
+                return;
+            }
+            Err(state) => state,
+        };
+        while state != COMPLETE {
+            if state == RUNNING {
+                // Make sure the thread that is running `f` wakes us up.
+                if let Err(now) = self.state.compare_exchange(
+                    RUNNING,
+                    RUNNING_CONTENDED,
+                    Ordering::Acquire,
+                    Ordering::Acquire,
+                ) {
+                    state = now;
+                    continue;
+                }
+            }
+            futex_wait(&self.state, RUNNING_CONTENDED).ok();
+            state = self.state.load(Ordering::Acquire);
+        }
+    }
+}
+
+impl Default for Once {
+    fn default() -> Once {
+        Once::new()
+    }
+}
+
+#[cfg(all(test, not(any(target_os = "none", target_os = "xous"))))]
+mod tests {
+    use super::*;
+    use std::sync::mpsc::channel;
+    use std::sync::{Arc, Barrier};
+    use std::thread;
+    use std::time::Duration;
+
+    const THREADS: usize = 8;
+
+    /// Long enough that a missed wakeup fails the test instead of hanging it
+    const TIMEOUT: Duration = Duration::from_secs(5);
+
+    #[test]
+    fn mutex_excludes() {
+        const ROUNDS: usize = 200;
+        let mutex = Arc::new(Mutex::new((0usize, false)));
+        let threads: Vec<_> = (0..THREADS)
+            .map(|_| {
+                let mutex = mutex.clone();
+                thread::spawn(move || {
+                    for _ in 0..ROUNDS {
+                        let mut guard = mutex.lock();
+                        assert!(!guard.1, "two threads held the lock");
+                        guard.1 = true;
+                        // Give other threads a chance to break in
+                        let count = guard.0;
+                        thread::yield_now();
+                        guard.0 = count + 1;
+                        guard.1 = false;
+                    }
+                })
+            })
+            .collect();
+        for thread in threads {
+            thread.join().unwrap();
+        }
+        assert_eq!(mutex.lock().0, THREADS * ROUNDS);
+        assert!(mutex.try_lock().is_some());
+    }
+
+    /// Start `THREADS` threads that each sleep on the `Condvar` until the
+    /// count lets one of them go, and return once they're all waiting.
+    fn start_waiters(state: &Arc<(Mutex<usize>, Condvar)>) -> std::sync::mpsc::Receiver<()> {
+        let (done_send, done_recv) = channel();
+        for _ in 0..THREADS {
+            let state = state.clone();
+            let done_send = done_send.clone();
+            thread::spawn(move || {
+                let (ready, condvar) = &*state;
+                let mut ready = ready.lock();
+                while *ready == 0 {
+                    ready = condvar.wait(ready);
+                }
+                *ready -= 1;
+                drop(ready);
+                done_send.send(()).unwrap();
+            });
+        }
+        while state.1.waiters.load(Ordering::SeqCst) != THREADS {
+            thread::yield_now();
+        }
+        done_recv
+    }
+
+    #[test]
+    fn condvar_notify_one() {
+        let state = Arc::new((Mutex::new(0), Condvar::new()));
+        let done = start_waiters(&state);
+        for _ in 0..THREADS {
+            *state.0.lock() += 1;
+            state.1.notify_one();
+            done.recv_timeout(TIMEOUT).expect("notify_one didn't wake a waiter");
+        }
+    }
+
+    #[test]
+    fn condvar_notify_all() {
+        let state = Arc::new((Mutex::new(0), Condvar::new()));
+        let done = start_waiters(&state);
+        *state.0.lock() = THREADS;
+        state.1.notify_all();
+        for _ in 0..THREADS {
+            done.recv_timeout(TIMEOUT).expect("notify_all didn't wake every waiter");
+        }
+    }
+
+    #[test]
+    fn once_runs_once() {
+        let once = Arc::new(Once::new());
+        let runs = Arc::new(AtomicUsize::new(0));
+        let barrier = Arc::new(Barrier::new(THREADS));
+        let threads: Vec<_> = (0..THREADS)
+            .map(|_| {
+                let (once, runs, barrier) = (once.clone(), runs.clone(), barrier.clone());
+                thread::spawn(move || {
+                    barrier.wait();
+                    once.call_once(|| {
+                        // Keep the others waiting on it for a while
+                        thread::sleep(Duration::from_millis(20));
+                        runs.fetch_add(1, Ordering::SeqCst);
+                    });
+                    // Nobody gets past `call_once()` before it has run
+                    assert!(once.is_completed());
+                    assert_eq!(runs.load(Ordering::SeqCst), 1);
+                })
+            })
+            .collect();
+        for thread in threads {
+            thread.join().unwrap();
+        }
+        once.call_once(|| panic!("ran a second time"));
+    }
+}
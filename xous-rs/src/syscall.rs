@@ -1,9 +1,10 @@
 use crate::{
     pid_from_usize, CpuID, Error, MemoryAddress, MemoryFlags, MemoryMessage, MemoryRange,
     MemorySize, MemoryType, Message, MessageEnvelope, MessageSender, ProcessArgs, ProcessInit,
-    Result, ScalarMessage, SysCallResult, ThreadInit, CID, PID, SID, TID,
+    ProcessStats, Result, ScalarMessage, SysCallResult, ThreadInit, TraceEvent, CID, PID, SID, TID,
 };
 use core::convert::{TryFrom, TryInto};
+use core::sync::atomic::AtomicUsize;
 
 // use num_derive::FromPrimitive;
 // use num_traits::FromPrimitive;
@@ -321,6 +322,103 @@ pub enum SysCall {
     /// Waits for a thread to finish, and returns the return value of that thread.
     JoinThread(TID),
 
+    /// Send a batch of non-blocking scalar messages to a server in a single
+    /// call. The range holds an array of `ScalarMessage` structures, which
+    /// are queued in order. Returns the number of messages that were sent,
+    /// which may be fewer than the number in the batch if the server's queue
+    /// filled up.
+    ///
+    /// # Errors
+    ///
+    /// * **ServerNotFound**: The server does not exist so the connection is now invalid
+    /// * **BadAddress**: The range is not mapped in this process
+    /// * **BadAlignment**: The range is not a whole number of `ScalarMessage`s
+    /// * **ServerQueueFull**: The queue in the server is full, and no messages were sent
+    SendMessageBatch(CID, MemoryRange),
+
+    /// Lend memory to a server without giving up access to it. The server
+    /// receives a `MutableBorrow` message and may use the memory until it
+    /// returns it, while the caller is still able to read and write it. This
+    /// call blocks until the memory is returned, so it is generally made from
+    /// a thread dedicated to keeping the region shared. The region may not be
+    /// unmapped, moved, or lent again while it is shared.
+    ///
+    /// # Errors
+    ///
+    /// * **ServerNotFound**: The server does not exist so the connection is now invalid
+    /// * **ShareViolation**: The memory is already being shared or lent
+    /// * **BadAlignment**: The memory is not page-aligned
+    /// * **UnhandledSyscall**: This platform is unable to share memory
+    ShareMemory(CID, MemoryMessage),
+
+    /// Set the scheduling priority of a thread in the current process. Threads
+    /// with a higher priority are run first, and threads start out with the
+    /// priority of the thread that created them. Priorities above
+    /// `THREAD_PRIORITY_MAX` are treated as `THREAD_PRIORITY_MAX`. Only PID 1
+    /// and the services it started may set a priority above
+    /// `THREAD_PRIORITY_DEFAULT`.
+    ///
+    /// # Errors
+    ///
+    /// * **InvalidThread**: The thread ID is out of range
+    /// * **AccessDenied**: The priority is above `THREAD_PRIORITY_DEFAULT`
+    ///   and the caller isn't privileged
+    SetThreadPriority(TID, usize),
+
+    /// Choose which kinds of event the kernel records in its trace ring. Each
+    /// bit of the mask enables one `TraceEventKind`. Only PID 1 and the
+    /// services it started may trace. The first of those to set a nonzero
+    /// mask owns the ring, and is the only one that may change the mask or
+    /// read events until it sets the mask back to 0 or exits. Returns the
+    /// previous mask.
+    ///
+    /// # Errors
+    ///
+    /// * **AccessDenied**: The caller may not trace, or another process owns
+    ///   the trace ring
+    /// * **UnhandledSyscall**: The kernel was built without tracing
+    SetTraceMask(usize),
+
+    /// Take the oldest event out of the kernel trace ring. Returns
+    /// `Result::None` if the ring is empty.
+    ///
+    /// # Errors
+    ///
+    /// * **AccessDenied**: The current process doesn't own the trace ring
+    /// * **UnhandledSyscall**: The kernel was built without tracing
+    ReadTrace,
+
+    /// Get the counters the kernel keeps for a process. Any process may ask
+    /// about itself, but only PID 1 and the services it started may ask about
+    /// other processes.
+    ///
+    /// # Errors
+    ///
+    /// * **AccessDenied**: The process is another one, and the caller isn't
+    ///   privileged
+    /// * **ProcessNotFound**: The process does not exist
+    GetProcessStats(PID),
+
+    /// Park the current thread until another thread in this process calls
+    /// `FutexWake` on the word at `address`. If the word no longer holds
+    /// `expected` the call returns straight away, so a wakeup can't be
+    /// missed between checking the word and going to sleep.
+    ///
+    /// ## Arguments
+    ///
+    /// * **address**: The address of a word in this process
+    /// * **expected**: The value the word must hold for the thread to sleep
+    ///
+    /// # Errors
+    ///
+    /// * **BadAlignment**: The address isn't aligned to a word
+    /// * **BadAddress**: The address isn't in userspace memory
+    FutexWait(usize /* address */, usize /* expected */),
+
+    /// Wake up to `count` threads in this process that are parked in
+    /// `FutexWait` on `address`. Returns the number of threads that were woken.
+    FutexWake(usize /* address */, usize /* count */),
+
     /// This syscall does not exist. It captures all possible
     /// arguments so detailed analysis can be performed.
     Invalid(usize, usize, usize, usize, usize, usize, usize),
@@ -363,6 +461,14 @@ pub enum SysCallNumber {
     DestroyServer = 34,
     Disconnect = 35,
     JoinThread = 36,
+    SendMessageBatch = 37,
+    ShareMemory = 38,
+    SetThreadPriority = 39,
+    SetTraceMask = 40,
+    ReadTrace = 41,
+    GetProcessStats = 42,
+    FutexWait = 43,
+    FutexWake = 44,
     Invalid,
 }
 
@@ -405,6 +511,14 @@ impl SysCallNumber {
             34 => DestroyServer,
             35 => Disconnect,
             36 => JoinThread,
+            37 => SendMessageBatch,
+            38 => ShareMemory,
+            39 => SetThreadPriority,
+            40 => SetTraceMask,
+            41 => ReadTrace,
+            42 => GetProcessStats,
+            43 => FutexWait,
+            44 => FutexWake,
             _ => Invalid,
         }
     }
@@ -736,6 +850,77 @@ impl SysCall {
                 0,
                 0,
             ],
+            SysCall::SendMessageBatch(cid, range) => [
+                SysCallNumber::SendMessageBatch as usize,
+                *cid as usize,
+                range.as_ptr() as usize,
+                range.len(),
+                0,
+                0,
+                0,
+                0,
+            ],
+            SysCall::ShareMemory(cid, mm) => [
+                SysCallNumber::ShareMemory as usize,
+                *cid as usize,
+                mm.id as usize,
+                mm.buf.as_ptr() as usize,
+                mm.buf.len(),
+                mm.offset.map(|x| x.get()).unwrap_or(0) as usize,
+                mm.valid.map(|x| x.get()).unwrap_or(0) as usize,
+                0,
+            ],
+            SysCall::SetThreadPriority(tid, priority) => [
+                SysCallNumber::SetThreadPriority as usize,
+                *tid as usize,
+                *priority,
+                0,
+                0,
+                0,
+                0,
+                0,
+            ],
+            SysCall::SetTraceMask(mask) => [
+                SysCallNumber::SetTraceMask as usize,
+                *mask,
+                0,
+                0,
+                0,
+                0,
+                0,
+                0,
+            ],
+            SysCall::ReadTrace => [SysCallNumber::ReadTrace as usize, 0, 0, 0, 0, 0, 0, 0],
+            SysCall::GetProcessStats(pid) => [
+                SysCallNumber::GetProcessStats as usize,
+                pid.get() as usize,
+                0,
+                0,
+                0,
+                0,
+                0,
+                0,
+            ],
+            SysCall::FutexWait(address, expected) => [
+                SysCallNumber::FutexWait as usize,
+                *address,
+                *expected,
+                0,
+                0,
+                0,
+                0,
+                0,
+            ],
+            SysCall::FutexWake(address, count) => [
+                SysCallNumber::FutexWake as usize,
+                *address,
+                *count,
+                0,
+                0,
+                0,
+                0,
+                0,
+            ],
             SysCall::Invalid(a1, a2, a3, a4, a5, a6, a7) => [
                 SysCallNumber::Invalid as usize,
                 *a1,
@@ -898,6 +1083,26 @@ impl SysCall {
             }
             SysCallNumber::Disconnect => SysCall::Disconnect(a1 as _),
             SysCallNumber::JoinThread => SysCall::JoinThread(a1 as _),
+            SysCallNumber::SendMessageBatch => {
+                SysCall::SendMessageBatch(a1 as _, unsafe { MemoryRange::new(a2, a3) }?)
+            }
+            SysCallNumber::ShareMemory => SysCall::ShareMemory(
+                a1 as _,
+                MemoryMessage {
+                    id: a2,
+                    buf: unsafe { MemoryRange::new(a3, a4) }?,
+                    offset: MemorySize::new(a5),
+                    valid: MemorySize::new(a6),
+                },
+            ),
+            SysCallNumber::SetThreadPriority => SysCall::SetThreadPriority(a1 as _, a2),
+            SysCallNumber::SetTraceMask => SysCall::SetTraceMask(a1),
+            SysCallNumber::ReadTrace => SysCall::ReadTrace,
+            SysCallNumber::GetProcessStats => {
+                SysCall::GetProcessStats(PID::new(a1 as _).ok_or(Error::InvalidSyscall)?)
+            }
+            SysCallNumber::FutexWait => SysCall::FutexWait(a1, a2),
+            SysCallNumber::FutexWake => SysCall::FutexWake(a1, a2),
             SysCallNumber::Invalid => SysCall::Invalid(a1, a2, a3, a4, a5, a6, a7),
         })
     }
@@ -911,7 +1116,7 @@ impl SysCall {
                     Message::Move(_) | Message::Borrow(_) | Message::MutableBorrow(_)
                 )
             }
-            SysCall::ReturnMemory(_, _, _, _) => true,
+            SysCall::ReturnMemory(_, _, _, _) | SysCall::SendMessageBatch(_, _) => true,
             _ => false,
         }
     }
@@ -960,7 +1165,9 @@ impl SysCall {
                 | Message::MutableBorrow(memory_message) => Some(memory_message.buf),
                 _ => None,
             },
-            SysCall::ReturnMemory(_, range, _, _) => Some(*range),
+            SysCall::ReturnMemory(_, range, _, _) | SysCall::SendMessageBatch(_, range) => {
+                Some(*range)
+            }
             _ => None,
         }
     }
@@ -1312,6 +1519,38 @@ pub fn try_send_message(connection: CID, message: Message) -> core::result::Resu
     }
 }
 
+/// Send a batch of non-blocking scalar messages to a server with a single
+/// syscall. Messages are delivered in order. If the server's queue fills up
+/// partway through, the remaining messages are not sent; the number that were
+/// sent is returned so the caller may retry the rest.
+///
+/// # Errors
+///
+/// * **ServerNotFound**: The server does not exist so the connection is now invalid
+/// * **ServerQueueFull**: The queue in the server is full, and no messages were sent
+pub fn send_message_batch(
+    connection: CID,
+    messages: &[ScalarMessage],
+) -> core::result::Result<usize, Error> {
+    if messages.is_empty() {
+        return Ok(0);
+    }
+    let range = unsafe {
+        MemoryRange::new(
+            messages.as_ptr() as usize,
+            messages.len() * core::mem::size_of::<ScalarMessage>(),
+        )
+    }?;
+    let result = rsyscall(SysCall::SendMessageBatch(connection, range))?;
+    if let Result::Scalar1(sent) = result {
+        Ok(sent)
+    } else if let Result::Error(e) = result {
+        Err(e)
+    } else {
+        Err(Error::InternalError)
+    }
+}
+
 /// Connect to a server on behalf of another process. This can be used by a name
 /// resolution server to securely create connections without disclosing a SID.
 ///
@@ -1354,6 +1593,29 @@ pub fn send_message(connection: CID, message: Message) -> core::result::Result<R
     }
 }
 
+/// Lend memory to a server while keeping access to it, allowing both sides to
+/// use the region at the same time. The server sees this as a `MutableBorrow`.
+/// This blocks until the server returns the memory.
+///
+/// # Errors
+///
+/// * **ServerNotFound**: The server does not exist so the connection is now invalid
+/// * **ShareViolation**: The memory is already being shared or lent
+/// * **UnhandledSyscall**: This platform is unable to share memory
+pub fn share_memory(
+    connection: CID,
+    message: MemoryMessage,
+) -> core::result::Result<Result, Error> {
+    let result = rsyscall(SysCall::ShareMemory(connection, message))?;
+    if let Result::MemoryReturned(offset, valid) = result {
+        Ok(Result::MemoryReturned(offset, valid))
+    } else if let Result::Error(e) = result {
+        Err(e)
+    } else {
+        Err(Error::InternalError)
+    }
+}
+
 pub fn terminate_process(exit_code: u32) -> ! {
     rsyscall(SysCall::TerminateProcess(exit_code)).expect("terminate_process returned an error");
     panic!("process didn't terminate");
@@ -1555,6 +1817,101 @@ pub fn current_pid() -> core::result::Result<PID, Error> {
     })
 }
 
+/// Set the scheduling priority of thread `tid` in the current process. Only
+/// PID 1 and the services it started may go above `THREAD_PRIORITY_DEFAULT`.
+///
+/// # Errors
+///
+/// * **InvalidThread**: The thread ID is out of range
+/// * **AccessDenied**: The priority is above `THREAD_PRIORITY_DEFAULT` and
+///   this process isn't privileged
+pub fn set_thread_priority(tid: TID, priority: usize) -> core::result::Result<(), Error> {
+    rsyscall(SysCall::SetThreadPriority(tid, priority)).and_then(|result| {
+        if let Result::Ok = result {
+            Ok(())
+        } else if let Result::Error(e) = result {
+            Err(e)
+        } else {
+            Err(Error::InternalError)
+        }
+    })
+}
+
+/// Choose which kinds of event the kernel records in its trace ring, and
+/// return the previous mask. Build the mask out of `TraceEventKind::mask()`.
+/// Setting a nonzero mask claims the ring for this process, and setting it to
+/// 0 stops tracing and gives the ring up again. Only PID 1 and the services
+/// it started may trace.
+///
+/// # Errors
+///
+/// * **AccessDenied**: This process may not trace, or another process owns
+///   the trace ring
+/// * **UnhandledSyscall**: The kernel was built without tracing
+pub fn set_trace_mask(mask: usize) -> core::result::Result<usize, Error> {
+    rsyscall(SysCall::SetTraceMask(mask)).and_then(|result| {
+        if let Result::Scalar1(previous) = result {
+            Ok(previous)
+        } else if let Result::Error(e) = result {
+            Err(e)
+        } else {
+            Err(Error::InternalError)
+        }
+    })
+}
+
+/// Take the oldest event out of the kernel trace ring, or return `None` if
+/// there aren't any. Only the process that set the trace mask may do this.
+///
+/// # Errors
+///
+/// * **AccessDenied**: The current process doesn't own the trace ring
+/// * **UnhandledSyscall**: The kernel was built without tracing
+pub fn read_trace() -> core::result::Result<Option<TraceEvent>, Error> {
+    rsyscall(SysCall::ReadTrace).and_then(|result| match result {
+        Result::TraceEvent(ts_lo, ts_hi, kind, pid, tid, arg0, arg1) => {
+            TraceEvent::from_args(ts_lo, ts_hi, kind, pid, tid, arg0, arg1)
+                .map(Some)
+                .ok_or(Error::InternalError)
+        }
+        Result::None => Ok(None),
+        Result::Error(e) => Err(e),
+        _ => Err(Error::InternalError),
+    })
+}
+
+/// Get the CPU time, message and memory counters for process `pid`. Only PID 1
+/// and the services it started may ask about a process other than their own.
+///
+/// # Errors
+///
+/// * **AccessDenied**: `pid` is another process, and this one isn't privileged
+/// * **ProcessNotFound**: The process does not exist
+pub fn process_stats(pid: PID) -> core::result::Result<ProcessStats, Error> {
+    rsyscall(SysCall::GetProcessStats(pid)).and_then(|result| match result {
+        Result::ProcessStats(cpu_lo, cpu_hi, messages_sent, pages_owned) => Ok(ProcessStats {
+            cpu_time: (cpu_lo as u32 as u64) | ((cpu_hi as u64) << 32),
+            messages_sent,
+            pages_owned,
+        }),
+        Result::Error(e) => Err(e),
+        _ => Err(Error::InternalError),
+    })
+}
+
+/// Park the current thread until `futex_wake()` is called on `futex`, as long
+/// as `futex` still holds `expected`. This may return early, so callers must
+/// check the value again when it does.
+pub fn futex_wait(futex: &AtomicUsize, expected: usize) -> core::result::Result<(), Error> {
+    crate::arch::futex_wait(futex, expected)
+}
+
+/// Wake up to `count` threads that are parked in `futex_wait()` on `futex`,
+/// returning the number of threads that were woken.
+pub fn futex_wake(futex: &AtomicUsize, count: usize) -> core::result::Result<usize, Error> {
+    crate::arch::futex_wake(futex, count)
+}
+
 /// Get the current thread ID
 pub fn current_tid() -> core::result::Result<TID, Error> {
     rsyscall(SysCall::GetThreadId).and_then(|result| {
@@ -128,6 +128,7 @@ fn try_main() -> Result<(), DynError> {
         Some("benchmark") => {
             build_hw_image(false, env::args().nth(2), &benchmark_pkgs, lkey, kkey, None)?
         }
+        Some("benchmark-run") => run(false, &benchmark_pkgs)?,
         Some("minimal") => {
             build_hw_image(false, env::args().nth(2), &minimal_pkgs, lkey, kkey, None)?
         }
@@ -180,6 +181,7 @@ hw-image [soc.svd] [loader.key] [kernel.key]   builds an image for real hardware
 run                     runs a release build using a hosted environment
 debug                   runs a debug build using a hosted environment
 benchmark [soc.svd]     builds a benchmarking image for real hardware
+benchmark-run           runs the benchmarks using a hosted environment
 minimal [soc.svd]       builds a minimal image for API testing
 cbtest                  builds an image for callback testing
 trng-test [soc.svd]     builds an image for TRNG testing - urandom source seeded by TRNG+AV
@@ -190,6 +192,8 @@ burn-kernel             invoke the `usb_update.py` utility to burn the kernel
 burn-loader             invoke the `usb_update.py` utility to burn the loader
 burn-soc                invoke the `usb_update.py` utility to burn the SoC gateware
 
+Set XOUS_COMPRESS_IMAGE to store the programs in an image compressed.
+
 Please refer to tools/README_UPDATE.md for instructions on how to set up `usb_update.py`
 "
     )
@@ -568,6 +572,12 @@ fn create_image(
         args.push(i.to_str().ok_or(BuildError::PathConversionError)?);
     }
 
+    // Compressed programs are smaller to read out of FLASH and to verify at boot, but they
+    // also have to be expanded, so this is opt-in until it's been shown to boot faster.
+    if env::var_os("XOUS_COMPRESS_IMAGE").is_some() {
+        args.push("--compress");
+    }
+
     match memory_spec {
         MemorySpec::SvdFile(ref s) => {
             args.push("--svd");